@@ -1,8 +1,11 @@
+#include "vertex_format.hlsli"
+
 #define ROOTSIG \
   "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT), " \
-  "DescriptorTable(CBV(b0, numDescriptors=1)), " \
-  "DescriptorTable(CBV(b1, numDescriptors=1)), " \
+  "CBV(b0), " \
+  "CBV(b1), " \
   "DescriptorTable(SRV(t0, numDescriptors=1, flags = DESCRIPTORS_VOLATILE | DATA_VOLATILE)), " \
+  "RootConstants(num32BitConstants=8, b2), " \
   "StaticSampler(s0," \
         "addressU = TEXTURE_ADDRESS_CLAMP," \
         "addressV = TEXTURE_ADDRESS_CLAMP," \
@@ -42,18 +45,18 @@ float remap(float value, float inMin, float inMax, float outMin, float outMax)
 }
 
 [RootSignature(ROOTSIG)]
-PSInput VSMain(float4 position : POSITION, float3 normal : NORMAL, float2 uv : TEXCOORD)
+PSInput VSMain(VSInput input)
 {
     PSInput result;
     
-    float4 pos = float4(position.xyz, 1.0);
+    float4 pos = float4(DecodePosition(input), 1.0);
     float4 worldPos = mul(pos, m_model);
     float4 viewPos = mul(worldPos, s_view);
     float4 clipPos = mul(viewPos, s_projection);
     
     result.position = clipPos;
-    result.normal = mul(float4(normal, 0.0), m_model).xyz;
-    result.uv = uv;
+    result.normal = mul(float4(DecodeNormal(input), 0.0), m_model).xyz;
+    result.uv = input.uv;
 
     return result;
 }
@@ -80,6 +83,11 @@ float4 PSMain(PSInput input) : SV_TARGET
     float2 uv = frac(input.uv); // Ensure UVs stay in [0,1] range
     
     float4 color = g_texture.Sample(g_sampler, uv) * float4(lighting, 1.0);
+
+#ifdef ALPHA_TEST
+    // cutout materials, compiled in only for the ALPHA_TEST variant
+    clip(color.a - 0.5f);
+#endif
   
     return color;
 }
\ No newline at end of file
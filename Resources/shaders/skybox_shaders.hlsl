@@ -1,8 +1,11 @@
+#include "vertex_format.hlsli"
+
 #define ROOTSIG \
   "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT), " \
-  "DescriptorTable(CBV(b0, numDescriptors=1)), " \
-  "DescriptorTable(CBV(b1, numDescriptors=1)), " \
+  "CBV(b0), " \
+  "CBV(b1), " \
   "DescriptorTable(SRV(t0, numDescriptors=1, flags = DESCRIPTORS_VOLATILE | DATA_VOLATILE)), " \
+  "RootConstants(num32BitConstants=8, b2), " \
   "StaticSampler(s0," \
         "addressU = TEXTURE_ADDRESS_CLAMP," \
         "addressV = TEXTURE_ADDRESS_CLAMP," \
@@ -36,7 +39,7 @@ struct PSInput
 };
 
 [RootSignature(ROOTSIG)]
-PSInput VSMain(float4 position : POSITION, float3 normal : NORMAL, float2 uv : TEXCOORD)
+PSInput VSMain(VSInput input)
 {
     PSInput result;
     
@@ -45,7 +48,7 @@ PSInput VSMain(float4 position : POSITION, float3 normal : NORMAL, float2 uv : T
     viewNoTranslation._42 = 0;
     viewNoTranslation._43 = 0;
     
-    float4 pos = float4(position.xyz, 1.0);
+    float4 pos = float4(DecodePosition(input), 1.0);
     float4 viewPos = mul(pos, viewNoTranslation);
     float4 clipPos = mul(viewPos, s_projection);
     
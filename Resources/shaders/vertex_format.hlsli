@@ -0,0 +1,61 @@
+#ifndef VERTEX_FORMAT_HLSLI
+#define VERTEX_FORMAT_HLSLI
+
+// mesh vertex input, COMPRESSED_VERTEX is defined by the ShaderManager when
+// VertexFormat is "Compressed" in Shaders.json
+// compressed vertices are 16 bytes: position R16G16B16A16_UNORM relative to the
+// mesh bounds, normal R16G16_SNORM octahedral, uv R16G16_FLOAT
+
+// mesh bounds, root constants set per draw
+cbuffer VertexDequantization : register(b2)
+{
+    float3 v_positionMin;
+    float v_padding0;
+    float3 v_positionExtent;
+    float v_padding1;
+};
+
+#ifdef COMPRESSED_VERTEX
+struct VSInput
+{
+    float4 position : POSITION;
+    float2 normal : NORMAL;
+    float2 uv : TEXCOORD;
+};
+#else
+struct VSInput
+{
+    float3 position : POSITION;
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD;
+};
+#endif
+
+float3 OctDecode(float2 encoded)
+{
+    float3 normal = float3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // unfold the lower half
+    float t = saturate(-normal.z);
+    normal.xy += (normal.xy >= 0.0) ? -t : t;
+    return normalize(normal);
+}
+
+float3 DecodePosition(VSInput input)
+{
+#ifdef COMPRESSED_VERTEX
+    return v_positionMin + input.position.xyz * v_positionExtent;
+#else
+    return input.position;
+#endif
+}
+
+float3 DecodeNormal(VSInput input)
+{
+#ifdef COMPRESSED_VERTEX
+    return OctDecode(input.normal);
+#else
+    return input.normal;
+#endif
+}
+
+#endif
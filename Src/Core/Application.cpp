@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "Application.h"
 
+#include "Core/JobSystem.h"
+
 #include "Graphics/DX12Interface.h"
 #include "Graphics/ResourceManager.h"
 #include "Graphics/PSOManager.h"
@@ -12,6 +14,7 @@
 
 #include "Shaders/ShaderManager.h"
 
+#include <chrono>
 #include <random>
 
 #define TINYOBJLOADER_IMPLEMENTATION // define this in only *one* .cc
@@ -33,6 +36,11 @@ namespace Core
 
   void Application::OnInit()
   {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // create the job system first, this thread becomes its main thread
+    Core::JobSystem::Instance();
+
     // Create DX12Interface, It will create Device and factory
     Graphics::DX12Interface::Get();
 
@@ -55,8 +63,14 @@ namespace Core
     // create render graph
     Rendering::RenderGraph::Instance();
 
-    // create scene graph
+    // create scene graph, its models keep loading while frames are rendered
     Scene::SceneGraph::Instance();
+    Scene::SceneGraph::Instance().SetLoadedCallback([start]() {
+      const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+      char message[256];
+      snprintf(message, sizeof(message), "[STARTUP] scene ready %.1f ms after init\n", milliseconds);
+      OutputDebugStringA(message);
+    });
 
     // this should be done on the scene graph
     Scene::SceneGraph::Instance().GetSkybox()->LoadModel("Resources/models/cube.obj");
@@ -70,10 +84,38 @@ namespace Core
 
   void Application::OnUpdate()
   {
-    Scene::SceneGraph::Instance().UpdateScene();
+    // what workers handed back to the main thread
+    Core::JobSystem::Instance().RunMainThreadJobs();
+
+    // fire and forget jobs that failed, reported here instead of taking the app down
+    size_t failedJobs = 0;
+    if (auto exception = Core::JobSystem::Instance().TakeUnhandledException(&failedJobs))
+    {
+      char message[512];
+      try
+      {
+        std::rethrow_exception(exception);
+      } catch (const std::exception& error)
+      {
+        snprintf(message, sizeof(message), "[JOBS] %zu jobs without a counter threw, the first one: %s\n", failedJobs, error.what());
+      } catch (...)
+      {
+        snprintf(message, sizeof(message), "[JOBS] %zu jobs without a counter threw\n", failedJobs);
+      }
+      OutputDebugStringA(message);
+    }
 
-    for (auto model : Scene::SceneGraph::Instance().GetModels())
-      model->UpdateModel();
+    // shaders recompiled after their files changed, swapped before this frame records
+    // the old pipeline states live until the frames in flight are done, no need to wait for the GPU
+    auto reloaded = Shaders::ShaderManager::Instance().UpdateHotReload();
+    if (!reloaded.empty())
+    {
+      Graphics::PSOManager::Instance().RebuildPSOs(reloaded);
+      Rendering::RenderGraph::Instance().UpdatePipelineStates();
+    }
+
+    // models are updated by the scene
+    Scene::SceneGraph::Instance().UpdateScene();
   }
 
   void Application::OnRender()
@@ -84,7 +126,11 @@ namespace Core
 
     // execute passes in order
     for (auto pass : Rendering::RenderGraph::Instance().GetPasses())
+    {
+      m_context->ResetCounters();
       pass->Render(m_context.get());
+      pass->UpdateCounters(m_context->GetCounters());
+    }
 
     // transition to present state
     m_context->EndFrame();
@@ -0,0 +1,403 @@
+#include "stdafx.h"
+#include "JobSystem.h"
+
+#include <utility>
+
+// helpers
+namespace
+{
+  // the system and the deque of the current thread
+  thread_local const Core::JobSystem* t_system = nullptr;
+  thread_local int t_index = -1;
+}
+
+namespace Core
+{
+  struct Job
+  {
+    std::function<void()> function;
+    JobCounter* counter;
+    JobAffinity affinity;
+  };
+
+  WorkStealingDeque::WorkStealingDeque()
+    : m_top(0)
+    , m_bottom(0)
+    , m_jobs()
+  {
+    for (auto& job : m_jobs)
+      job.store(nullptr, std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque::~WorkStealingDeque()
+  {
+  }
+
+  bool WorkStealingDeque::Push(Job* job)
+  {
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    const int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= static_cast<int64_t>(CAPACITY))
+      return false;
+
+    m_jobs[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    // publishes the job to the thieves reading the bottom
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+  }
+
+  Job* WorkStealingDeque::Pop()
+  {
+    // claims the last job before looking at the top, thieves see the claim first
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_seq_cst);
+
+    if (top > bottom)
+    {
+      // empty
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    Job* job = m_jobs[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+      // the last job, a thief may be taking it too
+      if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        job = nullptr;
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  Job* WorkStealingDeque::Steal()
+  {
+    int64_t top = m_top.load(std::memory_order_seq_cst);
+    const int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+    if (top >= bottom)
+      return nullptr;
+
+    // may be overwritten once the top moved, the exchange fails then
+    Job* job = m_jobs[top & (CAPACITY - 1)].load(std::memory_order_acquire);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return nullptr;
+    return job;
+  }
+
+  JobCounter::JobCounter()
+    : m_value(0)
+    , m_mutex()
+    , m_continuations()
+    , m_exception()
+  {
+  }
+
+  JobCounter::~JobCounter()
+  {
+  }
+
+  unsigned JobSystem::DefaultWorkerCount()
+  {
+    // zero when unknown
+    const unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+  }
+
+  JobSystem::JobSystem(unsigned workerCount)
+    : m_deques()
+    , m_workers()
+    , m_sharedMutex()
+    , m_sharedJobs()
+    , m_mainThreadMutex()
+    , m_mainThreadJobs()
+    , m_pending(0)
+    , m_sleeping(0)
+    , m_sleepMutex()
+    , m_wake()
+    , m_stop(false)
+    , m_unhandledMutex()
+    , m_unhandled()
+    , m_unhandledCount(0)
+  {
+    for (unsigned i = 0; i <= workerCount; ++i)
+      m_deques.push_back(std::make_unique<WorkStealingDeque>());
+
+    t_system = this;
+    t_index = 0;
+
+    m_workers.reserve(workerCount);
+    for (unsigned i = 0; i < workerCount; ++i)
+      m_workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+  }
+
+  JobSystem::~JobSystem()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_sleepMutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers)
+      worker.join();
+
+    for (auto& deque : m_deques)
+      while (Job* job = deque->Pop())
+        delete job;
+    for (Job* job : m_sharedJobs)
+      delete job;
+    for (Job* job : m_mainThreadJobs)
+      delete job;
+
+    if (t_system == this)
+    {
+      t_system = nullptr;
+      t_index = -1;
+    }
+  }
+
+  void JobSystem::Run(std::function<void()> function, JobCounter* counter, JobAffinity affinity)
+  {
+    if (counter)
+      counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    Schedule(new Job{ std::move(function), counter, affinity });
+  }
+
+  void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter, JobAffinity affinity)
+  {
+    if (counter)
+      counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    Job* job = new Job{ std::move(function), counter, affinity };
+
+    {
+      // the dependency reaches zero holding its mutex, the job is either queued there or run now
+      std::lock_guard<std::mutex> lock(dependency.m_mutex);
+      if (!dependency.IsDone())
+      {
+        dependency.m_continuations.push_back(job);
+        return;
+      }
+    }
+    Schedule(job);
+  }
+
+  void JobSystem::Wait(JobCounter& counter)
+  {
+    const int index = GetThreadIndex();
+
+    // only jobs any thread can run, main thread jobs may touch what the caller is in the middle of
+    unsigned idle = 0;
+    while (!counter.IsDone())
+    {
+      if (Job* job = FindJob(index))
+      {
+        Execute(job);
+        idle = 0;
+      } else if (++idle > IDLE_SPINS)
+      {
+        // what is left runs elsewhere
+        std::this_thread::yield();
+      }
+    }
+
+    // the last job may still hold the mutex, the counter can go away once it is released
+    std::exception_ptr exception;
+    {
+      std::lock_guard<std::mutex> lock(counter.m_mutex);
+      exception = std::exchange(counter.m_exception, nullptr);
+    }
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+
+  void JobSystem::ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& body)
+  {
+    if (count == 0)
+      return;
+    batchSize = batchSize > 0 ? batchSize : 1;
+
+    // the calling thread takes the first batch
+    JobCounter counter;
+    for (size_t begin = batchSize; begin < count; begin += batchSize)
+    {
+      const size_t end = count - begin > batchSize ? begin + batchSize : count;
+      Run([&body, begin, end]() { body(begin, end); }, &counter);
+    }
+
+    // the other batches use the body and the counter, they finish before anything is thrown
+    std::exception_ptr exception;
+    try
+    {
+      body(0, count > batchSize ? batchSize : count);
+    } catch (...)
+    {
+      exception = std::current_exception();
+    }
+    try
+    {
+      Wait(counter);
+    } catch (...)
+    {
+      if (!exception)
+        exception = std::current_exception();
+    }
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+
+  void JobSystem::RunMainThreadJobs()
+  {
+    std::vector<Job*> jobs;
+    {
+      std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+      jobs.swap(m_mainThreadJobs);
+    }
+    // jobs queued by these wait for the next call
+    for (Job* job : jobs)
+      Execute(job);
+  }
+
+  std::exception_ptr JobSystem::TakeUnhandledException(size_t* count)
+  {
+    std::lock_guard<std::mutex> lock(m_unhandledMutex);
+    if (count)
+      *count = m_unhandledCount;
+    m_unhandledCount = 0;
+    return std::exchange(m_unhandled, nullptr);
+  }
+
+  void JobSystem::WorkerLoop(unsigned index)
+  {
+    t_system = this;
+    t_index = static_cast<int>(index);
+
+    unsigned idle = 0;
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+      if (Job* job = FindJob(t_index))
+      {
+        Execute(job);
+        idle = 0;
+        continue;
+      }
+      if (++idle <= IDLE_SPINS)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+
+      // checked after counting as sleeping, a job scheduled meanwhile sees the sleeper and wakes it
+      std::unique_lock<std::mutex> lock(m_sleepMutex);
+      m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+      m_wake.wait(lock, [this]() { return m_stop.load(std::memory_order_relaxed) || m_pending.load(std::memory_order_seq_cst) > 0; });
+      m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+      idle = 0;
+    }
+
+    t_system = nullptr;
+    t_index = -1;
+  }
+
+  void JobSystem::Schedule(Job* job)
+  {
+    if (job->affinity == MainThread)
+    {
+      std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+      m_mainThreadJobs.push_back(job);
+      return;
+    }
+
+    m_pending.fetch_add(1, std::memory_order_seq_cst);
+    const int index = GetThreadIndex();
+    if (index < 0 || !m_deques[index]->Push(job))
+    {
+      std::lock_guard<std::mutex> lock(m_sharedMutex);
+      m_sharedJobs.push_back(job);
+    }
+
+    if (m_sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+      // taking the mutex orders the wake after a sleeper's check
+      {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+      }
+      m_wake.notify_one();
+    }
+  }
+
+  Job* JobSystem::FindJob(int index)
+  {
+    Job* job = index >= 0 ? m_deques[index]->Pop() : nullptr;
+
+    // steal from the next deques first, so thieves spread
+    const size_t dequeCount = m_deques.size();
+    const size_t start = index >= 0 ? static_cast<size_t>(index) + 1 : 0;
+    for (size_t i = 0; !job && i < dequeCount; ++i)
+    {
+      const size_t victim = (start + i) % dequeCount;
+      if (static_cast<int>(victim) != index)
+        job = m_deques[victim]->Steal();
+    }
+
+    if (!job)
+    {
+      std::lock_guard<std::mutex> lock(m_sharedMutex);
+      if (!m_sharedJobs.empty())
+      {
+        job = m_sharedJobs.front();
+        m_sharedJobs.pop_front();
+      }
+    }
+
+    if (job)
+      m_pending.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+  }
+
+  void JobSystem::Execute(Job* job)
+  {
+    std::exception_ptr exception;
+    try
+    {
+      job->function();
+    } catch (...)
+    {
+      exception = std::current_exception();
+    }
+
+    // nobody to hand it to without a counter, kept for TakeUnhandledException
+    if (exception && !job->counter)
+    {
+      std::lock_guard<std::mutex> lock(m_unhandledMutex);
+      if (!m_unhandled)
+        m_unhandled = exception;
+      ++m_unhandledCount;
+    }
+    Finish(job, exception);
+  }
+
+  void JobSystem::Finish(Job* job, std::exception_ptr exception)
+  {
+    JobCounter* counter = job->counter;
+    delete job;
+    if (!counter)
+      return;
+
+    std::vector<Job*> ready;
+    {
+      std::lock_guard<std::mutex> lock(counter->m_mutex);
+      if (exception && !counter->m_exception)
+        counter->m_exception = exception;
+      if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        ready.swap(counter->m_continuations);
+    }
+    // the counter may be gone already
+    for (Job* continuation : ready)
+      Schedule(continuation);
+  }
+
+  int JobSystem::GetThreadIndex() const
+  {
+    return t_system == this ? t_index : -1;
+  }
+}
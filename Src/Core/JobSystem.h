@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Core
+{
+  struct Job;
+
+  // Chase-Lev deque of jobs: its owner pushes and pops at the bottom, other threads steal from the top.
+  // The capacity is fixed, Push fails when it is full.
+  class WorkStealingDeque
+  {
+    static constexpr size_t CAPACITY = 4096;
+
+  public:
+    WorkStealingDeque();
+    ~WorkStealingDeque();
+
+    // owner only
+    bool Push(Job* job);
+    Job* Pop();
+    // any thread, null when empty or when another thread took the job first
+    Job* Steal();
+
+  private:
+    std::atomic<int64_t> m_top;
+    std::atomic<int64_t> m_bottom;
+    std::atomic<Job*> m_jobs[CAPACITY];
+
+  private:
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+  };
+
+  // Jobs left in a group. Jobs run after it reach zero, and the first exception
+  // thrown by its jobs is rethrown by JobSystem::Wait.
+  class JobCounter
+  {
+  public:
+    JobCounter();
+    ~JobCounter();
+
+    bool IsDone() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_value;
+    // guards the continuations and the exception, held while reaching zero
+    std::mutex m_mutex;
+    std::vector<Job*> m_continuations;
+    std::exception_ptr m_exception;
+
+  private:
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+  };
+
+  enum JobAffinity
+  {
+    AnyThread,
+    // run by RunMainThreadJobs only, between frames, never in the middle of a wait
+    MainThread
+  };
+
+  // Work-stealing job system: each worker owns a deque, idle workers steal from the others.
+  // The thread creating it is the main thread, it owns a deque too and runs jobs while it waits,
+  // main thread jobs excepted, they wait for RunMainThreadJobs.
+  // Other threads submit through a shared queue.
+  class JobSystem
+  {
+    // spins looking for work before a worker sleeps
+    const unsigned IDLE_SPINS = 64;
+
+  public:
+    static JobSystem& Instance()
+    {
+      static JobSystem instance(DefaultWorkerCount());
+      return instance;
+    }
+
+    // a worker for every other hardware thread
+    static unsigned DefaultWorkerCount();
+
+    explicit JobSystem(unsigned workerCount);
+    // jobs still queued are dropped, wait for them first
+    ~JobSystem();
+
+    // the counter is incremented now and decremented once the job ran
+    void Run(std::function<void()> function, JobCounter* counter = nullptr, JobAffinity affinity = AnyThread);
+    // queued once the dependency reaches zero, right away if it already is
+    void RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr, JobAffinity affinity = AnyThread);
+    // runs other jobs until the counter reaches zero, rethrows what its jobs threw
+    // main thread jobs are left to RunMainThreadJobs, the main thread can't wait on them
+    void Wait(JobCounter& counter);
+    // body(begin, end) over [0, count) in batches, the calling thread takes part and returns when all are done
+    void ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& body);
+    // main thread only, runs the main thread jobs queued so far
+    void RunMainThreadJobs();
+    // first exception thrown by a job without a counter since the last call, null when none did
+    // such jobs have nobody to rethrow it to, the worker keeps going
+    std::exception_ptr TakeUnhandledException(size_t* count = nullptr);
+
+    unsigned GetWorkerCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+  private:
+    void WorkerLoop(unsigned index);
+    void Schedule(Job* job);
+    // a job for the thread owning the deque at index, any deque can be stolen from
+    Job* FindJob(int index);
+    void Execute(Job* job);
+    void Finish(Job* job, std::exception_ptr exception);
+    // deque of the calling thread in this system, -1 for other threads
+    int GetThreadIndex() const;
+
+  private:
+    // deque 0 is the main thread's, then one per worker
+    std::vector<std::unique_ptr<WorkStealingDeque>> m_deques;
+    std::vector<std::thread> m_workers;
+    // jobs from threads without a deque, or that didn't fit in one
+    std::mutex m_sharedMutex;
+    std::deque<Job*> m_sharedJobs;
+    std::mutex m_mainThreadMutex;
+    std::vector<Job*> m_mainThreadJobs;
+    // queued jobs any thread can run, workers sleep when there are none
+    std::atomic<int64_t> m_pending;
+    std::atomic<unsigned> m_sleeping;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_stop;
+    // thrown by jobs without a counter
+    std::mutex m_unhandledMutex;
+    std::exception_ptr m_unhandled;
+    size_t m_unhandledCount;
+
+  private:
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+  };
+}
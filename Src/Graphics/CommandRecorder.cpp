@@ -0,0 +1,256 @@
+#include "stdafx.h"
+#include "CommandRecorder.h"
+
+#include <cstring>
+
+namespace Graphics
+{
+  CommandListTarget::CommandListTarget()
+    : m_commandList(nullptr)
+  {
+  }
+
+  CommandListTarget::~CommandListTarget()
+  {
+  }
+
+  void CommandListTarget::SetPipelineState(ID3D12PipelineState* pso)
+  {
+    m_commandList->SetPipelineState(pso);
+  }
+
+  void CommandListTarget::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+  {
+    m_commandList->SetGraphicsRootSignature(rootSignature);
+  }
+
+  void CommandListTarget::SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps)
+  {
+    m_commandList->SetDescriptorHeaps(count, heaps);
+  }
+
+  void CommandListTarget::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+  {
+    m_commandList->IASetPrimitiveTopology(topology);
+  }
+
+  void CommandListTarget::IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views)
+  {
+    m_commandList->IASetVertexBuffers(startSlot, count, views);
+  }
+
+  void CommandListTarget::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+  {
+    m_commandList->IASetIndexBuffer(view);
+  }
+
+  void CommandListTarget::SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+  {
+    m_commandList->SetGraphicsRootConstantBufferView(parameter, address);
+  }
+
+  void CommandListTarget::SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE table)
+  {
+    m_commandList->SetGraphicsRootDescriptorTable(parameter, table);
+  }
+
+  void CommandListTarget::SetGraphicsRoot32BitConstants(UINT parameter, UINT count, const void* data, UINT offset)
+  {
+    m_commandList->SetGraphicsRoot32BitConstants(parameter, count, data, offset);
+  }
+
+  uint32_t CommandRecorder::Counters::TotalIssued() const
+  {
+    uint32_t total = 0;
+    for (unsigned i = 0; i < NumCommands; ++i)
+      total += issued[i];
+    return total;
+  }
+
+  uint32_t CommandRecorder::Counters::TotalElided() const
+  {
+    uint32_t total = 0;
+    for (unsigned i = 0; i < NumCommands; ++i)
+      total += elided[i];
+    return total;
+  }
+
+  CommandRecorder::CommandRecorder(CommandTarget* target)
+    : m_target(target)
+    , m_counters()
+    , m_pso(nullptr)
+    , m_rootSignature(nullptr)
+    , m_heapCount(0)
+    , m_heaps()
+    , m_topologyValid(false)
+    , m_topology(D3D_PRIMITIVE_TOPOLOGY_UNDEFINED)
+    , m_vertexBuffersValid()
+    , m_vertexBuffers()
+    , m_indexBufferValid(false)
+    , m_indexBuffer()
+    , m_rootParameters()
+  {
+  }
+
+  CommandRecorder::~CommandRecorder()
+  {
+  }
+
+  void CommandRecorder::Invalidate()
+  {
+    m_pso = nullptr;
+    m_rootSignature = nullptr;
+    m_heapCount = 0;
+    m_topologyValid = false;
+    for (auto& valid : m_vertexBuffersValid)
+      valid = false;
+    m_indexBufferValid = false;
+    InvalidateRootParameters();
+  }
+
+  void CommandRecorder::ResetCounters()
+  {
+    m_counters = {};
+  }
+
+  bool CommandRecorder::Count(Command command, bool changed)
+  {
+    if (changed)
+      ++m_counters.issued[command];
+    else
+      ++m_counters.elided[command];
+    return changed;
+  }
+
+  void CommandRecorder::InvalidateRootParameters()
+  {
+    for (auto& parameter : m_rootParameters)
+      parameter.valid = false;
+  }
+
+  void CommandRecorder::SetPipelineState(ID3D12PipelineState* pso)
+  {
+    if (!Count(PipelineState, pso != m_pso || pso == nullptr))
+      return;
+
+    m_target->SetPipelineState(pso);
+    m_pso = pso;
+  }
+
+  void CommandRecorder::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+  {
+    if (!Count(RootSignature, rootSignature != m_rootSignature || rootSignature == nullptr))
+      return;
+
+    m_target->SetGraphicsRootSignature(rootSignature);
+    m_rootSignature = rootSignature;
+    InvalidateRootParameters();
+  }
+
+  void CommandRecorder::SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps)
+  {
+    bool changed = count != m_heapCount || count == 0 || count > MAX_DESCRIPTOR_HEAPS;
+    for (UINT i = 0; !changed && i < count; ++i)
+      changed = heaps[i] != m_heaps[i];
+    if (!Count(DescriptorHeaps, changed))
+      return;
+
+    m_target->SetDescriptorHeaps(count, heaps);
+    m_heapCount = count <= MAX_DESCRIPTOR_HEAPS ? count : 0;
+    for (UINT i = 0; i < m_heapCount; ++i)
+      m_heaps[i] = heaps[i];
+  }
+
+  void CommandRecorder::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+  {
+    if (!Count(PrimitiveTopology, !m_topologyValid || topology != m_topology))
+      return;
+
+    m_target->IASetPrimitiveTopology(topology);
+    m_topologyValid = true;
+    m_topology = topology;
+  }
+
+  void CommandRecorder::IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views)
+  {
+    // unbinding or slots past the cache always go through
+    bool changed = views == nullptr || count == 0 || startSlot + count > MAX_VERTEX_BUFFERS;
+    for (UINT i = 0; !changed && i < count; ++i)
+      changed = !m_vertexBuffersValid[startSlot + i] || std::memcmp(&views[i], &m_vertexBuffers[startSlot + i], sizeof(D3D12_VERTEX_BUFFER_VIEW)) != 0;
+    if (!Count(VertexBuffers, changed))
+      return;
+
+    m_target->IASetVertexBuffers(startSlot, count, views);
+    for (UINT i = 0; i < count && startSlot + i < MAX_VERTEX_BUFFERS; ++i)
+    {
+      m_vertexBuffersValid[startSlot + i] = views != nullptr;
+      if (views)
+        m_vertexBuffers[startSlot + i] = views[i];
+    }
+  }
+
+  void CommandRecorder::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+  {
+    const bool changed = view == nullptr || !m_indexBufferValid || std::memcmp(view, &m_indexBuffer, sizeof(D3D12_INDEX_BUFFER_VIEW)) != 0;
+    if (!Count(IndexBuffer, changed))
+      return;
+
+    m_target->IASetIndexBuffer(view);
+    m_indexBufferValid = view != nullptr;
+    if (view)
+      m_indexBuffer = *view;
+  }
+
+  void CommandRecorder::SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+  {
+    RootParameter* bound = parameter < MAX_ROOT_PARAMETERS ? &m_rootParameters[parameter] : nullptr;
+    const bool changed = !bound || !bound->valid || bound->type != RootConstantBufferView || bound->address != address;
+    if (!Count(RootConstantBufferView, changed))
+      return;
+
+    m_target->SetGraphicsRootConstantBufferView(parameter, address);
+    if (bound)
+    {
+      bound->type = RootConstantBufferView;
+      bound->valid = true;
+      bound->address = address;
+    }
+  }
+
+  void CommandRecorder::SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE table)
+  {
+    RootParameter* bound = parameter < MAX_ROOT_PARAMETERS ? &m_rootParameters[parameter] : nullptr;
+    const bool changed = !bound || !bound->valid || bound->type != RootDescriptorTable || bound->table.ptr != table.ptr;
+    if (!Count(RootDescriptorTable, changed))
+      return;
+
+    m_target->SetGraphicsRootDescriptorTable(parameter, table);
+    if (bound)
+    {
+      bound->type = RootDescriptorTable;
+      bound->valid = true;
+      bound->table = table;
+    }
+  }
+
+  void CommandRecorder::SetGraphicsRoot32BitConstants(UINT parameter, UINT count, const void* data, UINT offset)
+  {
+    RootParameter* bound = parameter < MAX_ROOT_PARAMETERS ? &m_rootParameters[parameter] : nullptr;
+    const bool cached = bound && offset == 0 && count <= MAX_ROOT_CONSTANTS;
+    const bool changed = !cached || !bound->valid || bound->type != Root32BitConstants || bound->constantCount != count ||
+      std::memcmp(bound->constants, data, count * sizeof(uint32_t)) != 0;
+    if (!Count(Root32BitConstants, changed))
+      return;
+
+    m_target->SetGraphicsRoot32BitConstants(parameter, count, data, offset);
+    if (bound)
+    {
+      // partial sets leave the parameter unknown
+      bound->type = Root32BitConstants;
+      bound->valid = cached;
+      bound->constantCount = count;
+      if (cached)
+        std::memcpy(bound->constants, data, count * sizeof(uint32_t));
+    }
+  }
+}
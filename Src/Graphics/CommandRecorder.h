@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Graphics
+{
+  // the state setting calls of ID3D12GraphicsCommandList the recorder filters
+  // CommandListTarget forwards them to a command list, tests can count them with a mock instead
+  class CommandTarget
+  {
+  public:
+    virtual ~CommandTarget() {}
+
+    virtual void SetPipelineState(ID3D12PipelineState* pso) = 0;
+    virtual void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) = 0;
+    virtual void SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps) = 0;
+    virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+    virtual void IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views) = 0;
+    virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view) = 0;
+    virtual void SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+    virtual void SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE table) = 0;
+    virtual void SetGraphicsRoot32BitConstants(UINT parameter, UINT count, const void* data, UINT offset) = 0;
+  };
+
+  class CommandListTarget : public CommandTarget
+  {
+  public:
+    CommandListTarget();
+    ~CommandListTarget();
+
+    void SetCommandList(ID3D12GraphicsCommandList* commandList) { m_commandList = commandList; }
+
+    virtual void SetPipelineState(ID3D12PipelineState* pso) override;
+    virtual void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) override;
+    virtual void SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps) override;
+    virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override;
+    virtual void IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views) override;
+    virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view) override;
+    virtual void SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+    virtual void SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE table) override;
+    virtual void SetGraphicsRoot32BitConstants(UINT parameter, UINT count, const void* data, UINT offset) override;
+
+  private:
+    ID3D12GraphicsCommandList* m_commandList;
+
+  private:
+    CommandListTarget(const CommandListTarget&) = delete;
+    CommandListTarget& operator=(const CommandListTarget&) = delete;
+  };
+
+  // Keeps the graphics state bound on a command list and drops the calls that would set it again.
+  // Anything recording on the list without going through it (compute work, a list reset) has to
+  // be followed by Invalidate. Calls issued and elided are counted until ResetCounters.
+  class CommandRecorder
+  {
+    // root parameters and root constants past these are always issued
+    static constexpr unsigned MAX_ROOT_PARAMETERS = 16;
+    static constexpr unsigned MAX_ROOT_CONSTANTS = 16;
+    static constexpr unsigned MAX_VERTEX_BUFFERS = 4;
+    static constexpr unsigned MAX_DESCRIPTOR_HEAPS = 2;
+
+  public:
+    enum Command
+    {
+      PipelineState,
+      RootSignature,
+      DescriptorHeaps,
+      PrimitiveTopology,
+      VertexBuffers,
+      IndexBuffer,
+      RootConstantBufferView,
+      RootDescriptorTable,
+      Root32BitConstants,
+      NumCommands
+    };
+
+    struct Counters
+    {
+      uint32_t issued[NumCommands];
+      uint32_t elided[NumCommands];
+
+      uint32_t TotalIssued() const;
+      uint32_t TotalElided() const;
+    };
+
+    explicit CommandRecorder(CommandTarget* target);
+    ~CommandRecorder();
+
+    // nothing is known to be bound anymore
+    void Invalidate();
+    void ResetCounters();
+    const Counters& GetCounters() const { return m_counters; }
+
+    void SetPipelineState(ID3D12PipelineState* pso);
+    // a different root signature drops the root parameters
+    void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature);
+    void SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps);
+    void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+    void IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views);
+    void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view);
+    void SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address);
+    void SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE table);
+    // only whole sets starting at offset 0 are compared
+    void SetGraphicsRoot32BitConstants(UINT parameter, UINT count, const void* data, UINT offset);
+
+  private:
+    // true when the call has to go through, counts it either way
+    bool Count(Command command, bool changed);
+    void InvalidateRootParameters();
+
+  private:
+    // what is bound for each root parameter
+    struct RootParameter
+    {
+      Command type;
+      bool valid;
+      D3D12_GPU_VIRTUAL_ADDRESS address;
+      D3D12_GPU_DESCRIPTOR_HANDLE table;
+      UINT constantCount;
+      uint32_t constants[MAX_ROOT_CONSTANTS];
+    };
+
+    CommandTarget* m_target;
+    Counters m_counters;
+    // bound state, null or the valid flags when unknown
+    ID3D12PipelineState* m_pso;
+    ID3D12RootSignature* m_rootSignature;
+    UINT m_heapCount;
+    ID3D12DescriptorHeap* m_heaps[MAX_DESCRIPTOR_HEAPS];
+    bool m_topologyValid;
+    D3D12_PRIMITIVE_TOPOLOGY m_topology;
+    bool m_vertexBuffersValid[MAX_VERTEX_BUFFERS];
+    D3D12_VERTEX_BUFFER_VIEW m_vertexBuffers[MAX_VERTEX_BUFFERS];
+    bool m_indexBufferValid;
+    D3D12_INDEX_BUFFER_VIEW m_indexBuffer;
+    RootParameter m_rootParameters[MAX_ROOT_PARAMETERS];
+
+  private:
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+  };
+}
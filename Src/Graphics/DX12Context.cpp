@@ -5,10 +5,13 @@
 #include "Core/Application.h"
 
 #include "Graphics/ResourceManager.h"
+#include "Graphics/GeometryPool.h"
 #include "Graphics/DX12Interface.h"
 
 #include "Textures/DX12Texture.h"
 
+#include <stdexcept>
+
 // helpers
 namespace
 {
@@ -42,8 +45,10 @@ namespace Graphics
   DX12Context::DX12Context()
     : m_frameIndex(0)
     , m_commandQueue(nullptr)
-    , m_commandList(nullptr)
-    , m_commandAllocators()
+    , m_lists()
+    , m_usedLists(0)
+    , m_frameLists()
+    , m_parallelLists()
     , m_fence(nullptr)
     , m_fenceEvent()
     , m_fenceValues()
@@ -61,11 +66,6 @@ namespace Graphics
     // create command queue
     m_commandQueue = DX12Interface::Get().CreateCommandQueue();
 
-    // create command list and allocators for it
-    for (unsigned n = 0; n < Core::Application::FrameCount; ++n)
-      m_commandAllocators.push_back(DX12Interface::Get().CreateCommandAllocator());
-    m_commandList = DX12Interface::Get().CreateCommandList(m_commandAllocators);
-
     // Describe and create the swap chain.
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.BufferCount = Core::Application::FrameCount;
@@ -96,15 +96,19 @@ namespace Graphics
 
     // Create synchronization objects.
     InitFence();
+
+    // the first list records the setup
+    AcquireList();
   }
 
   DX12Context::~DX12Context()
   {
-    m_commandList.Reset();
+    m_frameLists.clear();
+    m_parallelLists.clear();
+    m_lists.clear();
     m_fence.Reset();
     m_fenceValues.clear();
     m_commandQueue.Reset();
-    m_commandAllocators.clear(); // could be a bug
     m_swapChain.Reset();
     m_renderTargets.clear();
     m_depth.reset();
@@ -118,12 +122,18 @@ namespace Graphics
 
   void DX12Context::Execute()
   {
-    // close command List
-    m_commandList->Close();
+    // close the lists of the frame and submit them together, in the order they were added
+    std::vector<ID3D12CommandList*> commandLists;
+    commandLists.reserve(m_frameLists.size());
+    for (auto list : m_frameLists)
+    {
+      list->commandList->Close();
+      commandLists.push_back(list->commandList.Get());
+    }
+    m_commandQueue->ExecuteCommandLists(static_cast<UINT>(commandLists.size()), commandLists.data());
 
-    // execute commands to finish setup
-    ID3D12CommandList* commandLists[] = { m_commandList.Get() };
-    m_commandQueue->ExecuteCommandLists(1, commandLists);
+    // the pool tracks page states per command list
+    GeometryPool::Instance().OnExecute();
   }
 
   void DX12Context::WaitForGpu()
@@ -134,6 +144,8 @@ namespace Graphics
     // Schedule a Signal command in the queue.
     SignalFence();
     WaitFence();
+
+    RetireReleases();
   }
 
   void DX12Context::MoveToNextFrame()
@@ -161,6 +173,12 @@ namespace Graphics
     // currentFrame fenceValue = 1
     // nextFrame fenceValue = 2
     m_fenceValues[m_frameIndex] = currentFenceValue + 1;
+
+    // the GPU is done with this frame's constants
+    ResourceManager::Instance().ResetConstants(m_frameIndex);
+
+    // what was retired by the frames the GPU finished can be released now
+    RetireReleases();
   }
 
   void DX12Context::Resize(unsigned width, unsigned height)
@@ -168,6 +186,8 @@ namespace Graphics
     // delete old resources
     m_renderTargets.clear();
     m_depth.reset();
+    // the GPU is idle when resizing, release them now so their heap slots can be reused below
+    ResourceManager::Instance().FlushReleases();
 
     // resize swapchain buffers
     auto hr = m_swapChain->ResizeBuffers(
@@ -190,6 +210,7 @@ namespace Graphics
 
     // initialize current frame
     m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+    ResourceManager::Instance().ResetConstants(m_frameIndex);
     
     // reset fence
     m_fence.Reset();
@@ -201,50 +222,39 @@ namespace Graphics
 
   void DX12Context::BeginFrame()
   {
-    // Command list allocators can only be reset when the associated 
-    // command lists have finished execution on the GPU; apps should use 
-    // fences to determine GPU execution progress.
-    // However, when ExecuteCommandList() is called on a particular command 
-    // list, that command list can then be reset at any time and must be before 
-    // re-recording.
-    Utilities::ThrowIfFailed(m_commandAllocators[m_frameIndex]->Reset());
-    Utilities::ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr));
+    // the lists of the last frame go back to the pool
+    m_usedLists = 0;
+    m_frameLists.clear();
+    auto commandList = AcquireList()->commandList.Get();
 
     // get render target resource
     std::shared_ptr<RenderTargetDescriptor> renderTarget = m_renderTargets[m_frameIndex];
     // Indicate that the back buffer will be used as a render target.
     auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(
       renderTarget->swapRenderTarget, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    m_commandList->ResourceBarrier(1, &barrier1);
-
-    // these must be done in the same commandlist as drawing
-    // because they set a state for rendering
-    // and states they reset between command lists
-    // since we are using bundles for drawing this should be fine
-    m_commandList->RSSetViewports(1, &m_viewport);
-    m_commandList->RSSetScissorRects(1, &m_scissorRect);
+    commandList->ResourceBarrier(1, &barrier1);
 
     // set the active render target
     renderTarget->SwapActive();
     auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(
       renderTarget->activeRT, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    m_commandList->ResourceBarrier(1, &barrier2);
+    commandList->ResourceBarrier(1, &barrier2);
     // set the last render target to pixel shader resource, to accumulate the previous color
     if (renderTarget->lastRT)
     {
       auto barrier3 = CD3DX12_RESOURCE_BARRIER::Transition(
         renderTarget->lastRT, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-      m_commandList->ResourceBarrier(1, &barrier3);
+      commandList->ResourceBarrier(1, &barrier3);
     }
 
     // set render target and depth buffer
+    SetRenderTargets(commandList);
     auto rtvHandle = ResourceManager::Instance().GetRTVCpuHandle(renderTarget->activeRTIndex);
     auto dsvHandle = ResourceManager::Instance().GetDSVCpuHandle(0);
-    m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
     const float clearColor[] = { 0.25f, 0.55f, 0.45f, 1.0f };
-    m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+    commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
 
-    m_commandList->ClearDepthStencilView(
+    commandList->ClearDepthStencilView(
       dsvHandle,
       D3D12_CLEAR_FLAG_DEPTH,
       1.0f,    // Clear depth to maximum (far plane)
@@ -253,32 +263,110 @@ namespace Graphics
     );
   }
 
-  void DX12Context::Draw(Scene::DX12Model* model, ID3D12PipelineState* pso, ID3D12RootSignature* rootSig)
-  {
-    model->DrawModel(pso, rootSig, m_commandList.Get());
-  }
-
   void DX12Context::EndFrame()
   {
+    auto commandList = GetCommandList();
+
     // get render target resource
     std::shared_ptr<RenderTargetDescriptor> renderTarget = m_renderTargets[m_frameIndex];
     // Indicate that the back buffer will now be used to present.
     auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(
       renderTarget->swapRenderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-    m_commandList->ResourceBarrier(1, &barrier1);
+    commandList->ResourceBarrier(1, &barrier1);
     // set the active render target
     auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(
       renderTarget->activeRT, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COMMON);
-    m_commandList->ResourceBarrier(1, &barrier2);
+    commandList->ResourceBarrier(1, &barrier2);
     // set the last render target to pixel shader resource, to accumulate the previous color
     if (renderTarget->lastRT)
     {
       auto barrier3 = CD3DX12_RESOURCE_BARRIER::Transition(
         renderTarget->lastRT, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COMMON);
-      m_commandList->ResourceBarrier(1, &barrier3);
+      commandList->ResourceBarrier(1, &barrier3);
     }
   }
 
+  const std::vector<FrameCommandList*>& DX12Context::BeginParallel(unsigned count)
+  {
+    m_parallelLists.clear();
+    for (unsigned i = 0; i < count; ++i)
+    {
+      FrameCommandList* list = AcquireList();
+      SetRenderTargets(list->commandList.Get());
+      m_parallelLists.push_back(list);
+    }
+
+    // what is recorded next runs after them
+    SetRenderTargets(AcquireList()->commandList.Get());
+    return m_parallelLists;
+  }
+
+  void DX12Context::ResetCounters()
+  {
+    for (auto list : m_frameLists)
+      list->recorder.ResetCounters();
+  }
+
+  CommandRecorder::Counters DX12Context::GetCounters() const
+  {
+    CommandRecorder::Counters counters = {};
+    for (auto list : m_frameLists)
+    {
+      const CommandRecorder::Counters& listCounters = list->recorder.GetCounters();
+      for (unsigned i = 0; i < CommandRecorder::NumCommands; ++i)
+      {
+        counters.issued[i] += listCounters.issued[i];
+        counters.elided[i] += listCounters.elided[i];
+      }
+    }
+    return counters;
+  }
+
+  FrameCommandList* DX12Context::AcquireList()
+  {
+    if (m_usedLists == m_lists.size())
+    {
+      if (m_lists.size() >= MAX_FRAME_LISTS)
+        throw std::out_of_range("[CONTEXT] TOO MANY COMMAND LISTS IN A FRAME !");
+
+      auto list = std::make_unique<FrameCommandList>();
+      for (unsigned n = 0; n < Core::Application::FrameCount; ++n)
+        list->allocators.push_back(DX12Interface::Get().CreateCommandAllocator());
+      list->commandList = DX12Interface::Get().CreateCommandList(list->allocators);
+      // lists are created recording, closed to be reset like the others
+      Utilities::ThrowIfFailed(list->commandList->Close());
+      list->target.SetCommandList(list->commandList.Get());
+      m_lists.push_back(std::move(list));
+    }
+
+    // Command list allocators can only be reset when the associated
+    // command lists have finished execution on the GPU; MoveToNextFrame waited for this frame's fence.
+    // However, when ExecuteCommandList() is called on a particular command
+    // list, that command list can then be reset at any time and must be before
+    // re-recording.
+    FrameCommandList* list = m_lists[m_usedLists++].get();
+    Utilities::ThrowIfFailed(list->allocators[m_frameIndex]->Reset());
+    Utilities::ThrowIfFailed(list->commandList->Reset(list->allocators[m_frameIndex].Get(), nullptr));
+    // a reset list has no state
+    list->recorder.Invalidate();
+    list->recorder.ResetCounters();
+    m_frameLists.push_back(list);
+    return list;
+  }
+
+  void DX12Context::SetRenderTargets(ID3D12GraphicsCommandList* commandList)
+  {
+    // these must be done in the same commandlist as drawing
+    // because they set a state for rendering
+    // and states they reset between command lists
+    commandList->RSSetViewports(1, &m_viewport);
+    commandList->RSSetScissorRects(1, &m_scissorRect);
+
+    auto rtvHandle = ResourceManager::Instance().GetRTVCpuHandle(m_renderTargets[m_frameIndex]->activeRTIndex);
+    auto dsvHandle = ResourceManager::Instance().GetDSVCpuHandle(0);
+    commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+  }
+
   void DX12Context::InitFence()
   {
     m_fence = DX12Interface::Get().CreateFence();
@@ -291,6 +379,8 @@ namespace Graphics
       Utilities::ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
 
     m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+
+    ResourceManager::Instance().SetReleaseFenceValue(m_fenceValues[m_frameIndex]);
   }
 
   void DX12Context::SignalFence()
@@ -314,4 +404,11 @@ namespace Graphics
     m_fenceValues[m_frameIndex]++;
   }
 
+  void DX12Context::RetireReleases()
+  {
+    ResourceManager::Instance().ProcessReleases(m_fence->GetCompletedValue());
+    // releases from now on belong to the frame that will signal this value
+    ResourceManager::Instance().SetReleaseFenceValue(m_fenceValues[m_frameIndex]);
+  }
+
 }
\ No newline at end of file
@@ -3,13 +3,29 @@
 #include "Scene/DX12Model.h"
 #include "Scene/DX12Skybox.h"
 
+#include "Graphics/CommandRecorder.h"
+
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
 namespace Graphics
 {
+  // a command list with an allocator for each frame in flight and the state bound on it
+  struct FrameCommandList
+  {
+    std::vector<ComPtr<ID3D12CommandAllocator>> allocators;
+    ComPtr<ID3D12GraphicsCommandList> commandList;
+    CommandListTarget target;
+    CommandRecorder recorder;
+
+    FrameCommandList() : recorder(&target) {}
+  };
+
   class DX12Context
   {
+    // command lists a frame can record on, the main ones included
+    const unsigned MAX_FRAME_LISTS = 32;
+
   public:
     DX12Context();
     ~DX12Context();
@@ -22,17 +38,30 @@ namespace Graphics
     void Resize(unsigned width, unsigned height);
 
     void BeginFrame();
-    void Draw(Scene::DX12Model* model, ID3D12PipelineState* pso, ID3D12RootSignature* rootSig);
     void EndFrame();
 
     ID3D12CommandQueue* GetCommandQueue() { return m_commandQueue.Get(); }
-    ID3D12GraphicsCommandList* GetCommandList() { return m_commandList.Get(); }
+    // the list recording continues on, the last one of the frame
+    ID3D12GraphicsCommandList* GetCommandList() { return m_frameLists.back()->commandList.Get(); }
+    // graphics state goes through it, so calls that change nothing are dropped
+    CommandRecorder& GetRecorder() { return m_frameLists.back()->recorder; }
+    // count lists for recording in parallel, with the viewport and render targets set, submitted in order
+    // after what the frame recorded so far; recording continues on a new list after them
+    const std::vector<FrameCommandList*>& BeginParallel(unsigned count);
+    // recorder counters summed over the lists of the frame
+    void ResetCounters();
+    CommandRecorder::Counters GetCounters() const;
     RenderTargetDescriptor* GetCurrentRenderTarget() { return m_renderTargets[m_frameIndex].get(); }
 
   private:
     void InitFence();
     void SignalFence();
     void WaitFence();
+    // run deferred releases the GPU is done with, and tag new ones with the current frame
+    void RetireReleases();
+    // a list of the pool reset on this frame's allocator, added to the frame
+    FrameCommandList* AcquireList();
+    void SetRenderTargets(ID3D12GraphicsCommandList* commandList);
 
   private:
     // the swapchain
@@ -42,9 +71,11 @@ namespace Graphics
 
     // command queue
     ComPtr<ID3D12CommandQueue> m_commandQueue;
-    // command list
-    std::vector<ComPtr<ID3D12CommandAllocator>> m_commandAllocators;
-    ComPtr<ID3D12GraphicsCommandList> m_commandList;
+    // command lists, the ones used this frame in submission order
+    std::vector<std::unique_ptr<FrameCommandList>> m_lists;
+    size_t m_usedLists;
+    std::vector<FrameCommandList*> m_frameLists;
+    std::vector<FrameCommandList*> m_parallelLists;
     // synchronization
     HANDLE m_fenceEvent;
     ComPtr<ID3D12Fence> m_fence;
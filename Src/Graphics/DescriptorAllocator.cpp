@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "DescriptorAllocator.h"
+
+#include <stdexcept>
+
+namespace Graphics
+{
+  DescriptorAllocator::DescriptorAllocator(unsigned begin, unsigned count, unsigned blockSize)
+    : m_begin(begin)
+    , m_blockCount(blockSize > 0 ? count / blockSize : 0)
+    , m_blockSize(blockSize)
+    , m_next(nullptr)
+    , m_head(0)
+    , m_usedBlocks(0)
+    , m_highWaterBlocks(0)
+  {
+    if (blockSize == 0)
+      throw std::invalid_argument("[DESCRIPTOR_ALLOCATOR] BLOCK SIZE CAN'T BE 0!");
+
+    // chain all blocks in order, so the first allocations are handed out from the start of the range
+    m_next = std::make_unique<std::atomic<unsigned>[]>(m_blockCount);
+    for (unsigned i = 0; i < m_blockCount; ++i)
+      m_next[i].store(i + 1 < m_blockCount ? i + 1 : EndOfList, std::memory_order_relaxed);
+
+    m_head.store(Pack(0, m_blockCount > 0 ? 0 : EndOfList), std::memory_order_release);
+  }
+
+  DescriptorAllocator::~DescriptorAllocator()
+  {
+    m_next.reset();
+  }
+
+  unsigned DescriptorAllocator::Allocate()
+  {
+    uint64_t head = m_head.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+      const unsigned block = Block(head);
+      if (block == EndOfList)
+        return InvalidIndex;
+
+      // m_next[block] may already be stale if another thread popped this block,
+      // in that case the tag changed and the CAS below fails
+      const unsigned next = m_next[block].load(std::memory_order_relaxed);
+      if (m_head.compare_exchange_weak(head, Pack(Tag(head) + 1, next), std::memory_order_acquire, std::memory_order_acquire))
+      {
+        // update stats
+        const unsigned used = m_usedBlocks.fetch_add(1, std::memory_order_relaxed) + 1;
+        unsigned highWater = m_highWaterBlocks.load(std::memory_order_relaxed);
+        while (used > highWater && !m_highWaterBlocks.compare_exchange_weak(highWater, used, std::memory_order_relaxed))
+          ;
+
+        return m_begin + block * m_blockSize;
+      }
+    }
+  }
+
+  void DescriptorAllocator::Free(unsigned index)
+  {
+    if (!Owns(index))
+      throw std::out_of_range("[DESCRIPTOR_ALLOCATOR] INDEX DOES NOT BELONG TO THIS RANGE!");
+
+    const unsigned block = (index - m_begin) / m_blockSize;
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      m_next[block].store(Block(head), std::memory_order_relaxed);
+      // pushing does not need to bump the tag, only pops can be affected by ABA
+      if (m_head.compare_exchange_weak(head, Pack(Tag(head), block), std::memory_order_release, std::memory_order_relaxed))
+        break;
+    }
+
+    m_usedBlocks.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
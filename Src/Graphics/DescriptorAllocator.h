@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace Graphics
+{
+  // Hands out descriptor indices from a fixed range of a heap.
+  // The free slots are kept in a lock-free free-list (a Treiber stack over an index array),
+  // so Allocate and Free are O(1) and can be called from any number of loader threads.
+  // Indices are handed out in blocks of blockSize consecutive slots,
+  // e.g. the mips region hands out 4 UAVs at once.
+  class DescriptorAllocator
+  {
+  public:
+    static constexpr unsigned InvalidIndex = 0xFFFFFFFF;
+
+    DescriptorAllocator(unsigned begin, unsigned count, unsigned blockSize = 1);
+    ~DescriptorAllocator();
+
+    // returns the first index of the block, InvalidIndex if the range is full
+    unsigned Allocate();
+    // index has to be a value returned by Allocate
+    void Free(unsigned index);
+
+    bool Owns(unsigned index) const { return index >= m_begin && index < m_begin + m_blockCount * m_blockSize; }
+
+    unsigned GetBegin() const { return m_begin; }
+    unsigned GetBlockSize() const { return m_blockSize; }
+    // in slots, not blocks
+    unsigned GetCapacity() const { return m_blockCount * m_blockSize; }
+    unsigned GetUsed() const { return m_usedBlocks.load(std::memory_order_relaxed) * m_blockSize; }
+    unsigned GetHighWater() const { return m_highWaterBlocks.load(std::memory_order_relaxed) * m_blockSize; }
+
+  private:
+    static constexpr unsigned EndOfList = 0xFFFFFFFF;
+
+    // the head packs a tag (upper 32 bits) with the first free block (lower 32 bits),
+    // the tag is bumped on every pop so a stale CAS cannot succeed (ABA)
+    static uint64_t Pack(uint64_t tag, unsigned block) { return (tag << 32) | block; }
+    static unsigned Block(uint64_t head) { return static_cast<unsigned>(head & 0xFFFFFFFF); }
+    static uint64_t Tag(uint64_t head) { return head >> 32; }
+
+  private:
+    unsigned m_begin;
+    unsigned m_blockCount;
+    unsigned m_blockSize;
+    // next free block for each block
+    std::unique_ptr<std::atomic<unsigned>[]> m_next;
+    std::atomic<uint64_t> m_head;
+    // stats
+    std::atomic<unsigned> m_usedBlocks;
+    std::atomic<unsigned> m_highWaterBlocks;
+
+  private:
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+  };
+}
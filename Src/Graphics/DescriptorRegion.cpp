@@ -0,0 +1,244 @@
+#include "stdafx.h"
+#include "DescriptorRegion.h"
+
+#include <stdexcept>
+
+// helpers
+namespace
+{
+  // counts a caller for as long as it may use page allocators
+  // page pointers are read after the count goes up, a page nulled before a count of zero is seen can't be in use
+  class ReaderScope
+  {
+  public:
+    explicit ReaderScope(std::atomic<unsigned>& readers)
+      : m_readers(readers)
+    {
+      m_readers.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    ~ReaderScope()
+    {
+      m_readers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+  private:
+    std::atomic<unsigned>& m_readers;
+  };
+}
+
+namespace Graphics
+{
+  DescriptorRegion::DescriptorRegion(const std::string& name, unsigned begin, unsigned count, unsigned blockSize, DescriptorAllocator* pagePool)
+    : m_name(name)
+    , m_blockSize(blockSize)
+    , m_pagePool(pagePool)
+    , m_reserved()
+    , m_pages()
+    , m_pageSlots(0)
+    , m_generation(0)
+    , m_readers(0)
+    , m_retired()
+    , m_growMutex()
+    , m_usedBlocks(0)
+    , m_highWaterBlocks(0)
+  {
+    if (pagePool && pagePool->GetBlockSize() < blockSize)
+      throw std::invalid_argument("[DESCRIPTOR_REGION] PAGES ARE SMALLER THAN A BLOCK!");
+
+    m_reserved = std::make_unique<DescriptorAllocator>(begin, count, blockSize);
+    for (auto& page : m_pages)
+      page.store(nullptr, std::memory_order_relaxed);
+  }
+
+  DescriptorRegion::~DescriptorRegion()
+  {
+    // pages still held are not given back, the page pool goes away with the heap
+    for (auto& page : m_pages)
+      delete page.exchange(nullptr, std::memory_order_relaxed);
+    m_retired.clear();
+    m_reserved.reset();
+  }
+
+  unsigned DescriptorRegion::Allocate()
+  {
+    for (;;)
+    {
+      const unsigned generation = m_generation.load(std::memory_order_acquire);
+      unsigned index = DescriptorAllocator::InvalidIndex;
+      {
+        ReaderScope reader(m_readers);
+
+        // the reserved range first, then the pages in slot order
+        index = m_reserved->Allocate();
+        const unsigned slots = m_pageSlots.load(std::memory_order_acquire);
+        for (unsigned i = 0; index == DescriptorAllocator::InvalidIndex && i < slots; ++i)
+        {
+          DescriptorAllocator* page = m_pages[i].load(std::memory_order_seq_cst);
+          if (page)
+            index = page->Allocate();
+        }
+      }
+
+      if (index != DescriptorAllocator::InvalidIndex)
+      {
+        const unsigned used = m_usedBlocks.fetch_add(1, std::memory_order_relaxed) + 1;
+        unsigned highWater = m_highWaterBlocks.load(std::memory_order_relaxed);
+        while (used > highWater && !m_highWaterBlocks.compare_exchange_weak(highWater, used, std::memory_order_relaxed))
+          ;
+
+        return index;
+      }
+
+      if (!Grow(generation))
+        return DescriptorAllocator::InvalidIndex;
+    }
+  }
+
+  void DescriptorRegion::Free(unsigned index)
+  {
+    bool found = false;
+    bool emptied = false;
+    {
+      ReaderScope reader(m_readers);
+
+      if (m_reserved->Owns(index))
+      {
+        m_reserved->Free(index);
+        m_usedBlocks.fetch_sub(1, std::memory_order_relaxed);
+        return;
+      }
+
+      // a page being given back holds all its blocks, an index of it can't come back here
+      const unsigned slots = m_pageSlots.load(std::memory_order_acquire);
+      for (unsigned i = 0; i < slots && !found; ++i)
+      {
+        DescriptorAllocator* page = m_pages[i].load(std::memory_order_seq_cst);
+        if (!page || !page->Owns(index))
+          continue;
+
+        page->Free(index);
+        m_usedBlocks.fetch_sub(1, std::memory_order_relaxed);
+        found = true;
+        emptied = page->GetUsed() == 0;
+      }
+    }
+
+    if (!found)
+      throw std::out_of_range("[DESCRIPTOR_REGION] INDEX DOES NOT BELONG TO " + m_name + "!");
+
+    if (emptied)
+      ReturnEmptyPages();
+  }
+
+  DescriptorRegion::Stats DescriptorRegion::GetStats() const
+  {
+    ReaderScope reader(m_readers);
+
+    Stats output;
+    output.name = m_name;
+    output.capacity = m_reserved->GetCapacity();
+    output.used = m_usedBlocks.load(std::memory_order_relaxed) * m_blockSize;
+    output.highWater = m_highWaterBlocks.load(std::memory_order_relaxed) * m_blockSize;
+    output.pages = 0;
+
+    const unsigned slots = m_pageSlots.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < slots; ++i)
+    {
+      const DescriptorAllocator* page = m_pages[i].load(std::memory_order_seq_cst);
+      if (!page)
+        continue;
+      output.capacity += page->GetCapacity();
+      ++output.pages;
+    }
+
+    return output;
+  }
+
+  bool DescriptorRegion::Grow(unsigned knownGeneration)
+  {
+    std::lock_guard<std::mutex> lock(m_growMutex);
+    DeleteRetired();
+
+    // another thread took or gave back a page, look again
+    if (m_generation.load(std::memory_order_relaxed) != knownGeneration)
+      return true;
+
+    if (!m_pagePool)
+      return false;
+
+    // the first slot given back, or a new one
+    const unsigned slots = m_pageSlots.load(std::memory_order_relaxed);
+    unsigned slot = 0;
+    while (slot < slots && m_pages[slot].load(std::memory_order_relaxed))
+      ++slot;
+    if (slot == MaxPages)
+      return false;
+
+    const unsigned page = m_pagePool->Allocate();
+    if (page == DescriptorAllocator::InvalidIndex)
+      return false;
+
+    // published before the slot count, readers only look at slots below it
+    m_pages[slot].store(new DescriptorAllocator(page, m_pagePool->GetBlockSize(), m_blockSize), std::memory_order_seq_cst);
+    if (slot == slots)
+      m_pageSlots.store(slots + 1, std::memory_order_release);
+    m_generation.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  void DescriptorRegion::ReturnEmptyPages()
+  {
+    std::lock_guard<std::mutex> lock(m_growMutex);
+    DeleteRetired();
+
+    // pages only change under the mutex
+    const unsigned slots = m_pageSlots.load(std::memory_order_relaxed);
+    unsigned capacity = m_reserved->GetCapacity();
+    for (unsigned i = 0; i < slots; ++i)
+    {
+      if (const DescriptorAllocator* page = m_pages[i].load(std::memory_order_relaxed))
+        capacity += page->GetCapacity();
+    }
+
+    // pages kept earlier are given back too once the region has room again
+    for (unsigned i = 0; i < slots; ++i)
+    {
+      DescriptorAllocator* page = m_pages[i].load(std::memory_order_relaxed);
+      if (!page || page->GetUsed() > 0)
+        continue;
+
+      // keep it while the rest of the region is close to full, it would be taken again right away
+      const unsigned pageCapacity = page->GetCapacity();
+      if (m_usedBlocks.load(std::memory_order_relaxed) * m_blockSize + pageCapacity + pageCapacity / 2 > capacity)
+        break;
+
+      // once every block is taken here nobody else holds one or can get one
+      std::vector<unsigned> drained;
+      for (unsigned index = page->Allocate(); index != DescriptorAllocator::InvalidIndex; index = page->Allocate())
+        drained.push_back(index);
+      if (drained.size() * m_blockSize != pageCapacity)
+      {
+        // allocated meanwhile, the page stays
+        for (unsigned index : drained)
+          page->Free(index);
+        continue;
+      }
+
+      // callers that already read the pointer only find a drained allocator, it is deleted once they are gone
+      m_pages[i].store(nullptr, std::memory_order_seq_cst);
+      m_generation.fetch_add(1, std::memory_order_release);
+      m_pagePool->Free(page->GetBegin());
+      m_retired.emplace_back(page);
+      capacity -= pageCapacity;
+    }
+
+    DeleteRetired();
+  }
+
+  void DescriptorRegion::DeleteRetired()
+  {
+    if (!m_retired.empty() && m_readers.load(std::memory_order_seq_cst) == 0)
+      m_retired.clear();
+  }
+}
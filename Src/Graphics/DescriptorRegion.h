@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Graphics/DescriptorAllocator.h"
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Graphics
+{
+  // A named region of the resources heap (constant buffers, textures, mips ...etc).
+  // It starts with the range reserved for it in the config and, once that is full, grows
+  // by taking pages from a page pool shared by all regions, so a region can use the space
+  // other regions don't need. A page goes back to the pool once nothing in it is allocated and
+  // the rest of the region has room to spare, so a load spike doesn't keep the slack from the others.
+  class DescriptorRegion
+  {
+  public:
+    static constexpr unsigned MaxPages = 64;
+
+    struct Stats
+    {
+      std::string name;
+      // in slots, reserved range and pages
+      unsigned capacity;
+      unsigned used;
+      unsigned highWater;
+      unsigned pages;
+    };
+
+    // pagePool hands out the first index of free pages, it can be null for a fixed region
+    DescriptorRegion(const std::string& name, unsigned begin, unsigned count, unsigned blockSize, DescriptorAllocator* pagePool);
+    ~DescriptorRegion();
+
+    // returns the first index of a block, InvalidIndex if the region is full and no page is left
+    unsigned Allocate();
+    void Free(unsigned index);
+
+    const std::string& GetName() const { return m_name; }
+    unsigned GetBlockSize() const { return m_blockSize; }
+    Stats GetStats() const;
+
+  private:
+    // true when the pages changed since knownGeneration or a page was taken, the caller looks again
+    bool Grow(unsigned knownGeneration);
+    // gives empty pages back to the pool when the region doesn't need them, takes the grow mutex
+    void ReturnEmptyPages();
+    // deletes the allocators of given back pages once no caller can be in them, under the grow mutex
+    void DeleteRetired();
+
+  private:
+    std::string m_name;
+    unsigned m_blockSize;
+    DescriptorAllocator* m_pagePool;
+    std::unique_ptr<DescriptorAllocator> m_reserved;
+    // owned, null once given back, only the first m_pageSlots are used
+    std::array<std::atomic<DescriptorAllocator*>, MaxPages> m_pages;
+    std::atomic<unsigned> m_pageSlots;
+    // bumped whenever a page is taken or given back
+    std::atomic<unsigned> m_generation;
+    // callers that may be in a page allocator, given back pages are deleted when there are none
+    mutable std::atomic<unsigned> m_readers;
+    std::vector<std::unique_ptr<DescriptorAllocator>> m_retired;
+    // taking and giving back pages
+    std::mutex m_growMutex;
+    // stats, in blocks
+    std::atomic<unsigned> m_usedBlocks;
+    std::atomic<unsigned> m_highWaterBlocks;
+
+  private:
+    DescriptorRegion(const DescriptorRegion&) = delete;
+    DescriptorRegion& operator=(const DescriptorRegion&) = delete;
+  };
+}
@@ -0,0 +1,209 @@
+#include "stdafx.h"
+#include "GeometryPool.h"
+
+#include "Graphics/DX12Interface.h"
+#include "Graphics/ResourceManager.h"
+
+#include "Utilities/DXApplicationHelper.h"
+
+#include <stdexcept>
+
+namespace Graphics
+{
+  GeometryAllocation::~GeometryAllocation()
+  {
+    // the page is kept alive by the release, it doesn't depend on the pool still being around
+    if (page)
+      ResourceManager::Instance().DeferRelease([page = std::move(page), allocation = allocation]() {
+        std::lock_guard<std::mutex> lock(page->mutex);
+        page->allocator.Free(allocation);
+      });
+  }
+
+  GeometryPool::GeometryPool()
+    : m_vertexPages()
+    , m_indexPages()
+    , m_mutex()
+  {
+  }
+
+  GeometryPool::~GeometryPool()
+  {
+    m_vertexPages.clear();
+    m_indexPages.clear();
+  }
+
+  std::unique_ptr<GeometryAllocation> GeometryPool::AllocateVertices(
+    ID3D12GraphicsCommandList* commandList, const void* data, unsigned count, unsigned stride)
+  {
+    std::unique_ptr<GeometryAllocation> output;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      output = Allocate(m_vertexPages[stride], count, stride, DXGI_FORMAT_UNKNOWN, VERTEX_PAGE_SIZE);
+    }
+
+    Upload(commandList, output.get(), data, stride);
+    return output;
+  }
+
+  std::unique_ptr<GeometryAllocation> GeometryPool::AllocateIndices(
+    ID3D12GraphicsCommandList* commandList, const void* data, unsigned count, DXGI_FORMAT format)
+  {
+    if (format != DXGI_FORMAT_R16_UINT && format != DXGI_FORMAT_R32_UINT)
+      throw std::invalid_argument("[GEOMETRY_POOL] INDEX FORMAT NOT SUPPORTED!");
+
+    const unsigned indexSize = format == DXGI_FORMAT_R16_UINT ? 2 : 4;
+    std::unique_ptr<GeometryAllocation> output;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      output = Allocate(m_indexPages[format], count, indexSize, format, INDEX_PAGE_SIZE);
+    }
+
+    Upload(commandList, output.get(), data, indexSize);
+    return output;
+  }
+
+  void GeometryPool::PrepareForDraw(ID3D12GraphicsCommandList* commandList, GeometryAllocation* allocation)
+  {
+    auto& page = allocation->page;
+    std::lock_guard<std::mutex> lock(page->mutex);
+    if (page->state == page->readState)
+      return;
+
+    // an implicit promotion would leave the tracked state wrong for a later upload
+    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(page->buffer.Get(), page->state, page->readState);
+    commandList->ResourceBarrier(1, &barrier);
+    page->state = page->readState;
+  }
+
+  void GeometryPool::OnExecute()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto decay = [](PageList& pages) {
+      for (auto& page : pages)
+      {
+        std::lock_guard<std::mutex> pageLock(page->mutex);
+        page->state = D3D12_RESOURCE_STATE_COMMON;
+      }
+    };
+
+    for (auto& [stride, pages] : m_vertexPages)
+      decay(pages);
+    for (auto& [format, pages] : m_indexPages)
+      decay(pages);
+  }
+
+  std::vector<OffsetAllocator::Stats> GeometryPool::GetStats()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<OffsetAllocator::Stats> output;
+    auto collect = [&](PageList& pages) {
+      for (auto& page : pages)
+      {
+        std::lock_guard<std::mutex> pageLock(page->mutex);
+        output.push_back(page->allocator.GetStats());
+      }
+    };
+
+    for (auto& [stride, pages] : m_vertexPages)
+      collect(pages);
+    for (auto& [format, pages] : m_indexPages)
+      collect(pages);
+
+    return output;
+  }
+
+  std::unique_ptr<GeometryAllocation> GeometryPool::Allocate(
+    PageList& pages, unsigned count, unsigned elementSize, DXGI_FORMAT indexFormat, size_t pageSize)
+  {
+    // no page can hand out 0 elements, a new one would be made for nothing
+    if (count == 0)
+      throw std::invalid_argument("[GEOMETRY_POOL] CAN'T ALLOCATE 0 ELEMENTS!");
+
+    std::unique_ptr<GeometryAllocation> output = std::make_unique<GeometryAllocation>();
+    output->count = count;
+
+    // first page with a range big enough
+    for (auto& page : pages)
+    {
+      std::lock_guard<std::mutex> lock(page->mutex);
+      auto allocation = page->allocator.Allocate(count);
+      if (allocation.offset != OffsetAllocator::InvalidOffset)
+      {
+        output->page = page;
+        output->allocation = allocation;
+        break;
+      }
+    }
+
+    // no space left, add a page
+    if (!output->page)
+    {
+      const uint32_t pageElements = static_cast<uint32_t>(max(pageSize / elementSize, static_cast<size_t>(count)));
+      auto page = CreatePage(pageElements, elementSize, indexFormat);
+      output->page = page;
+      output->allocation = page->allocator.Allocate(count);
+      pages.push_back(page);
+    }
+
+    output->offset = output->allocation.offset;
+    return output;
+  }
+
+  std::shared_ptr<GeometryPage> GeometryPool::CreatePage(uint32_t elementCount, unsigned elementSize, DXGI_FORMAT indexFormat)
+  {
+    auto page = std::make_shared<GeometryPage>(elementCount);
+
+    auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(static_cast<UINT64>(elementCount) * elementSize);
+    Utilities::ThrowIfFailed(DX12Interface::Get().GetDevice()->CreateCommittedResource(
+      &defaultHeapProps,
+      D3D12_HEAP_FLAG_NONE,
+      &resDesc,
+      D3D12_RESOURCE_STATE_COMMON,
+      nullptr,
+      IID_PPV_ARGS(&page->buffer)));
+
+    // views over the whole page
+    if (indexFormat == DXGI_FORMAT_UNKNOWN)
+    {
+      page->readState = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+      page->vertexView.BufferLocation = page->buffer->GetGPUVirtualAddress();
+      page->vertexView.StrideInBytes = elementSize;
+      page->vertexView.SizeInBytes = elementCount * elementSize;
+    }
+    else
+    {
+      page->readState = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+      page->indexView.BufferLocation = page->buffer->GetGPUVirtualAddress();
+      page->indexView.SizeInBytes = elementCount * elementSize;
+      page->indexView.Format = indexFormat;
+    }
+
+    return page;
+  }
+
+  void GeometryPool::Upload(ID3D12GraphicsCommandList* commandList, GeometryAllocation* allocation, const void* data, unsigned elementSize)
+  {
+    auto& page = allocation->page;
+    std::lock_guard<std::mutex> lock(page->mutex);
+    const size_t size = static_cast<size_t>(allocation->count) * elementSize;
+
+    if (page->state != D3D12_RESOURCE_STATE_COPY_DEST)
+    {
+      auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(page->buffer.Get(), page->state, D3D12_RESOURCE_STATE_COPY_DEST);
+      commandList->ResourceBarrier(1, &barrier);
+    }
+
+    auto staging = ResourceManager::Instance().ReserveStaging(size, 4);
+    memcpy(staging.cpuAddress, data, size);
+    commandList->CopyBufferRegion(
+      page->buffer.Get(), static_cast<UINT64>(allocation->offset) * elementSize, staging.resource, staging.offset, size);
+
+    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(page->buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, page->readState);
+    commandList->ResourceBarrier(1, &barrier);
+    page->state = page->readState;
+  }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Graphics/OffsetAllocator.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace Graphics
+{
+  // one big default heap buffer shared by many meshes, ranges are handed out in elements
+  // (vertices of one stride, or indices of one format) so offsets map directly to
+  // BaseVertexLocation and StartIndexLocation
+  struct GeometryPage
+  {
+    ComPtr<ID3D12Resource> buffer;
+    OffsetAllocator allocator;
+    std::mutex mutex;
+    // what draws need, VERTEX_AND_CONSTANT_BUFFER or INDEX_BUFFER
+    D3D12_RESOURCE_STATES readState;
+    // state in the command list being recorded, buffers decay to COMMON once executed
+    D3D12_RESOURCE_STATES state;
+    // views over the whole page, only the one matching the page type is set
+    D3D12_VERTEX_BUFFER_VIEW vertexView;
+    D3D12_INDEX_BUFFER_VIEW indexView;
+
+    explicit GeometryPage(uint32_t elementCount)
+      : buffer(nullptr)
+      , allocator(elementCount)
+      , mutex()
+      , readState(D3D12_RESOURCE_STATE_COMMON)
+      , state(D3D12_RESOURCE_STATE_COMMON)
+      , vertexView()
+      , indexView()
+    {
+    }
+  };
+
+  // range of a page used by a mesh, given back to the page once the GPU is done with it
+  struct GeometryAllocation
+  {
+    std::shared_ptr<GeometryPage> page;
+    OffsetAllocator::Allocation allocation;
+    // in elements
+    unsigned offset;
+    unsigned count;
+
+    ~GeometryAllocation();
+  };
+
+  class GeometryPool
+  {
+    // meshes bigger than a page get a page of their own
+    const size_t VERTEX_PAGE_SIZE = 32 * 1024 * 1024;
+    const size_t INDEX_PAGE_SIZE = 16 * 1024 * 1024;
+
+  public:
+    static GeometryPool& Instance()
+    {
+      static GeometryPool instance;
+      return instance;
+    }
+
+    ~GeometryPool();
+
+    // suballocate and upload through the staging ring, the copy is recorded on commandList
+    // throws on count 0, empty meshes are skipped at import
+    std::unique_ptr<GeometryAllocation> AllocateVertices(ID3D12GraphicsCommandList* commandList, const void* data, unsigned count, unsigned stride);
+    // format is R16_UINT or R32_UINT
+    std::unique_ptr<GeometryAllocation> AllocateIndices(ID3D12GraphicsCommandList* commandList, const void* data, unsigned count, DXGI_FORMAT format);
+
+    // makes the page readable before drawing from it, so uploads recorded later in the same
+    // command list transition from the right state
+    void PrepareForDraw(ID3D12GraphicsCommandList* commandList, GeometryAllocation* allocation);
+    // called after ExecuteCommandLists, every page decayed to COMMON
+    void OnExecute();
+
+    // one entry per page
+    std::vector<OffsetAllocator::Stats> GetStats();
+
+  private:
+    using PageList = std::vector<std::shared_ptr<GeometryPage>>;
+
+    // indexFormat is DXGI_FORMAT_UNKNOWN for vertex pages
+    std::unique_ptr<GeometryAllocation> Allocate(
+      PageList& pages, unsigned count, unsigned elementSize, DXGI_FORMAT indexFormat, size_t pageSize);
+    std::shared_ptr<GeometryPage> CreatePage(uint32_t elementCount, unsigned elementSize, DXGI_FORMAT indexFormat);
+    void Upload(ID3D12GraphicsCommandList* commandList, GeometryAllocation* allocation, const void* data, unsigned elementSize);
+
+  private:
+    // vertex pages by stride
+    std::unordered_map<unsigned, PageList> m_vertexPages;
+    // index pages by format
+    std::unordered_map<DXGI_FORMAT, PageList> m_indexPages;
+    std::mutex m_mutex;
+
+  private:
+    GeometryPool();
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+  };
+}
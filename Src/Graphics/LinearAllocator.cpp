@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "LinearAllocator.h"
+
+#include <stdexcept>
+
+namespace Graphics
+{
+  LinearAllocator::LinearAllocator(size_t regionSize, unsigned regionCount)
+    : m_regionSize(regionSize)
+    , m_regionCount(regionCount)
+    , m_activeRegion(0)
+    , m_offset(0)
+    , m_peak(0)
+  {
+    if (regionCount == 0)
+      throw std::invalid_argument("[LINEAR_ALLOCATOR] NEEDS AT LEAST ONE REGION!");
+  }
+
+  LinearAllocator::~LinearAllocator()
+  {
+  }
+
+  void LinearAllocator::Reset(unsigned regionIndex)
+  {
+    if (regionIndex >= m_regionCount)
+      throw std::out_of_range("[LINEAR_ALLOCATOR] REGION DOES NOT EXIST!");
+
+    m_activeRegion = regionIndex;
+    m_offset.store(0, std::memory_order_relaxed);
+  }
+
+  size_t LinearAllocator::Allocate(size_t size, size_t alignment)
+  {
+    size_t offset = m_offset.load(std::memory_order_relaxed);
+    size_t aligned = 0;
+
+    // CAS loop so recording threads can allocate at the same time
+    do
+    {
+      aligned = (offset + alignment - 1) & ~(alignment - 1);
+      if (aligned + size > m_regionSize || aligned + size < aligned)
+        return InvalidOffset;
+    } while (!m_offset.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed));
+
+    size_t peak = m_peak.load(std::memory_order_relaxed);
+    while (aligned + size > peak && !m_peak.compare_exchange_weak(peak, aligned + size, std::memory_order_relaxed))
+      ;
+
+    return m_activeRegion * m_regionSize + aligned;
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+
+namespace Graphics
+{
+  // Bump allocator over a buffer split in regionCount equal regions, one per frame in flight.
+  // Allocations are taken from the active region only, and the whole region is recycled at once
+  // when the frame that used it comes around again (after its fence retired).
+  // It only deals with offsets, the owner maps them to CPU/GPU addresses.
+  class LinearAllocator
+  {
+  public:
+    static constexpr size_t InvalidOffset = ~static_cast<size_t>(0);
+
+    LinearAllocator(size_t regionSize, unsigned regionCount);
+    ~LinearAllocator();
+
+    // makes regionIndex the active region and empties it, the GPU must be done with it
+    void Reset(unsigned regionIndex);
+    // returns an offset from the start of the buffer, InvalidOffset if the region is full
+    // alignment has to be a power of two
+    size_t Allocate(size_t size, size_t alignment);
+
+    unsigned GetActiveRegion() const { return m_activeRegion; }
+    size_t GetRegionSize() const { return m_regionSize; }
+    size_t GetCapacity() const { return m_regionSize * m_regionCount; }
+    // bytes used in the active region
+    size_t GetUsed() const { return m_offset.load(std::memory_order_relaxed); }
+    // highest usage of a region so far
+    size_t GetPeak() const { return m_peak.load(std::memory_order_relaxed); }
+
+  private:
+    size_t m_regionSize;
+    unsigned m_regionCount;
+    unsigned m_activeRegion;
+    // offset inside the active region
+    std::atomic<size_t> m_offset;
+    std::atomic<size_t> m_peak;
+
+  private:
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+  };
+}
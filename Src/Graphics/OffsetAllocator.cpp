@@ -0,0 +1,312 @@
+#include "stdafx.h"
+#include "OffsetAllocator.h"
+
+#include <bit>
+#include <stdexcept>
+
+// helpers
+namespace
+{
+  // sizes are stored as tiny floats, 3 bits of mantissa and 5 bits of exponent
+  // sizes below 8 are exact, above that every power of two is split in 8 bins
+  constexpr uint32_t MantissaBits = 3;
+  constexpr uint32_t MantissaValue = 1 << MantissaBits;
+  constexpr uint32_t MantissaMask = MantissaValue - 1;
+
+  // smallest bin that only holds ranges >= size, used to allocate
+  uint32_t SizeToBinRoundUp(uint32_t size)
+  {
+    if (size < MantissaValue)
+      return size;
+
+    const uint32_t highestBit = std::bit_width(size) - 1;
+    const uint32_t mantissaStart = highestBit - MantissaBits;
+    const uint32_t exponent = mantissaStart + 1;
+    uint32_t mantissa = (size >> mantissaStart) & MantissaMask;
+    // round up, an overflowing mantissa carries into the exponent
+    if (size & ((1u << mantissaStart) - 1))
+      ++mantissa;
+
+    return (exponent << MantissaBits) + mantissa;
+  }
+
+  // bin a free range of size goes to, every range in it is >= the bin size
+  uint32_t SizeToBinRoundDown(uint32_t size)
+  {
+    if (size < MantissaValue)
+      return size;
+
+    const uint32_t highestBit = std::bit_width(size) - 1;
+    const uint32_t mantissaStart = highestBit - MantissaBits;
+    const uint32_t exponent = mantissaStart + 1;
+    const uint32_t mantissa = (size >> mantissaStart) & MantissaMask;
+
+    return (exponent << MantissaBits) | mantissa;
+  }
+
+  // lowest set bit at or after startBit
+  uint32_t FindLowestSetBitAfter(uint32_t mask, uint32_t startBit)
+  {
+    if (startBit >= 32)
+      return 32;
+    const uint32_t masked = mask & ~((1u << startBit) - 1);
+    return masked ? std::countr_zero(masked) : 32;
+  }
+}
+
+namespace Graphics
+{
+  OffsetAllocator::OffsetAllocator(uint32_t size)
+    : m_size(size)
+    , m_freeStorage(0)
+    , m_allocations(0)
+    , m_usedTopBins(0)
+    , m_usedLeafBins()
+    , m_binHeads()
+    , m_nodes()
+    , m_freeNodes()
+  {
+    if (size == 0)
+      throw std::invalid_argument("[OFFSET_ALLOCATOR] SIZE CAN'T BE 0!");
+
+    Reset();
+  }
+
+  OffsetAllocator::~OffsetAllocator()
+  {
+  }
+
+  void OffsetAllocator::Reset()
+  {
+    m_freeStorage = 0;
+    m_allocations = 0;
+    m_usedTopBins = 0;
+    for (auto& leafBins : m_usedLeafBins)
+      leafBins = 0;
+    for (auto& head : m_binHeads)
+      head = Unused;
+    m_nodes.clear();
+    m_freeNodes.clear();
+
+    // the whole space is one free range
+    InsertFree(0, m_size);
+  }
+
+  OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32_t size)
+  {
+    Allocation output;
+    if (size == 0 || size > m_freeStorage)
+      return output;
+
+    // round up, so any node of the bin found is big enough
+    const uint32_t minBin = SizeToBinRoundUp(size);
+    const uint32_t bin = FindBin(minBin);
+    uint32_t nodeIndex = bin != Unused ? m_binHeads[bin] : Unused;
+
+    // nothing in the bigger bins, the bin of size itself may still have a node that fits
+    if (nodeIndex == Unused)
+    {
+      for (uint32_t node = m_binHeads[SizeToBinRoundDown(size)]; node != Unused; node = m_nodes[node].binNext)
+      {
+        if (m_nodes[node].size >= size)
+        {
+          nodeIndex = node;
+          break;
+        }
+      }
+      if (nodeIndex == Unused)
+        return output;
+    }
+
+    RemoveFree(nodeIndex);
+
+    Node& node = m_nodes[nodeIndex];
+    const uint32_t remainder = node.size - size;
+    node.size = size;
+    node.used = true;
+    ++m_allocations;
+
+    // give back what's left after the allocation
+    if (remainder > 0)
+    {
+      const uint32_t newIndex = InsertFree(m_nodes[nodeIndex].offset + size, remainder);
+      // InsertFree can grow m_nodes, don't hold on to the reference
+      Node& allocated = m_nodes[nodeIndex];
+      Node& split = m_nodes[newIndex];
+      split.neighborPrev = nodeIndex;
+      split.neighborNext = allocated.neighborNext;
+      if (allocated.neighborNext != Unused)
+        m_nodes[allocated.neighborNext].neighborPrev = newIndex;
+      allocated.neighborNext = newIndex;
+    }
+
+    output.offset = m_nodes[nodeIndex].offset;
+    output.node = nodeIndex;
+    return output;
+  }
+
+  void OffsetAllocator::Free(Allocation allocation)
+  {
+    if (allocation.node >= m_nodes.size() || !m_nodes[allocation.node].used)
+      throw std::out_of_range("[OFFSET_ALLOCATOR] ALLOCATION IS NOT IN USE!");
+
+    const uint32_t nodeIndex = allocation.node;
+    uint32_t offset = m_nodes[nodeIndex].offset;
+    uint32_t size = m_nodes[nodeIndex].size;
+    uint32_t neighborPrev = m_nodes[nodeIndex].neighborPrev;
+    uint32_t neighborNext = m_nodes[nodeIndex].neighborNext;
+    --m_allocations;
+
+    // merge with the free neighbours
+    if (neighborPrev != Unused && !m_nodes[neighborPrev].used)
+    {
+      const uint32_t prev = neighborPrev;
+      offset = m_nodes[prev].offset;
+      size += m_nodes[prev].size;
+      neighborPrev = m_nodes[prev].neighborPrev;
+      RemoveFree(prev);
+      ReleaseNode(prev);
+    }
+
+    if (neighborNext != Unused && !m_nodes[neighborNext].used)
+    {
+      const uint32_t next = neighborNext;
+      size += m_nodes[next].size;
+      neighborNext = m_nodes[next].neighborNext;
+      RemoveFree(next);
+      ReleaseNode(next);
+    }
+
+    ReleaseNode(nodeIndex);
+
+    // the merged range takes the place of the three nodes
+    const uint32_t merged = InsertFree(offset, size);
+    m_nodes[merged].neighborPrev = neighborPrev;
+    m_nodes[merged].neighborNext = neighborNext;
+    if (neighborPrev != Unused)
+      m_nodes[neighborPrev].neighborNext = merged;
+    if (neighborNext != Unused)
+      m_nodes[neighborNext].neighborPrev = merged;
+  }
+
+  OffsetAllocator::Stats OffsetAllocator::GetStats() const
+  {
+    Stats output = {};
+    output.size = m_size;
+    output.totalFree = m_freeStorage;
+    output.allocations = m_allocations;
+
+    for (uint32_t bin = 0; bin < LeafBinCount; ++bin)
+    {
+      for (uint32_t node = m_binHeads[bin]; node != Unused; node = m_nodes[node].binNext)
+      {
+        ++output.freeRegions;
+        if (m_nodes[node].size > output.largestFree)
+          output.largestFree = m_nodes[node].size;
+      }
+    }
+
+    if (output.totalFree > 0)
+      output.fragmentation = 1.0f - static_cast<float>(output.largestFree) / static_cast<float>(output.totalFree);
+
+    return output;
+  }
+
+  uint32_t OffsetAllocator::InsertFree(uint32_t offset, uint32_t size)
+  {
+    const uint32_t bin = SizeToBinRoundDown(size);
+    const uint32_t topBin = bin / BinsPerLeaf;
+    const uint32_t leafBin = bin % BinsPerLeaf;
+
+    m_usedTopBins |= 1u << topBin;
+    m_usedLeafBins[topBin] |= 1u << leafBin;
+
+    // push at the head of the bin
+    const uint32_t nodeIndex = NewNode();
+    Node& node = m_nodes[nodeIndex];
+    node.offset = offset;
+    node.size = size;
+    node.used = false;
+    node.binPrev = Unused;
+    node.binNext = m_binHeads[bin];
+    node.neighborPrev = Unused;
+    node.neighborNext = Unused;
+    if (node.binNext != Unused)
+      m_nodes[node.binNext].binPrev = nodeIndex;
+    m_binHeads[bin] = nodeIndex;
+
+    m_freeStorage += size;
+    return nodeIndex;
+  }
+
+  void OffsetAllocator::RemoveFree(uint32_t nodeIndex)
+  {
+    Node& node = m_nodes[nodeIndex];
+
+    if (node.binPrev != Unused)
+    {
+      m_nodes[node.binPrev].binNext = node.binNext;
+    }
+    else
+    {
+      // head of its bin, the bin may become empty
+      const uint32_t bin = SizeToBinRoundDown(node.size);
+      const uint32_t topBin = bin / BinsPerLeaf;
+      const uint32_t leafBin = bin % BinsPerLeaf;
+      m_binHeads[bin] = node.binNext;
+      if (node.binNext == Unused)
+      {
+        m_usedLeafBins[topBin] &= ~(1u << leafBin);
+        if (m_usedLeafBins[topBin] == 0)
+          m_usedTopBins &= ~(1u << topBin);
+      }
+    }
+
+    if (node.binNext != Unused)
+      m_nodes[node.binNext].binPrev = node.binPrev;
+
+    node.binPrev = Unused;
+    node.binNext = Unused;
+    m_freeStorage -= node.size;
+  }
+
+  uint32_t OffsetAllocator::NewNode()
+  {
+    if (!m_freeNodes.empty())
+    {
+      const uint32_t node = m_freeNodes.back();
+      m_freeNodes.pop_back();
+      return node;
+    }
+
+    m_nodes.emplace_back();
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+  }
+
+  void OffsetAllocator::ReleaseNode(uint32_t node)
+  {
+    m_nodes[node] = Node();
+    m_freeNodes.push_back(node);
+  }
+
+  uint32_t OffsetAllocator::FindBin(uint32_t minBin) const
+  {
+    const uint32_t minTopBin = minBin / BinsPerLeaf;
+    const uint32_t minLeafBin = minBin % BinsPerLeaf;
+
+    // first try the leaf bins of the same level
+    if (m_usedTopBins & (1u << minTopBin))
+    {
+      const uint32_t leafBin = FindLowestSetBitAfter(m_usedLeafBins[minTopBin], minLeafBin);
+      if (leafBin < BinsPerLeaf)
+        return minTopBin * BinsPerLeaf + leafBin;
+    }
+
+    // any bin of the next used level is big enough
+    const uint32_t topBin = FindLowestSetBitAfter(m_usedTopBins, minTopBin + 1);
+    if (topBin >= TopBinCount)
+      return Unused;
+
+    return topBin * BinsPerLeaf + std::countr_zero(static_cast<uint32_t>(m_usedLeafBins[topBin]));
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Graphics
+{
+  // TLSF style suballocator, it hands out ranges of a [0, size) space and knows nothing about
+  // what lives there, the caller decides the unit (bytes, vertices, indices ...etc).
+  // Free ranges are kept in 256 bins: 32 power of two levels split in 8 linear bins each,
+  // a two level bitmask finds a big enough bin in O(1), neighbours are merged on free.
+  // Not thread safe, the owner locks.
+  class OffsetAllocator
+  {
+  public:
+    static constexpr uint32_t InvalidOffset = 0xFFFFFFFF;
+
+    struct Allocation
+    {
+      uint32_t offset = InvalidOffset;
+      // internal node, needed to free
+      uint32_t node = InvalidOffset;
+    };
+
+    struct Stats
+    {
+      uint32_t size;
+      uint32_t totalFree;
+      uint32_t largestFree;
+      uint32_t freeRegions;
+      uint32_t allocations;
+      // 0 when all the free space is contiguous, close to 1 when it is scattered in small holes
+      float fragmentation;
+    };
+
+    explicit OffsetAllocator(uint32_t size);
+    ~OffsetAllocator();
+
+    // offset is InvalidOffset when there is no free range big enough
+    Allocation Allocate(uint32_t size);
+    void Free(Allocation allocation);
+    // frees everything
+    void Reset();
+
+    uint32_t GetSize() const { return m_size; }
+    Stats GetStats() const;
+
+  private:
+    static constexpr uint32_t TopBinCount = 32;
+    static constexpr uint32_t BinsPerLeaf = 8;
+    static constexpr uint32_t LeafBinCount = TopBinCount * BinsPerLeaf;
+    static constexpr uint32_t Unused = 0xFFFFFFFF;
+
+    struct Node
+    {
+      uint32_t offset = 0;
+      uint32_t size = 0;
+      // free list of the bin
+      uint32_t binPrev = Unused;
+      uint32_t binNext = Unused;
+      // physical neighbours
+      uint32_t neighborPrev = Unused;
+      uint32_t neighborNext = Unused;
+      bool used = false;
+    };
+
+    uint32_t InsertFree(uint32_t offset, uint32_t size);
+    void RemoveFree(uint32_t node);
+    uint32_t NewNode();
+    void ReleaseNode(uint32_t node);
+    uint32_t FindBin(uint32_t minBin) const;
+
+  private:
+    uint32_t m_size;
+    uint32_t m_freeStorage;
+    uint32_t m_allocations;
+    // a bit per top level, set when one of its leaf bins has free nodes
+    uint32_t m_usedTopBins;
+    uint8_t m_usedLeafBins[TopBinCount];
+    uint32_t m_binHeads[LeafBinCount];
+    std::vector<Node> m_nodes;
+    // recycled node indices
+    std::vector<uint32_t> m_freeNodes;
+  };
+}
@@ -2,9 +2,11 @@
 #include "PSOManager.h"
 
 #include "Graphics/DX12Interface.h"
+#include "Graphics/ResourceManager.h"
 
 #include "Shaders/ShaderManager.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 
@@ -29,35 +31,69 @@ namespace Graphics
 
   ID3D12RootSignature* PSOManager::GetRootSignature(const std::string& name)
   {
-    auto shaderName = m_psoMap[name]->shaderName;
-    auto shaderBlob = Shaders::ShaderManager::Instance().GetShader(shaderName);
+    auto pso = m_psoMap[name];
+    auto shaderBlob = Shaders::ShaderManager::Instance().GetShader(pso->shaderName, pso->permutation);
     return shaderBlob->rootSignature.Get();
   }
 
-  void PSOManager::RegisterPSOs()
+  void PSOManager::RebuildPSOs(const std::vector<std::pair<std::string, uint32_t>>& variants)
   {
-    // create pipeline state object
-    // Define the vertex input layout.
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+    for (auto& entry : m_psoMap)
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-    };
+      PSO& pso = *entry.second;
+      if (std::find(variants.begin(), variants.end(), std::make_pair(pso.shaderName, pso.permutation)) == variants.end())
+        continue;
 
+      // made before the old one is touched, a shader the device rejects leaves the pso as it was
+      ComPtr<ID3D12PipelineState> rebuilt;
+      try
+      {
+        rebuilt = CreatePSO(pso);
+      }
+      catch (const std::exception& exception)
+      {
+        char message[512];
+        snprintf(message, sizeof(message), "[HOTRELOAD] pso %s could not be rebuilt, the previous one is kept: %s\n", entry.first.c_str(), exception.what());
+        OutputDebugStringA(message);
+        continue;
+      }
+
+      // the frames in flight still record with the old one
+      ComPtr<ID3D12PipelineState> retired = std::move(pso.pipelineState);
+      ResourceManager::Instance().DeferRelease([retired = std::move(retired)]() mutable { retired.Reset(); });
+      pso.pipelineState = std::move(rebuilt);
+    }
+  }
+
+  void PSOManager::RegisterPSOs()
+  {
     // TODO: handle errors
     auto configPath = std::filesystem::current_path().string() + "/Resources/configs/PipelineState.json";
 
     // read config file and parse it
     json configData = json::parse(std::ifstream(configPath))["PipelineStateObjects"];
 
+    // only the shader variants used by a pso are compiled, all of them at once
+    std::vector<std::pair<std::string, uint32_t>> variants;
     for (auto data : configData)
     {
+      std::string shader;
+      data.at("Shader").get_to(shader);
+      // optional, the permutation axes of the shader set for this pso
+      auto defines = data.value("Permutation", std::vector<std::string>());
+      variants.push_back({ shader, Shaders::ShaderManager::Instance().GetPermutationKey(shader, defines) });
+    }
+    Shaders::ShaderManager::Instance().CompileVariants(variants);
+
+    for (size_t i = 0; i < configData.size(); ++i)
+    {
+      auto data = configData[i];
       std::string name;
       std::string type;
       std::string shader;
       std::string cullMode;
       std::string depthTesting;
+      std::string inputLayout;
 
       data.at("Name").get_to(name);
       data.at("Type").get_to(type);
@@ -67,54 +103,19 @@ namespace Graphics
       {
         data.at("CullMode").get_to(cullMode);
         data.at("DepthTesting").get_to(depthTesting);
+        inputLayout = data.value("InputLayout", std::string("Full"));
       }
 
-      // get the shader blob
-      auto shaderBlob = Shaders::ShaderManager::Instance().GetShader(shader);
       // the pso
       auto pso = std::make_shared<PSO>();
       // set the shader name
       pso->shaderName = shader;
-
-      if (type == "Graphics")
-      { // graphics pso
-        // maybe handle case sensitive problems and errors
-        auto d3dCullMode = cullMode == "Back" ? D3D12_CULL_MODE_BACK : cullMode == "Front" ? D3D12_CULL_MODE_FRONT : D3D12_CULL_MODE_NONE;
-        // TODO: handle other cases
-        auto d3dDepthFunc = depthTesting == "Less" ? D3D12_COMPARISON_FUNC_LESS : D3D12_COMPARISON_FUNC_NONE;
-
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-        psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-        psoDesc.pRootSignature = shaderBlob->rootSignature.Get();
-        psoDesc.VS = CD3DX12_SHADER_BYTECODE(shaderBlob->vertexShader.Get());
-        psoDesc.PS = CD3DX12_SHADER_BYTECODE(shaderBlob->pixelShader.Get());
-        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-        psoDesc.RasterizerState.CullMode = d3dCullMode; // from config
-        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-        psoDesc.DepthStencilState.DepthEnable = depthTesting != "None"; // from config
-        psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
-        psoDesc.DepthStencilState.DepthFunc = d3dDepthFunc; // from config
-        psoDesc.DepthStencilState.StencilEnable = FALSE;
-        psoDesc.SampleMask = UINT_MAX;
-        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-        psoDesc.NumRenderTargets = 1;
-        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-        psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-        psoDesc.SampleDesc.Count = 1;
-        Utilities::ThrowIfFailed(
-          DX12Interface::Get().GetDevice()->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pso->pipelineState)));
-
-      } else if (type == "Compute")
-      { // compute pso
-        // Pipeline state descriptor
-        D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
-        psoDesc.pRootSignature = shaderBlob->rootSignature.Get();  // Root signature
-        psoDesc.CS.pShaderBytecode = shaderBlob->computeShader->GetBufferPointer();
-        psoDesc.CS.BytecodeLength = shaderBlob->computeShader->GetBufferSize();
-        psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE; // Default flag
-        // Create the compute PSO
-        DX12Interface::Get().GetDevice()->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&pso->pipelineState));
-      }
+      pso->permutation = variants[i].second;
+      pso->type = type;
+      pso->cullMode = cullMode;
+      pso->depthTesting = depthTesting;
+      pso->inputLayout = inputLayout;
+      pso->pipelineState = CreatePSO(*pso);
 
       if (type == "Graphics" || type == "Compute")
         m_psoMap[name] = pso; // store
@@ -122,4 +123,75 @@ namespace Graphics
 
   }
 
+  ComPtr<ID3D12PipelineState> PSOManager::CreatePSO(const PSO& pso) const
+  {
+    ComPtr<ID3D12PipelineState> pipelineState;
+    // create pipeline state object
+    // Define the vertex input layout.
+    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+    // compressed mesh vertices (Scene::CompressedVertex), position relative to the mesh bounds,
+    // octahedral normal and half uvs
+    D3D12_INPUT_ELEMENT_DESC compressedElementDescs[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+    // "Mesh" layouts follow the vertex format of the shaders
+    bool meshCompressed = Shaders::ShaderManager::Instance().IsVertexCompressed();
+
+    // get the shader blob
+    auto shaderBlob = Shaders::ShaderManager::Instance().GetShader(pso.shaderName, pso.permutation);
+
+    if (pso.type == "Graphics")
+    { // graphics pso
+      // maybe handle case sensitive problems and errors
+      auto d3dCullMode = pso.cullMode == "Back" ? D3D12_CULL_MODE_BACK : pso.cullMode == "Front" ? D3D12_CULL_MODE_FRONT : D3D12_CULL_MODE_NONE;
+      // TODO: handle other cases
+      auto d3dDepthFunc = pso.depthTesting == "Less" ? D3D12_COMPARISON_FUNC_LESS : D3D12_COMPARISON_FUNC_NONE;
+
+      D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+      if (pso.inputLayout == "Mesh" && meshCompressed)
+        psoDesc.InputLayout = { compressedElementDescs, _countof(compressedElementDescs) };
+      else
+        psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+      psoDesc.pRootSignature = shaderBlob->rootSignature.Get();
+      psoDesc.VS = CD3DX12_SHADER_BYTECODE(shaderBlob->vertexShader.Get());
+      psoDesc.PS = CD3DX12_SHADER_BYTECODE(shaderBlob->pixelShader.Get());
+      psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+      psoDesc.RasterizerState.CullMode = d3dCullMode; // from config
+      psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+      psoDesc.DepthStencilState.DepthEnable = pso.depthTesting != "None"; // from config
+      psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+      psoDesc.DepthStencilState.DepthFunc = d3dDepthFunc; // from config
+      psoDesc.DepthStencilState.StencilEnable = FALSE;
+      psoDesc.SampleMask = UINT_MAX;
+      psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+      psoDesc.NumRenderTargets = 1;
+      psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+      psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+      psoDesc.SampleDesc.Count = 1;
+      Utilities::ThrowIfFailed(
+        DX12Interface::Get().GetDevice()->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
+
+    } else if (pso.type == "Compute")
+    { // compute pso
+      // Pipeline state descriptor
+      D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+      psoDesc.pRootSignature = shaderBlob->rootSignature.Get();  // Root signature
+      psoDesc.CS.pShaderBytecode = shaderBlob->computeShader->GetBufferPointer();
+      psoDesc.CS.BytecodeLength = shaderBlob->computeShader->GetBufferSize();
+      psoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE; // Default flag
+      // Create the compute PSO
+      Utilities::ThrowIfFailed(
+        DX12Interface::Get().GetDevice()->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
+    }
+    return pipelineState;
+  }
+
 }
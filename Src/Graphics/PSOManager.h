@@ -1,6 +1,9 @@
 #pragma once
 
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
@@ -27,6 +30,12 @@ namespace Graphics
   struct PSO
   {
     std::string shaderName; // necessary to query the root signature
+    uint32_t permutation; // key of the shader variant
+    // from the config, kept to rebuild it when its shader is reloaded
+    std::string type;
+    std::string cullMode;
+    std::string depthTesting;
+    std::string inputLayout;
     ComPtr<ID3D12PipelineState> pipelineState;
 
     ~PSO()
@@ -47,9 +56,15 @@ namespace Graphics
 
     ID3D12PipelineState* GetPSO(const std::string& name) { return m_psoMap[name]->pipelineState.Get(); }
     ID3D12RootSignature* GetRootSignature(const std::string& name);
+    // recreates the psos of the reloaded shader variants, between frames. The replaced pipeline states
+    // are released once the GPU is done with them, the render graph has to take the new ones.
+    // A pso that fails to build keeps its previous pipeline state
+    void RebuildPSOs(const std::vector<std::pair<std::string, uint32_t>>& variants);
 
   private:
     void RegisterPSOs();
+    // the pipeline state from the shader variant and the config of the pso, throws when the device rejects it
+    ComPtr<ID3D12PipelineState> CreatePSO(const PSO& pso) const;
 
   private:
     std::unordered_map<std::string, std::shared_ptr<PSO>> m_psoMap;
@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include "ReleaseQueue.h"
+
+namespace Graphics
+{
+  ReleaseQueue::ReleaseQueue()
+    : m_buckets()
+    , m_currentFenceValue(0)
+    , m_mutex()
+  {
+  }
+
+  ReleaseQueue::~ReleaseQueue()
+  {
+    Flush();
+  }
+
+  void ReleaseQueue::SetCurrentFenceValue(uint64_t fenceValue)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_currentFenceValue = fenceValue;
+  }
+
+  uint64_t ReleaseQueue::GetCurrentFenceValue()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_currentFenceValue;
+  }
+
+  void ReleaseQueue::Enqueue(std::function<void()> release)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // one bucket per frame
+    if (m_buckets.empty() || m_buckets.back().fenceValue != m_currentFenceValue)
+      m_buckets.push_back({ m_currentFenceValue, {} });
+    m_buckets.back().releases.push_back(std::move(release));
+  }
+
+  void ReleaseQueue::Process(uint64_t completedFenceValue)
+  {
+    std::vector<std::function<void()>> ready;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      while (!m_buckets.empty() && m_buckets.front().fenceValue <= completedFenceValue)
+      {
+        auto& releases = m_buckets.front().releases;
+        ready.insert(ready.end(), std::make_move_iterator(releases.begin()), std::make_move_iterator(releases.end()));
+        m_buckets.pop_front();
+      }
+    }
+
+    // run outside of the lock, releases can take other locks
+    for (auto& release : ready)
+      release();
+  }
+
+  void ReleaseQueue::Flush()
+  {
+    std::deque<Bucket> buckets;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      buckets.swap(m_buckets);
+    }
+
+    for (auto& bucket : buckets)
+      for (auto& release : bucket.releases)
+        release();
+  }
+
+  size_t ReleaseQueue::GetPendingCount()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (const auto& bucket : m_buckets)
+      count += bucket.releases.size();
+    return count;
+  }
+}
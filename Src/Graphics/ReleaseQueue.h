@@ -0,0 +1,48 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Graphics
+{
+  // Holds on to releases (descriptor indices, resources ...etc) until the GPU is done with them.
+  // Releases are grouped in buckets keyed by the fence value that will be signaled at the end
+  // of the frame that retired them, a bucket runs once the fence reached that value.
+  // It knows nothing about D3D12, the context feeds it fence values.
+  class ReleaseQueue
+  {
+  public:
+    ReleaseQueue();
+    ~ReleaseQueue();
+
+    // fence value that will be signaled when the frame being recorded is done
+    void SetCurrentFenceValue(uint64_t fenceValue);
+    uint64_t GetCurrentFenceValue();
+
+    void Enqueue(std::function<void()> release);
+    // runs every bucket whose fence value is <= completedFenceValue
+    void Process(uint64_t completedFenceValue);
+    // runs everything, only call this when the GPU is idle
+    void Flush();
+
+    size_t GetPendingCount();
+
+  private:
+    struct Bucket
+    {
+      uint64_t fenceValue;
+      std::vector<std::function<void()>> releases;
+    };
+
+    // ordered by fence value, since fence values only grow
+    std::deque<Bucket> m_buckets;
+    uint64_t m_currentFenceValue;
+    std::mutex m_mutex;
+
+  private:
+    ReleaseQueue(const ReleaseQueue&) = delete;
+    ReleaseQueue& operator=(const ReleaseQueue&) = delete;
+  };
+}
@@ -1,58 +1,193 @@
 #include "stdafx.h"
 #include "ResourceManager.h"
 
+#include "Core/Application.h"
+
 #include "Graphics/DX12Interface.h"
 
 #include "Utilities/DXApplicationHelper.h"
 
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+// json
+#include <json.hpp>
+using json = nlohmann::json;
+
+// helpers
+namespace
+{
+  template<typename Allocator>
+  unsigned AllocateOrThrow(Allocator& allocator, const char* error)
+  {
+    auto index = allocator.Allocate();
+    if (index == Graphics::DescriptorAllocator::InvalidIndex)
+      throw std::out_of_range(error);
+    return index;
+  }
+}
+
 namespace Graphics
 {
+  Descriptor::~Descriptor()
+  {
+    if (freeResource)
+      ResourceManager::Instance().DeferRelease([freeResource = std::move(freeResource), index = index]() {
+        freeResource(index);
+      });
+  }
+
+  ResourceDescriptor::~ResourceDescriptor()
+  {
+    if (resource)
+      ResourceManager::Instance().DeferRelease([resource = std::move(resource)]() mutable {
+        resource.Reset();
+      });
+  }
+
+  TextureDescriptor::~TextureDescriptor()
+  {
+    if (freeMips && mipLevels > 0)
+      ResourceManager::Instance().DeferRelease([freeMips = std::move(freeMips), mipIndex = mipIndex]() {
+        freeMips(mipIndex);
+      });
+  }
+
+  RenderTargetDescriptor::~RenderTargetDescriptor()
+  {
+    ResourceManager::Instance().DeferRelease(
+      [renderTarget1 = std::move(renderTarget1), renderTarget2 = std::move(renderTarget2), freeRT = std::move(freeRT),
+      indices = std::array<unsigned, 4>{ renderTargetIndex1, shaderResourceIndex1, renderTargetIndex2, shaderResourceIndex2 }]() mutable {
+        renderTarget1.Reset();
+        renderTarget2.Reset();
+        if (freeRT)
+          freeRT(indices[0], indices[1], indices[2], indices[3]);
+      });
+  }
+
   ResourceManager::ResourceManager()
     : m_resourcesHeap(nullptr)
     , m_rtvHeap(nullptr)
     , m_dsvHeap(nullptr)
     , m_samplerHeap(nullptr)
-    , m_nextFreeTex()
-    , m_nextFreeMip()
-    , m_nextFreeCB()
-    , m_nextFreeRT()
-    , m_nextFreeDS()
-    , m_nextFreeSampler()
-    , m_mutexTex()
-    , m_mutexMip()
-    , m_mutexCB()
-    , m_mutexRT()
-    , m_mutexDS()
-    , m_mutexSampler()
+    , m_resourcesHeapSize(0)
+    , m_pagePool(nullptr)
+    , m_regions()
+    , m_texRegion(nullptr)
+    , m_mipRegion(nullptr)
+    , m_cbRegion(nullptr)
+    , m_rtAllocator(RT_RANGE.begin, RT_RANGE.end - RT_RANGE.begin + 1)
+    , m_dsAllocator(DS_RANGE.begin, DS_RANGE.end - DS_RANGE.begin + 1)
+    , m_samplerAllocator(SAMPLER_RANGE.begin, SAMPLER_RANGE.end - SAMPLER_RANGE.begin + 1)
+    , m_releaseQueue()
+    , m_constantsBuffer(nullptr)
+    , m_pConstantsBegin(nullptr)
+    , m_constantsAllocator(FRAME_CONSTANTS_SIZE, Core::Application::FrameCount)
+    , m_stagingBuffer(nullptr)
+    , m_pStagingBegin(nullptr)
+    , m_stagingAllocator(STAGING_SIZE, STAGING_CHUNK_THRESHOLD)
+    , m_stagedBytes(0)
+    , m_stagingChunkBytes(0)
   {
+    // regions layout, it also gives the heap size
+    CreateRegions();
+
     m_resourcesHeap = DX12Interface::Get().CreateHeapDescriptor(
-      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, RESOURCE_HEAP_SIZE);
+      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_resourcesHeapSize);
     // depth heap and render targets heap
     m_dsvHeap = DX12Interface::Get().CreateHeapDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, DSV_HEAP_SIZE);
     m_rtvHeap = DX12Interface::Get().CreateHeapDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, RTV_HEAP_SIZE);
     m_samplerHeap = DX12Interface::Get().CreateHeapDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, SAMPLER_HEAP_SIZE);
 
-    // populate free Index vector
-    for (unsigned i = TEX_RANGE.begin; i <= TEX_RANGE.end; i++)
-      m_nextFreeTex.push_back(i);
-    for (unsigned i = MIPS_RANGE.begin; i <= MIPS_RANGE.end; i++)
-      m_nextFreeMip.push_back(i);
-    for (unsigned i = CB_RANGE.begin; i <= CB_RANGE.end; i++)
-      m_nextFreeCB.push_back(i);
-    for (unsigned i = RT_RANGE.begin; i <= RT_RANGE.end; i++)
-      m_nextFreeRT.push_back(i);
-    for (unsigned i = DS_RANGE.begin; i <= DS_RANGE.end; i++)
-      m_nextFreeDS.push_back(i);
-    for (unsigned i = SAMPLER_RANGE.begin; i <= SAMPLER_RANGE.end; i++)
-      m_nextFreeSampler.push_back(i);
+    // one region per frame, mapped for the lifetime of the app
+    m_constantsBuffer = DX12Interface::Get().CreateConstantBuffer(m_constantsAllocator.GetCapacity(), D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RANGE readRange(0, 0); // We do not intend to read from this resource on the CPU.
+    Utilities::ThrowIfFailed(m_constantsBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pConstantsBegin)));
+
+    // staging ring, also mapped for the lifetime of the app
+    m_stagingBuffer = DX12Interface::Get().CreateConstantBuffer(STAGING_SIZE, D3D12_HEAP_TYPE_UPLOAD);
+    Utilities::ThrowIfFailed(m_stagingBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pStagingBegin)));
   }
 
   ResourceManager::~ResourceManager()
   {
+    // whatever is still pending, the GPU is idle at this point
+    m_releaseQueue.Flush();
+    m_constantsBuffer.Reset();
+    m_stagingBuffer.Reset();
     m_resourcesHeap.Reset();
     m_dsvHeap.Reset();
     m_rtvHeap.Reset();
     m_samplerHeap.Reset();
+    m_regions.clear();
+    m_pagePool.reset();
+  }
+
+  void ResourceManager::CreateRegions()
+  {
+    // TODO: handle errors
+    auto configPath = std::filesystem::current_path().string() + "/Resources/configs/DescriptorHeap.json";
+
+    // read config file and parse it
+    json configData = json::parse(std::ifstream(configPath))["ResourceHeap"];
+
+    m_resourcesHeapSize = configData["Size"];
+    unsigned pageSize = configData["PageSize"];
+
+    // shader visible heaps are limited to 1M descriptors on tier 1 hardware
+    if (m_resourcesHeapSize > D3D12_MAX_SHADER_VISIBLE_DESCRIPTOR_HEAP_SIZE_TIER_1)
+      throw std::out_of_range("[DESCRIPTOR_HEAP] HEAP SIZE IS BIGGER THAN WHAT TIER 1 SUPPORTS!");
+    if (pageSize % MIPS_BLOCK_SIZE != 0)
+      throw std::invalid_argument("[DESCRIPTOR_HEAP] PAGE SIZE HAS TO BE A MULTIPLE OF THE MIPS BLOCK SIZE!");
+
+    // reserved ranges first, in the config order
+    unsigned begin = 0;
+    std::vector<std::pair<std::string, unsigned>> reserved;
+    for (auto data : configData["Regions"])
+    {
+      std::string name = data["Name"];
+      unsigned count = data["Count"];
+      reserved.push_back({ name, begin });
+      begin += count;
+    }
+
+    if (begin > m_resourcesHeapSize)
+      throw std::out_of_range("[DESCRIPTOR_HEAP] REGIONS DON'T FIT IN THE HEAP!");
+
+    // what is left is shared as pages
+    m_pagePool = std::make_unique<DescriptorAllocator>(begin, m_resourcesHeapSize - begin, pageSize);
+
+    for (unsigned i = 0; i < reserved.size(); ++i)
+    {
+      const auto& [name, regionBegin] = reserved[i];
+      const unsigned regionEnd = i + 1 < reserved.size() ? reserved[i + 1].second : begin;
+      // the mips root signature takes a block of UAVs at once
+      const unsigned blockSize = name == "Mips" ? MIPS_BLOCK_SIZE : 1;
+      m_regions.push_back(std::make_unique<DescriptorRegion>(name, regionBegin, regionEnd - regionBegin, blockSize, m_pagePool.get()));
+    }
+
+    m_cbRegion = GetRegion("ConstantBuffers");
+    m_texRegion = GetRegion("Textures");
+    m_mipRegion = GetRegion("Mips");
+  }
+
+  DescriptorRegion* ResourceManager::GetRegion(const std::string& name)
+  {
+    for (auto& region : m_regions)
+      if (region->GetName() == name)
+        return region.get();
+
+    throw std::out_of_range("[DESCRIPTOR_HEAP] REGION " + name + " IS MISSING FROM THE CONFIG!");
+  }
+
+  std::vector<DescriptorRegion::Stats> ResourceManager::GetDescriptorStats()
+  {
+    std::vector<DescriptorRegion::Stats> output;
+    for (auto& region : m_regions)
+      output.push_back(region->GetStats());
+    return output;
   }
 
   D3D12_GPU_DESCRIPTOR_HANDLE ResourceManager::GetResourceGpuHandle(unsigned index)
@@ -119,52 +254,118 @@ namespace Graphics
       DX12Interface::Get().GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER));
   }
 
-  std::unique_ptr<ResourceDescriptor> ResourceManager::CreateConstantBufferResource(size_t size, D3D12_HEAP_TYPE type)
+  ConstantAllocation ResourceManager::AllocateConstants(size_t size)
   {
-    // check if space is available
-    if (m_nextFreeCB.size() < 1)
-      throw std::out_of_range("[CONSTANT_BUFFER] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    auto offset = m_constantsAllocator.Allocate(size, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+    if (offset == LinearAllocator::InvalidOffset)
+      throw std::out_of_range("[FRAME_CONSTANTS] FRAME CONSTANT BUFFER HAVE NO SPACE LEFT!");
 
-    std::unique_ptr<ResourceDescriptor> output = std::make_unique<ResourceDescriptor>();
-    output->resource = DX12Interface::Get().CreateConstantBuffer(size, D3D12_HEAP_TYPE_UPLOAD);
-    
+    ConstantAllocation output;
+    output.cpuAddress = m_pConstantsBegin + offset;
+    output.gpuAddress = m_constantsBuffer->GetGPUVirtualAddress() + offset;
+
+    return output;
+  }
+
+  StagingAllocation ResourceManager::ReserveStaging(size_t size, size_t alignment)
+  {
+    m_stagedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    StagingAllocation output = {};
+
+    auto offset = m_stagingAllocator.Allocate(size, alignment);
+    if (offset != RingAllocator::InvalidOffset)
     {
-      std::lock_guard<std::mutex> lock(m_mutexCB);
-      output->index = m_nextFreeCB.front();
-      m_nextFreeCB.erase(m_nextFreeCB.begin());
+      output.resource = m_stagingBuffer.Get();
+      output.offset = offset;
+      output.cpuAddress = m_pStagingBegin + offset;
+      return output;
     }
 
-    DX12Interface::Get().CreateConstantBufferView(output->resource.Get(), m_resourcesHeap.Get(), output->index);
+    // too big for the ring or the ring is full, use a temporary chunk that goes away with the frame
+    auto chunk = DX12Interface::Get().CreateConstantBuffer(size, D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RANGE readRange(0, 0);
+    Utilities::ThrowIfFailed(chunk->Map(0, &readRange, &output.cpuAddress));
+    output.resource = chunk.Get();
+    output.offset = 0;
+
+    DeferRelease([chunk = std::move(chunk)]() mutable {
+      chunk.Reset();
+    });
+    m_stagingChunkBytes.fetch_add(size, std::memory_order_relaxed);
+
+    return output;
+  }
+
+  void ResourceManager::UploadBuffer(ID3D12GraphicsCommandList* commandList, ID3D12Resource* destination, const void* data, size_t size)
+  {
+    auto staging = ReserveStaging(size, 4);
+    memcpy(staging.cpuAddress, data, size);
+    commandList->CopyBufferRegion(destination, 0, staging.resource, staging.offset, size);
+  }
+
+  void ResourceManager::SetReleaseFenceValue(uint64_t fenceValue)
+  {
+    m_releaseQueue.SetCurrentFenceValue(fenceValue);
+    m_stagingAllocator.SetCurrentFenceValue(fenceValue);
+  }
 
+  void ResourceManager::ProcessReleases(uint64_t completedFenceValue)
+  {
+    m_releaseQueue.Process(completedFenceValue);
+    m_stagingAllocator.Retire(completedFenceValue);
+
+    // report frames that uploaded something, the counters restart every frame either way
+    auto staged = m_stagedBytes.exchange(0, std::memory_order_relaxed);
+    auto chunks = m_stagingChunkBytes.exchange(0, std::memory_order_relaxed);
+    auto peak = m_stagingAllocator.ConsumePeak();
+    if (Utilities::FRAME_STATS_ENABLED && staged > 0)
+    {
+      char message[256];
+      snprintf(message, sizeof(message), "[STAGING] frame staged %zu KB, ring peak %zu / %zu KB, temporary chunks %zu KB\n",
+        staged / 1024, peak / 1024, m_stagingAllocator.GetCapacity() / 1024, chunks / 1024);
+      OutputDebugStringA(message);
+    }
+  }
+
+  void ResourceManager::FlushReleases()
+  {
+    m_releaseQueue.Flush();
+    m_stagingAllocator.Reset();
+  }
+
+  std::unique_ptr<ResourceDescriptor> ResourceManager::CreateConstantBufferResource(size_t size, D3D12_HEAP_TYPE type)
+  {
+    std::unique_ptr<ResourceDescriptor> output = std::make_unique<ResourceDescriptor>();
+    output->index = AllocateOrThrow(*m_cbRegion, "[CONSTANT_BUFFER] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
     output->freeResource = [&](unsigned index) {
-      std::lock_guard<std::mutex> lock(m_mutexCB);
-      m_nextFreeCB.push_back(index);
+      m_cbRegion->Free(index);
     };
 
+    output->resource = DX12Interface::Get().CreateConstantBuffer(size, D3D12_HEAP_TYPE_UPLOAD);
+
+    DX12Interface::Get().CreateConstantBufferView(output->resource.Get(), m_resourcesHeap.Get(), output->index);
+
     return output;
   }
 
   std::shared_ptr<TextureDescriptor> ResourceManager::CreateTextureResource(D3D12_RESOURCE_DESC& desc, bool isCubeMap, bool generateMips)
   {
     // TODO: add condition for cubemap
-    // check if space is available
-    if (m_nextFreeTex.size() < 1)
-      throw std::out_of_range("[TEXTURE] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
-
-    // check if space is available
-    if (m_nextFreeMip.size() < desc.MipLevels)
-      throw std::out_of_range("[MIPS] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    if (generateMips && desc.MipLevels > MIPS_BLOCK_SIZE)
+      throw std::out_of_range("[MIPS] TEXTURE HAS MORE MIPS THAN A MIPS BLOCK CAN HOLD!");
 
     std::unique_ptr<TextureDescriptor> output = std::make_unique<TextureDescriptor>();
     ComPtr<ID3D12Resource> texture;
-    ComPtr<ID3D12Resource> upload;
-    
-    {
-      std::lock_guard<std::mutex> lock(m_mutexTex);
-      output->index = m_nextFreeTex.front();
-      // index no longer free
-      m_nextFreeTex.erase(m_nextFreeTex.begin());
-    }
+
+    // the free callbacks are set right away, so the indices are returned if anything below throws
+    output->index = AllocateOrThrow(*m_texRegion, "[TEXTURE] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    output->freeResource = [&](unsigned index) {
+      m_texRegion->Free(index);
+    };
+    output->freeMips = [&](unsigned index) {
+      m_mipRegion->Free(index);
+    };
 
     auto defaultProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     // texture resource
@@ -176,65 +377,32 @@ namespace Graphics
       nullptr,
       IID_PPV_ARGS(&texture)));
 
-    // upload heap
-    auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(
-      GetRequiredIntermediateSize(texture.Get(), 0, desc.DepthOrArraySize * desc.MipLevels));
-    auto uploadProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    Utilities::ThrowIfFailed(DX12Interface::Get().GetDevice()->CreateCommittedResource(
-      &uploadProps,
-      D3D12_HEAP_FLAG_NONE,
-      &uploadDesc,
-      D3D12_RESOURCE_STATE_GENERIC_READ,
-      nullptr,
-      IID_PPV_ARGS(&upload)));
-
     DX12Interface::Get().CreateShaderResourceView(texture.Get(), m_resourcesHeap.Get(), output->index, isCubeMap);
 
     // mips?
+    if (generateMips)
     {
-      std::lock_guard<std::mutex> lock(m_mutexMip);
-      if (generateMips && m_nextFreeMip.size() >= texture->GetDesc().MipLevels)
-      {
-        // root signature takes 4 UAV at once
-        output->mipIndex = m_nextFreeMip.front();
-        output->mipLevels = texture->GetDesc().MipLevels;
-        for (unsigned mip = 0; mip < texture->GetDesc().MipLevels; ++mip)
-        {
-          DX12Interface::Get().CreateUnorderedAccessView(texture.Get(), m_resourcesHeap.Get(), m_nextFreeMip.front(), mip);
-          m_nextFreeMip.erase(m_nextFreeMip.begin());
-        }
-      }
+      // root signature takes 4 UAV at once, a block holds consecutive UAVs
+      output->mipIndex = AllocateOrThrow(*m_mipRegion, "[MIPS] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+      output->mipLevels = texture->GetDesc().MipLevels;
+      for (unsigned mip = 0; mip < output->mipLevels; ++mip)
+        DX12Interface::Get().CreateUnorderedAccessView(texture.Get(), m_resourcesHeap.Get(), output->mipIndex + mip, mip);
     }
 
     output->resource = texture;
-    output->upload = upload;
-    output->freeResource = [&](unsigned index) {
-      std::lock_guard<std::mutex> lock(m_mutexTex);
-      m_nextFreeTex.push_back(index);
-    };
-    output->freeMips = [&](unsigned index, unsigned mips) {
-      std::lock_guard<std::mutex> lock(m_mutexMip);
-      for (unsigned i = index; i < index + mips; ++i)
-        m_nextFreeMip.push_back(i);
-    };
 
     return output;
   }
   std::unique_ptr<ResourceDescriptor> ResourceManager::CreateDepthResource(D3D12_RESOURCE_DESC& desc, D3D12_CLEAR_VALUE& clearValue)
   {
-    // check if space is available
-    if (m_nextFreeDS.size() < 1)
-      throw std::out_of_range("[DEPTH] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
-
-    // no need to check for free place I guess, I expect to have only one depth buffer
+    // I expect to have only one depth buffer
     std::unique_ptr<ResourceDescriptor> output = std::make_unique<ResourceDescriptor>();
     ComPtr<ID3D12Resource> depth;
-    
-    {
-      std::lock_guard<std::mutex> lock(m_mutexDS);
-      output->index = m_nextFreeDS.front();
-      m_nextFreeDS.erase(m_nextFreeDS.begin());
-    }
+
+    output->index = AllocateOrThrow(m_dsAllocator, "[DEPTH] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    output->freeResource = [&](unsigned index) {
+      m_dsAllocator.Free(index);
+    };
 
     auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     Utilities::ThrowIfFailed(DX12Interface::Get().GetDevice()->CreateCommittedResource(
@@ -249,44 +417,41 @@ namespace Graphics
     DX12Interface::Get().CreateDepthStencilView(depth.Get(), m_dsvHeap.Get(), output->index);
 
     output->resource = depth;
-    output->freeResource = [&](unsigned index) {
-      std::lock_guard<std::mutex> lock(m_mutexDS);
-      m_nextFreeDS.push_back(index);
-    };
 
     return output;
   }
 
   std::shared_ptr<RenderTargetDescriptor> ResourceManager::CreateRenderTargetResource(ID3D12Resource* swapRenderTarget)
   {
-    // check if space is available
-    if (m_nextFreeRT.size() < 1) // TODO: this condition should be changed because we create multiple render targets per swap
-      throw std::out_of_range("[RENDERTARGET] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
-
-    // TODO: a condition for textures
-
     std::unique_ptr<RenderTargetDescriptor> output = std::make_unique<RenderTargetDescriptor>();
 
     // swap render target
-    {
-      std::lock_guard<std::mutex> lock(m_mutexRT);
-      output->index = m_nextFreeRT.front();
-      m_nextFreeRT.erase(m_nextFreeRT.begin());
-      // render targets
-      output->renderTargetIndex1 = m_nextFreeRT.front();
-      m_nextFreeRT.erase(m_nextFreeRT.begin());
-      output->renderTargetIndex2 = m_nextFreeRT.front();
-      m_nextFreeRT.erase(m_nextFreeRT.begin());
-    }
-    DX12Interface::Get().CreateRenderTargetView(swapRenderTarget, m_rtvHeap.Get(), output->index);
+    output->index = AllocateOrThrow(m_rtAllocator, "[RENDERTARGET] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    // we will not store the resource because swapchain is the owner of the render target
+    output->freeResource = [&](unsigned index) {
+      m_rtAllocator.Free(index);
+    };
 
-    {
-      std::lock_guard<std::mutex> lock(m_mutexTex);
-      output->shaderResourceIndex1 = m_nextFreeTex.front();
-      m_nextFreeTex.erase(m_nextFreeTex.begin());
-      output->shaderResourceIndex2 = m_nextFreeTex.front();
-      m_nextFreeTex.erase(m_nextFreeTex.begin());
-    }
+    // render targets and their views
+    // start as invalid, so only what was allocated is given back if an allocation below throws
+    output->renderTargetIndex1 = DescriptorAllocator::InvalidIndex;
+    output->renderTargetIndex2 = DescriptorAllocator::InvalidIndex;
+    output->shaderResourceIndex1 = DescriptorAllocator::InvalidIndex;
+    output->shaderResourceIndex2 = DescriptorAllocator::InvalidIndex;
+    output->freeRT = [&](unsigned RTIndex1, unsigned SRIndex1, unsigned RTIndex2, unsigned SRIndex2) {
+      for (auto index : { RTIndex1, RTIndex2 })
+        if (index != DescriptorAllocator::InvalidIndex)
+          m_rtAllocator.Free(index);
+      for (auto index : { SRIndex1, SRIndex2 })
+        if (index != DescriptorAllocator::InvalidIndex)
+          m_texRegion->Free(index);
+    };
+    output->renderTargetIndex1 = AllocateOrThrow(m_rtAllocator, "[RENDERTARGET] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    output->renderTargetIndex2 = AllocateOrThrow(m_rtAllocator, "[RENDERTARGET] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    output->shaderResourceIndex1 = AllocateOrThrow(*m_texRegion, "[TEXTURE] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+    output->shaderResourceIndex2 = AllocateOrThrow(*m_texRegion, "[TEXTURE] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
+
+    DX12Interface::Get().CreateRenderTargetView(swapRenderTarget, m_rtvHeap.Get(), output->index);
 
     // create resources and views
     // texture resource
@@ -315,20 +480,6 @@ namespace Graphics
     DX12Interface::Get().CreateShaderResourceView(output->renderTarget1.Get(), m_resourcesHeap.Get(), output->shaderResourceIndex1);
     DX12Interface::Get().CreateShaderResourceView(output->renderTarget2.Get(), m_resourcesHeap.Get(), output->shaderResourceIndex2);
 
-    // we will not store the resource because swapchain is the owner of the render target
-    output->freeResource = [&](unsigned index) {
-      std::lock_guard<std::mutex> lock(m_mutexRT);
-      m_nextFreeRT.push_back(index);
-    };
-
-    output->freeRT = [&](unsigned RTIndex1, unsigned SRIndex1, unsigned RTIndex2, unsigned SRIndex2) {
-      std::lock_guard<std::mutex> lockTex(m_mutexTex);
-      std::lock_guard<std::mutex> lockRT(m_mutexRT);
-      m_nextFreeRT.push_back(RTIndex1);
-      m_nextFreeRT.push_back(RTIndex2);
-      m_nextFreeTex.push_back(SRIndex1);
-      m_nextFreeTex.push_back(SRIndex2);
-    };
     // set the swap render target
     output->swapRenderTarget = swapRenderTarget;
 
@@ -337,26 +488,16 @@ namespace Graphics
 
   std::unique_ptr<Descriptor> ResourceManager::CreateSampler(D3D12_SAMPLER_DESC& desc)
   {
-    // check if space is available
-    if (m_nextFreeSampler.size() < 1)
-      throw std::out_of_range("[SAMPLER] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
-
     std::unique_ptr<Descriptor> output = std::make_unique<Descriptor>();
 
-    {
-      std::lock_guard<std::mutex> lock(m_mutexSampler);
-      output->index = m_nextFreeSampler.front();
-      m_nextFreeSampler.erase(m_nextFreeSampler.begin());
-    }
-
-    DX12Interface::Get().CreateSampler(&desc, m_samplerHeap.Get(), output->index);
-
     // no need to sore resource
+    output->index = AllocateOrThrow(m_samplerAllocator, "[SAMPLER] HEAP DESCRIPTOR HAVE NO SPACE LEFT!");
     output->freeResource = [&](unsigned index) {
-      std::lock_guard<std::mutex> lock(m_mutexSampler);
-      m_nextFreeSampler.push_back(index);
+      m_samplerAllocator.Free(index);
     };
 
+    DX12Interface::Get().CreateSampler(&desc, m_samplerHeap.Get(), output->index);
+
     return output;
   }
 }
@@ -1,15 +1,21 @@
 #pragma once
 
-#include <mutex>
+#include "Graphics/DescriptorAllocator.h"
+#include "Graphics/DescriptorRegion.h"
+#include "Graphics/ReleaseQueue.h"
+#include "Graphics/LinearAllocator.h"
+#include "Graphics/RingAllocator.h"
+
+#include <atomic>
 #include <functional>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
 // Regions
-// 0 - 999 : textures
-// 1000 - 4999 : mips [expecting 4 mips per texture]
-// 5000 - 7999 : constant buffers
+// the resources heap size and its regions (constant buffers, textures, mips)
+// are read from Resources/configs/DescriptorHeap.json, what is not reserved by
+// a region is split in pages that full regions take from
 
 namespace Graphics
 {
@@ -19,41 +25,31 @@ namespace Graphics
     unsigned end;
   };
 
+  // descriptors don't free their indices and resources right away when destroyed,
+  // frames that are still in flight may reference them, the release is deferred
+  // to the ResourceManager release queue until the GPU is done with the current frame
   struct Descriptor
   {
     unsigned index;
     std::function<void(unsigned)> freeResource;
 
-    virtual ~Descriptor()
-    {
-      if (freeResource)
-        freeResource(index);
-    }
+    virtual ~Descriptor();
   };
 
   struct ResourceDescriptor : public Descriptor
   {
     ComPtr<ID3D12Resource> resource;
     
-    virtual ~ResourceDescriptor()
-    {
-      resource.Reset();
-    }
+    virtual ~ResourceDescriptor();
   };
 
   struct TextureDescriptor : public ResourceDescriptor
   {
-    ComPtr<ID3D12Resource> upload;
-    unsigned mipIndex;
-    unsigned mipLevels;
-    std::function<void(unsigned, unsigned)> freeMips;
+    unsigned mipIndex = 0;
+    unsigned mipLevels = 0; // 0 when no mips UAVs were allocated
+    std::function<void(unsigned)> freeMips;
 
-    ~TextureDescriptor()
-    {
-      upload.Reset();
-      if (freeMips)
-        freeMips(mipIndex, mipLevels);
-    }
+    ~TextureDescriptor();
   };
 
   struct RenderTargetDescriptor : public Descriptor
@@ -98,32 +94,40 @@ namespace Graphics
       activeSRVIndex = shaderResourceIndex2;
     }
 
-    ~RenderTargetDescriptor()
-    {
-      renderTarget1.Reset();
-      renderTarget2.Reset();
+    ~RenderTargetDescriptor();
+  };
 
-      if (freeRT)
-        freeRT(
-          renderTargetIndex1, shaderResourceIndex1, renderTargetIndex2, shaderResourceIndex2);
-    }
+  // a slice of the per-frame constant buffer, only valid for the frame it was allocated in
+  struct ConstantAllocation
+  {
+    void* cpuAddress;
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+  };
+
+  // staging space for a copy to a default heap resource, only valid until the frame it was reserved in retires
+  struct StagingAllocation
+  {
+    ID3D12Resource* resource;
+    UINT64 offset;
+    void* cpuAddress;
   };
 
   class ResourceManager
   {
-    // fixed size of 64k, (max supported by DX12)
-    const unsigned RESOURCE_HEAP_SIZE = 65535;
     const unsigned DSV_HEAP_SIZE = 1;
     const unsigned RTV_HEAP_SIZE = 2 + (2 * 2); // double buffering (for offscreen rendering each framebuffer need 2 RenderTargets)
     const unsigned SAMPLER_HEAP_SIZE = 2048; // overkill reduce this later
-    // resources are ordered in regions, assuming that I will be loading 1500 meshes at once
-    const Range CB_RANGE = { 0, 7499 }; // for each mesh 5 CBVs
-    const Range TEX_RANGE = { 7500, 14999 }; // since PBR is planned, normally we need 5 textures per mesh
-    const Range MIPS_RANGE = { 15000, 44999 }; // for each texture we have 4 mips
+    // resources heap regions come from the config
+    const unsigned MIPS_BLOCK_SIZE = 4; // the mips root signature takes 4 UAVs at once
     // has its own heap
     const Range RT_RANGE = { 0, RTV_HEAP_SIZE - 1 }; // for each texture we have 4 mips
     const Range DS_RANGE = { 0, DSV_HEAP_SIZE - 1 };
     const Range SAMPLER_RANGE = { 0, SAMPLER_HEAP_SIZE - 1 };
+    // per frame constant data, 256 bytes per model/scene buffer
+    const size_t FRAME_CONSTANTS_SIZE = 4 * 1024 * 1024;
+    // shared staging ring, requests above the threshold get a temporary chunk instead
+    const size_t STAGING_SIZE = 64 * 1024 * 1024;
+    const size_t STAGING_CHUNK_THRESHOLD = STAGING_SIZE / 4;
 
   public:
     static ResourceManager& Instance()
@@ -150,8 +154,7 @@ namespace Graphics
     D3D12_CPU_DESCRIPTOR_HANDLE GetSamplerCpuHandle(unsigned index);
 
     std::unique_ptr<ResourceDescriptor> CreateConstantBufferResource(size_t size, D3D12_HEAP_TYPE type);
-    // right now I believe the upload buffer is not freed after the texture has been uploaded to the GPU
-    // TODO: remove free the upload resource
+    // texture data is uploaded through ReserveStaging
     std::shared_ptr<TextureDescriptor> CreateTextureResource(D3D12_RESOURCE_DESC& desc, bool isCubeMap, bool generateMips);
     std::unique_ptr<ResourceDescriptor> CreateDepthResource(D3D12_RESOURCE_DESC& desc, D3D12_CLEAR_VALUE& clearValue);
     // view and not resource because the swap chain is the one that owns RT resources
@@ -160,25 +163,63 @@ namespace Graphics
     // also sampler will have no resource
     std::unique_ptr<Descriptor> CreateSampler(D3D12_SAMPLER_DESC& desc);
 
+    // per-frame constants, allocated every frame from one persistently mapped upload buffer
+    // slices are 256-byte aligned and bound by GPU virtual address
+    ConstantAllocation AllocateConstants(size_t size);
+    // called once the fence of frameIndex retired, recycles that frame's constants
+    void ResetConstants(unsigned frameIndex) { m_constantsAllocator.Reset(frameIndex); }
+
+    // staging memory for uploads, write to cpuAddress then record a copy from resource at offset
+    // the space is reclaimed once the frame's fence passed, alignment has to be a power of two
+    StagingAllocation ReserveStaging(size_t size, size_t alignment);
+    // stages data and records the copy to the start of destination, which has to be in COPY_DEST
+    void UploadBuffer(ID3D12GraphicsCommandList* commandList, ID3D12Resource* destination, const void* data, size_t size);
+
+    // deferred releases, they run once the fence passed the frame they were retired in
+    void DeferRelease(std::function<void()> release) { m_releaseQueue.Enqueue(std::move(release)); }
+    // the context sets the fence value of the frame being recorded
+    void SetReleaseFenceValue(uint64_t fenceValue);
+    // also gives back the staging space of retired frames
+    void ProcessReleases(uint64_t completedFenceValue);
+    // GPU has to be idle
+    void FlushReleases();
+
+    // occupancy of the resources heap regions
+    std::vector<DescriptorRegion::Stats> GetDescriptorStats();
+
+  private:
+    void CreateRegions();
+    DescriptorRegion* GetRegion(const std::string& name);
+
   private:
     ComPtr<ID3D12DescriptorHeap> m_resourcesHeap;
     ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
     ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
     ComPtr<ID3D12DescriptorHeap> m_samplerHeap;
-    // track free heap places
-    std::vector<unsigned> m_nextFreeTex;
-    std::vector<unsigned> m_nextFreeMip;
-    std::vector<unsigned> m_nextFreeCB;
-    std::vector<unsigned> m_nextFreeRT;
-    std::vector<unsigned> m_nextFreeDS;
-    std::vector<unsigned> m_nextFreeSampler;
-    // mutex
-    std::mutex m_mutexTex;
-    std::mutex m_mutexMip;
-    std::mutex m_mutexCB;
-    std::mutex m_mutexRT;
-    std::mutex m_mutexDS;
-    std::mutex m_mutexSampler;
+    unsigned m_resourcesHeapSize;
+    // resources heap regions, and the pages they grow into
+    std::unique_ptr<DescriptorAllocator> m_pagePool;
+    std::vector<std::unique_ptr<DescriptorRegion>> m_regions;
+    DescriptorRegion* m_texRegion;
+    DescriptorRegion* m_mipRegion;
+    DescriptorRegion* m_cbRegion;
+    // track free heap places, lock-free so loader threads can allocate concurrently
+    DescriptorAllocator m_rtAllocator;
+    DescriptorAllocator m_dsAllocator;
+    DescriptorAllocator m_samplerAllocator;
+    // releases waiting for the GPU
+    ReleaseQueue m_releaseQueue;
+    // per-frame constants
+    ComPtr<ID3D12Resource> m_constantsBuffer;
+    UINT8* m_pConstantsBegin;
+    LinearAllocator m_constantsAllocator;
+    // staging ring
+    ComPtr<ID3D12Resource> m_stagingBuffer;
+    UINT8* m_pStagingBegin;
+    RingAllocator m_stagingAllocator;
+    // staging stats, reset every frame
+    std::atomic<size_t> m_stagedBytes;
+    std::atomic<size_t> m_stagingChunkBytes;
 
   private:
     ResourceManager();
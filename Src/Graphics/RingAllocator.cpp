@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "RingAllocator.h"
+
+namespace Graphics
+{
+  RingAllocator::RingAllocator(size_t capacity, size_t maxAllocationSize)
+    : m_capacity(capacity)
+    , m_maxAllocationSize(maxAllocationSize < capacity ? maxAllocationSize : capacity)
+    , m_head(0)
+    , m_tail(0)
+    , m_used(0)
+    , m_peak(0)
+    , m_currentFenceValue(0)
+    , m_frames()
+    , m_mutex()
+  {
+  }
+
+  RingAllocator::~RingAllocator()
+  {
+  }
+
+  void RingAllocator::SetCurrentFenceValue(uint64_t fenceValue)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_currentFenceValue = fenceValue;
+  }
+
+  size_t RingAllocator::Allocate(size_t size, size_t alignment)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (size == 0 || size > m_maxAllocationSize)
+      return InvalidOffset;
+
+    // empty, start over from the beginning to get the largest contiguous space
+    if (m_used == 0)
+      m_head = m_tail = 0;
+
+    size_t offset = (m_tail + alignment - 1) & ~(alignment - 1);
+    size_t consumed = 0;
+
+    if (m_used > 0 && m_tail == m_head)
+    {
+      // full
+      return InvalidOffset;
+    }
+    else if (m_tail >= m_head)
+    {
+      // free space is [tail, capacity) and [0, head)
+      if (offset + size <= m_capacity)
+      {
+        consumed = offset + size - m_tail;
+      }
+      else
+      {
+        // wrap, the skipped end of the buffer is wasted until this frame retires
+        if (size > m_head)
+          return InvalidOffset;
+        offset = 0;
+        consumed = m_capacity - m_tail + size;
+      }
+    }
+    else
+    {
+      // free space is [tail, head)
+      if (offset + size > m_head)
+        return InvalidOffset;
+      consumed = offset + size - m_tail;
+    }
+
+    m_tail = (offset + size) % m_capacity;
+    m_used += consumed;
+    if (m_used > m_peak)
+      m_peak = m_used;
+
+    // one entry per frame
+    if (m_frames.empty() || m_frames.back().fenceValue != m_currentFenceValue)
+      m_frames.push_back({ m_currentFenceValue, m_tail, 0 });
+    m_frames.back().end = m_tail;
+    m_frames.back().size += consumed;
+
+    return offset;
+  }
+
+  size_t RingAllocator::Retire(uint64_t completedFenceValue)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t retired = 0;
+    while (!m_frames.empty() && m_frames.front().fenceValue <= completedFenceValue)
+    {
+      m_head = m_frames.front().end;
+      m_used -= m_frames.front().size;
+      retired += m_frames.front().size;
+      m_frames.pop_front();
+    }
+
+    return retired;
+  }
+
+  void RingAllocator::Reset()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frames.clear();
+    m_head = m_tail = 0;
+    m_used = 0;
+  }
+
+  size_t RingAllocator::GetUsed()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_used;
+  }
+
+  size_t RingAllocator::ConsumePeak()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t peak = m_peak;
+    m_peak = m_used;
+    return peak;
+  }
+}
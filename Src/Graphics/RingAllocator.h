@@ -0,0 +1,67 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+
+namespace Graphics
+{
+  // Ring allocator over a fixed size buffer, allocations are tagged with the fence value of the
+  // frame they were made in and are given back once that fence completed, oldest frame first.
+  // An allocation that doesn't fit at the end of the buffer wraps to the start, the skipped tail
+  // counts as used until the frame retires.
+  // It only deals with offsets and fence values, like the ReleaseQueue the context feeds it fences.
+  class RingAllocator
+  {
+  public:
+    static constexpr size_t InvalidOffset = ~static_cast<size_t>(0);
+
+    // allocations above maxAllocationSize are refused, so one upload can't take the whole ring
+    explicit RingAllocator(size_t capacity, size_t maxAllocationSize = ~static_cast<size_t>(0));
+    ~RingAllocator();
+
+    // fence value that will be signaled when the frame being recorded is done
+    void SetCurrentFenceValue(uint64_t fenceValue);
+    // returns an offset from the start of the buffer, InvalidOffset if there is not enough space
+    // or the size is above the maximum, the caller falls back on something else
+    // alignment has to be a power of two
+    size_t Allocate(size_t size, size_t alignment);
+    // gives back every frame whose fence value is <= completedFenceValue
+    // returns the bytes that were retired
+    size_t Retire(uint64_t completedFenceValue);
+    // gives back everything, only call this when the GPU is idle
+    void Reset();
+
+    size_t GetCapacity() const { return m_capacity; }
+    size_t GetMaxAllocationSize() const { return m_maxAllocationSize; }
+    size_t GetUsed();
+    // highest usage since the last call, usage is sampled after each allocation
+    size_t ConsumePeak();
+
+  private:
+    struct Frame
+    {
+      uint64_t fenceValue;
+      // where the ring tail was after the last allocation of this frame
+      size_t end;
+      // bytes taken by this frame, alignment and wrapping included
+      size_t size;
+    };
+
+    size_t m_capacity;
+    size_t m_maxAllocationSize;
+    // oldest byte still in use
+    size_t m_head;
+    // next free byte
+    size_t m_tail;
+    size_t m_used;
+    size_t m_peak;
+    uint64_t m_currentFenceValue;
+    // ordered by fence value, since fence values only grow
+    std::deque<Frame> m_frames;
+    std::mutex m_mutex;
+
+  private:
+    RingAllocator(const RingAllocator&) = delete;
+    RingAllocator& operator=(const RingAllocator&) = delete;
+  };
+}
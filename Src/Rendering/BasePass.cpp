@@ -1,12 +1,35 @@
 #include "stdafx.h"
 #include "BasePass.h"
 
+#include "Core/JobSystem.h"
+
 #include "Scene/SceneGraph.h"
 
+#include "Utilities/DXApplicationHelper.h"
+
+#include <chrono>
+
+// helpers
+namespace
+{
+  unsigned RecordingThreads(unsigned maximum)
+  {
+    // the workers and the calling thread
+    const unsigned threads = Core::JobSystem::Instance().GetWorkerCount() + 1;
+    return threads < maximum ? threads : maximum;
+  }
+}
+
 namespace Rendering
 {
   BasePass::BasePass()
     : RenderPass()
+    , m_visibleModels(0)
+    , m_visibleMeshes(0)
+    , m_recordingLists(0)
+    , m_scheduler(RecordingThreads(MAX_RECORDING_THREADS), INITIAL_RECORDING_COST)
+    , m_weights()
+    , m_chunkMicroseconds()
   {
   }
 
@@ -16,8 +39,72 @@ namespace Rendering
 
   void BasePass::Render(Graphics::DX12Context* ctx)
   {
-    // draw meshes
-    for (auto model : Scene::SceneGraph::Instance().GetModels())
-      ctx->Draw(model, m_pso, m_rootSignature);
+    auto& scene = Scene::SceneGraph::Instance();
+
+    // the scene BVH leaves only the meshes inside the frustum and not behind occluders
+    scene.CullScene(scene.GetCamera()->GetFrustum());
+
+    const auto& models = scene.GetVisibleModels();
+    for (auto model : models)
+      model->SubmitModel(m_queue, m_order, m_pso, m_rootSignature);
+    PrepareQueue(ctx);
+    RecordParallel(ctx);
+    m_queue.Clear();
+
+    const size_t visibleModels = models.size();
+    const size_t visibleMeshes = scene.GetVisibleMeshCount();
+    if (Utilities::FRAME_STATS_ENABLED && (visibleModels != m_visibleModels || visibleMeshes != m_visibleMeshes))
+    {
+      char message[256];
+      snprintf(message, sizeof(message), "[CULLING] models %zu visible, %zu culled, meshes %zu visible, %zu culled, %zu of them occluded\n",
+        visibleModels, scene.GetModels().size() - visibleModels, visibleMeshes, scene.GetMeshCount() - visibleMeshes, scene.GetOccludedMeshCount());
+      OutputDebugStringA(message);
+      m_visibleModels = visibleModels;
+      m_visibleMeshes = visibleMeshes;
+    }
+  }
+
+  void BasePass::RecordParallel(Graphics::DX12Context* ctx)
+  {
+    // a draw costs its draw calls and the bindings before them
+    m_weights.resize(m_queue.Size());
+    for (size_t i = 0; i < m_queue.Size(); ++i)
+      m_weights[i] = m_queue.GetPacket(i).mesh->GetDrawCount() + 1;
+
+    const auto& chunks = m_scheduler.Partition(m_weights);
+    if (chunks.empty())
+      return;
+    m_chunkMicroseconds.assign(chunks.size(), 0.0);
+
+    auto record = [this, &chunks](size_t chunk, Graphics::CommandRecorder* recorder, ID3D12GraphicsCommandList* commandList)
+    {
+      const auto start = std::chrono::high_resolution_clock::now();
+      RecordPackets(*recorder, commandList, chunks[chunk].begin, chunks[chunk].end);
+      m_chunkMicroseconds[chunk] = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+    };
+
+    if (chunks.size() == 1)
+    {
+      // not worth another list
+      record(0, &ctx->GetRecorder(), ctx->GetCommandList());
+    } else
+    {
+      // lists are submitted in chunk order, a job records each
+      const auto& lists = ctx->BeginParallel(static_cast<unsigned>(chunks.size()));
+      Core::JobSystem::Instance().ParallelFor(lists.size(), 1, [&record, &lists](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+          record(i, &lists[i]->recorder, lists[i]->commandList.Get());
+      });
+    }
+    m_scheduler.Report(m_chunkMicroseconds);
+
+    if (Utilities::FRAME_STATS_ENABLED && chunks.size() != m_recordingLists)
+    {
+      char message[256];
+      snprintf(message, sizeof(message), "[RECORDING] base pass: %zu draws on %zu command lists, %.3f us per weighted draw\n",
+        m_queue.Size(), chunks.size(), m_scheduler.GetMicrosecondsPerWeight());
+      OutputDebugStringA(message);
+      m_recordingLists = chunks.size();
+    }
   }
 }
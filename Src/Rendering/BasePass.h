@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Rendering/RenderPass.h"
+#include "Rendering/RecordingScheduler.h"
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
@@ -9,12 +10,31 @@ namespace Rendering
 {
   class BasePass : public RenderPass
   {
+    // threads recording the draws, the calling one included
+    const unsigned MAX_RECORDING_THREADS = 8;
+    // first guess of the recording cost in microseconds per draw weight, the measured one replaces it
+    const double INITIAL_RECORDING_COST = 1.0;
+
   public:
     BasePass();
     ~BasePass();
 
     virtual void Render(Graphics::DX12Context* ctx) override;
 
+  private:
+    // records the prepared queue in chunks, one command list and job per chunk
+    void RecordParallel(Graphics::DX12Context* ctx);
+
+  private:
+    // last reported counts, logged when they change
+    size_t m_visibleModels;
+    size_t m_visibleMeshes;
+    size_t m_recordingLists;
+    // chunk sizes from the recording cost of the last frames
+    RecordingScheduler m_scheduler;
+    std::vector<uint32_t> m_weights;
+    std::vector<double> m_chunkMicroseconds;
+
   private:
     BasePass(const BasePass&) = delete;
     BasePass& operator=(const BasePass&) = delete;
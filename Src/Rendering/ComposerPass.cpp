@@ -15,10 +15,8 @@ namespace Rendering
     , m_vertices()
     , m_indices()
     , m_vertexBuffer()
-    , m_vertexBufferUploadHeap()
     , m_vertexBufferView()
     , m_indexBuffer()
-    , m_indexBufferUploadHeap()
     , m_indexBufferView()
     , m_quadReady(false)
   {
@@ -40,8 +38,6 @@ namespace Rendering
   {
     m_vertexBuffer.Reset();
     m_indexBuffer.Reset();
-    m_vertexBufferUploadHeap.Reset();
-    m_indexBufferUploadHeap.Reset();
   }
 
   void ComposerPass::Render(Graphics::DX12Context* ctx)
@@ -66,25 +62,25 @@ namespace Rendering
     const float clearColor[] = { 0.25f, 0.55f, 0.45f, 1.0f };
     commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
 
-    commandList->SetPipelineState(m_pso);
-    commandList->SetGraphicsRootSignature(m_rootSignature);
+    auto& recorder = ctx->GetRecorder();
+    recorder.SetPipelineState(m_pso);
+    recorder.SetGraphicsRootSignature(m_rootSignature);
 
     ID3D12DescriptorHeap* ppHeaps[] = { Graphics::ResourceManager::Instance().GetResourcesHeap() };
-    commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+    recorder.SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
 
     // texture SRV
-    commandList->SetGraphicsRootDescriptorTable(0, Graphics::ResourceManager::Instance().GetResourceGpuHandle(renderTarget->activeSRVIndex));
+    recorder.SetGraphicsRootDescriptorTable(0, Graphics::ResourceManager::Instance().GetResourceGpuHandle(renderTarget->activeSRVIndex));
 
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-    commandList->IASetIndexBuffer(&m_indexBufferView);
+    recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    recorder.IASetVertexBuffers(0, 1, &m_vertexBufferView);
+    recorder.IASetIndexBuffer(&m_indexBufferView);
     commandList->DrawIndexedInstanced(6 /* indices */, 1, 0, 0, 0);
   }
 
   void ComposerPass::SetupVertexBuffer(ID3D12GraphicsCommandList* commandList)
   {
     const unsigned vertexBufferSize = static_cast<unsigned>(sizeof(m_vertices));
-    auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize);
     Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
@@ -95,24 +91,11 @@ namespace Rendering
       nullptr,
       IID_PPV_ARGS(&m_vertexBuffer)));
 
-    Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
-      &uploadHeapProps,
-      D3D12_HEAP_FLAG_NONE,
-      &resDesc,
-      D3D12_RESOURCE_STATE_GENERIC_READ,
-      nullptr,
-      IID_PPV_ARGS(&m_vertexBufferUploadHeap)));
-
-    // copy data to intermediate upload heap
-    D3D12_SUBRESOURCE_DATA vertexData = {};
-    vertexData.pData = m_vertices;
-    vertexData.RowPitch = vertexBufferSize;
-    vertexData.SlicePitch = vertexData.RowPitch;
-
     auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
     auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
     commandList->ResourceBarrier(1, &barrier1);
-    UpdateSubresources(commandList, m_vertexBuffer.Get(), m_vertexBufferUploadHeap.Get(), 0, 0, 1, &vertexData);
+    // stage the data and copy it to the vertex buffer
+    Graphics::ResourceManager::Instance().UploadBuffer(commandList, m_vertexBuffer.Get(), m_vertices, vertexBufferSize);
     commandList->ResourceBarrier(1, &barrier2);
 
     // Initialize the vertex buffer view.
@@ -124,7 +107,6 @@ namespace Rendering
   void ComposerPass::SetupIndexBuffer(ID3D12GraphicsCommandList* commandList)
   {
     const unsigned indexBufferSize = static_cast<unsigned>(sizeof(m_indices));
-    auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize);
     Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
@@ -135,25 +117,11 @@ namespace Rendering
       nullptr,
       IID_PPV_ARGS(&m_indexBuffer)));
 
-    Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
-      &uploadHeapProps,
-      D3D12_HEAP_FLAG_NONE,
-      &resDesc,
-      D3D12_RESOURCE_STATE_GENERIC_READ,
-      nullptr,
-      IID_PPV_ARGS(&m_indexBufferUploadHeap)));
-
-    // Copy data to the intermediate upload heap and then schedule a copy 
-    // from the upload heap to the index buffer.
-    D3D12_SUBRESOURCE_DATA indexData = {};
-    indexData.pData = m_indices;
-    indexData.RowPitch = indexBufferSize;
-    indexData.SlicePitch = indexData.RowPitch;
-
     auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(m_indexBuffer.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
     auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(m_indexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER);
     commandList->ResourceBarrier(1, &barrier1);
-    UpdateSubresources(commandList, m_indexBuffer.Get(), m_indexBufferUploadHeap.Get(), 0, 0, 1, &indexData);
+    // stage the data and copy it to the index buffer
+    Graphics::ResourceManager::Instance().UploadBuffer(commandList, m_indexBuffer.Get(), m_indices, indexBufferSize);
     commandList->ResourceBarrier(1, &barrier2);
 
     // Initialize the index buffer view.
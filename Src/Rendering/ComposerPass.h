@@ -32,11 +32,9 @@ namespace Rendering
     uint16_t m_indices[6]; // 2 triangles needed for a quad
     // vertex buffer
     ComPtr<ID3D12Resource> m_vertexBuffer;
-    ComPtr<ID3D12Resource> m_vertexBufferUploadHeap;
     D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
     // index buffer
     ComPtr<ID3D12Resource> m_indexBuffer;
-    ComPtr<ID3D12Resource> m_indexBufferUploadHeap;
     D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
     // did we setup?
     bool m_quadReady;
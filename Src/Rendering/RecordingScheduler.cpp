@@ -0,0 +1,71 @@
+#include "stdafx.h"
+#include "RecordingScheduler.h"
+
+#include <stdexcept>
+
+namespace Rendering
+{
+  RecordingScheduler::RecordingScheduler(unsigned maxChunks, double microsecondsPerWeight)
+    : m_maxChunks(maxChunks)
+    , m_microsecondsPerWeight(microsecondsPerWeight)
+    , m_weight(0)
+    , m_chunks()
+  {
+    if (maxChunks == 0)
+      throw std::invalid_argument("[RECORDING] A SCHEDULER NEEDS AT LEAST ONE CHUNK !");
+  }
+
+  RecordingScheduler::~RecordingScheduler()
+  {
+  }
+
+  const std::vector<RecordingChunk>& RecordingScheduler::Partition(const std::vector<uint32_t>& weights)
+  {
+    m_chunks.clear();
+    m_weight = 0;
+    for (const uint32_t weight : weights)
+      m_weight += weight;
+    if (weights.empty())
+      return m_chunks;
+
+    // as many chunks as the estimated cost pays for
+    const double estimate = static_cast<double>(m_weight) * m_microsecondsPerWeight;
+    size_t chunkCount = static_cast<size_t>(estimate / MIN_CHUNK_MICROSECONDS);
+    chunkCount = chunkCount < m_maxChunks ? chunkCount : m_maxChunks;
+    chunkCount = chunkCount < weights.size() ? chunkCount : weights.size();
+    chunkCount = chunkCount > 0 ? chunkCount : 1;
+
+    // a chunk ends on the draw closest to its share of the weight, keeping one draw for each chunk after it
+    size_t begin = 0;
+    uint64_t prefix = 0;
+    for (size_t chunk = 0; chunk + 1 < chunkCount; ++chunk)
+    {
+      const double target = static_cast<double>(m_weight) * (chunk + 1) / chunkCount;
+      const size_t last = weights.size() - (chunkCount - chunk - 1);
+      size_t end = begin;
+      do
+      {
+        prefix += weights[end++];
+      } while (end < last && prefix + weights[end] * 0.5 <= target);
+
+      m_chunks.push_back({ begin, end });
+      begin = end;
+    }
+    m_chunks.push_back({ begin, weights.size() });
+
+    return m_chunks;
+  }
+
+  void RecordingScheduler::Report(const std::vector<double>& chunkMicroseconds)
+  {
+    if (m_weight == 0 || chunkMicroseconds.size() != m_chunks.size())
+      return;
+
+    double total = 0.0;
+    for (const double microseconds : chunkMicroseconds)
+      total += microseconds;
+
+    const double measured = total / static_cast<double>(m_weight);
+    m_microsecondsPerWeight += (measured - m_microsecondsPerWeight) * COST_SMOOTHING;
+  }
+}
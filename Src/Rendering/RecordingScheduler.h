@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Rendering
+{
+  // a range of the sorted draws, recorded on its own command list
+  struct RecordingChunk
+  {
+    size_t begin;
+    size_t end;
+  };
+
+  // Splits the sorted draws of a pass in contiguous chunks of about the same recording cost.
+  // The cost of a draw is measured frame to frame, a chunk is only made when its work pays for
+  // the command list it needs, and there are never more chunks than workers.
+  class RecordingScheduler
+  {
+    // a list recording less than this costs more to reset and submit than it saves
+    const double MIN_CHUNK_MICROSECONDS = 50.0;
+    // weight of the last frame in the measured cost
+    const double COST_SMOOTHING = 0.2;
+
+  public:
+    RecordingScheduler(unsigned maxChunks, double microsecondsPerWeight);
+    ~RecordingScheduler();
+
+    // weights are the relative cost of each draw, the chunks cover them all in order
+    const std::vector<RecordingChunk>& Partition(const std::vector<uint32_t>& weights);
+    // recording time of each chunk of the last partition
+    void Report(const std::vector<double>& chunkMicroseconds);
+
+    const std::vector<RecordingChunk>& GetChunks() const { return m_chunks; }
+    unsigned GetMaxChunks() const { return m_maxChunks; }
+    double GetMicrosecondsPerWeight() const { return m_microsecondsPerWeight; }
+
+  private:
+    unsigned m_maxChunks;
+    double m_microsecondsPerWeight;
+    // total weight of the last partition
+    uint64_t m_weight;
+    std::vector<RecordingChunk> m_chunks;
+
+  private:
+    RecordingScheduler(const RecordingScheduler&) = delete;
+    RecordingScheduler& operator=(const RecordingScheduler&) = delete;
+  };
+}
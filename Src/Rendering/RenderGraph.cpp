@@ -19,6 +19,7 @@ namespace Rendering
   RenderGraph::RenderGraph()
     : m_passesMap()
     , m_passesVec()
+    , m_psoNames()
     , m_creators()
   {
     // register creators
@@ -38,6 +39,7 @@ namespace Rendering
 
     m_passesMap.clear();
     m_passesVec.clear();
+    m_psoNames.clear();
     m_creators.clear();
   }
 
@@ -46,6 +48,15 @@ namespace Rendering
     return m_passesVec;
   }
 
+  void RenderGraph::UpdatePipelineStates()
+  {
+    for (const auto& pass : m_psoNames)
+    {
+      m_passesMap[pass.first]->SetPSO(Graphics::PSOManager::Instance().GetPSO(pass.second));
+      m_passesMap[pass.first]->SetRootSignature(Graphics::PSOManager::Instance().GetRootSignature(pass.second));
+    }
+  }
+
   void RenderGraph::ReadRenderGraph()
   {
     // TODO: handle errors
@@ -65,9 +76,11 @@ namespace Rendering
 
       // just plain pass for now
       m_passesMap[name] = m_creators[name](); // create
+      m_psoNames[name] = pso;
       // set pso and root signature
       m_passesMap[name]->SetPSO(Graphics::PSOManager::Instance().GetPSO(pso));
       m_passesMap[name]->SetRootSignature(Graphics::PSOManager::Instance().GetRootSignature(pso));
+      m_passesMap[name]->SetOrder(static_cast<uint32_t>(m_passesVec.size()));
       // store in vec to maintain order of config file
       m_passesVec.emplace_back(m_passesMap[name]);
     }
@@ -22,6 +22,8 @@ namespace Rendering
 
     // get passes in order from config
     const std::vector<RenderPass*>& GetPasses();
+    // passes take the pipeline states and root signatures again, after the psos were rebuilt
+    void UpdatePipelineStates();
 
   private:
     void ReadRenderGraph();
@@ -34,6 +36,8 @@ namespace Rendering
     std::unordered_map<std::string, RenderPass*> m_passesMap;
     // to maintain passes order
     std::vector<RenderPass*> m_passesVec;
+    // pso of each pass
+    std::unordered_map<std::string, std::string> m_psoNames;
 
   private:
     RenderGraph();
@@ -1,11 +1,18 @@
 #include "stdafx.h"
 #include "RenderPass.h"
 
+#include "Scene/SceneGraph.h"
+#include "Utilities/DXApplicationHelper.h"
+
 namespace Rendering
 {
   RenderPass::RenderPass()
     : m_pso()
     , m_rootSignature()
+    , m_order(0)
+    , m_queue()
+    , m_issuedCalls(0)
+    , m_elidedCalls(0)
   {
   }
 
@@ -15,13 +22,74 @@ namespace Rendering
 
   void RenderPass::SetPSO(ID3D12PipelineState* pso)
   {
-    // set the pso
+    // set the pso, the ids of the replaced ones go with them
     m_pso = pso;
+    m_queue.ResetIds();
   }
 
   void RenderPass::SetRootSignature(ID3D12RootSignature* rootSig)
   {
     // set the root signature
     m_rootSignature = rootSig;
+    m_queue.ResetIds();
+  }
+
+  void RenderPass::RecordQueue(Graphics::DX12Context* ctx)
+  {
+    PrepareQueue(ctx);
+    RecordPackets(ctx->GetRecorder(), ctx->GetCommandList(), 0, m_queue.Size());
+    m_queue.Clear();
+  }
+
+  void RenderPass::PrepareQueue(Graphics::DX12Context* ctx)
+  {
+    m_queue.Sort();
+
+    // first uses upload and generate mips on the list directly, the recorder can't know what they bound
+    for (size_t i = 0; i < m_queue.Size(); ++i)
+      m_queue.GetPacket(i).mesh->Prepare(ctx->GetCommandList());
+    ctx->GetRecorder().Invalidate();
+  }
+
+  void RenderPass::RecordPackets(Graphics::CommandRecorder& recorder, ID3D12GraphicsCommandList* commandList, size_t begin, size_t end) const
+  {
+    // the recorder drops what the previous draw already bound
+    ID3D12DescriptorHeap* ppHeaps[] = { Graphics::ResourceManager::Instance().GetResourcesHeap() };
+    for (size_t i = begin; i < end; ++i)
+    {
+      const DrawPacket& packet = m_queue.GetPacket(i);
+
+      recorder.SetPipelineState(packet.pso);
+      recorder.SetGraphicsRootSignature(packet.rootSignature);
+      recorder.SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+      // scene CBV
+      recorder.SetGraphicsRootConstantBufferView(0, Scene::SceneGraph::Instance().GetSceneBufferAddress());
+      // object CBV
+      recorder.SetGraphicsRootConstantBufferView(1, packet.modelConstants);
+      // texture SRV
+      recorder.SetGraphicsRootDescriptorTable(2, Graphics::ResourceManager::Instance().GetResourceGpuHandle(packet.mesh->GetTextureIndex()));
+
+      packet.mesh->Bind(recorder);
+      packet.mesh->Draw(commandList);
+    }
+  }
+
+  void RenderPass::UpdateCounters(const Graphics::CommandRecorder::Counters& counters)
+  {
+    const uint32_t issued = counters.TotalIssued();
+    const uint32_t elided = counters.TotalElided();
+    if (!Utilities::FRAME_STATS_ENABLED || (issued == m_issuedCalls && elided == m_elidedCalls))
+      return;
+
+    char message[256];
+    snprintf(message, sizeof(message), "[RECORDER] pass %u: %u state calls issued, %u elided (pso %u/%u, root signature %u/%u, heaps %u/%u, topology %u/%u)\n",
+      m_order, issued, elided,
+      counters.issued[Graphics::CommandRecorder::PipelineState], counters.elided[Graphics::CommandRecorder::PipelineState],
+      counters.issued[Graphics::CommandRecorder::RootSignature], counters.elided[Graphics::CommandRecorder::RootSignature],
+      counters.issued[Graphics::CommandRecorder::DescriptorHeaps], counters.elided[Graphics::CommandRecorder::DescriptorHeaps],
+      counters.issued[Graphics::CommandRecorder::PrimitiveTopology], counters.elided[Graphics::CommandRecorder::PrimitiveTopology]);
+    OutputDebugStringA(message);
+    m_issuedCalls = issued;
+    m_elidedCalls = elided;
   }
 }
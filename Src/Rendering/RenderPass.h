@@ -3,6 +3,8 @@
 #include "Graphics/PSOManager.h"
 #include "Graphics/DX12Context.h"
 
+#include "Rendering/RenderQueue.h"
+
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
@@ -16,12 +18,31 @@ namespace Rendering
 
     virtual void Render(Graphics::DX12Context* ctx) = 0;
 
+    // also when the psos are rebuilt, between frames
     void SetPSO(ID3D12PipelineState* pso);
     void SetRootSignature(ID3D12RootSignature* rootSig);
+    // position in the render graph, the most significant field of the draw keys
+    void SetOrder(uint32_t order) { m_order = order; }
+    // recorder counters of the last Render, logged when they change in FRAME_STATS builds
+    void UpdateCounters(const Graphics::CommandRecorder::Counters& counters);
+
+  protected:
+    // sorts the queued packets and records them, state goes through the context recorder
+    void RecordQueue(Graphics::DX12Context* ctx);
+    // sorts the queued packets and records what their meshes need before any draw, on the context list
+    void PrepareQueue(Graphics::DX12Context* ctx);
+    // records the sorted packets in [begin, end), safe to call from several threads on different lists
+    void RecordPackets(Graphics::CommandRecorder& recorder, ID3D12GraphicsCommandList* commandList, size_t begin, size_t end) const;
 
   protected:
     ID3D12PipelineState* m_pso;
     ID3D12RootSignature* m_rootSignature;
+    uint32_t m_order;
+    // draws of the pass, filled by Render
+    RenderQueue m_queue;
+    // state calls of the last Render
+    uint32_t m_issuedCalls;
+    uint32_t m_elidedCalls;
 
   };
 }
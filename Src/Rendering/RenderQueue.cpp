@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "RenderQueue.h"
+
+#include <cstring>
+#include <utility>
+
+namespace Rendering
+{
+  namespace DrawKey
+  {
+    uint64_t Make(uint32_t pass, uint32_t pso, uint32_t rootSignature, uint32_t texture, uint32_t depth)
+    {
+      auto field = [](uint32_t value, unsigned bits) { return static_cast<uint64_t>(value) & ((1ull << bits) - 1); };
+
+      uint64_t key = field(pass, PassBits);
+      key = (key << PsoBits) | field(pso, PsoBits);
+      key = (key << RootSignatureBits) | field(rootSignature, RootSignatureBits);
+      key = (key << TextureBits) | field(texture, TextureBits);
+      key = (key << DepthBits) | field(depth, DepthBits);
+      return key;
+    }
+
+    uint32_t QuantizeDepth(float depth, float maxDepth)
+    {
+      const uint32_t maximum = (1u << DepthBits) - 1;
+      // also catches NaNs
+      if (!(depth > 0.0f) || !(maxDepth > 0.0f))
+        return 0;
+      if (depth >= maxDepth)
+        return maximum;
+      return static_cast<uint32_t>(depth / maxDepth * maximum);
+    }
+  }
+
+  namespace RadixSort
+  {
+    void Sort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* keyScratch, uint32_t* valueScratch)
+    {
+      if (count < 2)
+        return;
+
+      // histograms of every digit in one read
+      size_t histograms[8][256];
+      std::memset(histograms, 0, sizeof(histograms));
+      for (size_t i = 0; i < count; ++i)
+      {
+        const uint64_t key = keys[i];
+        for (unsigned digit = 0; digit < 8; ++digit)
+          ++histograms[digit][(key >> (digit * 8)) & 0xff];
+      }
+
+      uint64_t* sourceKeys = keys;
+      uint32_t* sourceValues = values;
+      uint64_t* targetKeys = keyScratch;
+      uint32_t* targetValues = valueScratch;
+      for (unsigned digit = 0; digit < 8; ++digit)
+      {
+        const unsigned shift = digit * 8;
+        size_t* histogram = histograms[digit];
+        // the same for every key, the order stays
+        if (histogram[(sourceKeys[0] >> shift) & 0xff] == count)
+          continue;
+
+        size_t offset = 0;
+        for (unsigned bucket = 0; bucket < 256; ++bucket)
+        {
+          const size_t bucketCount = histogram[bucket];
+          histogram[bucket] = offset;
+          offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+          const size_t target = histogram[(sourceKeys[i] >> shift) & 0xff]++;
+          targetKeys[target] = sourceKeys[i];
+          targetValues[target] = sourceValues[i];
+        }
+
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourceValues, targetValues);
+      }
+
+      if (sourceKeys != keys)
+      {
+        std::memcpy(keys, sourceKeys, count * sizeof(uint64_t));
+        std::memcpy(values, sourceValues, count * sizeof(uint32_t));
+      }
+    }
+  }
+
+  RenderQueue::RenderQueue()
+    : m_keys()
+    , m_order()
+    , m_packets()
+    , m_keyScratch()
+    , m_orderScratch()
+    , m_psoIds()
+    , m_rootSignatureIds()
+  {
+  }
+
+  RenderQueue::~RenderQueue()
+  {
+  }
+
+  uint32_t RenderQueue::GetPsoId(const ID3D12PipelineState* pso)
+  {
+    return m_psoIds.emplace(pso, static_cast<uint32_t>(m_psoIds.size())).first->second;
+  }
+
+  uint32_t RenderQueue::GetRootSignatureId(const ID3D12RootSignature* rootSignature)
+  {
+    return m_rootSignatureIds.emplace(rootSignature, static_cast<uint32_t>(m_rootSignatureIds.size())).first->second;
+  }
+
+  void RenderQueue::ResetIds()
+  {
+    m_psoIds.clear();
+    m_rootSignatureIds.clear();
+  }
+
+  void RenderQueue::Push(uint64_t key, const DrawPacket& packet)
+  {
+    m_order.push_back(static_cast<uint32_t>(m_packets.size()));
+    m_keys.push_back(key);
+    m_packets.push_back(packet);
+  }
+
+  void RenderQueue::Sort()
+  {
+    m_keyScratch.resize(m_keys.size());
+    m_orderScratch.resize(m_order.size());
+    RadixSort::Sort(m_keys.data(), m_order.data(), m_keys.size(), m_keyScratch.data(), m_orderScratch.data());
+  }
+
+  void RenderQueue::Clear()
+  {
+    m_keys.clear();
+    m_order.clear();
+    m_packets.clear();
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Scene
+{
+  class DX12Mesh;
+}
+
+namespace Rendering
+{
+  // everything needed to record one mesh draw
+  struct DrawPacket
+  {
+    Scene::DX12Mesh* mesh;
+    ID3D12PipelineState* pso;
+    ID3D12RootSignature* rootSignature;
+    D3D12_GPU_VIRTUAL_ADDRESS modelConstants;
+  };
+
+  // 64-bit sort keys, most significant field first: pass, PSO, root signature, texture, depth
+  // sorting them groups the draws sharing state, front to back inside a group
+  namespace DrawKey
+  {
+    constexpr unsigned PassBits = 4;
+    constexpr unsigned PsoBits = 12;
+    constexpr unsigned RootSignatureBits = 8;
+    constexpr unsigned TextureBits = 20;
+    constexpr unsigned DepthBits = 20;
+
+    // fields wider than their bits are cut
+    uint64_t Make(uint32_t pass, uint32_t pso, uint32_t rootSignature, uint32_t texture, uint32_t depth);
+    // distance in [0, maxDepth] to DepthBits, clamped
+    uint32_t QuantizeDepth(float depth, float maxDepth);
+  }
+
+  namespace RadixSort
+  {
+    // LSD radix sort of keys with their values, 8 bits per pass, passes where all keys
+    // share the digit are skipped, scratch arrays have to hold count elements
+    void Sort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* keyScratch, uint32_t* valueScratch);
+  }
+
+  // Draw packets of a frame, recorded in key order once sorted.
+  class RenderQueue
+  {
+  public:
+    RenderQueue();
+    ~RenderQueue();
+
+    // small ids for the key fields, stable until ResetIds
+    uint32_t GetPsoId(const ID3D12PipelineState* pso);
+    uint32_t GetRootSignatureId(const ID3D12RootSignature* rootSignature);
+    // forgets the ids once the pipeline states they were given to are replaced, a new one
+    // can get the address of a released one, between frames
+    void ResetIds();
+
+    void Push(uint64_t key, const DrawPacket& packet);
+    void Sort();
+    // keeps the memory and the ids
+    void Clear();
+
+    size_t Size() const { return m_packets.size(); }
+    // in key order after Sort, push order before
+    const DrawPacket& GetPacket(size_t index) const { return m_packets[m_order[index]]; }
+    uint64_t GetKey(size_t index) const { return m_keys[index]; }
+
+  private:
+    // keys are sorted with the index of their packet
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_order;
+    std::vector<DrawPacket> m_packets;
+    std::vector<uint64_t> m_keyScratch;
+    std::vector<uint32_t> m_orderScratch;
+    std::unordered_map<const void*, uint32_t> m_psoIds;
+    std::unordered_map<const void*, uint32_t> m_rootSignatureIds;
+
+  private:
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+  };
+}
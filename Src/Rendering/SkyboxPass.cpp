@@ -18,6 +18,7 @@ namespace Rendering
   void SkyboxPass::Render(Graphics::DX12Context* ctx)
   {
     // draw skybox first
-    ctx->Draw(Scene::SceneGraph::Instance().GetSkybox(), m_pso, m_rootSignature);
+    Scene::SceneGraph::Instance().GetSkybox()->SubmitModel(m_queue, m_order, m_pso, m_rootSignature);
+    RecordQueue(ctx);
   }
 }
@@ -0,0 +1,501 @@
+#include "stdafx.h"
+#include "BoundingVolumeHierarchy.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// helpers
+namespace
+{
+  const unsigned BIN_COUNT = 16;
+  // SAH costs of a traversal step and of an item test
+  const float TRAVERSAL_COST = 2.0f;
+  const float ITEM_COST = 1.0f;
+
+  struct Box
+  {
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    void Grow(const float lower[3], const float upper[3])
+    {
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        minimum[axis] = lower[axis] < minimum[axis] ? lower[axis] : minimum[axis];
+        maximum[axis] = upper[axis] > maximum[axis] ? upper[axis] : maximum[axis];
+      }
+    }
+
+    void Grow(const Box& other) { Grow(other.minimum, other.maximum); }
+
+    void Grow(const Scene::Bounds& bounds)
+    {
+      const float lower[3] = {
+        bounds.center[0] - bounds.extents[0], bounds.center[1] - bounds.extents[1], bounds.center[2] - bounds.extents[2] };
+      const float upper[3] = {
+        bounds.center[0] + bounds.extents[0], bounds.center[1] + bounds.extents[1], bounds.center[2] + bounds.extents[2] };
+      Grow(lower, upper);
+    }
+
+    float Area() const
+    {
+      const float dx = maximum[0] - minimum[0];
+      const float dy = maximum[1] - minimum[1];
+      const float dz = maximum[2] - minimum[2];
+      return dx < 0.0f ? 0.0f : 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+  };
+
+  float Area(const float minimum[3], const float maximum[3])
+  {
+    const float dx = maximum[0] - minimum[0];
+    const float dy = maximum[1] - minimum[1];
+    const float dz = maximum[2] - minimum[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+  }
+
+  // -1 outside, 1 inside, 0 crossing the plane
+  int ClassifyBox(const float minimum[3], const float maximum[3], const float plane[4])
+  {
+    float center = plane[3];
+    float reach = 0.0f;
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      center += plane[axis] * (minimum[axis] + maximum[axis]) * 0.5f;
+      reach += std::fabs(plane[axis]) * (maximum[axis] - minimum[axis]) * 0.5f;
+    }
+    if (center + reach < 0.0f)
+      return -1;
+    return center - reach >= 0.0f ? 1 : 0;
+  }
+
+  // slab test, distance to the entry point or FLT_MAX
+  float IntersectBox(const float minimum[3], const float maximum[3], const float origin[3], const float inverse[3], float maxDistance)
+  {
+    float enter = 0.0f;
+    float exit = maxDistance;
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      float t0 = (minimum[axis] - origin[axis]) * inverse[axis];
+      float t1 = (maximum[axis] - origin[axis]) * inverse[axis];
+      if (t0 > t1)
+      {
+        const float swap = t0;
+        t0 = t1;
+        t1 = swap;
+      }
+      // NaN from 0 * inf fails both comparisons and keeps the slab open
+      enter = t0 > enter ? t0 : enter;
+      exit = t1 < exit ? t1 : exit;
+    }
+    return enter <= exit ? enter : FLT_MAX;
+  }
+}
+
+namespace Scene
+{
+  BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+    : m_nodes()
+    , m_parents()
+    , m_items()
+    , m_itemBounds()
+    , m_itemLeaves()
+    , m_buildCost(0.0f)
+  {
+  }
+
+  BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+  {
+  }
+
+  void BoundingVolumeHierarchy::Build(const std::vector<Bounds>& bounds)
+  {
+    if (bounds.size() >= InvalidItem)
+      throw std::out_of_range("[BVH] TOO MANY ITEMS!");
+
+    m_itemBounds = bounds;
+    m_items.resize(bounds.size());
+    for (uint32_t i = 0; i < m_items.size(); ++i)
+      m_items[i] = i;
+    m_itemLeaves.assign(bounds.size(), 0);
+
+    m_nodes.clear();
+    m_parents.clear();
+    m_nodes.reserve(bounds.empty() ? 1 : bounds.size() * 2);
+    m_parents.reserve(m_nodes.capacity());
+
+    Node root = {};
+    root.first = 0;
+    root.count = static_cast<uint32_t>(bounds.size());
+    m_nodes.push_back(root);
+    m_parents.push_back(InvalidItem);
+    FitLeaf(m_nodes[0]);
+
+    // children are always added after their parent
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty())
+    {
+      const uint32_t nodeIndex = stack.back();
+      stack.pop_back();
+      if (Subdivide(nodeIndex))
+      {
+        stack.push_back(m_nodes[nodeIndex].first);
+        stack.push_back(m_nodes[nodeIndex].first + 1);
+      }
+    }
+
+    for (uint32_t nodeIndex = 0; nodeIndex < m_nodes.size(); ++nodeIndex)
+    {
+      const Node& node = m_nodes[nodeIndex];
+      for (uint32_t i = 0; i < node.count; ++i)
+        m_itemLeaves[m_items[node.first + i]] = nodeIndex;
+    }
+
+    m_buildCost = GetCost();
+  }
+
+  bool BoundingVolumeHierarchy::Subdivide(uint32_t nodeIndex)
+  {
+    const uint32_t first = m_nodes[nodeIndex].first;
+    const uint32_t count = m_nodes[nodeIndex].count;
+    if (count <= 1)
+      return false;
+
+    // bins over the item centers
+    Box centers;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const float* center = m_itemBounds[m_items[first + i]].center;
+      centers.Grow(center, center);
+    }
+
+    float bestCost = FLT_MAX;
+    unsigned bestAxis = 0;
+    unsigned bestSplit = 0;
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      const float extent = centers.maximum[axis] - centers.minimum[axis];
+      if (extent <= 0.0f)
+        continue;
+
+      Box bins[BIN_COUNT];
+      uint32_t binCounts[BIN_COUNT] = {};
+      const float scale = BIN_COUNT / extent;
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        const Bounds& bounds = m_itemBounds[m_items[first + i]];
+        unsigned bin = static_cast<unsigned>((bounds.center[axis] - centers.minimum[axis]) * scale);
+        bin = bin < BIN_COUNT ? bin : BIN_COUNT - 1;
+        bins[bin].Grow(bounds);
+        ++binCounts[bin];
+      }
+
+      // areas and counts left of every split, then right while sweeping back
+      float leftAreas[BIN_COUNT - 1];
+      uint32_t leftCounts[BIN_COUNT - 1];
+      Box left;
+      uint32_t leftCount = 0;
+      for (unsigned split = 0; split < BIN_COUNT - 1; ++split)
+      {
+        left.Grow(bins[split]);
+        leftCount += binCounts[split];
+        leftAreas[split] = left.Area();
+        leftCounts[split] = leftCount;
+      }
+
+      Box right;
+      uint32_t rightCount = 0;
+      for (unsigned split = BIN_COUNT - 1; split > 0; --split)
+      {
+        right.Grow(bins[split]);
+        rightCount += binCounts[split];
+        if (leftCounts[split - 1] == 0 || rightCount == 0)
+          continue;
+        const float cost = leftAreas[split - 1] * leftCounts[split - 1] + right.Area() * rightCount;
+        if (cost < bestCost)
+        {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = split;
+        }
+      }
+    }
+
+    Node& node = m_nodes[nodeIndex];
+    const float parentArea = Area(node.minimum, node.maximum);
+    const float leafCost = ITEM_COST * count;
+    const float splitCost = parentArea > 0.0f ? TRAVERSAL_COST + ITEM_COST * bestCost / parentArea : FLT_MAX;
+
+    uint32_t middle = 0;
+    if (bestCost < FLT_MAX && (splitCost < leafCost || count > MaxLeafItems))
+    {
+      // partition at the best bin
+      const float extent = centers.maximum[bestAxis] - centers.minimum[bestAxis];
+      const float scale = BIN_COUNT / extent;
+      uint32_t i = first;
+      uint32_t j = first + count;
+      while (i < j)
+      {
+        unsigned bin = static_cast<unsigned>((m_itemBounds[m_items[i]].center[bestAxis] - centers.minimum[bestAxis]) * scale);
+        bin = bin < BIN_COUNT ? bin : BIN_COUNT - 1;
+        if (bin < bestSplit)
+        {
+          ++i;
+        } else
+        {
+          --j;
+          const uint32_t swap = m_items[i];
+          m_items[i] = m_items[j];
+          m_items[j] = swap;
+        }
+      }
+      middle = i - first;
+    } else if (count > MaxLeafItems)
+    {
+      // every center in the same spot, split in halves
+      middle = count / 2;
+    } else
+    {
+      return false;
+    }
+
+    const uint32_t childIndex = static_cast<uint32_t>(m_nodes.size());
+    Node leftChild = {};
+    leftChild.first = first;
+    leftChild.count = middle;
+    Node rightChild = {};
+    rightChild.first = first + middle;
+    rightChild.count = count - middle;
+    FitLeaf(leftChild);
+    FitLeaf(rightChild);
+
+    m_nodes.push_back(leftChild);
+    m_nodes.push_back(rightChild);
+    m_parents.push_back(nodeIndex);
+    m_parents.push_back(nodeIndex);
+
+    m_nodes[nodeIndex].first = childIndex;
+    m_nodes[nodeIndex].count = 0;
+    return true;
+  }
+
+  void BoundingVolumeHierarchy::FitLeaf(Node& node) const
+  {
+    Box box;
+    for (uint32_t i = 0; i < node.count; ++i)
+      box.Grow(m_itemBounds[m_items[node.first + i]]);
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      node.minimum[axis] = box.minimum[axis];
+      node.maximum[axis] = box.maximum[axis];
+    }
+  }
+
+  void BoundingVolumeHierarchy::FitInner(Node& node) const
+  {
+    const Node& left = m_nodes[node.first];
+    const Node& right = m_nodes[node.first + 1];
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      node.minimum[axis] = left.minimum[axis] < right.minimum[axis] ? left.minimum[axis] : right.minimum[axis];
+      node.maximum[axis] = left.maximum[axis] > right.maximum[axis] ? left.maximum[axis] : right.maximum[axis];
+    }
+  }
+
+  void BoundingVolumeHierarchy::Update(uint32_t item, const Bounds& bounds)
+  {
+    if (item >= m_itemBounds.size())
+      throw std::out_of_range("[BVH] ITEM DOES NOT EXIST!");
+
+    m_itemBounds[item] = bounds;
+
+    uint32_t nodeIndex = m_itemLeaves[item];
+    FitLeaf(m_nodes[nodeIndex]);
+
+    // up to the root, or until a node doesn't change
+    while (m_parents[nodeIndex] != InvalidItem)
+    {
+      nodeIndex = m_parents[nodeIndex];
+      Node& node = m_nodes[nodeIndex];
+      const Node previous = node;
+      FitInner(node);
+      if (memcmp(&previous, &node, sizeof(Node)) == 0)
+        break;
+    }
+  }
+
+  void BoundingVolumeHierarchy::Refit(const std::vector<Bounds>& bounds)
+  {
+    if (bounds.size() != m_itemBounds.size())
+      throw std::invalid_argument("[BVH] REFIT NEEDS THE SAME ITEMS!");
+
+    m_itemBounds = bounds;
+    // children come after their parent
+    for (size_t i = m_nodes.size(); i-- > 0;)
+    {
+      Node& node = m_nodes[i];
+      if (node.count > 0 || m_itemBounds.empty())
+        FitLeaf(node);
+      else
+        FitInner(node);
+    }
+  }
+
+  void BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& output) const
+  {
+    if (m_itemBounds.empty())
+      return;
+
+    // items of leaves crossing the frustum, tested together afterwards
+    BoundsList candidates;
+    std::vector<uint32_t> candidateItems;
+
+    // node and the planes it still has to be tested against
+    struct Entry
+    {
+      uint32_t node;
+      uint32_t planeMask;
+    };
+    std::vector<Entry> stack;
+    stack.push_back({ 0, 0x3f });
+
+    while (!stack.empty())
+    {
+      const Entry entry = stack.back();
+      stack.pop_back();
+      const Node& node = m_nodes[entry.node];
+
+      uint32_t planeMask = entry.planeMask;
+      bool outside = false;
+      for (unsigned plane = 0; plane < 6 && !outside; ++plane)
+      {
+        if ((planeMask & (1u << plane)) == 0)
+          continue;
+        const int side = ClassifyBox(node.minimum, node.maximum, frustum.planes[plane]);
+        outside = side < 0;
+        if (side > 0)
+          planeMask &= ~(1u << plane);
+      }
+      if (outside)
+        continue;
+
+      if (node.count > 0)
+      {
+        for (uint32_t i = 0; i < node.count; ++i)
+        {
+          const uint32_t item = m_items[node.first + i];
+          if (planeMask == 0)
+          {
+            output.push_back(item);
+          } else
+          {
+            candidates.Push(m_itemBounds[item]);
+            candidateItems.push_back(item);
+          }
+        }
+      } else if (planeMask == 0)
+      {
+        // fully inside, everything below is visible
+        std::vector<uint32_t> inside(1, entry.node);
+        while (!inside.empty())
+        {
+          const Node& child = m_nodes[inside.back()];
+          inside.pop_back();
+          if (child.count > 0)
+          {
+            output.insert(output.end(), m_items.begin() + child.first, m_items.begin() + child.first + child.count);
+          } else
+          {
+            inside.push_back(child.first);
+            inside.push_back(child.first + 1);
+          }
+        }
+      } else
+      {
+        stack.push_back({ node.first, planeMask });
+        stack.push_back({ node.first + 1, planeMask });
+      }
+    }
+
+    std::vector<uint8_t> visible(candidateItems.size());
+    FrustumCulling::Cull(candidates, frustum, visible.data());
+    for (size_t i = 0; i < candidateItems.size(); ++i)
+      if (visible[i])
+        output.push_back(candidateItems[i]);
+  }
+
+  RayHit BoundingVolumeHierarchy::Raycast(const float origin[3], const float direction[3], float maxDistance) const
+  {
+    RayHit hit = { InvalidItem, maxDistance };
+    if (m_itemBounds.empty())
+      return hit;
+
+    const float inverse[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+
+    std::vector<uint32_t> stack;
+    if (IntersectBox(m_nodes[0].minimum, m_nodes[0].maximum, origin, inverse, hit.distance) != FLT_MAX)
+      stack.push_back(0);
+
+    while (!stack.empty())
+    {
+      const Node& node = m_nodes[stack.back()];
+      stack.pop_back();
+
+      if (node.count > 0)
+      {
+        for (uint32_t i = 0; i < node.count; ++i)
+        {
+          const uint32_t item = m_items[node.first + i];
+          const Bounds& bounds = m_itemBounds[item];
+          const float minimum[3] = {
+            bounds.center[0] - bounds.extents[0], bounds.center[1] - bounds.extents[1], bounds.center[2] - bounds.extents[2] };
+          const float maximum[3] = {
+            bounds.center[0] + bounds.extents[0], bounds.center[1] + bounds.extents[1], bounds.center[2] + bounds.extents[2] };
+          const float distance = IntersectBox(minimum, maximum, origin, inverse, hit.distance);
+          if (distance != FLT_MAX && (distance < hit.distance || hit.item == InvalidItem))
+          {
+            hit.distance = distance;
+            hit.item = item;
+          }
+        }
+        continue;
+      }
+
+      // nearest child last so it is visited first
+      const Node& left = m_nodes[node.first];
+      const Node& right = m_nodes[node.first + 1];
+      const float leftDistance = IntersectBox(left.minimum, left.maximum, origin, inverse, hit.distance);
+      const float rightDistance = IntersectBox(right.minimum, right.maximum, origin, inverse, hit.distance);
+      const bool leftFirst = leftDistance <= rightDistance;
+      const float farDistance = leftFirst ? rightDistance : leftDistance;
+      const float nearDistance = leftFirst ? leftDistance : rightDistance;
+      if (farDistance != FLT_MAX)
+        stack.push_back(leftFirst ? node.first + 1 : node.first);
+      if (nearDistance != FLT_MAX)
+        stack.push_back(leftFirst ? node.first : node.first + 1);
+    }
+
+    return hit;
+  }
+
+  float BoundingVolumeHierarchy::GetCost() const
+  {
+    if (m_itemBounds.empty())
+      return 0.0f;
+
+    const float rootArea = Area(m_nodes[0].minimum, m_nodes[0].maximum);
+    if (rootArea <= 0.0f)
+      return ITEM_COST * m_itemBounds.size();
+
+    float cost = 0.0f;
+    for (const Node& node : m_nodes)
+    {
+      const float share = Area(node.minimum, node.maximum) / rootArea;
+      cost += share * (node.count > 0 ? ITEM_COST * node.count : TRAVERSAL_COST);
+    }
+    return cost;
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Scene/FrustumCulling.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Scene
+{
+  struct RayHit
+  {
+    // InvalidItem when nothing was hit
+    uint32_t item;
+    // along the direction, in direction lengths
+    float distance;
+  };
+
+  // Binary BVH over item bounds, built with binned SAH.
+  // Items keep the index they were given at build time, moving items are updated in place
+  // (refit) and the tree only needs a rebuild once the refits made it much worse (GetCost).
+  class BoundingVolumeHierarchy
+  {
+  public:
+    static constexpr uint32_t InvalidItem = ~0u;
+    // leaves are split while it is worth it by SAH, and always above this
+    static constexpr uint32_t MaxLeafItems = 8;
+
+    BoundingVolumeHierarchy();
+    ~BoundingVolumeHierarchy();
+
+    void Build(const std::vector<Bounds>& bounds);
+    // one item moved, its leaf and the nodes above it grow or shrink to fit
+    void Update(uint32_t item, const Bounds& bounds);
+    // every item may have moved, same topology
+    void Refit(const std::vector<Bounds>& bounds);
+
+    // appends the items that may be inside, nodes fully inside skip the tests below them
+    // and the items of partially inside leaves go through the culling kernel
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& output) const;
+    // closest item box hit within maxDistance
+    RayHit Raycast(const float origin[3], const float direction[3], float maxDistance) const;
+
+    size_t GetItemCount() const { return m_itemBounds.size(); }
+    size_t GetNodeCount() const { return m_nodes.size(); }
+    // SAH cost of the tree as it is now, compare with GetBuildCost to decide on a rebuild
+    float GetCost() const;
+    float GetBuildCost() const { return m_buildCost; }
+
+  private:
+    struct Node
+    {
+      float minimum[3];
+      // first child for inner nodes (the second one follows), first of m_items for leaves
+      uint32_t first;
+      float maximum[3];
+      // 0 for inner nodes
+      uint32_t count;
+    };
+
+    // false when the node stays a leaf
+    bool Subdivide(uint32_t nodeIndex);
+    void FitLeaf(Node& node) const;
+    void FitInner(Node& node) const;
+
+  private:
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_parents;
+    // item indices, leaves own ranges of them
+    std::vector<uint32_t> m_items;
+    std::vector<Bounds> m_itemBounds;
+    // leaf of every item, for updates
+    std::vector<uint32_t> m_itemLeaves;
+    float m_buildCost;
+  };
+}
@@ -4,6 +4,7 @@
 #include "Core/WindowsApplication.h"
 
 #include <algorithm>
+#include <cmath>
 
 namespace
 {
@@ -29,6 +30,9 @@ namespace Scene
     : m_fov(fov)
     , m_near(nearPlane)
     , m_far(farPlane)
+    , m_pixelScale(1.0f)
+    , m_viewProjection()
+    , m_frustum()
     , m_cameraPosition(0.0f, 0.0f, -10.0f)
     , m_lookAt(0.0f, 0.0f, 1.0f)
     , m_up(0.0f, 1.0f, 0.0)
@@ -102,5 +106,10 @@ namespace Scene
     auto height = rect.bottom - rect.top;
     auto aspectRatio = static_cast<double>(width) / height;
     m_projection = XMMatrixTranspose(XMMatrixPerspectiveFovLH(m_fov, static_cast<float>(aspectRatio), m_near, m_far));
+    m_pixelScale = static_cast<float>(height) / (2.0f * std::fabs(std::tan(m_fov * 0.5f)));
+
+    // view and projection are stored transposed for the shaders
+    XMStoreFloat4x4(&m_viewProjection, XMMatrixTranspose(m_view) * XMMatrixTranspose(m_projection));
+    m_frustum = FrustumCulling::ExtractPlanes(&m_viewProjection._11);
   }
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Scene/FrustumCulling.h"
+
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
@@ -18,6 +20,14 @@ namespace Scene
 
     XMMATRIX GetView() { return m_view; }
     XMMATRIX GetProjection() { return m_projection; }
+    XMFLOAT3 GetPosition() const { return m_cameraPosition; }
+    float GetFar() const { return m_far; }
+    // pixels covered by one unit of size at distance one, for screen-space errors
+    float GetPixelScale() const { return m_pixelScale; }
+    // world space planes of the current view
+    const Frustum& GetFrustum() const { return m_frustum; }
+    // not transposed, for the CPU
+    const XMFLOAT4X4& GetViewProjection() const { return m_viewProjection; }
 
   private:
     XMMATRIX m_view;
@@ -25,6 +35,9 @@ namespace Scene
     float m_fov;
     float m_near;
     float m_far;
+    float m_pixelScale;
+    XMFLOAT4X4 m_viewProjection;
+    Frustum m_frustum;
     XMFLOAT3 m_cameraPosition;
     XMFLOAT3 m_lookAt;
     XMFLOAT3 m_up;
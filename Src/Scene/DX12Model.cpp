@@ -2,6 +2,7 @@
 #include "DX12Model.h"
 
 #include "Core/WindowsApplication.h"
+#include "Core/JobSystem.h"
 
 #include "Textures/DX12Texture.h"
 #include "Textures/TextureManager.h"
@@ -11,19 +12,92 @@
 
 #include "Scene/SceneGraph.h"
 
+#include "Shaders/ShaderManager.h"
+
 #include <assimp\Importer.hpp>
 #include <assimp\scene.h>
 #include <assimp\postprocess.h>
 
+#include <cfloat>
+#include <cmath>
 #include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+// helpers
+namespace
+{
+  // a mesh of an imported model and the texture it uses
+  struct MeshSource
+  {
+    const aiMesh* mesh;
+    aiMatrix4x4 transform;
+    size_t texture;
+  };
+
+  // shared by the jobs loading a model, released with the last of them
+  struct ModelLoad
+  {
+    Assimp::Importer importer;
+    std::vector<MeshSource> meshes;
+    // each texture once, meshes point into it
+    std::vector<std::string> texturePaths;
+    std::vector<std::shared_ptr<Textures::DX12Texture>> textures;
+    // the mesh and texture jobs
+    Core::JobCounter parts;
+  };
+
+  void CollectMeshes(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform,
+    ModelLoad& load, std::unordered_map<std::string, size_t>& textureSlots)
+  {
+    aiMatrix4x4 nodeTransform = parentTransform * node->mTransformation;
+
+    for (unsigned int i = 0; i < node->mNumMeshes; ++i)
+    {
+      const aiMesh* pMesh = scene->mMeshes[node->mMeshes[i]];
+      // points and lines only, nothing to draw
+      if (pMesh->mNumVertices == 0 || !(pMesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE))
+        continue;
+
+      const auto material = scene->mMaterials[pMesh->mMaterialIndex];
+      aiString texturePath;
+      // else default texture
+      std::string path = material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS ? texturePath.C_Str() : "textures\\brick.png";
+
+      // workaround!!!
+      path = "Resources\\" + path;
+      // does file exists?
+      if (!std::filesystem::exists(path))
+        path = "Resources\\textures\\brick.png";
+
+      auto slot = textureSlots.emplace(path, load.texturePaths.size());
+      if (slot.second)
+        load.texturePaths.push_back(path);
+      load.meshes.push_back({ pMesh, nodeTransform, slot.first->second });
+    }
+
+    for (unsigned int i = 0; i < node->mNumChildren; ++i)
+    {
+      CollectMeshes(node->mChildren[i], scene, nodeTransform, load, textureSlots);
+    }
+  }
+}
 
 namespace Scene
 {
   DX12Mesh::DX12Mesh(const aiMesh* pMesh, const aiMatrix4x4& transform, std::shared_ptr<Textures::DX12Texture> texture)
     : m_vertices()
     , m_indices()
-    , m_vertexBufferView()
-    , m_indexBufferView()
+    , m_ranges()
+    , m_meshlets()
+    , m_lods()
+    , m_lodErrors()
+    , m_currentLod(0)
+    , m_bounds()
+    , m_occluder()
+    , m_vertexAllocation(nullptr)
+    , m_indexAllocation(nullptr)
+    , m_dequantization()
     , m_texture(texture)
     , m_ready(false)
   {
@@ -33,68 +107,101 @@ namespace Scene
 
   DX12Mesh::~DX12Mesh()
   {
-    m_vertexBuffer.Reset();
-    m_vertexBufferUploadHeap.Reset();
-    m_indexBuffer.Reset();
-    m_indexBufferUploadHeap.Reset();
+    m_vertexAllocation.reset();
+    m_indexAllocation.reset();
     // owns the texture
     m_texture.reset();
   }
 
-  void DX12Mesh::Setup(ID3D12GraphicsCommandList* commandList)
+  void DX12Mesh::Prepare(ID3D12GraphicsCommandList* commandList)
+  {
+    if (!m_ready)
+      Upload(commandList);
+
+    // the views cover whole pages, shared with the other meshes in them
+    // transitioned here, the lists drawing them may be recorded in parallel and submitted after this one
+    Graphics::GeometryPool::Instance().PrepareForDraw(commandList, m_vertexAllocation.get());
+    Graphics::GeometryPool::Instance().PrepareForDraw(commandList, m_indexAllocation.get());
+  }
+
+  void DX12Mesh::Upload(ID3D12GraphicsCommandList* commandList)
   {
     // setup texture
     m_texture->CopyToGPU(commandList);
     m_texture->GenerateMips(commandList);
     // setup vertex/index buffers
-    SetupVertexBuffer(commandList);
-    SetupIndexBuffer(commandList);
+    if (Shaders::ShaderManager::Instance().IsVertexCompressed())
+    {
+      // half the size, the shader decodes it
+      std::vector<CompressedVertex> compressed(m_vertices.size());
+      VertexCompression::Encode(
+        &m_vertices[0].position.x, &m_vertices[0].normal.x, &m_vertices[0].uv.x, sizeof(Vertex), m_vertices.size(),
+        m_dequantization, compressed.data());
+      m_vertexAllocation = Graphics::GeometryPool::Instance().AllocateVertices(
+        commandList, compressed.data(), static_cast<unsigned>(compressed.size()), sizeof(CompressedVertex));
+    } else
+    {
+      m_vertexAllocation = Graphics::GeometryPool::Instance().AllocateVertices(
+        commandList, m_vertices.data(), static_cast<unsigned>(m_vertices.size()), sizeof(Vertex));
+    }
+    m_indexAllocation = Graphics::GeometryPool::Instance().AllocateIndices(
+      commandList, m_indices.data(), static_cast<unsigned>(m_indices.size()), DXGI_FORMAT_R16_UINT);
     // ready to draw
     m_ready = true;
   }
 
-  void DX12Mesh::Draw(ID3D12PipelineState* pso, ID3D12RootSignature* rootSig, Graphics::ResourceDescriptor* cb, ID3D12GraphicsCommandList* commandList)
+  void DX12Mesh::Bind(Graphics::CommandRecorder& recorder) const
   {
-    if (!m_ready)
-      Setup(commandList);
+    // mesh bounds, unused by full vertices
+    recorder.SetGraphicsRoot32BitConstants(3, sizeof(VertexDequantization) / 4, &m_dequantization, 0);
+
+    recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    recorder.IASetVertexBuffers(0, 1, &m_vertexAllocation->page->vertexView);
+    recorder.IASetIndexBuffer(&m_indexAllocation->page->indexView);
+  }
 
-    commandList->SetPipelineState(pso);
-    commandList->SetGraphicsRootSignature(rootSig);
-    
-    ID3D12DescriptorHeap* ppHeaps[] = { Graphics::ResourceManager::Instance().GetResourcesHeap() };
-    commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+  void DX12Mesh::Draw(ID3D12GraphicsCommandList* commandList) const
+  {
+    const Lod& lod = m_lods[m_currentLod];
+    for (uint32_t r = lod.rangeBegin; r < lod.rangeBegin + lod.rangeCount; ++r)
+    {
+      const IndexRange& range = m_ranges[r];
+      commandList->DrawIndexedInstanced(range.indexCount, 1, m_indexAllocation->offset + range.indexOffset, m_vertexAllocation->offset + range.vertexOffset, 0);
+    }
+  }
 
-    // scene CBV
-    commandList->SetGraphicsRootDescriptorTable(
-      0, Graphics::ResourceManager::Instance().GetResourceGpuHandle(SceneGraph::Instance().GetSceneBuffer()->index));
+  unsigned DX12Mesh::GetTextureIndex() const
+  {
+    return m_texture->GetResource()->index;
+  }
 
-    // object CBV
-    commandList->SetGraphicsRootDescriptorTable(1, Graphics::ResourceManager::Instance().GetResourceGpuHandle(cb->index));
+  void DX12Mesh::SelectLod(const Bounds& worldBounds, float worldScale, const XMFLOAT3& viewPosition, float pixelScale)
+  {
+    const float dx = worldBounds.center[0] - viewPosition.x;
+    const float dy = worldBounds.center[1] - viewPosition.y;
+    const float dz = worldBounds.center[2] - viewPosition.z;
+    const float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - worldBounds.radius;
 
-    // texture CBV
-    commandList->SetGraphicsRootDescriptorTable(2, Graphics::ResourceManager::Instance().GetResourceGpuHandle(m_texture->GetResource()->index));
+    // inside the bounds, full detail
+    if (distance <= 0.0f)
+    {
+      m_currentLod = 0;
+      return;
+    }
 
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-    commandList->IASetIndexBuffer(&m_indexBufferView);
-    commandList->DrawIndexedInstanced(static_cast<unsigned>(m_indices.size()), 1, 0, 0, 0);
+    m_currentLod = static_cast<unsigned>(MeshSimplifier::SelectLevel(
+      m_lodErrors.data(), m_lodErrors.size(), m_currentLod, worldScale * pixelScale / distance, LOD_PIXEL_ERROR, LOD_HYSTERESIS));
   }
 
   void DX12Mesh::LoadMesh(const aiMesh* pMesh, const aiMatrix4x4& transform)
   {
     m_vertices.reserve(pMesh->mNumVertices);
-    // debug
-    float minY = 0;
-    float maxY = 0;
 
     for (unsigned i = 0; i < pMesh->mNumVertices; ++i)
     {
-      minY = std::min(minY, pMesh->mVertices[i].x);
-      maxY = max(maxY, pMesh->mVertices[i].x);
-
       aiVector3D transformed = transform * pMesh->mVertices[i];
 
-      Vertex vertex;
+      Vertex vertex = {};
       vertex.position = { transformed.x, transformed.y, transformed.z };
       if (pMesh->HasNormals())
       {
@@ -106,97 +213,126 @@ namespace Scene
       m_vertices.push_back(vertex);
     }
 
-    m_indices.reserve(pMesh->mNumFaces * 3);
+    std::vector<uint32_t> indices;
+    indices.reserve(pMesh->mNumFaces * 3);
 
     for (unsigned i = 0; i < pMesh->mNumFaces; ++i)
     {
+      // triangulated, points and lines of a mixed mesh stay as they are
       const auto& face = pMesh->mFaces[i];
-      assert(face.mNumIndices == 3);
-      m_indices.push_back(face.mIndices[0]);
-      m_indices.push_back(face.mIndices[1]);
-      m_indices.push_back(face.mIndices[2]);
+      if (face.mNumIndices != 3)
+        continue;
+      indices.push_back(face.mIndices[0]);
+      indices.push_back(face.mIndices[1]);
+      indices.push_back(face.mIndices[2]);
     }
-  }
+    // the import skips them, uploads and bounds rely on it
+    if (indices.empty())
+      throw std::invalid_argument("[MODEL] MESH HAS NO TRIANGLES !");
 
-  void DX12Mesh::SetupVertexBuffer(ID3D12GraphicsCommandList* commandList)
-  {
-    const unsigned vertexBufferSize = static_cast<unsigned>(m_vertices.size() * sizeof(Vertex));
-    auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize);
-    Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
-      &defaultHeapProps,
-      D3D12_HEAP_FLAG_NONE,
-      &resDesc,
-      D3D12_RESOURCE_STATE_COMMON,
-      nullptr,
-      IID_PPV_ARGS(&m_vertexBuffer)));
-
-    Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
-      &uploadHeapProps,
-      D3D12_HEAP_FLAG_NONE,
-      &resDesc,
-      D3D12_RESOURCE_STATE_GENERIC_READ,
-      nullptr,
-      IID_PPV_ARGS(&m_vertexBufferUploadHeap)));
-
-    // copy data to intermediate upload heap
-    D3D12_SUBRESOURCE_DATA vertexData = {};
-    vertexData.pData = m_vertices.data();
-    vertexData.RowPitch = vertexBufferSize;
-    vertexData.SlicePitch = vertexData.RowPitch;
-
-    auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
-    auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-    commandList->ResourceBarrier(1, &barrier1);
-    UpdateSubresources(commandList, m_vertexBuffer.Get(), m_vertexBufferUploadHeap.Get(), 0, 0, 1, &vertexData);
-    commandList->ResourceBarrier(1, &barrier2);
-
-    // Initialize the vertex buffer view.
-    m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-    m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-    m_vertexBufferView.SizeInBytes = vertexBufferSize;
-  }
+    // levels of detail, each one simplified from the previous one, all sharing the vertices
+    std::vector<std::vector<uint32_t>> levels(1);
+    levels[0].swap(indices);
+    std::vector<float> levelErrors(1, 0.0f);
 
-  void DX12Mesh::SetupIndexBuffer(ID3D12GraphicsCommandList* commandList)
-  {
-    const unsigned indexBufferSize = static_cast<unsigned>(m_indices.size() * sizeof(uint32_t));
-    auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize);
-    Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
-      &defaultHeapProps,
-      D3D12_HEAP_FLAG_NONE,
-      &resDesc,
-      D3D12_RESOURCE_STATE_COMMON,
-      nullptr,
-      IID_PPV_ARGS(&m_indexBuffer)));
-
-    Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateCommittedResource(
-      &uploadHeapProps,
-      D3D12_HEAP_FLAG_NONE,
-      &resDesc,
-      D3D12_RESOURCE_STATE_GENERIC_READ,
-      nullptr,
-      IID_PPV_ARGS(&m_indexBufferUploadHeap)));
-
-    // Copy data to the intermediate upload heap and then schedule a copy 
-        // from the upload heap to the index buffer.
-    D3D12_SUBRESOURCE_DATA indexData = {};
-    indexData.pData = m_indices.data();
-    indexData.RowPitch = indexBufferSize;
-    indexData.SlicePitch = indexData.RowPitch;
-
-    auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(m_indexBuffer.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
-    auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(m_indexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER);
-    commandList->ResourceBarrier(1, &barrier1);
-    UpdateSubresources(commandList, m_indexBuffer.Get(), m_indexBufferUploadHeap.Get(), 0, 0, 1, &indexData);
-    commandList->ResourceBarrier(1, &barrier2);
-
-    // Initialize the index buffer view.
-    m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
-    m_indexBufferView.SizeInBytes = indexBufferSize;
-    m_indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    const size_t vertexCount = m_vertices.size();
+    const auto before = MeshOptimizer::AnalyzeVertexCache(levels[0].data(), levels[0].size(), vertexCount);
+
+    // full mesh reordered for the post-transform cache and overdraw
+    auto clusters = MeshOptimizer::OptimizeVertexCache(levels[0].data(), levels[0].size(), vertexCount);
+    MeshOptimizer::OptimizeOverdraw(levels[0].data(), levels[0].size(), &m_vertices[0].position.x, sizeof(Vertex), vertexCount, clusters);
+
+    while (levels.size() < LOD_COUNT)
+    {
+      const auto& previous = levels.back();
+      auto simplified = MeshSimplifier::Simplify(
+        previous.data(), previous.size(), &m_vertices[0].position.x, sizeof(Vertex), vertexCount,
+        static_cast<size_t>(previous.size() / 3 * LOD_REDUCTION) * 3, FLT_MAX);
+      // seams and borders are kept, some meshes don't get much simpler
+      if (simplified.indices.empty() || simplified.indices.size() > previous.size() * LOD_MIN_REDUCTION)
+        break;
+
+      MeshOptimizer::OptimizeVertexCache(simplified.indices.data(), simplified.indices.size(), vertexCount);
+      // errors are measured against the previous level, they add up
+      levelErrors.push_back(levelErrors.back() + simplified.error);
+      levels.push_back(std::move(simplified.indices));
+    }
+
+    // vertices in fetch order of the full mesh, the other levels use a subset of them
+    auto sources = MeshOptimizer::OptimizeVertexFetch(levels[0].data(), levels[0].size(), vertexCount);
+    std::vector<uint32_t> remap(vertexCount);
+    for (uint32_t i = 0; i < sources.size(); ++i)
+      remap[sources[i]] = i;
+    for (size_t level = 1; level < levels.size(); ++level)
+      for (auto& index : levels[level])
+        index = remap[index];
+    MeshOptimizer::RemapVertices(sources, m_vertices);
+
+    const auto after = MeshOptimizer::AnalyzeVertexCache(levels[0].data(), levels[0].size(), m_vertices.size());
+
+    char message[256];
+    snprintf(message, sizeof(message), "[MESH] %s: %zu triangles, acmr %.3f -> %.3f, atvr %.3f -> %.3f, %zu lods down to %zu triangles\n",
+      pMesh->mName.C_Str(), levels[0].size() / 3, before.acmr, after.acmr, before.atvr, after.atvr, levels.size(), levels.back().size() / 3);
+    OutputDebugStringA(message);
+
+    // the coarsest level, compacted, stands in for the mesh in the occlusion buffer, pushed back by its error
+    const auto& coarsest = levels.back();
+    if (coarsest.size() / 3 <= OCCLUDER_MAX_TRIANGLES)
+    {
+      m_occluder.error = levelErrors.back();
+      std::vector<uint32_t> occluderVertices(m_vertices.size(), UINT32_MAX);
+      m_occluder.indices.reserve(coarsest.size());
+      for (uint32_t index : coarsest)
+      {
+        if (occluderVertices[index] == UINT32_MAX)
+        {
+          occluderVertices[index] = static_cast<uint32_t>(m_occluder.positions.size() / 3);
+          m_occluder.positions.insert(m_occluder.positions.end(), { m_vertices[index].position.x, m_vertices[index].position.y, m_vertices[index].position.z });
+        }
+        m_occluder.indices.push_back(occluderVertices[index]);
+      }
+    }
+
+    // 16-bit indices, split in ranges when the mesh has too many vertices
+    // in that case every level gets its own copy of the vertices it uses
+    std::vector<Vertex> source;
+    source.swap(m_vertices);
+    const bool shared = source.size() <= IndexSplitter::MaxRangeVertices;
+    if (shared)
+      m_vertices = source;
+
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+      auto split = IndexSplitter::Split(levels[level].data(), levels[level].size(), source.size());
+
+      const uint32_t vertexBase = shared ? 0 : static_cast<uint32_t>(m_vertices.size());
+      for (uint32_t vertex : split.vertexRemap)
+        m_vertices.push_back(source[vertex]);
+
+      const uint32_t indexBase = static_cast<uint32_t>(m_indices.size());
+      m_lods.push_back({ static_cast<uint32_t>(m_ranges.size()), static_cast<uint32_t>(split.ranges.size()) });
+      for (const auto& range : split.ranges)
+        m_ranges.push_back({ indexBase + range.indexOffset, range.indexCount, vertexBase + range.vertexOffset });
+      m_indices.insert(m_indices.end(), split.indices.begin(), split.indices.end());
+    }
+    m_lodErrors.swap(levelErrors);
+
+    // meshlets of the full mesh, they may cross ranges since they index the vertices directly
+    std::vector<uint32_t> meshIndices;
+    for (uint32_t r = m_lods[0].rangeBegin; r < m_lods[0].rangeBegin + m_lods[0].rangeCount; ++r)
+      for (uint32_t i = m_ranges[r].indexOffset; i < m_ranges[r].indexOffset + m_ranges[r].indexCount; ++i)
+        meshIndices.push_back(m_ranges[r].vertexOffset + m_indices[i]);
+    if (!meshIndices.empty())
+      m_meshlets = MeshletBuilder::Build(meshIndices.data(), meshIndices.size(), &m_vertices[0].position.x, sizeof(Vertex), m_vertices.size());
+
+    // bounds the compressed positions are relative to
+    if (!m_vertices.empty())
+    {
+      m_dequantization = VertexCompression::ComputeDequantization(&m_vertices[0].position.x, sizeof(Vertex), m_vertices.size());
+
+      // for culling and the lod distance
+      m_bounds = FrustumCulling::ComputeBounds(&m_vertices[0].position.x, sizeof(Vertex), m_vertices.size());
+    }
   }
 }
 
@@ -204,21 +340,19 @@ namespace Scene
 {
   DX12Model::DX12Model()
     : m_meshes()
-    , m_pCbvDataBegin(nullptr)
     , m_constantBufferData()
-    , m_constantBuffer(nullptr)
+    , m_constantBufferAddress(0)
+    , m_world()
+    , m_bounds()
+    , m_meshBounds()
+    , m_meshVisible()
+    , m_worldScale(1.0f)
+    , m_boundsDirty(true)
+    , m_boundsChanged(false)
     , m_translation(0.0f, 0.0f, 0.0f)
     , m_scale(1.0f, 1.0f, 1.0f)
     , m_angle(0.0f)
   {
-    // create constant buffer
-    m_constantBuffer = Graphics::ResourceManager::Instance().CreateConstantBufferResource(
-      sizeof(ConstantBufferData), D3D12_HEAP_TYPE_UPLOAD);
-    // Map and initialize the constant buffer. We don't unmap this until the
-    // app closes. Keeping things mapped for the lifetime of the resource is okay.
-    CD3DX12_RANGE readRange(0, 0); // We do not intend to read from this resource on the CPU.
-    Utilities::ThrowIfFailed(m_constantBuffer->resource->Map(0, &readRange, reinterpret_cast<void**>(&m_pCbvDataBegin)));
-    memcpy(m_pCbvDataBegin, &m_constantBufferData, sizeof(m_constantBufferData));
   }
 
   DX12Model::~DX12Model()
@@ -226,57 +360,110 @@ namespace Scene
     m_meshes.clear();
   }
 
-  void DX12Model::DrawModel(ID3D12PipelineState* pso, ID3D12RootSignature* rootSig, ID3D12GraphicsCommandList* commandList)
+  void DX12Model::SubmitModel(Rendering::RenderQueue& queue, uint32_t pass, ID3D12PipelineState* pso, ID3D12RootSignature* rootSig)
   {
-    for (int i = 0; i < m_meshes.size(); ++i)
-      m_meshes[i]->Draw(pso, rootSig, m_constantBuffer.get(), commandList);
-  }
+    auto camera = SceneGraph::Instance().GetCamera();
+    const XMFLOAT3 eye = camera->GetPosition();
+    const uint32_t psoId = queue.GetPsoId(pso);
+    const uint32_t rootSignatureId = queue.GetRootSignatureId(rootSig);
 
-  void DX12Model::ProcessNode(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform)
-  {
-    aiMatrix4x4 nodeTransform = parentTransform * node->mTransformation;
-
-    for (unsigned int i = 0; i < node->mNumMeshes; ++i)
+    for (int i = 0; i < m_meshes.size(); ++i)
     {
-      const aiMesh* pMesh = scene->mMeshes[node->mMeshes[i]];
-      const auto material = scene->mMaterials[pMesh->mMaterialIndex];
-      aiString texturePath;
-      std::vector<std::string> paths(1);
-      // else default texture
-      paths[0] = material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS ? texturePath.C_Str() : "textures\\brick.png";
+      // culled by the scene
+      if (i < m_meshVisible.size() && !m_meshVisible[i])
+        continue;
 
-      // workaround!!!
-      paths[0] = "Resources\\" + paths[0];
-      // does file exists?
-      if (!std::filesystem::exists(paths[0]))
-        paths[0] = "Resources\\textures\\brick.png";
-      
+      // level of detail and sorting depth from the camera distance
+      float depth = 0.0f;
+      if (i < m_meshBounds.Size())
+      {
+        const Bounds bounds = GetMeshBounds(i);
+        m_meshes[i]->SelectLod(bounds, m_worldScale, eye, camera->GetPixelScale());
+        const float dx = bounds.center[0] - eye.x;
+        const float dy = bounds.center[1] - eye.y;
+        const float dz = bounds.center[2] - eye.z;
+        depth = std::sqrt(dx * dx + dy * dy + dz * dz);
+      }
 
-      auto mesh = std::make_unique<DX12Mesh>(pMesh, nodeTransform, Textures::TextureManager::Instance().CreateOrGetTexture(paths));
-      m_meshes.emplace_back(mesh.release());
+      const uint64_t key = Rendering::DrawKey::Make(
+        pass, psoId, rootSignatureId, m_meshes[i]->GetTextureIndex(), Rendering::DrawKey::QuantizeDepth(depth, camera->GetFar()));
+      queue.Push(key, { m_meshes[i].get(), pso, rootSig, m_constantBufferAddress });
     }
+  }
 
-    for (unsigned int i = 0; i < node->mNumChildren; ++i)
-    {
-      ProcessNode(node->mChildren[i], scene, nodeTransform);
-    }
+  Bounds DX12Model::GetMeshBounds(size_t mesh) const
+  {
+    if (mesh >= m_meshBounds.Size())
+      throw std::out_of_range("[MODEL] MESH HAS NO BOUNDS!");
+
+    return {
+      { m_meshBounds.centerX[mesh], m_meshBounds.centerY[mesh], m_meshBounds.centerZ[mesh] },
+      { m_meshBounds.extentX[mesh], m_meshBounds.extentY[mesh], m_meshBounds.extentZ[mesh] },
+      m_meshBounds.radius[mesh] };
+  }
+
+  bool DX12Model::ConsumeBoundsChanged()
+  {
+    const bool changed = m_boundsChanged;
+    m_boundsChanged = false;
+    return changed;
   }
 
   void DX12Model::LoadModel(const char* path)
   {
-    Assimp::Importer importer;
+    Core::JobCounter counter;
+    LoadModelAsync(path, counter);
+    Core::JobSystem::Instance().Wait(counter);
+  }
+
+  void DX12Model::LoadModelAsync(const std::string& path, Core::JobCounter& counter)
+  {
+    Core::JobSystem::Instance().Run([this, path, &counter]() {
+      auto& jobs = Core::JobSystem::Instance();
+      auto load = std::make_shared<ModelLoad>();
+
+      const aiScene* pModel = load->importer.ReadFile(path,
+        aiProcess_Triangulate |
+        aiProcess_JoinIdenticalVertices |
+        aiProcess_ConvertToLeftHanded |
+        aiProcess_GenNormals |
+        aiProcess_CalcTangentSpace);
+      if (!pModel || !pModel->mRootNode)
+      {
+        char message[512];
+        snprintf(message, sizeof(message), "[MODEL] could not import %s: %s\n", path.c_str(), load->importer.GetErrorString());
+        OutputDebugStringA(message);
+        throw std::invalid_argument("[MODEL] MODEL COULD NOT BE IMPORTED !");
+      }
 
-    const aiScene* pModel = importer.ReadFile(path,
-      aiProcess_Triangulate |
-      aiProcess_JoinIdenticalVertices |
-      aiProcess_ConvertToLeftHanded |
-      aiProcess_GenNormals |
-      aiProcess_CalcTangentSpace);
+      std::unordered_map<std::string, size_t> textureSlots;
+      aiMatrix4x4 identity; // identity matrix
+      CollectMeshes(pModel->mRootNode, pModel, identity, *load, textureSlots);
 
-    // maybe check if model is available
+      // textures decode while the meshes convert, every slot is written by one job
+      m_meshes.resize(load->meshes.size());
+      load->textures.resize(load->texturePaths.size());
+      for (size_t i = 0; i < load->texturePaths.size(); ++i)
+      {
+        jobs.Run([load, i]() {
+          load->textures[i] = Textures::TextureManager::Instance().CreateOrGetTexture({ load->texturePaths[i] });
+        }, &load->parts);
+      }
+      for (size_t i = 0; i < load->meshes.size(); ++i)
+      {
+        jobs.Run([this, load, i]() {
+          const MeshSource& source = load->meshes[i];
+          m_meshes[i] = std::make_unique<DX12Mesh>(source.mesh, source.transform, nullptr);
+        }, &load->parts);
+      }
 
-    aiMatrix4x4 identity; // identity matrix
-    ProcessNode(pModel->mRootNode, pModel, identity);
+      jobs.RunAfter(load->parts, [this, load]() {
+        // rethrows what a part threw
+        Core::JobSystem::Instance().Wait(load->parts);
+        for (size_t i = 0; i < m_meshes.size(); ++i)
+          m_meshes[i]->SetTexture(load->textures[load->meshes[i].texture]);
+      }, &counter);
+    }, &counter);
   }
 
   void DX12Model::UpdateModel()
@@ -286,6 +473,30 @@ namespace Scene
     XMMATRIX S = XMMatrixScaling(m_scale.x, m_scale.y, m_scale.z);
 
     m_constantBufferData.model = XMMatrixTranspose(S * R * T);
-    memcpy(m_pCbvDataBegin, &m_constantBufferData, sizeof(m_constantBufferData));
+
+    // world space bounds, only when the transform changed
+    if (m_boundsDirty)
+    {
+      XMStoreFloat4x4(&m_world, S * R * T);
+      m_worldScale = m_scale.x > m_scale.y ? m_scale.x : m_scale.y;
+      m_worldScale = m_scale.z > m_worldScale ? m_scale.z : m_worldScale;
+
+      m_meshBounds.Resize(m_meshes.size());
+      for (size_t i = 0; i < m_meshes.size(); ++i)
+      {
+        const Bounds bounds = FrustumCulling::TransformBounds(m_meshes[i]->GetBounds(), &m_world._11, m_worldScale);
+        m_meshBounds.Set(i, bounds);
+        m_bounds = i == 0 ? bounds : FrustumCulling::MergeBounds(m_bounds, bounds);
+      }
+      m_boundsDirty = false;
+      m_boundsChanged = true;
+    }
+    // meshes are drawn until culled
+    m_meshVisible.assign(m_meshes.size(), 1);
+
+    // a fresh slice every frame, the GPU may still read last frame's one
+    auto constants = Graphics::ResourceManager::Instance().AllocateConstants(sizeof(m_constantBufferData));
+    memcpy(constants.cpuAddress, &m_constantBufferData, sizeof(m_constantBufferData));
+    m_constantBufferAddress = constants.gpuAddress;
   }
 }
\ No newline at end of file
@@ -1,6 +1,18 @@
 #pragma once
 
 #include "Graphics\ResourceManager.h"
+#include "Graphics\GeometryPool.h"
+#include "Graphics\CommandRecorder.h"
+
+#include "Scene\VertexCompression.h"
+#include "Scene\IndexSplitter.h"
+#include "Scene\MeshOptimizer.h"
+#include "Scene\MeshletBuilder.h"
+#include "Scene\MeshSimplifier.h"
+#include "Scene\FrustumCulling.h"
+#include "Scene\OcclusionBuffer.h"
+
+#include "Rendering\RenderQueue.h"
 
 #include <assimp\Importer.hpp>
 #include <assimp\scene.h>
@@ -9,6 +21,11 @@
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
+namespace Core
+{
+  class JobCounter;
+}
+
 namespace Textures
 {
   class DX12Texture;
@@ -18,20 +35,49 @@ namespace Scene
 {
   class DX12Mesh
   {
+    // levels are simplified by half until they stop getting simpler
+    const size_t LOD_COUNT = 4;
+    const float LOD_REDUCTION = 0.5f;
+    const float LOD_MIN_REDUCTION = 0.8f;
+    // projected error allowed, in pixels, and the share of it needed to go coarser
+    const float LOD_PIXEL_ERROR = 1.0f;
+    const float LOD_HYSTERESIS = 0.75f;
+    // the coarsest level is kept on the CPU for occlusion culling when it is at most this big
+    const size_t OCCLUDER_MAX_TRIANGLES = 2048;
+
   public:
     // context needed for setup and draw
     DX12Mesh(const aiMesh* pMesh, const aiMatrix4x4& transform, std::shared_ptr<Textures::DX12Texture> texture);
     ~DX12Mesh();
 
-    void Draw(ID3D12PipelineState* pso, ID3D12RootSignature* rootSig, Graphics::ResourceDescriptor* cb, ID3D12GraphicsCommandList* commandList);
+    // uploads the mesh and its texture the first time and transitions its pages, before any list binds it
+    void Prepare(ID3D12GraphicsCommandList* commandList);
+    // vertex/index buffers and mesh constants, the texture is bound by the caller
+    // only records on the recorder's list, so meshes can be bound from several threads
+    void Bind(Graphics::CommandRecorder& recorder) const;
+    // the ranges of the current level of detail
+    void Draw(ID3D12GraphicsCommandList* commandList) const;
+    // draw calls of the current level of detail
+    uint32_t GetDrawCount() const { return m_lods[m_currentLod].rangeCount; }
+    // resources heap index of the texture, for draw sorting and binding
+    unsigned GetTextureIndex() const;
+    // loaders convert the mesh and decode its texture in parallel, and join them here
+    void SetTexture(std::shared_ptr<Textures::DX12Texture> texture) { m_texture = std::move(texture); }
+
+    // picks the level of detail drawn next from its error projected on screen
+    void SelectLod(const Bounds& worldBounds, float worldScale, const XMFLOAT3& viewPosition, float pixelScale);
+
+    // clusters of the mesh with their bounds, for culling
+    const MeshletData& GetMeshlets() const { return m_meshlets; }
+    // mesh space
+    const Bounds& GetBounds() const { return m_bounds; }
+    // empty when the mesh is too detailed to be an occluder
+    const OccluderMesh& GetOccluder() const { return m_occluder; }
 
   private:
     void LoadMesh(const aiMesh* pMesh, const aiMatrix4x4& transform);
-    void Setup(ID3D12GraphicsCommandList* commandList);
-    
-    // setup functions
-    void SetupVertexBuffer(ID3D12GraphicsCommandList* commandList);
-    void SetupIndexBuffer(ID3D12GraphicsCommandList* commandList);
+    // vertices, indices and texture to the GPU
+    void Upload(ID3D12GraphicsCommandList* commandList);
 
   private:
     struct Vertex
@@ -43,15 +89,29 @@ namespace Scene
 
     // data
     std::vector<Vertex> m_vertices;
-    std::vector<uint32_t> m_indices;
-    // vertex buffer
-    ComPtr<ID3D12Resource> m_vertexBuffer;
-    ComPtr<ID3D12Resource> m_vertexBufferUploadHeap;
-    D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
-    // index buffer
-    ComPtr<ID3D12Resource> m_indexBuffer;
-    ComPtr<ID3D12Resource> m_indexBufferUploadHeap;
-    D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
+    // 16-bit, all levels of detail, meshes with too many vertices are drawn in several ranges
+    std::vector<uint16_t> m_indices;
+    std::vector<IndexRange> m_ranges;
+    // meshlets of the full mesh, they reference m_vertices directly
+    MeshletData m_meshlets;
+    // ranges of every level of detail, the full mesh first
+    struct Lod
+    {
+      uint32_t rangeBegin;
+      uint32_t rangeCount;
+    };
+    std::vector<Lod> m_lods;
+    // error of every level, in mesh units, against the full mesh
+    std::vector<float> m_lodErrors;
+    unsigned m_currentLod;
+    // mesh space
+    Bounds m_bounds;
+    OccluderMesh m_occluder;
+    // ranges in the geometry pool, draws use their offsets as base vertex and start index
+    std::unique_ptr<Graphics::GeometryAllocation> m_vertexAllocation;
+    std::unique_ptr<Graphics::GeometryAllocation> m_indexAllocation;
+    // mesh bounds, to get compressed positions back in the vertex shader
+    VertexDequantization m_dequantization;
     // mesh texture, one for now
     std::shared_ptr<Textures::DX12Texture> m_texture;
     // is it ready to draw
@@ -73,15 +133,30 @@ namespace Scene
     DX12Model();
     ~DX12Model();
 
+    // imports on the job system and waits for it
     virtual void LoadModel(const char* path);
+    // imports, converts the meshes and decodes the textures in jobs counted by counter,
+    // the model can't be used before the counter reaches zero
+    void LoadModelAsync(const std::string& path, Core::JobCounter& counter);
 
-    void DrawModel(ID3D12PipelineState* pso, ID3D12RootSignature* rootSig, ID3D12GraphicsCommandList* commandList);
+    // one packet per visible mesh, after picking its level of detail
+    void SubmitModel(Rendering::RenderQueue& queue, uint32_t pass, ID3D12PipelineState* pso, ID3D12RootSignature* rootSig);
+    // writes the model constants for the current frame, has to be called every frame before drawing
     void UpdateModel();
-    void SetTranslation(XMFLOAT3 translate) { m_translation = translate; };
-    void SetScale(XMFLOAT3 scale) { m_scale = scale; }
-
-  private:
-    void ProcessNode(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform);
+    void SetTranslation(XMFLOAT3 translate) { m_translation = translate; m_boundsDirty = true; };
+    void SetScale(XMFLOAT3 scale) { m_scale = scale; m_boundsDirty = true; }
+    // world space, updated with the model constants when the transform changed
+    const Bounds& GetBounds() const { return m_bounds; }
+    Bounds GetMeshBounds(size_t mesh) const;
+    size_t GetMeshCount() const { return m_meshes.size(); }
+    const DX12Mesh& GetMesh(size_t mesh) const { return *m_meshes[mesh]; }
+    // row vector transform of the last UpdateModel
+    const XMFLOAT4X4& GetWorld() const { return m_world; }
+    // true once after UpdateModel moved the bounds, for the scene BVH
+    bool ConsumeBoundsChanged();
+    // visibility until the next UpdateModel, which shows every mesh again
+    void HideMeshes() { m_meshVisible.assign(m_meshes.size(), 0); }
+    void ShowMesh(size_t mesh) { m_meshVisible[mesh] = 1; }
 
   protected:
     std::vector<std::unique_ptr<DX12Mesh>> m_meshes;
@@ -97,9 +172,18 @@ namespace Scene
     };
     // data
     ConstantBufferData m_constantBufferData;
-    UINT8* m_pCbvDataBegin;
-    // constant buffer
-    std::unique_ptr<Graphics::ResourceDescriptor> m_constantBuffer;
+    // this frame's slice of the frame constants
+    D3D12_GPU_VIRTUAL_ADDRESS m_constantBufferAddress;
+    // world space transform and bounds of the model and its meshes
+    XMFLOAT4X4 m_world;
+    Bounds m_bounds;
+    BoundsList m_meshBounds;
+    std::vector<uint8_t> m_meshVisible;
+    // largest axis scale, for the lod errors
+    float m_worldScale;
+    // bounds need to be transformed again, and were since the last ConsumeBoundsChanged
+    bool m_boundsDirty;
+    bool m_boundsChanged;
     // for testing
     XMFLOAT3 m_translation;
     XMFLOAT3 m_scale;
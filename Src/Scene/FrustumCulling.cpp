@@ -0,0 +1,265 @@
+#include "stdafx.h"
+#include "FrustumCulling.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define FRUSTUM_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+// helpers
+namespace
+{
+  // same operations in the same order as the kernel, so both agree exactly
+  bool Inside(const Scene::BoundsList& bounds, size_t i, const Scene::Frustum& frustum)
+  {
+    bool inside = true;
+    for (const auto& plane : frustum.planes)
+    {
+      const float distance = (plane[0] * bounds.centerX[i] + plane[1] * bounds.centerY[i]) + (plane[2] * bounds.centerZ[i] + plane[3]);
+      const float boxReach = (std::fabs(plane[0]) * bounds.extentX[i] + std::fabs(plane[1]) * bounds.extentY[i]) + std::fabs(plane[2]) * bounds.extentZ[i];
+      const float reach = boxReach < bounds.radius[i] ? boxReach : bounds.radius[i];
+      inside &= distance + reach >= 0.0f;
+    }
+    return inside;
+  }
+}
+
+namespace Scene
+{
+  void BoundsList::Clear()
+  {
+    Resize(0);
+  }
+
+  void BoundsList::Push(const Bounds& bounds)
+  {
+    Resize(Size() + 1);
+    Set(Size() - 1, bounds);
+  }
+
+  void BoundsList::Set(size_t index, const Bounds& bounds)
+  {
+    centerX[index] = bounds.center[0];
+    centerY[index] = bounds.center[1];
+    centerZ[index] = bounds.center[2];
+    extentX[index] = bounds.extents[0];
+    extentY[index] = bounds.extents[1];
+    extentZ[index] = bounds.extents[2];
+    radius[index] = bounds.radius;
+  }
+
+  void BoundsList::Resize(size_t size)
+  {
+    centerX.resize(size);
+    centerY.resize(size);
+    centerZ.resize(size);
+    extentX.resize(size);
+    extentY.resize(size);
+    extentZ.resize(size);
+    radius.resize(size);
+  }
+
+  namespace FrustumCulling
+  {
+    Frustum ExtractPlanes(const float viewProjection[16])
+    {
+      // column j of the matrix
+      auto column = [viewProjection](unsigned j, float output[4])
+      {
+        for (unsigned i = 0; i < 4; ++i)
+          output[i] = viewProjection[i * 4 + j];
+      };
+
+      float x[4], y[4], z[4], w[4];
+      column(0, x);
+      column(1, y);
+      column(2, z);
+      column(3, w);
+
+      Frustum frustum = {};
+      for (unsigned i = 0; i < 4; ++i)
+      {
+        frustum.planes[0][i] = w[i] + x[i];
+        frustum.planes[1][i] = w[i] - x[i];
+        frustum.planes[2][i] = w[i] + y[i];
+        frustum.planes[3][i] = w[i] - y[i];
+        frustum.planes[4][i] = z[i];
+        frustum.planes[5][i] = w[i] - z[i];
+      }
+
+      for (auto& plane : frustum.planes)
+      {
+        const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+          for (unsigned i = 0; i < 4; ++i)
+            plane[i] /= length;
+      }
+
+      return frustum;
+    }
+
+    Bounds ComputeBounds(const float* positions, size_t stride, size_t count)
+    {
+      Bounds bounds = {};
+      if (count == 0)
+        return bounds;
+
+      auto position = [positions, stride](size_t i)
+      {
+        return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + stride * i);
+      };
+
+      float minimum[3] = { positions[0], positions[1], positions[2] };
+      float maximum[3] = { positions[0], positions[1], positions[2] };
+      for (size_t i = 1; i < count; ++i)
+      {
+        const float* p = position(i);
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+          minimum[axis] = p[axis] < minimum[axis] ? p[axis] : minimum[axis];
+          maximum[axis] = p[axis] > maximum[axis] ? p[axis] : maximum[axis];
+        }
+      }
+
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        bounds.center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+        bounds.extents[axis] = (maximum[axis] - minimum[axis]) * 0.5f;
+      }
+
+      // the sphere around the center is often tighter than the box corners
+      float radiusSquared = 0.0f;
+      for (size_t i = 0; i < count; ++i)
+      {
+        const float* p = position(i);
+        const float dx = p[0] - bounds.center[0];
+        const float dy = p[1] - bounds.center[1];
+        const float dz = p[2] - bounds.center[2];
+        const float distance = dx * dx + dy * dy + dz * dz;
+        radiusSquared = distance > radiusSquared ? distance : radiusSquared;
+      }
+      bounds.radius = std::sqrt(radiusSquared);
+
+      return bounds;
+    }
+
+    Bounds TransformBounds(const Bounds& bounds, const float matrix[16], float scale)
+    {
+      Bounds output = {};
+      for (unsigned j = 0; j < 3; ++j)
+      {
+        output.center[j] = matrix[12 + j];
+        for (unsigned i = 0; i < 3; ++i)
+        {
+          output.center[j] += bounds.center[i] * matrix[i * 4 + j];
+          output.extents[j] += bounds.extents[i] * std::fabs(matrix[i * 4 + j]);
+        }
+      }
+      output.radius = bounds.radius * scale;
+      return output;
+    }
+
+    Bounds MergeBounds(const Bounds& a, const Bounds& b)
+    {
+      Bounds output = {};
+      float boxRadiusSquared = 0.0f;
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        const float aMin = a.center[axis] - a.extents[axis];
+        const float bMin = b.center[axis] - b.extents[axis];
+        const float aMax = a.center[axis] + a.extents[axis];
+        const float bMax = b.center[axis] + b.extents[axis];
+        const float minimum = aMin < bMin ? aMin : bMin;
+        const float maximum = aMax > bMax ? aMax : bMax;
+        output.center[axis] = (minimum + maximum) * 0.5f;
+        output.extents[axis] = (maximum - minimum) * 0.5f;
+        boxRadiusSquared += output.extents[axis] * output.extents[axis];
+      }
+
+      // spheres around the new center, or the box corners if they are closer
+      float radius = 0.0f;
+      for (const Bounds* bounds : { &a, &b })
+      {
+        const float dx = bounds->center[0] - output.center[0];
+        const float dy = bounds->center[1] - output.center[1];
+        const float dz = bounds->center[2] - output.center[2];
+        const float reach = std::sqrt(dx * dx + dy * dy + dz * dz) + bounds->radius;
+        radius = reach > radius ? reach : radius;
+      }
+      const float boxRadius = std::sqrt(boxRadiusSquared);
+      output.radius = radius < boxRadius ? radius : boxRadius;
+
+      return output;
+    }
+
+    size_t CullScalar(const BoundsList& bounds, const Frustum& frustum, uint8_t* visible)
+    {
+      size_t visibleCount = 0;
+      for (size_t i = 0; i < bounds.Size(); ++i)
+      {
+        visible[i] = Inside(bounds, i, frustum) ? 1 : 0;
+        visibleCount += visible[i];
+      }
+      return visibleCount;
+    }
+
+    size_t Cull(const BoundsList& bounds, const Frustum& frustum, uint8_t* visible)
+    {
+      size_t i = 0;
+      size_t visibleCount = 0;
+
+#ifdef FRUSTUM_CULLING_SSE2
+      const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+      __m128 planes[6][4];
+      __m128 absolutes[6][3];
+      for (unsigned p = 0; p < 6; ++p)
+      {
+        for (unsigned c = 0; c < 4; ++c)
+          planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+        for (unsigned c = 0; c < 3; ++c)
+          absolutes[p][c] = _mm_and_ps(planes[p][c], absMask);
+      }
+
+      for (; i + 4 <= bounds.Size(); i += 4)
+      {
+        const __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        const __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        const __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        const __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+        const __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+        const __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+        const __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (unsigned p = 0; p < 6; ++p)
+        {
+          __m128 distance = _mm_add_ps(_mm_mul_ps(planes[p][0], cx), _mm_mul_ps(planes[p][1], cy));
+          distance = _mm_add_ps(distance, _mm_add_ps(_mm_mul_ps(planes[p][2], cz), planes[p][3]));
+          __m128 boxReach = _mm_add_ps(_mm_mul_ps(absolutes[p][0], ex), _mm_mul_ps(absolutes[p][1], ey));
+          boxReach = _mm_add_ps(boxReach, _mm_mul_ps(absolutes[p][2], ez));
+          const __m128 reach = _mm_min_ps(boxReach, r);
+          inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        visible[i] = mask & 1;
+        visible[i + 1] = (mask >> 1) & 1;
+        visible[i + 2] = (mask >> 2) & 1;
+        visible[i + 3] = (mask >> 3) & 1;
+        visibleCount += visible[i] + visible[i + 1] + visible[i + 2] + visible[i + 3];
+      }
+#endif
+
+      // tail
+      for (; i < bounds.Size(); ++i)
+      {
+        visible[i] = Inside(bounds, i, frustum) ? 1 : 0;
+        visibleCount += visible[i];
+      }
+
+      return visibleCount;
+    }
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Scene
+{
+  // axis aligned box and a sphere around the same center
+  struct Bounds
+  {
+    float center[3];
+    float extents[3];
+    float radius;
+  };
+
+  // normalized planes (nx, ny, nz, d), a point is inside when n.p + d >= 0
+  // left, right, bottom, top, near, far
+  struct Frustum
+  {
+    float planes[6][4];
+  };
+
+  // bounds laid out for the culling kernel
+  struct BoundsList
+  {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    std::vector<float> radius;
+
+    size_t Size() const { return centerX.size(); }
+    void Clear();
+    void Push(const Bounds& bounds);
+    void Set(size_t index, const Bounds& bounds);
+    void Resize(size_t size);
+  };
+
+  namespace FrustumCulling
+  {
+    // from a view projection matrix for row vectors (v * M, DirectXMath layout), depth in [0, 1]
+    Frustum ExtractPlanes(const float viewProjection[16]);
+
+    // bounds of points, positions are strided in bytes
+    Bounds ComputeBounds(const float* positions, size_t stride, size_t count);
+    // bounds after a row vector transform, scale is the largest axis scale of it
+    Bounds TransformBounds(const Bounds& bounds, const float matrix[16], float scale);
+    // bounds around both
+    Bounds MergeBounds(const Bounds& a, const Bounds& b);
+
+    // writes 1 to visible for every bounds that may be inside, 0 otherwise, returns the visible count
+    // a bounds is out when its sphere or its box is fully behind one plane, SSE2 for 4 bounds at once
+    size_t Cull(const BoundsList& bounds, const Frustum& frustum, uint8_t* visible);
+    // scalar version, reference for the kernel
+    size_t CullScalar(const BoundsList& bounds, const Frustum& frustum, uint8_t* visible);
+  }
+}
@@ -0,0 +1,84 @@
+#include "stdafx.h"
+#include "IndexSplitter.h"
+
+#include <stdexcept>
+
+namespace Scene
+{
+  namespace IndexSplitter
+  {
+    SplitIndices Split(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+    {
+      if (indexCount % 3 != 0)
+        throw std::invalid_argument("[INDEX_SPLITTER] NOT A TRIANGLE LIST!");
+
+      SplitIndices output;
+      output.indices.resize(indexCount);
+
+      // fits as it is
+      if (vertexCount <= MaxRangeVertices)
+      {
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+          if (indices[i] >= vertexCount)
+            throw std::out_of_range("[INDEX_SPLITTER] INDEX OUT OF RANGE!");
+          output.indices[i] = static_cast<uint16_t>(indices[i]);
+        }
+        output.ranges.push_back({ 0, static_cast<uint32_t>(indexCount), 0 });
+        return output;
+      }
+
+      const uint32_t unassigned = ~0u;
+      // where a source vertex went in the current range
+      std::vector<uint32_t> local(vertexCount, unassigned);
+      IndexRange range = { 0, 0, 0 };
+
+      for (size_t triangle = 0; triangle < indexCount; triangle += 3)
+      {
+        // vertices this triangle adds to the range
+        size_t added = 0;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+          const uint32_t index = indices[triangle + corner];
+          if (index >= vertexCount)
+            throw std::out_of_range("[INDEX_SPLITTER] INDEX OUT OF RANGE!");
+          if (local[index] != unassigned)
+            continue;
+
+          // same vertex twice in a degenerate triangle
+          bool repeated = false;
+          for (size_t previous = 0; previous < corner; ++previous)
+            repeated |= indices[triangle + previous] == index;
+          added += repeated ? 0 : 1;
+        }
+
+        // range full, start a new one
+        const size_t rangeVertices = output.vertexRemap.size() - range.vertexOffset;
+        if (rangeVertices + added > MaxRangeVertices)
+        {
+          output.ranges.push_back(range);
+          for (size_t i = range.vertexOffset; i < output.vertexRemap.size(); ++i)
+            local[output.vertexRemap[i]] = unassigned;
+          range = { static_cast<uint32_t>(triangle), 0, static_cast<uint32_t>(output.vertexRemap.size()) };
+        }
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+          const uint32_t index = indices[triangle + corner];
+          if (local[index] == unassigned)
+          {
+            local[index] = static_cast<uint32_t>(output.vertexRemap.size()) - range.vertexOffset;
+            output.vertexRemap.push_back(index);
+          }
+          output.indices[triangle + corner] = static_cast<uint16_t>(local[index]);
+        }
+        range.indexCount += 3;
+      }
+
+      if (range.indexCount > 0)
+        output.ranges.push_back(range);
+
+      return output;
+    }
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Scene
+{
+  // part of a mesh drawn with 16-bit indices, vertexOffset is added to the base vertex
+  struct IndexRange
+  {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t vertexOffset;
+  };
+
+  // triangle list rewritten so every range fits 16-bit indices
+  struct SplitIndices
+  {
+    std::vector<uint16_t> indices;
+    // source vertex of every output vertex, empty when the vertices are used as they are
+    std::vector<uint32_t> vertexRemap;
+    std::vector<IndexRange> ranges;
+  };
+
+  namespace IndexSplitter
+  {
+    // most vertices a range can reference, 0xffff is fine since strip cuts are off
+    static constexpr size_t MaxRangeVertices = 65536;
+
+    // meshes with up to MaxRangeVertices vertices keep their vertex order and get one range,
+    // bigger ones are split in ranges of whole triangles with their own copy of the vertices
+    SplitIndices Split(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+  }
+}
@@ -0,0 +1,350 @@
+#include "stdafx.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// helpers
+namespace
+{
+  // triangles using each vertex, as offsets into one array
+  struct Adjacency
+  {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    Adjacency(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+      : offsets(vertexCount + 1, 0)
+      , triangles(indexCount)
+    {
+      for (size_t i = 0; i < indexCount; ++i)
+        ++offsets[indices[i] + 1];
+      for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+
+      std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+      for (size_t i = 0; i < indexCount; ++i)
+        triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  };
+
+  // FIFO cache, a vertex is cached while less than cacheSize misses happened since it was loaded
+  class FifoCache
+  {
+  public:
+    FifoCache(size_t vertexCount, unsigned cacheSize)
+      : m_loaded(vertexCount, 0)
+      , m_cacheSize(cacheSize)
+      , m_misses(0)
+    {
+    }
+
+    // true on a miss
+    bool Access(uint32_t vertex)
+    {
+      if (m_loaded[vertex] != 0 && m_misses + 1 - m_loaded[vertex] <= m_cacheSize)
+        return false;
+      m_loaded[vertex] = ++m_misses;
+      return true;
+    }
+
+    // forget everything, without clearing the vertices
+    void Flush() { m_misses += m_cacheSize; }
+
+  private:
+    // 1-based miss count when each vertex was loaded, 0 never
+    std::vector<size_t> m_loaded;
+    size_t m_cacheSize;
+    size_t m_misses;
+  };
+
+  void CheckIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+  {
+    if (indexCount % 3 != 0)
+      throw std::invalid_argument("[MESH_OPTIMIZER] NOT A TRIANGLE LIST!");
+    for (size_t i = 0; i < indexCount; ++i)
+      if (indices[i] >= vertexCount)
+        throw std::out_of_range("[MESH_OPTIMIZER] INDEX OUT OF RANGE!");
+  }
+}
+
+namespace Scene
+{
+  namespace MeshOptimizer
+  {
+    VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+    {
+      CheckIndices(indices, indexCount, vertexCount);
+
+      FifoCache cache(vertexCount, cacheSize);
+      std::vector<bool> used(vertexCount, false);
+      size_t misses = 0;
+      size_t usedCount = 0;
+
+      for (size_t i = 0; i < indexCount; ++i)
+      {
+        misses += cache.Access(indices[i]) ? 1 : 0;
+        if (!used[indices[i]])
+        {
+          used[indices[i]] = true;
+          ++usedCount;
+        }
+      }
+
+      VertexCacheStats stats = { 0.0f, 0.0f };
+      if (indexCount > 0)
+      {
+        stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+        stats.atvr = static_cast<float>(misses) / static_cast<float>(usedCount);
+      }
+      return stats;
+    }
+
+    std::vector<uint32_t> OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+    {
+      CheckIndices(indices, indexCount, vertexCount);
+
+      std::vector<uint32_t> clusters;
+      if (indexCount == 0)
+        return clusters;
+
+      const size_t triangleCount = indexCount / 3;
+      Adjacency adjacency(indices, indexCount, vertexCount);
+
+      // triangles left to emit around every vertex
+      std::vector<uint32_t> live(vertexCount);
+      for (size_t v = 0; v < vertexCount; ++v)
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+      // time each vertex entered the cache, time moves on every miss
+      std::vector<size_t> cacheTime(vertexCount, 0);
+      size_t time = cacheSize + 1;
+
+      std::vector<bool> emitted(triangleCount, false);
+      std::vector<uint32_t> deadEnds;
+      std::vector<uint32_t> candidates;
+      std::vector<uint32_t> output;
+      output.reserve(indexCount);
+
+      const uint32_t none = ~0u;
+      uint32_t fanning = 0;
+      // next vertex to look at once the dead ends run out
+      uint32_t cursor = 1;
+
+      clusters.push_back(0);
+
+      while (fanning != none)
+      {
+        candidates.clear();
+
+        // emit every triangle around the fanning vertex
+        for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; ++a)
+        {
+          const uint32_t triangle = adjacency.triangles[a];
+          if (emitted[triangle])
+            continue;
+
+          for (unsigned corner = 0; corner < 3; ++corner)
+          {
+            const uint32_t v = indices[triangle * 3 + corner];
+            output.push_back(v);
+            deadEnds.push_back(v);
+            candidates.push_back(v);
+            --live[v];
+            if (time - cacheTime[v] > cacheSize)
+              cacheTime[v] = time++;
+          }
+          emitted[triangle] = true;
+        }
+
+        // best candidate still in the cache after its remaining triangles are emitted
+        uint32_t next = none;
+        size_t best = 0;
+        for (uint32_t v : candidates)
+        {
+          if (live[v] == 0)
+            continue;
+
+          size_t priority = 0;
+          if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+            priority = time - cacheTime[v];
+          if (next == none || priority > best)
+          {
+            best = priority;
+            next = v;
+          }
+        }
+
+        if (next == none)
+        {
+          // dead end, last emitted vertices first, then the input order
+          while (!deadEnds.empty() && next == none)
+          {
+            const uint32_t v = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[v] > 0)
+              next = v;
+          }
+          while (next == none && cursor < vertexCount)
+          {
+            if (live[cursor] > 0)
+              next = cursor;
+            ++cursor;
+          }
+
+          const uint32_t emittedTriangles = static_cast<uint32_t>(output.size() / 3);
+          if (next != none && emittedTriangles > clusters.back())
+            clusters.push_back(emittedTriangles);
+        }
+
+        fanning = next;
+      }
+
+      std::copy(output.begin(), output.end(), indices);
+      return clusters;
+    }
+
+    void OptimizeOverdraw(
+      uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount,
+      const std::vector<uint32_t>& clusters, float threshold, unsigned cacheSize)
+    {
+      CheckIndices(indices, indexCount, vertexCount);
+
+      const size_t triangleCount = indexCount / 3;
+      if (triangleCount == 0 || clusters.empty())
+        return;
+
+      auto position = [positions, stride](uint32_t v)
+      {
+        return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + stride * v);
+      };
+
+      // split the clusters again wherever a cache flush would cost little
+      const float meshAcmr = AnalyzeVertexCache(indices, indexCount, vertexCount, cacheSize).acmr;
+      std::vector<uint32_t> splits;
+      {
+        FifoCache cache(vertexCount, cacheSize);
+        size_t hard = 0;
+        size_t start = 0;
+        size_t misses = 0;
+
+        for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+          const bool hardBoundary = hard < clusters.size() && clusters[hard] == triangle;
+          if (hardBoundary)
+            ++hard;
+
+          if (hardBoundary || (triangle > start && misses <= threshold * meshAcmr * (triangle - start)))
+          {
+            splits.push_back(static_cast<uint32_t>(triangle));
+            cache.Flush();
+            start = triangle;
+            misses = 0;
+          }
+
+          for (unsigned corner = 0; corner < 3; ++corner)
+            misses += cache.Access(indices[triangle * 3 + corner]) ? 1 : 0;
+        }
+      }
+
+      // mesh centroid, area weighted
+      float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+      float meshArea = 0.0f;
+
+      struct Cluster
+      {
+        uint32_t begin;
+        uint32_t end;
+        float centroid[3];
+        float normal[3];
+        float area;
+        float sortKey;
+      };
+      std::vector<Cluster> sorted(splits.size());
+
+      for (size_t c = 0; c < splits.size(); ++c)
+      {
+        Cluster& cluster = sorted[c];
+        cluster = {};
+        cluster.begin = splits[c];
+        cluster.end = c + 1 < splits.size() ? splits[c + 1] : static_cast<uint32_t>(triangleCount);
+
+        for (uint32_t triangle = cluster.begin; triangle < cluster.end; ++triangle)
+        {
+          const float* p0 = position(indices[triangle * 3 + 0]);
+          const float* p1 = position(indices[triangle * 3 + 1]);
+          const float* p2 = position(indices[triangle * 3 + 2]);
+
+          const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+          const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+          // twice the area weighted normal
+          const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+          const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+          for (unsigned axis = 0; axis < 3; ++axis)
+          {
+            cluster.centroid[axis] += (p0[axis] + p1[axis] + p2[axis]) / 3.0f * area;
+            cluster.normal[axis] += n[axis];
+          }
+          cluster.area += area;
+        }
+
+        for (unsigned axis = 0; axis < 3; ++axis)
+          meshCentroid[axis] += cluster.centroid[axis];
+        meshArea += cluster.area;
+
+        if (cluster.area > 0.0f)
+          for (unsigned axis = 0; axis < 3; ++axis)
+            cluster.centroid[axis] /= cluster.area;
+      }
+
+      if (meshArea > 0.0f)
+        for (unsigned axis = 0; axis < 3; ++axis)
+          meshCentroid[axis] /= meshArea;
+
+      // clusters pointing away from the center are likely to hide the others, draw them first
+      for (Cluster& cluster : sorted)
+      {
+        const float length = std::sqrt(
+          cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+        cluster.sortKey = 0.0f;
+        if (length > 0.0f)
+          for (unsigned axis = 0; axis < 3; ++axis)
+            cluster.sortKey += (cluster.centroid[axis] - meshCentroid[axis]) * cluster.normal[axis] / length;
+      }
+
+      std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+      std::vector<uint32_t> output;
+      output.reserve(indexCount);
+      for (const Cluster& cluster : sorted)
+        output.insert(output.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+
+      std::copy(output.begin(), output.end(), indices);
+    }
+
+    std::vector<uint32_t> OptimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount)
+    {
+      CheckIndices(indices, indexCount, vertexCount);
+
+      const uint32_t unassigned = ~0u;
+      std::vector<uint32_t> remap(vertexCount, unassigned);
+      std::vector<uint32_t> sources;
+      sources.reserve(vertexCount);
+
+      for (size_t i = 0; i < indexCount; ++i)
+      {
+        uint32_t& target = remap[indices[i]];
+        if (target == unassigned)
+        {
+          target = static_cast<uint32_t>(sources.size());
+          sources.push_back(indices[i]);
+        }
+        indices[i] = target;
+      }
+
+      return sources;
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Scene
+{
+  // FIFO post-transform cache simulation, lower is better
+  // acmr: vertices transformed per triangle (0.5 at best, 3 at worst)
+  // atvr: vertices transformed per vertex used (1 at best)
+  struct VertexCacheStats
+  {
+    float acmr;
+    float atvr;
+  };
+
+  // Import time reordering of triangle lists, CPU only.
+  // The passes are meant to run in order: vertex cache, overdraw, vertex fetch.
+  namespace MeshOptimizer
+  {
+    // cache size Tipsify targets, and the one the stats are measured with
+    static constexpr unsigned CacheSize = 16;
+    // clusters are split while their acmr stays under threshold * mesh acmr
+    static constexpr float OverdrawThreshold = 1.05f;
+
+    VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = CacheSize);
+
+    // Tipsify (Sander et al. 2007), reorders triangles in place
+    // returns the first triangle of every cluster the overdraw pass can move around
+    // (where the walk hit a dead end)
+    std::vector<uint32_t> OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = CacheSize);
+
+    // splits clusters where it costs little in cache misses and sorts them so the ones
+    // facing out of the mesh come first, positions are strided in bytes
+    void OptimizeOverdraw(
+      uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount,
+      const std::vector<uint32_t>& clusters, float threshold = OverdrawThreshold, unsigned cacheSize = CacheSize);
+
+    // renumbers vertices in the order they are first used, drops unused ones
+    // rewrites the indices and returns the source vertex of every new vertex
+    std::vector<uint32_t> OptimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    template<typename Vertex>
+    void RemapVertices(const std::vector<uint32_t>& sources, std::vector<Vertex>& vertices)
+    {
+      std::vector<Vertex> remapped(sources.size());
+      for (size_t i = 0; i < remapped.size(); ++i)
+        remapped[i] = vertices[sources[i]];
+      vertices.swap(remapped);
+    }
+  }
+}
@@ -0,0 +1,523 @@
+#include "stdafx.h"
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// helpers
+namespace
+{
+  // symmetric 4x4 plane quadric and the area it was built from
+  struct Quadric
+  {
+    double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+    double weight;
+
+    void AddPlane(double a, double b, double c, double d, double area)
+    {
+      a2 += a * a * area;
+      b2 += b * b * area;
+      c2 += c * c * area;
+      ab += a * b * area;
+      ac += a * c * area;
+      bc += b * c * area;
+      ad += a * d * area;
+      bd += b * d * area;
+      cd += c * d * area;
+      d2 += d * d * area;
+      weight += area;
+    }
+
+    void Add(const Quadric& other)
+    {
+      a2 += other.a2;
+      b2 += other.b2;
+      c2 += other.c2;
+      ab += other.ab;
+      ac += other.ac;
+      bc += other.bc;
+      ad += other.ad;
+      bd += other.bd;
+      cd += other.cd;
+      d2 += other.d2;
+      weight += other.weight;
+    }
+
+    // mean squared distance to the planes
+    double Error(const float* p) const
+    {
+      const double x = p[0];
+      const double y = p[1];
+      const double z = p[2];
+      const double sum = a2 * x * x + b2 * y * y + c2 * z * z
+        + 2.0 * (ab * x * y + ac * x * z + bc * y * z)
+        + 2.0 * (ad * x + bd * y + cd * z) + d2;
+      return weight > 0.0 ? std::fabs(sum) / weight : 0.0;
+    }
+  };
+
+  struct Collapse
+  {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+  };
+
+  // closest point on the triangle by Voronoi region (Ericson, Real-Time Collision Detection 5.1.5)
+  double PointTriangleDistanceSquared(const float* point, const float* a, const float* b, const float* c)
+  {
+    double ab[3], ac[3], ap[3];
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      ab[axis] = double(b[axis]) - a[axis];
+      ac[axis] = double(c[axis]) - a[axis];
+      ap[axis] = double(point[axis]) - a[axis];
+    }
+    auto dot = [](const double* x, const double* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+
+    double closest[3];
+    auto along = [&closest](const float* origin, const double* direction, double t)
+    {
+      for (unsigned axis = 0; axis < 3; ++axis)
+        closest[axis] = origin[axis] + direction[axis] * t;
+    };
+
+    const double d1 = dot(ab, ap);
+    const double d2 = dot(ac, ap);
+    double bp[3], cp[3];
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      bp[axis] = double(point[axis]) - b[axis];
+      cp[axis] = double(point[axis]) - c[axis];
+    }
+    const double d3 = dot(ab, bp);
+    const double d4 = dot(ac, bp);
+    const double d5 = dot(ab, cp);
+    const double d6 = dot(ac, cp);
+    const double va = d3 * d6 - d5 * d4;
+    const double vb = d5 * d2 - d1 * d6;
+    const double vc = d1 * d4 - d3 * d2;
+
+    if (d1 <= 0.0 && d2 <= 0.0)
+      along(a, ab, 0.0);
+    else if (d3 >= 0.0 && d4 <= d3)
+      along(b, ab, 0.0);
+    else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+      along(a, ab, d1 / (d1 - d3));
+    else if (d6 >= 0.0 && d5 <= d6)
+      along(c, ab, 0.0);
+    else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+      along(a, ac, d2 / (d2 - d6));
+    else if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+    {
+      const double bc[3] = { double(c[0]) - b[0], double(c[1]) - b[1], double(c[2]) - b[2] };
+      along(b, bc, (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    else
+    {
+      // inside, degenerate triangles never get here since one of the edge cases matches
+      const double denominator = 1.0 / (va + vb + vc);
+      for (unsigned axis = 0; axis < 3; ++axis)
+        closest[axis] = a[axis] + ab[axis] * vb * denominator + ac[axis] * vc * denominator;
+    }
+
+    const double offset[3] = { point[0] - closest[0], point[1] - closest[1], point[2] - closest[2] };
+    return dot(offset, offset);
+  }
+}
+
+namespace Scene
+{
+  namespace MeshSimplifier
+  {
+    SimplifiedMesh Simplify(
+      const uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount,
+      size_t targetIndexCount, float targetError)
+    {
+      if (indexCount % 3 != 0)
+        throw std::invalid_argument("[MESH_SIMPLIFIER] NOT A TRIANGLE LIST!");
+      for (size_t i = 0; i < indexCount; ++i)
+        if (indices[i] >= vertexCount)
+          throw std::out_of_range("[MESH_SIMPLIFIER] INDEX OUT OF RANGE!");
+
+      auto position = [positions, stride](uint32_t v)
+      {
+        return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + stride * v);
+      };
+
+      SimplifiedMesh output = { std::vector<uint32_t>(indices, indices + indexCount), 0.0f };
+      if (vertexCount == 0)
+        return output;
+
+      // vertices sharing a position get the first one as canonical vertex
+      std::vector<uint32_t> canonical(vertexCount);
+      std::vector<bool> locked(vertexCount, false);
+      {
+        std::vector<uint32_t> order(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+          order[v] = v;
+        auto less = [&position](uint32_t a, uint32_t b)
+        {
+          const int compare = memcmp(position(a), position(b), sizeof(float) * 3);
+          return compare != 0 ? compare < 0 : a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        for (size_t i = 0; i < vertexCount;)
+        {
+          size_t end = i + 1;
+          while (end < vertexCount && memcmp(position(order[i]), position(order[end]), sizeof(float) * 3) == 0)
+            ++end;
+          for (size_t j = i; j < end; ++j)
+          {
+            canonical[order[j]] = order[i];
+            // attribute seam
+            locked[order[j]] = end - i > 1;
+          }
+          i = end;
+        }
+      }
+
+      // lock border and non manifold edges, counted on canonical vertices
+      {
+        std::vector<uint64_t> edges;
+        edges.reserve(indexCount);
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+          for (unsigned corner = 0; corner < 3; ++corner)
+          {
+            uint64_t a = canonical[indices[i + corner]];
+            uint64_t b = canonical[indices[i + (corner + 1) % 3]];
+            if (a == b)
+              continue;
+            edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+          }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        for (size_t i = 0; i < edges.size();)
+        {
+          size_t end = i + 1;
+          while (end < edges.size() && edges[end] == edges[i])
+            ++end;
+          if (end - i != 2)
+          {
+            locked[static_cast<uint32_t>(edges[i] >> 32)] = true;
+            locked[static_cast<uint32_t>(edges[i] & 0xffffffffu)] = true;
+          }
+          i = end;
+        }
+
+        // canonical vertices carry the lock of the whole group
+        for (uint32_t v = 0; v < vertexCount; ++v)
+          if (locked[v])
+            locked[canonical[v]] = true;
+        for (uint32_t v = 0; v < vertexCount; ++v)
+          locked[v] = locked[canonical[v]];
+      }
+
+      // plane quadrics, per canonical vertex
+      std::vector<Quadric> quadrics(vertexCount, Quadric{});
+      for (size_t i = 0; i < indexCount; i += 3)
+      {
+        const float* p0 = position(indices[i]);
+        const float* p1 = position(indices[i + 1]);
+        const float* p2 = position(indices[i + 2]);
+        const double e1[3] = { double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2] };
+        const double e2[3] = { double(p2[0]) - p0[0], double(p2[1]) - p0[1], double(p2[2]) - p0[2] };
+        double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length <= 0.0)
+          continue;
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        const double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for (unsigned corner = 0; corner < 3; ++corner)
+          quadrics[canonical[indices[i + corner]]].AddPlane(n[0], n[1], n[2], d, length * 0.5);
+      }
+
+      const double errorLimit = double(targetError) * double(targetError);
+      double maxError = 0.0;
+      std::vector<uint32_t>& current = output.indices;
+      std::vector<uint32_t> remap(vertexCount);
+      std::vector<bool> touched(vertexCount);
+      std::vector<uint32_t> offsets(vertexCount + 1);
+      std::vector<uint32_t> adjacency;
+      std::vector<Collapse> collapses;
+      // vertex every removed vertex was moved onto
+      std::vector<uint32_t> collapsedTo(vertexCount);
+      for (uint32_t v = 0; v < vertexCount; ++v)
+        collapsedTo[v] = v;
+
+      // passes of independent collapses, cheapest first
+      while (current.size() > targetIndexCount)
+      {
+        const size_t triangleCount = current.size() / 3;
+
+        // triangles around every vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t v : current)
+          ++offsets[v + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+          offsets[v + 1] += offsets[v];
+        adjacency.resize(current.size());
+        {
+          std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+          for (size_t i = 0; i < current.size(); ++i)
+            adjacency[cursor[current[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+          for (unsigned corner = 0; corner < 3; ++corner)
+          {
+            const uint32_t a = current[i + corner];
+            const uint32_t b = current[i + (corner + 1) % 3];
+            Quadric quadric = quadrics[canonical[a]];
+            quadric.Add(quadrics[canonical[b]]);
+            if (!locked[a])
+              collapses.push_back({ a, b, quadric.Error(position(b)) });
+            if (!locked[b])
+              collapses.push_back({ b, a, quadric.Error(position(a)) });
+          }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y)
+          {
+            if (x.cost != y.cost)
+              return x.cost < y.cost;
+            return x.from != y.from ? x.from < y.from : x.to < y.to;
+          });
+
+        for (uint32_t v = 0; v < vertexCount; ++v)
+          remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t removed = 0;
+        size_t applied = 0;
+        for (const Collapse& collapse : collapses)
+        {
+          if (collapse.cost > errorLimit || (triangleCount - removed) * 3 <= targetIndexCount)
+            break;
+          if (touched[collapse.from] || touched[collapse.to])
+            continue;
+
+          // moving the vertex must not flip any triangle left around it
+          const float* target = position(collapse.to);
+          bool flips = false;
+          size_t collapsing = 0;
+          for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; ++a)
+          {
+            const uint32_t* triangle = &current[adjacency[a] * 3];
+            if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+            {
+              ++collapsing;
+              continue;
+            }
+
+            const float* p[3] = { position(triangle[0]), position(triangle[1]), position(triangle[2]) };
+            double before[3];
+            double after[3];
+            for (unsigned pass = 0; pass < 2; ++pass)
+            {
+              const float* q[3] = { p[0], p[1], p[2] };
+              if (pass == 1)
+                for (unsigned corner = 0; corner < 3; ++corner)
+                  q[corner] = triangle[corner] == collapse.from ? target : q[corner];
+              const double e1[3] = { double(q[1][0]) - q[0][0], double(q[1][1]) - q[0][1], double(q[1][2]) - q[0][2] };
+              const double e2[3] = { double(q[2][0]) - q[0][0], double(q[2][1]) - q[0][1], double(q[2][2]) - q[0][2] };
+              double* n = pass == 0 ? before : after;
+              n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+              n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+              n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            }
+            flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0;
+          }
+          if (flips)
+            continue;
+
+          remap[collapse.from] = collapse.to;
+          collapsedTo[collapse.from] = collapse.to;
+          quadrics[canonical[collapse.to]].Add(quadrics[canonical[collapse.from]]);
+          maxError = collapse.cost > maxError ? collapse.cost : maxError;
+          removed += collapsing;
+          ++applied;
+
+          // the neighbourhood changed, wait for the next pass
+          for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; ++a)
+            for (unsigned corner = 0; corner < 3; ++corner)
+              touched[current[adjacency[a] * 3 + corner]] = true;
+        }
+
+        if (applied == 0)
+          break;
+
+        // apply and drop the degenerate triangles
+        size_t write = 0;
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+          const uint32_t a = remap[current[i]];
+          const uint32_t b = remap[current[i + 1]];
+          const uint32_t c = remap[current[i + 2]];
+          if (a == b || b == c || a == c)
+            continue;
+          current[write++] = a;
+          current[write++] = b;
+          current[write++] = c;
+        }
+        current.resize(write);
+      }
+
+      // the quadrics are averaged over the planes and underestimate, the reported error is measured
+      // instead: largest distance of an input vertex to the simplified surface
+      output.error = static_cast<float>(std::sqrt(maxError));
+      if (current.empty() || current.size() == indexCount)
+        return output;
+
+      std::fill(offsets.begin(), offsets.end(), 0);
+      for (uint32_t v : current)
+        ++offsets[v + 1];
+      for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+      adjacency.resize(current.size());
+      {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < current.size(); ++i)
+          adjacency[cursor[current[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+
+      // simplified triangles in a uniform grid, about one per cell, in every cell their bounds overlap
+      const size_t triangleCount = current.size() / 3;
+      double low[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+      double high[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+      for (uint32_t v : current)
+      {
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+          low[axis] = (std::min)(low[axis], double(position(v)[axis]));
+          high[axis] = (std::max)(high[axis], double(position(v)[axis]));
+        }
+      }
+      const double largest = (std::max)({ high[0] - low[0], high[1] - low[1], high[2] - low[2] });
+      const double cellSize = largest > 0.0 ? largest / (std::max)(1.0, std::cbrt(double(triangleCount))) : 1.0;
+      int resolution[3];
+      for (unsigned axis = 0; axis < 3; ++axis)
+        resolution[axis] = std::clamp(static_cast<int>((high[axis] - low[axis]) / cellSize) + 1, 1, 1024);
+      auto cell = [&](double value, unsigned axis)
+      {
+        return std::clamp(static_cast<int>((value - low[axis]) / cellSize), 0, resolution[axis] - 1);
+      };
+      auto cellRange = [&](const double* minimum, const double* maximum, int* begin, int* end)
+      {
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+          begin[axis] = cell(minimum[axis], axis);
+          end[axis] = cell(maximum[axis], axis) + 1;
+        }
+      };
+      auto triangleCells = [&](size_t triangle, int* begin, int* end)
+      {
+        double minimum[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+        double maximum[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+          for (unsigned axis = 0; axis < 3; ++axis)
+          {
+            minimum[axis] = (std::min)(minimum[axis], double(position(current[triangle * 3 + corner])[axis]));
+            maximum[axis] = (std::max)(maximum[axis], double(position(current[triangle * 3 + corner])[axis]));
+          }
+        }
+        cellRange(minimum, maximum, begin, end);
+      };
+
+      std::vector<uint32_t> cellOffsets(size_t(resolution[0]) * resolution[1] * resolution[2] + 1, 0);
+      std::vector<uint32_t> cellTriangles;
+      for (unsigned pass = 0; pass < 2; ++pass)
+      {
+        std::vector<uint32_t> cursor;
+        if (pass == 1)
+        {
+          for (size_t c = 1; c < cellOffsets.size(); ++c)
+            cellOffsets[c] += cellOffsets[c - 1];
+          cellTriangles.resize(cellOffsets.back());
+          cursor.assign(cellOffsets.begin(), cellOffsets.end() - 1);
+        }
+
+        for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+          int begin[3], end[3];
+          triangleCells(triangle, begin, end);
+          for (int z = begin[2]; z < end[2]; ++z)
+            for (int y = begin[1]; y < end[1]; ++y)
+              for (int x = begin[0]; x < end[0]; ++x)
+              {
+                const size_t c = (size_t(z) * resolution[1] + y) * resolution[0] + x;
+                if (pass == 0)
+                  ++cellOffsets[c + 1];
+                else
+                  cellTriangles[cursor[c]++] = static_cast<uint32_t>(triangle);
+              }
+        }
+      }
+
+      double measured = 0.0;
+      std::fill(touched.begin(), touched.end(), false);
+      for (size_t i = 0; i < indexCount; ++i)
+      {
+        const uint32_t vertex = indices[i];
+        if (touched[vertex] || offsets[vertex + 1] > offsets[vertex])
+          continue;
+        touched[vertex] = true;
+
+        const float* point = position(vertex);
+        double closest = DBL_MAX;
+        auto distance = [&](uint32_t triangle)
+        {
+          const uint32_t* corners = &current[triangle * 3];
+          closest = (std::min)(closest, PointTriangleDistanceSquared(point, position(corners[0]), position(corners[1]), position(corners[2])));
+        };
+
+        // the triangles around the vertex it ended on give a first guess, usually close
+        uint32_t last = vertex;
+        while (collapsedTo[last] != last)
+          last = collapsedTo[last];
+        for (uint32_t a = offsets[last]; a < offsets[last + 1]; ++a)
+          distance(adjacency[a]);
+
+        // then every cell a closer triangle can be in
+        const double radius = closest < DBL_MAX ? std::sqrt(closest) : largest + cellSize;
+        const double minimum[3] = { point[0] - radius, point[1] - radius, point[2] - radius };
+        const double maximum[3] = { point[0] + radius, point[1] + radius, point[2] + radius };
+        int begin[3], end[3];
+        cellRange(minimum, maximum, begin, end);
+        for (int z = begin[2]; z < end[2]; ++z)
+          for (int y = begin[1]; y < end[1]; ++y)
+            for (int x = begin[0]; x < end[0]; ++x)
+            {
+              const size_t c = (size_t(z) * resolution[1] + y) * resolution[0] + x;
+              for (uint32_t t = cellOffsets[c]; t < cellOffsets[c + 1]; ++t)
+                distance(cellTriangles[t]);
+            }
+
+        measured = (std::max)(measured, closest);
+      }
+
+      output.error = static_cast<float>(std::sqrt(measured));
+      return output;
+    }
+
+    size_t SelectLevel(const float* levelErrors, size_t levelCount, size_t currentLevel, float errorScale, float pixelError, float hysteresis)
+    {
+      size_t level = currentLevel < levelCount ? currentLevel : levelCount - 1;
+      while (level > 0 && levelErrors[level] * errorScale > pixelError)
+        --level;
+      while (level + 1 < levelCount && levelErrors[level + 1] * errorScale < pixelError * hysteresis)
+        ++level;
+      return level;
+    }
+  }
+}
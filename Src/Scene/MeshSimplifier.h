@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Scene
+{
+  struct SimplifiedMesh
+  {
+    // indexes the same vertices as the input, only vertices get removed
+    std::vector<uint32_t> indices;
+    // bound of the distance of the input vertices to the simplified surface, in mesh units
+    float error;
+  };
+
+  // Quadric error edge collapse (Garland and Heckbert), CPU only.
+  // Collapses move a vertex onto one of its neighbours, so every level can share
+  // the vertex buffer of the full mesh. Vertices on borders and attribute seams
+  // (several vertices at the same position) are kept, so the mesh doesn't crack.
+  namespace MeshSimplifier
+  {
+    // stops at targetIndexCount or before a collapse would cost more than targetError,
+    // the cost being the quadric estimate, error is measured once done and can be higher
+    // positions are strided in bytes
+    SimplifiedMesh Simplify(
+      const uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount,
+      size_t targetIndexCount, float targetError);
+
+    // level of detail to draw after currentLevel, levelErrors in mesh units and growing with the level
+    // errorScale turns them into pixels, world scale * pixel scale / distance
+    // finer as soon as the error shows, coarser only once it is under pixelError * hysteresis
+    size_t SelectLevel(const float* levelErrors, size_t levelCount, size_t currentLevel, float errorScale, float pixelError, float hysteresis);
+  }
+}
@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "MeshletBuilder.h"
+
+#include <cmath>
+#include <stdexcept>
+
+// helpers
+namespace
+{
+  struct Float3
+  {
+    float x;
+    float y;
+    float z;
+  };
+
+  Float3 Sub(const Float3& a, const Float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+  float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+  Float3 Cross(const Float3& a, const Float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+  // Ritter's bounding sphere
+  void ComputeSphere(const std::vector<Float3>& points, Scene::Meshlet& meshlet)
+  {
+    auto farthest = [&points](const Float3& from)
+    {
+      size_t index = 0;
+      float best = -1.0f;
+      for (size_t i = 0; i < points.size(); ++i)
+      {
+        const Float3 d = Sub(points[i], from);
+        if (Dot(d, d) > best)
+        {
+          best = Dot(d, d);
+          index = i;
+        }
+      }
+      return points[index];
+    };
+
+    const Float3 a = farthest(points[0]);
+    const Float3 b = farthest(a);
+    Float3 center = { (a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, (a.z + b.z) * 0.5f };
+    const Float3 half = Sub(b, center);
+    float radius = std::sqrt(Dot(half, half));
+
+    // grow to take in the points left outside
+    for (const Float3& point : points)
+    {
+      const Float3 d = Sub(point, center);
+      const float distance = std::sqrt(Dot(d, d));
+      if (distance > radius)
+      {
+        const float grown = (radius + distance) * 0.5f;
+        const float shift = (grown - radius) / distance;
+        center = { center.x + d.x * shift, center.y + d.y * shift, center.z + d.z * shift };
+        radius = grown;
+      }
+    }
+
+    meshlet.center[0] = center.x;
+    meshlet.center[1] = center.y;
+    meshlet.center[2] = center.z;
+    meshlet.radius = radius;
+  }
+
+  void ComputeCone(const std::vector<Float3>& normals, Scene::Meshlet& meshlet)
+  {
+    Float3 axis = { 0.0f, 0.0f, 0.0f };
+    for (const Float3& normal : normals)
+      axis = { axis.x + normal.x, axis.y + normal.y, axis.z + normal.z };
+
+    const float length = std::sqrt(Dot(axis, axis));
+    // the normals cancel out, never culled
+    meshlet.coneCutoff = 1.0f;
+    meshlet.coneAxis[0] = 0.0f;
+    meshlet.coneAxis[1] = 0.0f;
+    meshlet.coneAxis[2] = 0.0f;
+    if (length <= 0.0f)
+      return;
+
+    axis = { axis.x / length, axis.y / length, axis.z / length };
+    meshlet.coneAxis[0] = axis.x;
+    meshlet.coneAxis[1] = axis.y;
+    meshlet.coneAxis[2] = axis.z;
+
+    float minimumDot = 1.0f;
+    for (const Float3& normal : normals)
+    {
+      const float d = Dot(axis, normal);
+      minimumDot = d < minimumDot ? d : minimumDot;
+    }
+
+    // spread over 90 degrees, some triangle always faces the camera
+    if (minimumDot <= 0.0f)
+      return;
+
+    // sin of the spread angle, the view direction has to be within 90 - spread of the axis
+    meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+  }
+}
+
+namespace Scene
+{
+  namespace MeshletBuilder
+  {
+    MeshletData Build(const uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount)
+    {
+      if (indexCount % 3 != 0)
+        throw std::invalid_argument("[MESHLET_BUILDER] NOT A TRIANGLE LIST!");
+
+      auto position = [positions, stride](uint32_t v)
+      {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + stride * v);
+        return Float3{ p[0], p[1], p[2] };
+      };
+
+      MeshletData output;
+      output.triangles.reserve(indexCount);
+
+      const uint8_t unassigned = 0xff;
+      // local index of the mesh vertices in the open meshlet
+      std::vector<uint8_t> local(vertexCount, unassigned);
+
+      Meshlet meshlet = {};
+      // for the bounds of the open meshlet
+      std::vector<Float3> points;
+      std::vector<Float3> normals;
+
+      auto close = [&]()
+      {
+        if (meshlet.triangleCount == 0)
+          return;
+
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+          const uint32_t vertex = output.vertices[meshlet.vertexOffset + i];
+          local[vertex] = unassigned;
+          points.push_back(position(vertex));
+        }
+        ComputeSphere(points, meshlet);
+        ComputeCone(normals, meshlet);
+        output.meshlets.push_back(meshlet);
+
+        meshlet = {};
+        meshlet.vertexOffset = static_cast<uint32_t>(output.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(output.triangles.size());
+        points.clear();
+        normals.clear();
+      };
+
+      for (size_t triangle = 0; triangle < indexCount; triangle += 3)
+      {
+        const uint32_t corners[3] = { indices[triangle], indices[triangle + 1], indices[triangle + 2] };
+
+        size_t added = 0;
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+          if (corners[corner] >= vertexCount)
+            throw std::out_of_range("[MESHLET_BUILDER] INDEX OUT OF RANGE!");
+          const bool repeated = (corner > 0 && corners[0] == corners[corner]) || (corner > 1 && corners[1] == corners[corner]);
+          added += local[corners[corner]] == unassigned && !repeated ? 1 : 0;
+        }
+
+        if (meshlet.vertexCount + added > MaxVertices || meshlet.triangleCount + 1 > MaxTriangles)
+          close();
+
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+          uint8_t& index = local[corners[corner]];
+          if (index == unassigned)
+          {
+            index = static_cast<uint8_t>(meshlet.vertexCount++);
+            output.vertices.push_back(corners[corner]);
+          }
+          output.triangles.push_back(index);
+        }
+        ++meshlet.triangleCount;
+
+        // degenerate triangles don't bend the cone
+        const Float3 p0 = position(corners[0]);
+        const Float3 normal = Cross(Sub(position(corners[1]), p0), Sub(position(corners[2]), p0));
+        const float length = std::sqrt(Dot(normal, normal));
+        if (length > 0.0f)
+          normals.push_back({ normal.x / length, normal.y / length, normal.z / length });
+      }
+
+      close();
+
+      return output;
+    }
+  }
+}
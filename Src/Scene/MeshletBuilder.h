@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Scene
+{
+  // small cluster of a mesh, bounds are in mesh space
+  struct Meshlet
+  {
+    // into MeshletData::vertices and MeshletData::triangles (3 entries per triangle)
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    // bounding sphere
+    float center[3];
+    float radius;
+    // normal cone, the meshlet is back facing from camera when
+    // dot(normalize(center - camera), coneAxis) >= coneCutoff + radius / length(center - camera)
+    // coneCutoff is 1 when the normals spread too much to ever cull
+    float coneAxis[3];
+    float coneCutoff;
+  };
+
+  struct MeshletData
+  {
+    std::vector<Meshlet> meshlets;
+    // mesh vertex of every meshlet vertex
+    std::vector<uint32_t> vertices;
+    // meshlet local vertex indices
+    std::vector<uint8_t> triangles;
+  };
+
+  namespace MeshletBuilder
+  {
+    // limits of the usual mesh shader output
+    static constexpr size_t MaxVertices = 64;
+    static constexpr size_t MaxTriangles = 124;
+
+    // walks the triangles in order, a meshlet is closed once the next triangle doesn't fit,
+    // so the result is deterministic and follows the vertex cache order of the indices
+    // positions are strided in bytes
+    MeshletData Build(const uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount);
+  }
+}
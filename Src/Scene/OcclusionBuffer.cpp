@@ -0,0 +1,422 @@
+#include "stdafx.h"
+#include "OcclusionBuffer.h"
+
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define OCCLUSION_BUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+// helpers
+namespace
+{
+  // row vector transform, output = (x, y, z, 1) * matrix
+  void Transform(const float position[3], const float matrix[16], float output[4])
+  {
+    for (unsigned j = 0; j < 4; ++j)
+      output[j] = position[0] * matrix[j] + position[1] * matrix[4 + j] + position[2] * matrix[8 + j] + matrix[12 + j];
+  }
+}
+
+namespace Scene
+{
+  OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+    : m_width(width)
+    , m_height(height)
+    , m_tilesX(width / TileWidth)
+    , m_viewProjection()
+    , m_eye()
+    , m_depth(static_cast<size_t>(width) * height, 1.0f)
+    , m_tiles(static_cast<size_t>(width / TileWidth) * (height / TileHeight), 1.0f)
+    , m_triangles()
+  {
+    if (width == 0 || height == 0 || width % TileWidth != 0 || height % TileHeight != 0)
+      throw std::invalid_argument("[OCCLUSION] SIZE HAS TO BE A MULTIPLE OF THE TILE SIZE!");
+  }
+
+  OcclusionBuffer::~OcclusionBuffer()
+  {
+  }
+
+  void OcclusionBuffer::Clear(const float viewProjection[16], const float eye[3])
+  {
+    std::copy(viewProjection, viewProjection + 16, m_viewProjection);
+    std::copy(eye, eye + 3, m_eye);
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+    std::fill(m_tiles.begin(), m_tiles.end(), 1.0f);
+    m_triangles.clear();
+  }
+
+  void OcclusionBuffer::AddOccluder(const OccluderMesh& mesh, const float world[16])
+  {
+    // simplified triangles can be in front of the mesh by up to its error, they are moved
+    // that far away from the eye so they never hide what the mesh doesn't
+    float scale = 0.0f;
+    for (unsigned row = 0; row < 3; ++row)
+      scale = (std::max)(scale, std::sqrt(world[row * 4] * world[row * 4] + world[row * 4 + 1] * world[row * 4 + 1] + world[row * 4 + 2] * world[row * 4 + 2]));
+    const float offset = mesh.error * scale;
+
+    const size_t vertexCount = mesh.positions.size() / 3;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+      float clip[3][4];
+      bool valid = true;
+      for (unsigned corner = 0; corner < 3; ++corner)
+      {
+        const uint32_t index = mesh.indices[i + corner];
+        valid &= index < vertexCount;
+        if (!valid)
+          continue;
+
+        float position[4];
+        Transform(&mesh.positions[index * 3], world, position);
+        if (offset > 0.0f)
+        {
+          const float direction[3] = { position[0] - m_eye[0], position[1] - m_eye[1], position[2] - m_eye[2] };
+          const float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+          // the eye is on the occluder, the near plane clips it anyway
+          if (length > 0.0f)
+          {
+            for (unsigned j = 0; j < 3; ++j)
+              position[j] += direction[j] * (offset / length);
+          }
+        }
+        Transform(position, m_viewProjection, clip[corner]);
+      }
+      if (valid)
+        AddTriangle(clip);
+    }
+  }
+
+  void OcclusionBuffer::AddTriangle(const float clip[3][4])
+  {
+    // fully outside one side of the frustum, the near plane is clipped below
+    auto allOutside = [&clip](auto outside)
+    {
+      return outside(clip[0]) && outside(clip[1]) && outside(clip[2]);
+    };
+    if (allOutside([](const float* v) { return v[0] > v[3]; }) || allOutside([](const float* v) { return v[0] < -v[3]; }) ||
+      allOutside([](const float* v) { return v[1] > v[3]; }) || allOutside([](const float* v) { return v[1] < -v[3]; }) ||
+      allOutside([](const float* v) { return v[2] > v[3]; }) || allOutside([](const float* v) { return v[2] < 0.0f; }))
+      return;
+
+    // clipped to z >= 0, a triangle becomes up to a quad
+    float polygon[4][4];
+    unsigned count = 0;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+      const float* a = clip[i];
+      const float* b = clip[(i + 1) % 3];
+      if (a[2] >= 0.0f)
+      {
+        std::copy(a, a + 4, polygon[count]);
+        ++count;
+      }
+      if ((a[2] >= 0.0f) != (b[2] >= 0.0f))
+      {
+        const float t = a[2] / (a[2] - b[2]);
+        for (unsigned j = 0; j < 4; ++j)
+          polygon[count][j] = a[j] + (b[j] - a[j]) * t;
+        ++count;
+      }
+    }
+
+    // to pixels, y down
+    float screen[4][3];
+    for (unsigned i = 0; i < count; ++i)
+    {
+      if (polygon[i][3] <= 0.0f)
+        return;
+      const float inverseW = 1.0f / polygon[i][3];
+      screen[i][0] = (polygon[i][0] * inverseW * 0.5f + 0.5f) * m_width;
+      screen[i][1] = (0.5f - polygon[i][1] * inverseW * 0.5f) * m_height;
+      screen[i][2] = polygon[i][2] * inverseW;
+    }
+
+    for (unsigned i = 2; i < count; ++i)
+    {
+      const float triangle[3][3] = {
+        { screen[0][0], screen[0][1], screen[0][2] },
+        { screen[i - 1][0], screen[i - 1][1], screen[i - 1][2] },
+        { screen[i][0], screen[i][1], screen[i][2] } };
+      SetupTriangle(triangle);
+    }
+  }
+
+  void OcclusionBuffer::SetupTriangle(const float screen[3][3])
+  {
+    const float* v[3] = { screen[0], screen[1], screen[2] };
+    float area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[2][0] - v[0][0]) * (v[1][1] - v[0][1]);
+    // both facings are occluders, the nearest one wins anyway
+    if (area < 0.0f)
+    {
+      std::swap(v[1], v[2]);
+      area = -area;
+    }
+    // also drops NaNs and infinities
+    if (!(area > 0.0f) || !(area <= FLT_MAX))
+      return;
+
+    Triangle triangle = {};
+    for (unsigned i = 0; i < 3; ++i)
+    {
+      const float* a = v[i];
+      const float* b = v[(i + 1) % 3];
+      triangle.edges[i][0] = a[1] - b[1];
+      triangle.edges[i][1] = b[0] - a[0];
+      triangle.edges[i][2] = -(triangle.edges[i][0] * a[0] + triangle.edges[i][1] * a[1]);
+      // moved in by half a pixel, the edge is then positive at the center only when the whole pixel is inside
+      triangle.edges[i][2] -= 0.5f * (std::fabs(triangle.edges[i][0]) + std::fabs(triangle.edges[i][1]));
+    }
+
+    // z / w is linear in screen space, moved to the far corner of the pixel so the occluder stays conservative
+    const float dz1 = v[1][2] - v[0][2];
+    const float dz2 = v[2][2] - v[0][2];
+    const float slopeX = (dz1 * (v[2][1] - v[0][1]) - dz2 * (v[1][1] - v[0][1])) / area;
+    const float slopeY = (dz2 * (v[1][0] - v[0][0]) - dz1 * (v[2][0] - v[0][0])) / area;
+    triangle.depth[0] = slopeX;
+    triangle.depth[1] = slopeY;
+    triangle.depth[2] = v[0][2] - slopeX * v[0][0] - slopeY * v[0][1] + 0.5f * (std::fabs(slopeX) + std::fabs(slopeY));
+
+    // pixels whose center may be inside
+    float minimum[2] = { v[0][0], v[0][1] };
+    float maximum[2] = { v[0][0], v[0][1] };
+    for (unsigned i = 1; i < 3; ++i)
+      for (unsigned axis = 0; axis < 2; ++axis)
+      {
+        minimum[axis] = v[i][axis] < minimum[axis] ? v[i][axis] : minimum[axis];
+        maximum[axis] = v[i][axis] > maximum[axis] ? v[i][axis] : maximum[axis];
+      }
+
+    const float size[2] = { static_cast<float>(m_width), static_cast<float>(m_height) };
+    int first[2];
+    int last[2];
+    for (unsigned axis = 0; axis < 2; ++axis)
+    {
+      const float low = std::ceil(minimum[axis] - 0.5f);
+      const float high = std::floor(maximum[axis] - 0.5f);
+      if (high < 0.0f || low > size[axis] - 1.0f || low > high)
+        return;
+      first[axis] = low < 0.0f ? 0 : static_cast<int>(low);
+      last[axis] = high > size[axis] - 1.0f ? static_cast<int>(size[axis]) - 1 : static_cast<int>(high);
+    }
+    triangle.minX = first[0];
+    triangle.minY = first[1];
+    triangle.maxX = last[0];
+    triangle.maxY = last[1];
+
+    m_triangles.push_back(triangle);
+  }
+
+  void OcclusionBuffer::Rasterize(unsigned threadCount)
+  {
+    // bands of whole tile rows, the calling thread takes the first one
+    const uint32_t tileRows = m_height / TileHeight;
+    const uint32_t bandCount = threadCount == 0 ? 1 : (threadCount < tileRows ? threadCount : tileRows);
+    const uint32_t bandRows = (tileRows + bandCount - 1) / bandCount * TileHeight;
+
+    auto band = [this, bandRows](uint32_t index)
+    {
+      const uint32_t firstRow = index * bandRows;
+      const uint32_t endRow = firstRow + bandRows < m_height ? firstRow + bandRows : m_height;
+      if (firstRow >= endRow)
+        return;
+      RasterizeBand(firstRow, endRow);
+      BuildTiles(firstRow, endRow);
+    };
+
+    Core::JobSystem::Instance().ParallelFor(bandCount, 1, [&band](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        band(static_cast<uint32_t>(i));
+    });
+  }
+
+  void OcclusionBuffer::RasterizeScalar()
+  {
+    RasterizeBandScalar(0, m_height);
+    BuildTiles(0, m_height);
+  }
+
+  void OcclusionBuffer::RasterizeBand(uint32_t firstRow, uint32_t endRow)
+  {
+#ifdef OCCLUSION_BUFFER_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 laneCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    for (const Triangle& triangle : m_triangles)
+    {
+      const int rowBegin = triangle.minY > static_cast<int>(firstRow) ? triangle.minY : static_cast<int>(firstRow);
+      const int rowEnd = triangle.maxY < static_cast<int>(endRow) - 1 ? triangle.maxY : static_cast<int>(endRow) - 1;
+      if (rowBegin > rowEnd)
+        continue;
+
+      const __m128 a0 = _mm_set1_ps(triangle.edges[0][0]);
+      const __m128 a1 = _mm_set1_ps(triangle.edges[1][0]);
+      const __m128 a2 = _mm_set1_ps(triangle.edges[2][0]);
+      const __m128 slopeX = _mm_set1_ps(triangle.depth[0]);
+      const __m128 minX = _mm_set1_ps(static_cast<float>(triangle.minX));
+      const __m128 maxX = _mm_set1_ps(static_cast<float>(triangle.maxX));
+      // groups of 4 pixels, the lanes outside the triangle keep their depth
+      const int columnBegin = triangle.minX & ~3;
+
+      for (int y = rowBegin; y <= rowEnd; ++y)
+      {
+        const float centerY = static_cast<float>(y) + 0.5f;
+        const __m128 c0 = _mm_set1_ps(triangle.edges[0][1] * centerY + triangle.edges[0][2]);
+        const __m128 c1 = _mm_set1_ps(triangle.edges[1][1] * centerY + triangle.edges[1][2]);
+        const __m128 c2 = _mm_set1_ps(triangle.edges[2][1] * centerY + triangle.edges[2][2]);
+        const __m128 depthRow = _mm_set1_ps(triangle.depth[1] * centerY + triangle.depth[2]);
+        float* row = &m_depth[static_cast<size_t>(y) * m_width];
+
+        for (int x = columnBegin; x <= triangle.maxX; x += 4)
+        {
+          const __m128 column = _mm_set1_ps(static_cast<float>(x));
+          const __m128 centerX = _mm_add_ps(column, laneCenters);
+          const __m128 pixelX = _mm_add_ps(column, laneOffsets);
+
+          __m128 mask = _mm_and_ps(_mm_cmpge_ps(pixelX, minX), _mm_cmple_ps(pixelX, maxX));
+          mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, centerX), c0), zero));
+          mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, centerX), c1), zero));
+          mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, centerX), c2), zero));
+          if (_mm_movemask_ps(mask) == 0)
+            continue;
+
+          const __m128 depth = _mm_add_ps(_mm_mul_ps(slopeX, centerX), depthRow);
+          const __m128 current = _mm_loadu_ps(row + x);
+          const __m128 nearest = _mm_min_ps(depth, current);
+          _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearest), _mm_andnot_ps(mask, current)));
+        }
+      }
+    }
+#else
+    RasterizeBandScalar(firstRow, endRow);
+#endif
+  }
+
+  void OcclusionBuffer::RasterizeBandScalar(uint32_t firstRow, uint32_t endRow)
+  {
+    // same operations in the same order as the kernel, so both agree exactly
+    for (const Triangle& triangle : m_triangles)
+    {
+      const int rowBegin = triangle.minY > static_cast<int>(firstRow) ? triangle.minY : static_cast<int>(firstRow);
+      const int rowEnd = triangle.maxY < static_cast<int>(endRow) - 1 ? triangle.maxY : static_cast<int>(endRow) - 1;
+
+      for (int y = rowBegin; y <= rowEnd; ++y)
+      {
+        const float centerY = static_cast<float>(y) + 0.5f;
+        const float c0 = triangle.edges[0][1] * centerY + triangle.edges[0][2];
+        const float c1 = triangle.edges[1][1] * centerY + triangle.edges[1][2];
+        const float c2 = triangle.edges[2][1] * centerY + triangle.edges[2][2];
+        const float depthRow = triangle.depth[1] * centerY + triangle.depth[2];
+        float* row = &m_depth[static_cast<size_t>(y) * m_width];
+
+        for (int x = triangle.minX; x <= triangle.maxX; ++x)
+        {
+          const float centerX = static_cast<float>(x) + 0.5f;
+          if (triangle.edges[0][0] * centerX + c0 < 0.0f || triangle.edges[1][0] * centerX + c1 < 0.0f || triangle.edges[2][0] * centerX + c2 < 0.0f)
+            continue;
+
+          const float depth = triangle.depth[0] * centerX + depthRow;
+          row[x] = depth < row[x] ? depth : row[x];
+        }
+      }
+    }
+  }
+
+  void OcclusionBuffer::BuildTiles(uint32_t firstRow, uint32_t endRow)
+  {
+    for (uint32_t tileY = firstRow / TileHeight; tileY < endRow / TileHeight; ++tileY)
+    {
+      for (uint32_t tileX = 0; tileX < m_tilesX; ++tileX)
+      {
+        const float* pixels = &m_depth[static_cast<size_t>(tileY) * TileHeight * m_width + tileX * TileWidth];
+#ifdef OCCLUSION_BUFFER_SSE2
+        __m128 farthest = _mm_loadu_ps(pixels);
+        for (uint32_t y = 0; y < TileHeight; ++y)
+          for (uint32_t x = 0; x < TileWidth; x += 4)
+            farthest = _mm_max_ps(farthest, _mm_loadu_ps(pixels + y * m_width + x));
+        farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+        farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+        m_tiles[tileY * m_tilesX + tileX] = _mm_cvtss_f32(farthest);
+#else
+        float farthest = pixels[0];
+        for (uint32_t y = 0; y < TileHeight; ++y)
+          for (uint32_t x = 0; x < TileWidth; ++x)
+            farthest = pixels[y * m_width + x] > farthest ? pixels[y * m_width + x] : farthest;
+        m_tiles[tileY * m_tilesX + tileX] = farthest;
+#endif
+      }
+    }
+  }
+
+  bool OcclusionBuffer::IsVisible(const Bounds& bounds) const
+  {
+    float minimum[2] = { FLT_MAX, FLT_MAX };
+    float maximum[2] = { -FLT_MAX, -FLT_MAX };
+    float nearest = FLT_MAX;
+    for (unsigned corner = 0; corner < 8; ++corner)
+    {
+      const float position[3] = {
+        bounds.center[0] + ((corner & 1) ? bounds.extents[0] : -bounds.extents[0]),
+        bounds.center[1] + ((corner & 2) ? bounds.extents[1] : -bounds.extents[1]),
+        bounds.center[2] + ((corner & 4) ? bounds.extents[2] : -bounds.extents[2]) };
+      float clip[4];
+      Transform(position, m_viewProjection, clip);
+      // crosses the near plane, can't be hidden
+      if (clip[3] <= 0.0f || clip[2] < 0.0f)
+        return true;
+
+      const float inverseW = 1.0f / clip[3];
+      const float screen[2] = { (clip[0] * inverseW * 0.5f + 0.5f) * m_width, (0.5f - clip[1] * inverseW * 0.5f) * m_height };
+      for (unsigned axis = 0; axis < 2; ++axis)
+      {
+        minimum[axis] = screen[axis] < minimum[axis] ? screen[axis] : minimum[axis];
+        maximum[axis] = screen[axis] > maximum[axis] ? screen[axis] : maximum[axis];
+      }
+      const float depth = clip[2] * inverseW;
+      nearest = depth < nearest ? depth : nearest;
+    }
+
+    // pixels touched by the projected box, off screen is left to frustum culling
+    const float size[2] = { static_cast<float>(m_width), static_cast<float>(m_height) };
+    int first[2];
+    int last[2];
+    for (unsigned axis = 0; axis < 2; ++axis)
+    {
+      const float low = std::floor(minimum[axis]);
+      const float high = std::ceil(maximum[axis]) - 1.0f;
+      if (high < 0.0f || low > size[axis] - 1.0f || low > high)
+        return true;
+      first[axis] = low < 0.0f ? 0 : static_cast<int>(low);
+      last[axis] = high > size[axis] - 1.0f ? static_cast<int>(size[axis]) - 1 : static_cast<int>(high);
+    }
+
+    // tiles whose farthest depth is in front hide their part of the box, the others are looked at per pixel
+    for (int tileY = first[1] / static_cast<int>(TileHeight); tileY <= last[1] / static_cast<int>(TileHeight); ++tileY)
+    {
+      for (int tileX = first[0] / static_cast<int>(TileWidth); tileX <= last[0] / static_cast<int>(TileWidth); ++tileX)
+      {
+        if (m_tiles[tileY * m_tilesX + tileX] < nearest)
+          continue;
+
+        const int rowBegin = tileY * static_cast<int>(TileHeight) > first[1] ? tileY * static_cast<int>(TileHeight) : first[1];
+        const int rowEnd = (tileY + 1) * static_cast<int>(TileHeight) - 1 < last[1] ? (tileY + 1) * static_cast<int>(TileHeight) - 1 : last[1];
+        const int columnBegin = tileX * static_cast<int>(TileWidth) > first[0] ? tileX * static_cast<int>(TileWidth) : first[0];
+        const int columnEnd = (tileX + 1) * static_cast<int>(TileWidth) - 1 < last[0] ? (tileX + 1) * static_cast<int>(TileWidth) - 1 : last[0];
+        for (int y = rowBegin; y <= rowEnd; ++y)
+          for (int x = columnBegin; x <= columnEnd; ++x)
+            if (m_depth[static_cast<size_t>(y) * m_width + x] >= nearest)
+              return true;
+      }
+    }
+
+    return false;
+  }
+}
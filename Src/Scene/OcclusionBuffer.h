@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Scene/FrustumCulling.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Scene
+{
+  // simplified triangles standing in for a mesh in the occlusion buffer, mesh space
+  struct OccluderMesh
+  {
+    // x, y, z
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    // how far the mesh can be from these triangles, mesh units, they are pushed back by it
+    float error = 0.0f;
+  };
+
+  // Low resolution depth buffer for CPU occlusion culling.
+  // Occluders are rasterized with SSE2, 4 pixels at a time, and only the lanes covered by the
+  // triangle are written (masked min). Each tile of pixels then keeps its farthest depth, bounds
+  // are tested against the tiles first and only look at the pixels of tiles that don't hide them.
+  // Rows are split in bands rasterized as jobs, bands don't share pixels.
+  // Coverage is inner conservative, a pixel is only written when the triangle covers all of it
+  // (edges shared by two triangles leave a one pixel crack, the price of never hiding too much).
+  // Depth is z / w of a D3D projection, 0 at the near plane, cleared to the far plane.
+  class OcclusionBuffer
+  {
+  public:
+    static constexpr uint32_t TileWidth = 8;
+    static constexpr uint32_t TileHeight = 4;
+
+    // sizes have to be multiples of the tile size
+    OcclusionBuffer(uint32_t width, uint32_t height);
+    ~OcclusionBuffer();
+
+    // starts a frame, viewProjection is for row vectors (v * M, DirectXMath layout), eye in world space
+    void Clear(const float viewProjection[16], const float eye[3]);
+    // clips and sets up the triangles, world is the row vector transform of the mesh
+    void AddOccluder(const OccluderMesh& mesh, const float world[16]);
+    // rasterizes everything added since Clear and builds the tiles, in threadCount bands run by the job system
+    void Rasterize(unsigned threadCount);
+    // scalar version on the calling thread, reference for the kernel
+    void RasterizeScalar();
+
+    // false only when the world bounds are fully behind what was rasterized
+    bool IsVisible(const Bounds& bounds) const;
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    size_t GetTriangleCount() const { return m_triangles.size(); }
+    // row major, width * height
+    const std::vector<float>& GetDepth() const { return m_depth; }
+    // farthest depth of every tile, row major
+    const std::vector<float>& GetTiles() const { return m_tiles; }
+
+  private:
+    // screen space triangle, counter clockwise once set up
+    struct Triangle
+    {
+      // a * x + b * y + c >= 0 inside, for each edge
+      float edges[3][3];
+      // depth plane, biased to the farthest depth of the pixel
+      float depth[3];
+      // pixels touched, inclusive
+      int minX;
+      int minY;
+      int maxX;
+      int maxY;
+    };
+
+    void AddTriangle(const float clip[3][4]);
+    void SetupTriangle(const float screen[3][3]);
+    void RasterizeBand(uint32_t firstRow, uint32_t endRow);
+    void RasterizeBandScalar(uint32_t firstRow, uint32_t endRow);
+    void BuildTiles(uint32_t firstRow, uint32_t endRow);
+
+  private:
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tilesX;
+    float m_viewProjection[16];
+    float m_eye[3];
+    std::vector<float> m_depth;
+    std::vector<float> m_tiles;
+    std::vector<Triangle> m_triangles;
+
+  private:
+    OcclusionBuffer(const OcclusionBuffer&) = delete;
+    OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+  };
+}
@@ -3,8 +3,11 @@
 
 #include "Utilities/DXApplicationHelper.h"
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <thread>
 
 // json
 #include <json.hpp>
@@ -14,11 +17,25 @@ namespace Scene
 {
   SceneGraph::SceneGraph()
     : m_models()
-    , m_constantBuffer(nullptr)
+    , m_bvh()
+    , m_bvhItems()
+    , m_modelFirstItem()
+    , m_visibleItems()
+    , m_modelVisible()
+    , m_visibleModels()
+    , m_occlusion(OCCLUSION_WIDTH, OCCLUSION_HEIGHT)
+    , m_occluders()
+    , m_occludedCount(0)
+    , m_occlusionOverBudget(false)
+    , m_constantBufferAddress(0)
     , m_camera(nullptr)
-    , m_pCbvDataBegin(nullptr)
     , m_constantBufferData()
     , m_skybox(nullptr)
+    , m_loading()
+    , m_modelCount(0)
+    , m_loadedModels(0)
+    , m_loadStart(std::chrono::high_resolution_clock::now())
+    , m_loadedCallback()
   {
     // TODO: handle errors
     auto configPath = std::filesystem::current_path().string() + "/Resources/configs/Scene.json";
@@ -30,30 +47,24 @@ namespace Scene
     configData.at("Name").get_to(name);
 
     auto objects = configData["Objects"];
+    m_modelCount = objects.size();
 
+    // models import concurrently, each one joins the scene when its jobs are done
     for (auto object : objects)
     {
       std::string path;
       object.at("Path").get_to(path);
-      
-      auto model = new DX12Model();
-      model->LoadModel(path.c_str());
-      m_models.push_back(model);
 
-      // this currently done from application
-      // model->SetupModel(m_context->GetCommandList());
+      auto model = new DX12Model();
+      auto counter = std::make_shared<Core::JobCounter>();
+      model->LoadModelAsync(path, *counter);
+      Core::JobSystem::Instance().RunAfter(*counter, [this, model, counter, path]() {
+        OnModelLoaded(model, *counter, path);
+      }, &m_loading, Core::MainThread);
     }
 
     // create camera
     m_camera = std::make_unique<DX12Camera>(45.0f, 0.5f, 10000.0f);
-    // create the buffer
-    m_constantBuffer = Graphics::ResourceManager::Instance().CreateConstantBufferResource(
-      sizeof(ConstantBufferData), D3D12_HEAP_TYPE_UPLOAD);
-    // Map and initialize the constant buffer. We don't unmap this until the
-    // app closes. Keeping things mapped for the lifetime of the resource is okay.
-    CD3DX12_RANGE readRange(0, 0); // We do not intend to read from this resource on the CPU.
-    Utilities::ThrowIfFailed(m_constantBuffer->resource.Get()->Map(0, &readRange, reinterpret_cast<void**>(&m_pCbvDataBegin)));
-    memcpy(m_pCbvDataBegin, &m_constantBufferData, sizeof(m_constantBufferData));
 
     m_skybox = std::make_unique<DX12Skybox>();
     m_skybox->SetScale(XMFLOAT3(1.0f, 1.0f, 1.0f));
@@ -61,12 +72,18 @@ namespace Scene
 
   SceneGraph::~SceneGraph()
   {
+    // models still loading reference the scene, they join it through main thread jobs
+    while (!m_loading.IsDone())
+    {
+      Core::JobSystem::Instance().RunMainThreadJobs();
+      std::this_thread::yield();
+    }
+
     // delete models
     for (auto model : m_models)
       delete model;
     m_models.clear();
 
-    m_constantBuffer.reset();
     m_camera.reset();
     m_skybox.reset();
   }
@@ -76,13 +93,204 @@ namespace Scene
     m_camera->Update();
     m_skybox->UpdateModel();
 
+    for (auto model : m_models)
+      model->UpdateModel();
+    UpdateBvh();
+
     m_constantBufferData.view = m_camera->GetView();
     m_constantBufferData.projection = m_camera->GetProjection();
-    memcpy(m_pCbvDataBegin, &m_constantBufferData, sizeof(m_constantBufferData));
+
+    // a fresh slice every frame, the GPU may still read last frame's one
+    auto constants = Graphics::ResourceManager::Instance().AllocateConstants(sizeof(m_constantBufferData));
+    memcpy(constants.cpuAddress, &m_constantBufferData, sizeof(m_constantBufferData));
+    m_constantBufferAddress = constants.gpuAddress;
+  }
+
+  void SceneGraph::SetLoadedCallback(std::function<void()> callback)
+  {
+    if (IsLoaded())
+      callback();
+    else
+      m_loadedCallback = std::move(callback);
+  }
+
+  void SceneGraph::OnModelLoaded(DX12Model* model, Core::JobCounter& counter, const std::string& path)
+  {
+    ++m_loadedModels;
+
+    char message[512];
+    try
+    {
+      // rethrows what the loading jobs threw
+      Core::JobSystem::Instance().Wait(counter);
+      m_models.push_back(model);
+      snprintf(message, sizeof(message), "[LOADING] %s loaded, %zu meshes, %zu/%zu models\n",
+        path.c_str(), model->GetMeshCount(), m_loadedModels, m_modelCount);
+    } catch (const std::exception& exception)
+    {
+      delete model;
+      snprintf(message, sizeof(message), "[LOADING] %s failed: %s, %zu/%zu models\n",
+        path.c_str(), exception.what(), m_loadedModels, m_modelCount);
+    }
+    OutputDebugStringA(message);
+
+    if (!IsLoaded())
+      return;
+
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_loadStart).count();
+    snprintf(message, sizeof(message), "[LOADING] scene loaded in %.1f ms\n", milliseconds);
+    OutputDebugStringA(message);
+    if (m_loadedCallback)
+      m_loadedCallback();
   }
 
   const std::vector<DX12Model*>& SceneGraph::GetModels()
   {
     return m_models;
   }
+
+  void SceneGraph::UpdateBvh()
+  {
+    size_t itemCount = 0;
+    for (auto model : m_models)
+      itemCount += model->GetMeshCount();
+
+    // moved models are refitted in place, until the tree got too loose
+    bool rebuild = itemCount != m_bvhItems.size();
+    if (!rebuild)
+    {
+      for (size_t i = 0; i < m_models.size(); ++i)
+      {
+        if (!m_models[i]->ConsumeBoundsChanged())
+          continue;
+
+        for (size_t mesh = 0; mesh < m_models[i]->GetMeshCount(); ++mesh)
+          m_bvh.Update(m_modelFirstItem[i] + static_cast<uint32_t>(mesh), m_models[i]->GetMeshBounds(mesh));
+      }
+      rebuild = m_bvh.GetCost() > BVH_REBUILD_RATIO * m_bvh.GetBuildCost();
+    }
+
+    if (!rebuild)
+      return;
+
+    std::vector<Bounds> bounds;
+    bounds.reserve(itemCount);
+    m_bvhItems.clear();
+    m_modelFirstItem.resize(m_models.size());
+    for (size_t i = 0; i < m_models.size(); ++i)
+    {
+      m_models[i]->ConsumeBoundsChanged();
+      m_modelFirstItem[i] = static_cast<uint32_t>(m_bvhItems.size());
+      for (size_t mesh = 0; mesh < m_models[i]->GetMeshCount(); ++mesh)
+      {
+        m_bvhItems.push_back({ static_cast<uint32_t>(i), static_cast<uint32_t>(mesh) });
+        bounds.push_back(m_models[i]->GetMeshBounds(mesh));
+      }
+    }
+    m_bvh.Build(bounds);
+
+    char message[256];
+    snprintf(message, sizeof(message), "[BVH] built over %zu meshes, %zu nodes\n", m_bvh.GetItemCount(), m_bvh.GetNodeCount());
+    OutputDebugStringA(message);
+  }
+
+  void SceneGraph::CullScene(const Frustum& frustum)
+  {
+    m_visibleItems.clear();
+    m_bvh.QueryFrustum(frustum, m_visibleItems);
+    CullOccluded();
+
+    for (auto model : m_models)
+      model->HideMeshes();
+    m_modelVisible.assign(m_models.size(), 0);
+
+    for (const uint32_t item : m_visibleItems)
+    {
+      const BvhItem& bvhItem = m_bvhItems[item];
+      m_models[bvhItem.model]->ShowMesh(bvhItem.mesh);
+      m_modelVisible[bvhItem.model] = 1;
+    }
+
+    m_visibleModels.clear();
+    for (size_t i = 0; i < m_models.size(); ++i)
+    {
+      if (m_modelVisible[i])
+        m_visibleModels.push_back(m_models[i]);
+    }
+  }
+
+  void SceneGraph::CullOccluded()
+  {
+    const auto start = std::chrono::high_resolution_clock::now();
+    const XMFLOAT3 eye = m_camera->GetPosition();
+
+    m_occluders.clear();
+    for (const uint32_t item : m_visibleItems)
+    {
+      const BvhItem& bvhItem = m_bvhItems[item];
+      if (m_models[bvhItem.model]->GetMesh(bvhItem.mesh).GetOccluder().indices.empty())
+        continue;
+
+      const Bounds bounds = m_models[bvhItem.model]->GetMeshBounds(bvhItem.mesh);
+      const float dx = bounds.center[0] - eye.x;
+      const float dy = bounds.center[1] - eye.y;
+      const float dz = bounds.center[2] - eye.z;
+      const float distanceSquared = dx * dx + dy * dy + dz * dz;
+      const float size = bounds.radius * bounds.radius / (distanceSquared > 1e-4f ? distanceSquared : 1e-4f);
+      if (size >= OCCLUDER_MIN_SIZE * OCCLUDER_MIN_SIZE)
+        m_occluders.push_back({ size, item });
+    }
+    std::sort(m_occluders.begin(), m_occluders.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    m_occlusion.Clear(&m_camera->GetViewProjection()._11, &eye.x);
+    size_t triangles = 0;
+    for (const auto& occluder : m_occluders)
+    {
+      const BvhItem& bvhItem = m_bvhItems[occluder.second];
+      const DX12Model* model = m_models[bvhItem.model];
+      const OccluderMesh& mesh = model->GetMesh(bvhItem.mesh).GetOccluder();
+      if (triangles + mesh.indices.size() / 3 > OCCLUDER_TRIANGLE_BUDGET)
+        continue;
+
+      m_occlusion.AddOccluder(mesh, &model->GetWorld()._11);
+      triangles += mesh.indices.size() / 3;
+    }
+    m_occlusion.Rasterize(OCCLUSION_THREADS);
+
+    // occluders test against themselves too, their depth is never in front of their bounds
+    size_t kept = 0;
+    for (const uint32_t item : m_visibleItems)
+    {
+      const BvhItem& bvhItem = m_bvhItems[item];
+      if (m_occlusion.IsVisible(m_models[bvhItem.model]->GetMeshBounds(bvhItem.mesh)))
+        m_visibleItems[kept++] = item;
+    }
+    m_occludedCount = m_visibleItems.size() - kept;
+    m_visibleItems.resize(kept);
+
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    if (Utilities::FRAME_STATS_ENABLED && (milliseconds > OCCLUSION_BUDGET_MS) != m_occlusionOverBudget)
+    {
+      m_occlusionOverBudget = milliseconds > OCCLUSION_BUDGET_MS;
+      char message[256];
+      snprintf(message, sizeof(message), "[OCCLUSION] %.3f ms for %zu occluder triangles, %s the %.1f ms budget\n",
+        milliseconds, m_occlusion.GetTriangleCount(), m_occlusionOverBudget ? "over" : "back under", OCCLUSION_BUDGET_MS);
+      OutputDebugStringA(message);
+    }
+  }
+
+  bool SceneGraph::Pick(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, PickResult& result) const
+  {
+    const float rayOrigin[3] = { origin.x, origin.y, origin.z };
+    const float rayDirection[3] = { direction.x, direction.y, direction.z };
+    const RayHit hit = m_bvh.Raycast(rayOrigin, rayDirection, maxDistance);
+    if (hit.item == BoundingVolumeHierarchy::InvalidItem)
+      return false;
+
+    const BvhItem& bvhItem = m_bvhItems[hit.item];
+    result.model = m_models[bvhItem.model];
+    result.mesh = bvhItem.mesh;
+    result.distance = hit.distance;
+    return true;
+  }
 }
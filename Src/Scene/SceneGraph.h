@@ -1,17 +1,43 @@
 #pragma once
 
+#include "Core/JobSystem.h"
+
 #include "Scene/DX12Model.h"
 #include "Scene/DX12Camera.h"
 
 #include "Scene/DX12Skybox.h"
+#include "Scene/BoundingVolumeHierarchy.h"
+#include "Scene/OcclusionBuffer.h"
+
+#include <chrono>
+#include <functional>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
 namespace Scene
 {
+  struct PickResult
+  {
+    DX12Model* model;
+    size_t mesh;
+    // along the ray direction, in direction lengths
+    float distance;
+  };
+
   class SceneGraph
   {
+    // the BVH is rebuilt once refits made it this much more costly than when built
+    const float BVH_REBUILD_RATIO = 1.5f;
+    // occlusion buffer size, threads rasterizing it and what it may cost per frame
+    const uint32_t OCCLUSION_WIDTH = 320;
+    const uint32_t OCCLUSION_HEIGHT = 192;
+    const unsigned OCCLUSION_THREADS = 4;
+    const double OCCLUSION_BUDGET_MS = 1.0;
+    // occluders are the visible meshes looking biggest (radius over distance), up to a triangle budget
+    const float OCCLUDER_MIN_SIZE = 0.05f;
+    const size_t OCCLUDER_TRIANGLE_BUDGET = 8192;
+
   public:
     static SceneGraph& Instance()
     {
@@ -20,18 +46,61 @@ namespace Scene
     }
     ~SceneGraph();
 
-    const Graphics::ResourceDescriptor* GetSceneBuffer() { return m_constantBuffer.get(); }
+    D3D12_GPU_VIRTUAL_ADDRESS GetSceneBufferAddress() { return m_constantBufferAddress; }
     DX12Camera* GetCamera() { return m_camera.get(); }
     DX12Skybox* GetSkybox() { return m_skybox.get(); }
 
 
     // temporary
+    // updates the models too, and the BVH over their meshes
     void UpdateScene();
     const std::vector<DX12Model*>& GetModels();
 
+    // sets which meshes are drawn from the BVH and the occlusion buffer, until the next UpdateScene
+    void CullScene(const Frustum& frustum);
+    // models with at least one mesh left by the last CullScene
+    const std::vector<DX12Model*>& GetVisibleModels() const { return m_visibleModels; }
+    size_t GetMeshCount() const { return m_bvhItems.size(); }
+    size_t GetVisibleMeshCount() const { return m_visibleItems.size(); }
+    // inside the frustum but hidden by occluders
+    size_t GetOccludedMeshCount() const { return m_occludedCount; }
+    // closest mesh whose bounds the ray hits, false when there is none
+    bool Pick(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, PickResult& result) const;
+
+    // models load in jobs and join the scene on the main thread once done, between two frames
+    float GetLoadProgress() const { return m_modelCount > 0 ? static_cast<float>(m_loadedModels) / m_modelCount : 1.0f; }
+    bool IsLoaded() const { return m_loadedModels == m_modelCount; }
+    // called on the main thread once every model is done, right away if they already are
+    void SetLoadedCallback(std::function<void()> callback);
+
+  private:
+    // main thread, adds the model to the scene or drops it when its jobs threw
+    void OnModelLoaded(DX12Model* model, Core::JobCounter& counter, const std::string& path);
+    void UpdateBvh();
+    // drops the visible items hidden behind the largest ones
+    void CullOccluded();
+
   private:
     // meshes
     std::vector<DX12Model*> m_models;
+    // one BVH item per mesh of every model, items of a model are contiguous
+    struct BvhItem
+    {
+      uint32_t model;
+      uint32_t mesh;
+    };
+    BoundingVolumeHierarchy m_bvh;
+    std::vector<BvhItem> m_bvhItems;
+    std::vector<uint32_t> m_modelFirstItem;
+    // culling results, kept to reuse the memory
+    std::vector<uint32_t> m_visibleItems;
+    std::vector<uint8_t> m_modelVisible;
+    std::vector<DX12Model*> m_visibleModels;
+    // occlusion culling, occluders are (size, item) sorted by size
+    OcclusionBuffer m_occlusion;
+    std::vector<std::pair<float, uint32_t>> m_occluders;
+    size_t m_occludedCount;
+    bool m_occlusionOverBudget;
 
   private:
     // scene globals
@@ -45,12 +114,17 @@ namespace Scene
     };
     // data
     ConstantBufferData m_constantBufferData;
-    UINT8* m_pCbvDataBegin;
-    // CB resource
-    std::unique_ptr<Graphics::ResourceDescriptor> m_constantBuffer;
+    // this frame's slice of the frame constants
+    D3D12_GPU_VIRTUAL_ADDRESS m_constantBufferAddress;
     // camera and skybox
     std::unique_ptr<DX12Camera> m_camera;
     std::unique_ptr<DX12Skybox> m_skybox;
+    // scene loading, counts the jobs adding the models
+    Core::JobCounter m_loading;
+    size_t m_modelCount;
+    size_t m_loadedModels;
+    std::chrono::high_resolution_clock::time_point m_loadStart;
+    std::function<void()> m_loadedCallback;
 
   private:
     SceneGraph();
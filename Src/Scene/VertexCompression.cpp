@@ -0,0 +1,467 @@
+#include "stdafx.h"
+#include "VertexCompression.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define VERTEX_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+// helpers
+namespace
+{
+  const float* Advance(const float* pointer, size_t stride, size_t index)
+  {
+    return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(pointer) + stride * index);
+  }
+
+  float* Advance(float* pointer, size_t stride, size_t index)
+  {
+    return reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(pointer) + stride * index);
+  }
+
+  float Clamp(float value, float low, float high)
+  {
+    return value < low ? low : (value > high ? high : value);
+  }
+
+  uint16_t QuantizeUnorm16(float value, float minimum, float inverseExtent)
+  {
+    return static_cast<uint16_t>(Clamp((value - minimum) * inverseExtent, 0.0f, 1.0f) * 65535.0f + 0.5f);
+  }
+
+  int16_t QuantizeSnorm16(float value)
+  {
+    return static_cast<int16_t>(std::lround(Clamp(value, -1.0f, 1.0f) * 32767.0f));
+  }
+
+#ifdef VERTEX_COMPRESSION_SSE2
+  // 4 floats to halfs (in the low 16 bits of each lane), round to nearest even,
+  // handles denormals, infinities and NaNs like the scalar version
+  __m128i FloatToHalf4(__m128 value)
+  {
+    const __m128i signMask = _mm_set1_epi32(0x80000000u);
+    // every float >= this is +inf in half
+    const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i nanBit = _mm_set1_epi32(0x200);
+    const __m128i halfInfinity = _mm_set1_epi32(0x7c00);
+    // smallest float that is a normal half
+    const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+    const __m128i denormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    // rebias the exponent and add the rounding bias of the mantissa
+    const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+    const __m128 sign = _mm_and_ps(_mm_castsi128_ps(signMask), value);
+    const __m128 absolute = _mm_xor_ps(value, sign);
+    const __m128i absoluteBits = _mm_castps_si128(absolute);
+
+    const __m128 isNan = _mm_cmpunord_ps(absolute, absolute);
+    const __m128i isRegular = _mm_cmpgt_epi32(halfMax, absoluteBits);
+    const __m128i special = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isNan), nanBit), halfInfinity);
+
+    // denormal result, let the float adder do the rounding
+    const __m128i isDenormal = _mm_cmpgt_epi32(minNormal, absoluteBits);
+    const __m128 denormalSum = _mm_add_ps(absolute, _mm_castsi128_ps(denormalMagic));
+    const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(denormalSum), denormalMagic);
+
+    // normal result, round half to even using the lowest kept mantissa bit
+    const __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absoluteBits, 31 - 13), 31);
+    const __m128i rounded = _mm_sub_epi32(_mm_add_epi32(absoluteBits, normalBias), mantissaOdd);
+    const __m128i normal = _mm_srli_epi32(rounded, 13);
+
+    const __m128i finite = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+    const __m128i joined = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, special));
+
+    return _mm_or_si128(joined, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+  }
+
+  // 4 x int32 in [0, 65535] to uint16 in the low 4 lanes, SSE2 only has a signed pack
+  __m128i PackUnsigned16(__m128i value)
+  {
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(value, bias), _mm_setzero_si128());
+    return _mm_xor_si128(packed, _mm_set1_epi16(static_cast<short>(0x8000)));
+  }
+
+  // lanes of halfs (low 16 bits of each int32) to uint16 in the low 4 lanes
+  __m128i PackHalf16(__m128i value)
+  {
+    // clear the upper bits first, the signed pack would saturate them
+    const __m128i low = _mm_and_si128(value, _mm_set1_epi32(0xffff));
+    return PackUnsigned16(low);
+  }
+
+  __m128 Select(__m128 mask, __m128 a, __m128 b)
+  {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+
+  // halfs in the low 16 bits of each lane to 4 floats, exact like the scalar version
+  __m128 HalfToFloat4(__m128i value)
+  {
+    const __m128i exponentMask = _mm_set1_epi32(0x7c00);
+    const __m128i mantissaMask = _mm_set1_epi32(0x3ff);
+
+    const __m128i sign = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x8000)), 16);
+    const __m128i exponent = _mm_and_si128(value, exponentMask);
+    const __m128i mantissa = _mm_and_si128(value, mantissaMask);
+
+    // normal, rebias the exponent, infinities and NaNs get the float exponent of all ones
+    const __m128i shifted = _mm_slli_epi32(_mm_or_si128(exponent, mantissa), 13);
+    const __m128i isSpecial = _mm_cmpeq_epi32(exponent, exponentMask);
+    const __m128i bias = _mm_add_epi32(_mm_set1_epi32((127 - 15) << 23), _mm_and_si128(isSpecial, _mm_set1_epi32((128 - 16) << 23)));
+    const __m128i normal = _mm_add_epi32(shifted, bias);
+
+    // zero or denormal, the mantissa scaled is exact
+    const __m128i isDenormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+    const __m128i denormal = _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(mantissa), _mm_set1_ps(1.0f / 16777216.0f)));
+
+    const __m128i magnitude = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+    return _mm_castsi128_ps(_mm_or_si128(magnitude, sign));
+  }
+
+  // 4 x 4 transpose, vertices to one register per component and back
+  void Transpose(__m128& a, __m128& b, __m128& c, __m128& d)
+  {
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+  }
+#endif
+}
+
+namespace Scene
+{
+  namespace VertexCompression
+  {
+    VertexDequantization ComputeDequantization(const float* positions, size_t stride, size_t count)
+    {
+      float minimum[3] = { 0.0f, 0.0f, 0.0f };
+      float maximum[3] = { 0.0f, 0.0f, 0.0f };
+
+      if (count > 0)
+      {
+        for (unsigned axis = 0; axis < 3; ++axis)
+          minimum[axis] = maximum[axis] = positions[axis];
+
+        for (size_t i = 1; i < count; ++i)
+        {
+          const float* position = Advance(positions, stride, i);
+          for (unsigned axis = 0; axis < 3; ++axis)
+          {
+            minimum[axis] = position[axis] < minimum[axis] ? position[axis] : minimum[axis];
+            maximum[axis] = position[axis] > maximum[axis] ? position[axis] : maximum[axis];
+          }
+        }
+      }
+
+      VertexDequantization output = {};
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        output.positionMin[axis] = minimum[axis];
+        // flat on this axis, any extent decodes to the minimum
+        output.positionExtent[axis] = maximum[axis] > minimum[axis] ? maximum[axis] - minimum[axis] : 1.0f;
+      }
+
+      return output;
+    }
+
+    void Encode(
+      const float* positions, const float* normals, const float* uvs, size_t stride, size_t count,
+      const VertexDequantization& dequantization, CompressedVertex* output)
+    {
+      const float inverseExtent[3] = {
+        1.0f / dequantization.positionExtent[0],
+        1.0f / dequantization.positionExtent[1],
+        1.0f / dequantization.positionExtent[2] };
+
+      size_t i = 0;
+
+#ifdef VERTEX_COMPRESSION_SSE2
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 one = _mm_set1_ps(1.0f);
+      const __m128 signMask = _mm_set1_ps(-0.0f);
+      const __m128 tiny = _mm_set1_ps(1e-20f);
+
+      // 4 vertices at a time, transposed to one register per component
+      for (; i + 4 <= count; i += 4)
+      {
+        const float* p[4] = {
+          Advance(positions, stride, i), Advance(positions, stride, i + 1), Advance(positions, stride, i + 2), Advance(positions, stride, i + 3) };
+        const float* n[4] = {
+          Advance(normals, stride, i), Advance(normals, stride, i + 1), Advance(normals, stride, i + 2), Advance(normals, stride, i + 3) };
+        const float* t[4] = {
+          Advance(uvs, stride, i), Advance(uvs, stride, i + 1), Advance(uvs, stride, i + 2), Advance(uvs, stride, i + 3) };
+
+        // positions, unorm16 relative to the bounds
+        __m128i quantized[3];
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+          __m128 value = _mm_setr_ps(p[0][axis], p[1][axis], p[2][axis], p[3][axis]);
+          value = _mm_mul_ps(_mm_sub_ps(value, _mm_set1_ps(dequantization.positionMin[axis])), _mm_set1_ps(inverseExtent[axis]));
+          value = _mm_min_ps(_mm_max_ps(value, zero), one);
+          value = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f));
+          quantized[axis] = PackUnsigned16(_mm_cvttps_epi32(value));
+        }
+
+        // normals, project on the octahedron and fold the lower half
+        __m128 nx = _mm_setr_ps(n[0][0], n[1][0], n[2][0], n[3][0]);
+        __m128 ny = _mm_setr_ps(n[0][1], n[1][1], n[2][1], n[3][1]);
+        __m128 nz = _mm_setr_ps(n[0][2], n[1][2], n[2][2], n[3][2]);
+        const __m128 length = _mm_max_ps(
+          _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, nx), _mm_andnot_ps(signMask, ny)), _mm_andnot_ps(signMask, nz)), tiny);
+        nx = _mm_div_ps(nx, length);
+        ny = _mm_div_ps(ny, length);
+        nz = _mm_div_ps(nz, length);
+
+        const __m128 lowerHalf = _mm_cmplt_ps(nz, zero);
+        // sign(x) with sign(0) = 1
+        const __m128 signX = _mm_or_ps(_mm_and_ps(nx, signMask), one);
+        const __m128 signY = _mm_or_ps(_mm_and_ps(ny, signMask), one);
+        const __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ny)), signX);
+        const __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, nx)), signY);
+        nx = Select(lowerHalf, foldedX, nx);
+        ny = Select(lowerHalf, foldedY, ny);
+
+        const __m128 snormScale = _mm_set1_ps(32767.0f);
+        const __m128i octX = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(nx, _mm_set1_ps(-1.0f)), one), snormScale));
+        const __m128i octY = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(ny, _mm_set1_ps(-1.0f)), one), snormScale));
+
+        // uvs, halfs
+        const __m128i u = PackHalf16(FloatToHalf4(_mm_setr_ps(t[0][0], t[1][0], t[2][0], t[3][0])));
+        const __m128i v = PackHalf16(FloatToHalf4(_mm_setr_ps(t[0][1], t[1][1], t[2][1], t[3][1])));
+
+        // interleave back to 8 x 16 bits per vertex: px py pz pw nx ny u v
+        const __m128i positionXY = _mm_unpacklo_epi16(quantized[0], quantized[1]);
+        const __m128i positionZW = _mm_unpacklo_epi16(quantized[2], _mm_setzero_si128());
+        const __m128i normalXY = _mm_unpacklo_epi16(_mm_packs_epi32(octX, octX), _mm_packs_epi32(octY, octY));
+        const __m128i uv = _mm_unpacklo_epi16(u, v);
+
+        const __m128i position01 = _mm_unpacklo_epi32(positionXY, positionZW);
+        const __m128i position23 = _mm_unpackhi_epi32(positionXY, positionZW);
+        const __m128i attributes01 = _mm_unpacklo_epi32(normalXY, uv);
+        const __m128i attributes23 = _mm_unpackhi_epi32(normalXY, uv);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_unpacklo_epi64(position01, attributes01));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 1), _mm_unpackhi_epi64(position01, attributes01));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 2), _mm_unpacklo_epi64(position23, attributes23));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 3), _mm_unpackhi_epi64(position23, attributes23));
+      }
+#endif
+
+      // scalar fallback and tail
+      for (; i < count; ++i)
+      {
+        const float* position = Advance(positions, stride, i);
+        const float* normal = Advance(normals, stride, i);
+        const float* uv = Advance(uvs, stride, i);
+
+        CompressedVertex& vertex = output[i];
+        for (unsigned axis = 0; axis < 3; ++axis)
+          vertex.position[axis] = QuantizeUnorm16(position[axis], dequantization.positionMin[axis], inverseExtent[axis]);
+        vertex.position[3] = 0;
+        OctahedralEncode(normal, vertex.normal);
+        vertex.uv[0] = FloatToHalf(uv[0]);
+        vertex.uv[1] = FloatToHalf(uv[1]);
+      }
+    }
+
+    void Decode(const CompressedVertex& vertex, const VertexDequantization& dequantization, float position[3], float normal[3], float uv[2])
+    {
+      for (unsigned axis = 0; axis < 3; ++axis)
+        position[axis] = dequantization.positionMin[axis] + (vertex.position[axis] / 65535.0f) * dequantization.positionExtent[axis];
+      OctahedralDecode(vertex.normal, normal);
+      uv[0] = HalfToFloat(vertex.uv[0]);
+      uv[1] = HalfToFloat(vertex.uv[1]);
+    }
+
+    void Decode(
+      const CompressedVertex* vertices, size_t count, const VertexDequantization& dequantization,
+      float* positions, float* normals, float* uvs, size_t stride)
+    {
+      size_t i = 0;
+
+#ifdef VERTEX_COMPRESSION_SSE2
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 one = _mm_set1_ps(1.0f);
+      const __m128 signMask = _mm_set1_ps(-0.0f);
+
+      // 4 vertices at a time, one register per component
+      for (; i + 4 <= count; i += 4)
+      {
+        const __m128i vertex0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vertices + i));
+        const __m128i vertex1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vertices + i + 1));
+        const __m128i vertex2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vertices + i + 2));
+        const __m128i vertex3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vertices + i + 3));
+
+        // 32 bit lanes of a vertex: (px py) (pz pw) (nx ny) (u v), transposed to one register per lane
+        __m128 positionXY = _mm_castsi128_ps(vertex0);
+        __m128 positionZW = _mm_castsi128_ps(vertex1);
+        __m128 normalXY = _mm_castsi128_ps(vertex2);
+        __m128 uv = _mm_castsi128_ps(vertex3);
+        Transpose(positionXY, positionZW, normalXY, uv);
+
+        const __m128i low16 = _mm_set1_epi32(0xffff);
+        const __m128i positionX = _mm_and_si128(_mm_castps_si128(positionXY), low16);
+        const __m128i positionY = _mm_srli_epi32(_mm_castps_si128(positionXY), 16);
+        const __m128i positionZ = _mm_and_si128(_mm_castps_si128(positionZW), low16);
+        // snorms sign extended
+        const __m128i octX = _mm_srai_epi32(_mm_slli_epi32(_mm_castps_si128(normalXY), 16), 16);
+        const __m128i octY = _mm_srai_epi32(_mm_castps_si128(normalXY), 16);
+        const __m128i u = _mm_and_si128(_mm_castps_si128(uv), low16);
+        const __m128i v = _mm_srli_epi32(_mm_castps_si128(uv), 16);
+
+        // positions, same operations in the same order as the scalar version
+        const __m128i quantized[3] = { positionX, positionY, positionZ };
+        __m128 position[4];
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+          const __m128 unorm = _mm_div_ps(_mm_cvtepi32_ps(quantized[axis]), _mm_set1_ps(65535.0f));
+          position[axis] = _mm_add_ps(_mm_set1_ps(dequantization.positionMin[axis]), _mm_mul_ps(unorm, _mm_set1_ps(dequantization.positionExtent[axis])));
+        }
+        position[3] = zero;
+
+        // normals, unfold the lower half
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        const __m128 snormScale = _mm_set1_ps(32767.0f);
+        __m128 x = _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(octX), snormScale), minusOne);
+        __m128 y = _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(octY), snormScale), minusOne);
+        const __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+        // operands in the order that keeps the sign of zero like the scalar clamp
+        const __m128 t = _mm_min_ps(one, _mm_max_ps(zero, _mm_xor_ps(z, signMask)));
+        x = _mm_add_ps(x, Select(_mm_cmpge_ps(x, zero), _mm_xor_ps(t, signMask), t));
+        y = _mm_add_ps(y, Select(_mm_cmpge_ps(y, zero), _mm_xor_ps(t, signMask), t));
+
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 normal[4] = { _mm_div_ps(x, length), _mm_div_ps(y, length), _mm_div_ps(z, length), zero };
+
+        // uvs
+        __m128 texture[4] = { HalfToFloat4(u), HalfToFloat4(v), zero, zero };
+
+        // back to one register per vertex
+        Transpose(position[0], position[1], position[2], position[3]);
+        Transpose(normal[0], normal[1], normal[2], normal[3]);
+        Transpose(texture[0], texture[1], texture[2], texture[3]);
+
+        for (unsigned k = 0; k < 4; ++k)
+        {
+          float* outputPosition = Advance(positions, stride, i + k);
+          float* outputNormal = Advance(normals, stride, i + k);
+          float* outputUv = Advance(uvs, stride, i + k);
+
+          // 3 and 2 floats, the outputs may be packed in the same struct
+          alignas(16) float lanes[4];
+          _mm_store_ps(lanes, position[k]);
+          memcpy(outputPosition, lanes, sizeof(float) * 3);
+          _mm_store_ps(lanes, normal[k]);
+          memcpy(outputNormal, lanes, sizeof(float) * 3);
+          _mm_storel_pi(reinterpret_cast<__m64*>(outputUv), texture[k]);
+        }
+      }
+#endif
+
+      // scalar fallback and tail
+      for (; i < count; ++i)
+        Decode(vertices[i], dequantization, Advance(positions, stride, i), Advance(normals, stride, i), Advance(uvs, stride, i));
+    }
+
+    uint16_t FloatToHalf(float value)
+    {
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+
+      const uint32_t sign = (bits >> 16) & 0x8000;
+      const uint32_t absolute = bits & 0x7fffffff;
+
+      // NaN and infinity, and everything too big for a half
+      if (absolute >= 0x47800000)
+        return static_cast<uint16_t>(sign | (absolute > 0x7f800000 ? 0x7e00 : 0x7c00));
+
+      // denormal half, let the float adder round
+      if (absolute < 0x38800000)
+      {
+        float magnitude;
+        memcpy(&magnitude, &absolute, sizeof(magnitude));
+        const uint32_t magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+        float magic;
+        memcpy(&magic, &magicBits, sizeof(magic));
+        float sum = magnitude + magic;
+        uint32_t sumBits;
+        memcpy(&sumBits, &sum, sizeof(sumBits));
+        return static_cast<uint16_t>(sign | (sumBits - magicBits));
+      }
+
+      // normal half, round half to even
+      const uint32_t mantissaOdd = (absolute >> 13) & 1;
+      const uint32_t rounded = absolute + (0xfff - ((127 - 15) << 23)) + mantissaOdd;
+      return static_cast<uint16_t>(sign | (rounded >> 13));
+    }
+
+    float HalfToFloat(uint16_t value)
+    {
+      const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+      const uint32_t exponent = (value >> 10) & 0x1f;
+      const uint32_t mantissa = value & 0x3ff;
+
+      uint32_t bits;
+      if (exponent == 0x1f)
+      {
+        // infinity or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
+      }
+      else if (exponent == 0)
+      {
+        // zero or denormal, exact as a float
+        const float magnitude = mantissa * (1.0f / 16777216.0f);
+        memcpy(&bits, &magnitude, sizeof(bits));
+        bits |= sign;
+      }
+      else
+      {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+      }
+
+      float output;
+      memcpy(&output, &bits, sizeof(output));
+      return output;
+    }
+
+    void OctahedralEncode(const float normal[3], int16_t output[2])
+    {
+      float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+      length = length > 1e-20f ? length : 1e-20f;
+
+      float x = normal[0] / length;
+      float y = normal[1] / length;
+      const float z = normal[2] / length;
+
+      // lower half is folded over the diagonals
+      if (z < 0.0f)
+      {
+        const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+      }
+
+      output[0] = QuantizeSnorm16(x);
+      output[1] = QuantizeSnorm16(y);
+    }
+
+    void OctahedralDecode(const int16_t encoded[2], float output[3])
+    {
+      // same as the shader
+      float x = encoded[0] < -32767 ? -1.0f : encoded[0] / 32767.0f;
+      float y = encoded[1] < -32767 ? -1.0f : encoded[1] / 32767.0f;
+      const float z = 1.0f - std::fabs(x) - std::fabs(y);
+      const float t = Clamp(-z, 0.0f, 1.0f);
+      x += x >= 0.0f ? -t : t;
+      y += y >= 0.0f ? -t : t;
+
+      const float length = std::sqrt(x * x + y * y + z * z);
+      output[0] = x / length;
+      output[1] = y / length;
+      output[2] = z / length;
+    }
+  }
+}
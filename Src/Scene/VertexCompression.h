@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Scene
+{
+  // 16 bytes instead of 32, matches the compressed input layout:
+  // position R16G16B16A16_UNORM relative to the mesh bounds (w unused),
+  // normal R16G16_SNORM octahedral, uv R16G16_FLOAT
+  struct CompressedVertex
+  {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+  };
+
+  // what the shader needs to get positions back, sent as root constants (8 dwords)
+  struct VertexDequantization
+  {
+    float positionMin[3];
+    float padding0;
+    float positionExtent[3];
+    float padding1;
+  };
+
+  // Encoding/decoding of mesh vertices, SSE2 when available with a scalar fallback.
+  // Inputs are strided so they can read straight from an array of vertex structs,
+  // strides are in bytes.
+  namespace VertexCompression
+  {
+    // bounds of the positions, extent is never 0 so it can be divided by
+    VertexDequantization ComputeDequantization(const float* positions, size_t stride, size_t count);
+
+    void Encode(
+      const float* positions, const float* normals, const float* uvs, size_t stride, size_t count,
+      const VertexDequantization& dequantization, CompressedVertex* output);
+
+    // single vertex, reference for the encoder
+    void Decode(const CompressedVertex& vertex, const VertexDequantization& dequantization, float position[3], float normal[3], float uv[2]);
+
+    // gives the same floats as the single vertex version, outputs are strided like the encoder inputs
+    void Decode(
+      const CompressedVertex* vertices, size_t count, const VertexDequantization& dequantization,
+      float* positions, float* normals, float* uvs, size_t stride);
+
+    // building blocks, exposed to check error bounds
+    uint16_t FloatToHalf(float value);
+    float HalfToFloat(uint16_t value);
+    void OctahedralEncode(const float normal[3], int16_t output[2]);
+    void OctahedralDecode(const int16_t encoded[2], float output[3]);
+  }
+}
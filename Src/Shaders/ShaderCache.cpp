@@ -0,0 +1,216 @@
+#include "stdafx.h"
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+// helpers
+namespace
+{
+  // precedes the bytecode of an entry
+  struct EntryHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+    // hash of the bytecode
+    uint64_t checksum;
+  };
+
+  // name of an #include directive, quotes and angle brackets are both resolved next to the file
+  bool ParseInclude(const std::string& line, std::string& name)
+  {
+    size_t i = line.find_first_not_of(" \t");
+    if (i == std::string::npos || line[i] != '#')
+      return false;
+    i = line.find_first_not_of(" \t", i + 1);
+    if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+      return false;
+    i = line.find_first_not_of(" \t", i + 7);
+    if (i == std::string::npos || (line[i] != '"' && line[i] != '<'))
+      return false;
+
+    const size_t end = line.find(line[i] == '"' ? '"' : '>', i + 1);
+    if (end == std::string::npos)
+      return false;
+    name = line.substr(i + 1, end - i - 1);
+    return true;
+  }
+
+  bool ReadFile(const std::filesystem::path& path, std::string& content)
+  {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+      return false;
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+  }
+}
+
+namespace Shaders
+{
+  ShaderCache::ShaderCache(const std::filesystem::path& root)
+    : m_directory(root)
+  {
+    // one directory per entry format
+    std::ostringstream version;
+    version << "v" << VERSION;
+    m_directory /= version.str();
+  }
+
+  ShaderCache::~ShaderCache()
+  {
+  }
+
+  uint64_t ShaderCache::ComputeKey(const ShaderCompileDesc& desc, std::vector<std::filesystem::path>* includes) const
+  {
+    const std::filesystem::path path = std::filesystem::path(desc.path).lexically_normal();
+    if (!std::filesystem::is_regular_file(path))
+      throw std::invalid_argument("[SHADER] SHADER SOURCE COULD NOT BE READ !");
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = HashString(desc.path, hash);
+    hash = HashString(desc.entryPoint, hash);
+    hash = HashString(desc.profile, hash);
+    for (const auto& define : desc.defines)
+    {
+      hash = HashString(define.first, hash);
+      hash = HashString(define.second, hash);
+    }
+    hash = Hash(&desc.flags, sizeof(desc.flags), hash);
+    hash = HashString(desc.compiler, hash);
+
+    std::vector<std::filesystem::path> visited = { path };
+    hash = HashFile(path, hash, visited);
+
+    if (includes)
+      includes->assign(visited.begin() + 1, visited.end());
+    return hash;
+  }
+
+  bool ShaderCache::Load(uint64_t key, std::vector<uint8_t>& bytecode) const
+  {
+    bytecode.clear();
+
+    const std::filesystem::path path = GetEntryPath(key);
+    std::error_code error;
+    const uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if (error || fileSize < sizeof(EntryHeader))
+      return false;
+
+    std::ifstream file(path, std::ios::binary);
+    EntryHeader header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+      return false;
+    // a truncated or foreign entry
+    if (header.magic != MAGIC || header.version != VERSION || header.key != key || header.size != fileSize - sizeof(EntryHeader))
+      return false;
+
+    bytecode.resize(static_cast<size_t>(header.size));
+    if (!file.read(reinterpret_cast<char*>(bytecode.data()), static_cast<std::streamsize>(bytecode.size())) ||
+      Hash(bytecode.data(), bytecode.size(), FNV_OFFSET_BASIS) != header.checksum)
+    {
+      bytecode.clear();
+      return false;
+    }
+    return true;
+  }
+
+  bool ShaderCache::Store(uint64_t key, const void* bytecode, size_t size) const
+  {
+    static std::atomic<uint32_t> s_storeCount(0);
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error)
+      return false;
+
+    // written aside then renamed, readers and other writers of the key never see half an entry
+    const std::filesystem::path path = GetEntryPath(key);
+    std::ostringstream suffix;
+    suffix << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << "." << s_storeCount++ << ".tmp";
+    std::filesystem::path temporary = path;
+    temporary += suffix.str();
+
+    const EntryHeader header = { MAGIC, VERSION, key, size, Hash(bytecode, size, FNV_OFFSET_BASIS) };
+    {
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(static_cast<const char*>(bytecode), static_cast<std::streamsize>(size));
+      if (!file.flush())
+      {
+        file.close();
+        std::filesystem::remove(temporary, error);
+        return false;
+      }
+    }
+
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t ShaderCache::Hash(const void* data, size_t size, uint64_t hash) const
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= bytes[i];
+      hash *= FNV_PRIME;
+    }
+    return hash;
+  }
+
+  uint64_t ShaderCache::HashString(const std::string& value, uint64_t hash) const
+  {
+    // the length keeps "ab" + "c" and "a" + "bc" apart
+    const uint64_t length = value.size();
+    hash = Hash(&length, sizeof(length), hash);
+    return Hash(value.data(), value.size(), hash);
+  }
+
+  uint64_t ShaderCache::HashFile(const std::filesystem::path& path, uint64_t hash, std::vector<std::filesystem::path>& visited) const
+  {
+    std::string source;
+    if (!ReadFile(path, source))
+      return hash;
+    hash = HashString(source, hash);
+
+    // includes in inactive branches are hashed too, a key may change for nothing but never stays stale
+    std::istringstream lines(source);
+    std::string line;
+    std::string name;
+    while (std::getline(lines, line))
+    {
+      if (!ParseInclude(line, name))
+        continue;
+      hash = HashString(name, hash);
+
+      const std::filesystem::path include = (path.parent_path() / name).lexically_normal();
+      if (std::find(visited.begin(), visited.end(), include) != visited.end() || !std::filesystem::is_regular_file(include))
+        continue;
+      visited.push_back(include);
+      hash = HashFile(include, hash, visited);
+    }
+    return hash;
+  }
+
+  std::filesystem::path ShaderCache::GetEntryPath(uint64_t key) const
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(key));
+    return m_directory / name;
+  }
+}
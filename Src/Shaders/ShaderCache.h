@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Shaders
+{
+  // everything the bytecode of a stage depends on, besides the files
+  struct ShaderCompileDesc
+  {
+    // relative to the working directory, includes are resolved next to the file including them
+    std::string path;
+    std::string entryPoint;
+    std::string profile;
+    std::vector<std::pair<std::string, std::string>> defines;
+    uint32_t flags;
+    // compiler and its version, a new compiler makes new keys
+    std::string compiler;
+  };
+
+  // Persistent bytecode cache. Entries are keyed by a FNV-1a hash of the source, of the files it
+  // includes and of the compile description, and live in a directory named after the cache version.
+  // Entries are checked on load, a damaged or stale one is a miss.
+  // It knows nothing about D3D12, the manager compiles on a miss and stores the result.
+  class ShaderCache
+  {
+    // bump when the entry layout or the key change, older entries are then ignored
+    const uint32_t VERSION = 1;
+    // "SHCB"
+    const uint32_t MAGIC = 0x42434853;
+    const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+  public:
+    // entries go in a subdirectory of root, created on the first store
+    explicit ShaderCache(const std::filesystem::path& root);
+    ~ShaderCache();
+
+    // fills includes with the files reached from the source, a missing include only hashes its name
+    uint64_t ComputeKey(const ShaderCompileDesc& desc, std::vector<std::filesystem::path>* includes = nullptr) const;
+    // false on a miss, bytecode is left empty then
+    bool Load(uint64_t key, std::vector<uint8_t>& bytecode) const;
+    // false when the entry could not be written, the cache is only a speed up
+    bool Store(uint64_t key, const void* bytecode, size_t size) const;
+
+    const std::filesystem::path& GetDirectory() const { return m_directory; }
+
+  private:
+    uint64_t Hash(const void* data, size_t size, uint64_t hash) const;
+    uint64_t HashString(const std::string& value, uint64_t hash) const;
+    // hashes the file and, depth first, the files it includes
+    uint64_t HashFile(const std::filesystem::path& path, uint64_t hash, std::vector<std::filesystem::path>& visited) const;
+    std::filesystem::path GetEntryPath(uint64_t key) const;
+
+  private:
+    std::filesystem::path m_directory;
+
+  private:
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+  };
+}
@@ -1,10 +1,17 @@
 #include "stdafx.h"
 #include "ShaderManager.h"
 
+#include "Core/JobSystem.h"
+
 #include "Graphics/DX12Interface.h"
+#include "Graphics/ResourceManager.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <stdexcept>
 
 // json
 #include <json.hpp>
@@ -12,15 +19,180 @@ using json = nlohmann::json;
 
 namespace Shaders
 {
+  struct ShaderManager::Reload
+  {
+    std::vector<std::pair<std::string, uint32_t>> variants;
+    // the stages of the variants, in the same order, a job each
+    std::vector<ShaderStage> stages;
+    Core::JobCounter counter;
+    std::chrono::high_resolution_clock::time_point start;
+  };
+
   ShaderManager::ShaderManager()
     : m_shaderMap()
+    , m_vertexCompressed(false)
+    , m_defines()
+    , m_cache(std::filesystem::current_path() / "ShaderCache")
+    , m_dxcModule(nullptr)
+    , m_dxilModule(nullptr)
+    , m_dxcCreateInstance(nullptr)
+    , m_dxcVersion()
+    , m_watcher()
+    , m_dependencies()
+    , m_reload()
+    , m_lastPoll()
   {
     RegisterShaders();
   }
 
   ShaderManager::~ShaderManager()
   {
+    // the jobs write into the stages
+    if (m_reload)
+      Core::JobSystem::Instance().Wait(m_reload->counter);
     m_shaderMap.clear();
+
+    if (m_dxcModule)
+      FreeLibrary(m_dxcModule);
+    if (m_dxilModule)
+      FreeLibrary(m_dxilModule);
+  }
+
+  uint32_t ShaderManager::GetPermutationKey(const std::string& shaderName, const std::vector<std::string>& defines) const
+  {
+    auto shader = m_shaderMap.find(shaderName);
+    if (shader == m_shaderMap.end())
+      throw std::out_of_range("[SHADERS] UNKNOWN SHADER !");
+
+    uint32_t key = 0;
+    for (const auto& define : defines)
+    {
+      const auto& axes = shader->second.axes;
+      auto axis = std::find(axes.begin(), axes.end(), define);
+      if (axis == axes.end())
+        throw std::invalid_argument("[SHADERS] UNKNOWN PERMUTATION AXIS !");
+      key |= 1u << (axis - axes.begin());
+    }
+    return key;
+  }
+
+  void ShaderManager::CompileVariants(const std::vector<std::pair<std::string, uint32_t>>& variants)
+  {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // the variants to compile, without duplicates, their stages follow the ones of the variants before them
+    std::vector<std::pair<std::string, uint32_t>> compiled;
+    std::vector<ShaderStage> stages;
+    for (const auto& variant : variants)
+    {
+      auto shader = m_shaderMap.find(variant.first);
+      if (shader == m_shaderMap.end())
+        throw std::out_of_range("[SHADERS] UNKNOWN SHADER !");
+      if (shader->second.variants.count(variant.second) ||
+        std::find(compiled.begin(), compiled.end(), variant) != compiled.end())
+        continue;
+
+      AddStages(variant, stages);
+      compiled.push_back(variant);
+    }
+    if (stages.empty())
+      return;
+
+    // a job per stage, each writes its own stage so the results don't depend on the workers
+    Core::JobSystem::Instance().ParallelFor(stages.size(), 1, [this, &stages](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        CompileStage(stages[i]);
+    });
+
+    // every error at once, not only the first one
+    uint32_t cachedCount = 0;
+    const std::string errors = CollectErrors(stages, cachedCount);
+    if (!errors.empty())
+    {
+      OutputDebugStringA(errors.c_str());
+      throw std::invalid_argument("[SHADERS] SHADERS COULD NOT BE COMPILED !");
+    }
+
+    StoreVariants(compiled, stages);
+
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    char message[256];
+    snprintf(message, sizeof(message), "[SHADERS] %zu variants, %zu stages ready in %.1f ms on %u workers, %u from the cache\n",
+      compiled.size(), stages.size(), milliseconds, Core::JobSystem::Instance().GetWorkerCount() + 1, cachedCount);
+    OutputDebugStringA(message);
+  }
+
+  const std::shared_ptr<ShaderBlob> ShaderManager::GetShader(const std::string& shaderName, uint32_t permutation) const
+  {
+    auto shader = m_shaderMap.find(shaderName);
+    if (shader == m_shaderMap.end())
+      throw std::out_of_range("[SHADERS] UNKNOWN SHADER !");
+    auto variant = shader->second.variants.find(permutation);
+    if (variant == shader->second.variants.end())
+      throw std::out_of_range("[SHADERS] SHADER VARIANT WAS NOT COMPILED !");
+    return variant->second;
+  }
+
+  std::vector<std::pair<std::string, uint32_t>> ShaderManager::UpdateHotReload()
+  {
+    std::vector<std::pair<std::string, uint32_t>> reloaded;
+    if (!m_watcher)
+      return reloaded;
+
+    if (m_reload)
+    {
+      // the frame goes on while the jobs compile
+      if (!m_reload->counter.IsDone())
+        return reloaded;
+      Core::JobSystem::Instance().Wait(m_reload->counter);
+      std::unique_ptr<Reload> reload = std::move(m_reload);
+
+      uint32_t cachedCount = 0;
+      const std::string errors = CollectErrors(reload->stages, cachedCount);
+      if (!errors.empty())
+      {
+        // the previous shaders stay until the files are fixed
+        OutputDebugStringA(errors.c_str());
+        OutputDebugStringA("[HOTRELOAD] shaders could not be compiled, the previous ones are kept\n");
+        return reloaded;
+      }
+      reloaded = StoreVariants(reload->variants, reload->stages);
+
+      const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - reload->start).count();
+      char message[256];
+      snprintf(message, sizeof(message), "[HOTRELOAD] %zu of %zu variants, %zu stages reloaded in %.1f ms\n",
+        reloaded.size(), reload->variants.size(), reload->stages.size(), milliseconds);
+      OutputDebugStringA(message);
+      return reloaded;
+    }
+
+    // files changed while a reload compiles are found by the next poll
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPoll < POLL_INTERVAL)
+      return reloaded;
+    m_lastPoll = now;
+
+    const std::vector<std::string> shaders = m_dependencies.GetAffectedShaders(m_watcher->Poll());
+    if (shaders.empty())
+      return reloaded;
+
+    // every compiled variant of the shaders reading a changed file, the others are compiled once requested
+    auto reload = std::make_unique<Reload>();
+    reload->start = std::chrono::high_resolution_clock::now();
+    for (const auto& name : shaders)
+    {
+      for (const auto& variant : m_shaderMap[name].variants)
+      {
+        reload->variants.push_back({ name, variant.first });
+        AddStages(reload->variants.back(), reload->stages);
+      }
+    }
+
+    // the stages don't move from here, the jobs write into them
+    m_reload = std::move(reload);
+    for (auto& stage : m_reload->stages)
+      Core::JobSystem::Instance().Run([this, &stage]() { CompileStage(stage); }, &m_reload->counter);
+    return reloaded;
   }
 
   void ShaderManager::RegisterShaders()
@@ -29,8 +201,17 @@ namespace Shaders
     auto configPath = std::filesystem::current_path().string() + "/Resources/configs/Shaders.json";
 
     // read config file and parse it
-    json configData = json::parse(std::ifstream(configPath))["Shaders"];
+    json config = json::parse(std::ifstream(configPath));
+    json configData = config["Shaders"];
+
+    // "Compressed" or "Full", full when missing
+    m_vertexCompressed = config.value("VertexFormat", std::string("Full")) == "Compressed";
+
+    if (m_vertexCompressed)
+      m_defines.push_back({ "COMPRESSED_VERTEX", "1" });
 
+    // dxcompiler.dll is only loaded when a shader asks for it
+    bool dxc = false;
     for (auto data : configData)
     {
       std::string name;
@@ -41,8 +222,303 @@ namespace Shaders
       data.at("Type").get_to(type);
       data.at("Path").get_to(path);
 
-      // create shader blob, which will compile the shader for now
-      m_shaderMap[name] = std::make_shared<ShaderBlob>(path, type == "Compute");
+      Shader& shader = m_shaderMap[name];
+      shader.path = path;
+      shader.compute = type == "Compute";
+      // optional, defines that make variants of the shader
+      shader.axes = data.value("Permutations", std::vector<std::string>());
+      if (shader.axes.size() > MAX_PERMUTATION_AXES)
+        throw std::invalid_argument("[SHADERS] TOO MANY PERMUTATION AXES !");
+      // optional, "FXC" when missing
+      shader.backend = data.value("Compiler", std::string("FXC")) == "DXC" ? Dxc : Fxc;
+      shader.shaderModel = data.value("ShaderModel", std::string("6_0"));
+      dxc = dxc || shader.backend == Dxc;
+    }
+
+    if (dxc)
+      LoadDxc();
+
+    // optional, recompiles the shaders when their files change, debug builds only
+#ifdef _DEBUG
+    if (config.value("HotReload", false))
+      m_watcher = std::make_unique<ShaderWatcher>(SHADER_DIRECTORY);
+#endif
+  }
+
+  void ShaderManager::AddStages(const std::pair<std::string, uint32_t>& variant, std::vector<ShaderStage>& stages) const
+  {
+    auto shader = m_shaderMap.find(variant.first);
+    if (shader == m_shaderMap.end())
+      throw std::out_of_range("[SHADERS] UNKNOWN SHADER !");
+    if (shader->second.axes.size() < MAX_PERMUTATION_AXES && (variant.second >> shader->second.axes.size()) != 0)
+      throw std::invalid_argument("[SHADERS] UNKNOWN PERMUTATION AXIS !");
+
+    std::vector<std::pair<std::string, std::string>> defines = m_defines;
+    for (size_t axis = 0; axis < shader->second.axes.size(); ++axis)
+    {
+      if (variant.second & (1u << axis))
+        defines.push_back({ shader->second.axes[axis], "1" });
+    }
+
+    // shaders asking for DXC get FXC when it could not be loaded
+    const ShaderBackend backend = shader->second.backend == Dxc && m_dxcCreateInstance ? Dxc : Fxc;
+    const std::string& model = shader->second.shaderModel;
+
+    const std::string& path = shader->second.path;
+    if (shader->second.compute)
+    {
+      stages.push_back({ path, "main", backend == Dxc ? "cs_" + model : "cs_5_1", defines, backend });
+    } else
+    {
+      stages.push_back({ path, "VSMain", backend == Dxc ? "vs_" + model : "vs_5_0", defines, backend });
+      stages.push_back({ path, "PSMain", backend == Dxc ? "ps_" + model : "ps_5_0", defines, backend });
+    }
+  }
+
+  std::string ShaderManager::CollectErrors(const std::vector<ShaderStage>& stages, uint32_t& cachedCount) const
+  {
+    std::string errors;
+    cachedCount = 0;
+    for (const auto& stage : stages)
+    {
+      cachedCount += stage.cached ? 1 : 0;
+      if (!stage.errors.empty())
+        errors += stage.path + " (" + stage.entryPoint + "): " + stage.errors + "\n";
     }
+    return errors;
+  }
+
+  std::vector<std::pair<std::string, uint32_t>> ShaderManager::StoreVariants(const std::vector<std::pair<std::string, uint32_t>>& variants, const std::vector<ShaderStage>& stages)
+  {
+    std::vector<std::pair<std::string, uint32_t>> stored;
+    size_t stage = 0;
+    for (const auto& variant : variants)
+    {
+      Shader& shader = m_shaderMap[variant.first];
+      std::shared_ptr<ShaderBlob>& blob = shader.variants[variant.second];
+      const size_t first = stage;
+      stage += shader.compute ? 1 : 2;
+
+      // the variants of a shader read the same files, includes in inactive branches count too
+      m_dependencies.SetDependencies(variant.first, stages[stage - 1].files);
+
+      // made before anything is replaced, the device can reject the root signature
+      std::shared_ptr<ShaderBlob> created;
+      try
+      {
+        if (shader.compute)
+          created = std::make_shared<ShaderBlob>(nullptr, nullptr, stages[first].bytecode);
+        else
+          created = std::make_shared<ShaderBlob>(stages[first].bytecode, stages[first + 1].bytecode, nullptr);
+      }
+      catch (const std::exception& exception)
+      {
+        // nothing to fall back on before the first blob
+        if (!blob)
+          throw;
+
+        char message[512];
+        snprintf(message, sizeof(message), "[HOTRELOAD] %s could not be created, the previous one is kept: %s\n", variant.first.c_str(), exception.what());
+        OutputDebugStringA(message);
+        continue;
+      }
+
+      // a replaced blob may still be used by the frames in flight, its root signature with it
+      if (blob)
+        Graphics::ResourceManager::Instance().DeferRelease([retired = std::move(blob)]() mutable { retired.reset(); });
+      blob = std::move(created);
+      stored.push_back(variant);
+    }
+    return stored;
+  }
+
+  void ShaderManager::LoadDxc()
+  {
+    // dxil.dll signs what dxcompiler.dll compiles, D3D12 rejects unsigned shaders
+    m_dxcModule = LoadLibraryW(L"dxcompiler.dll");
+    m_dxilModule = LoadLibraryW(L"dxil.dll");
+    if (m_dxcModule)
+      m_dxcCreateInstance = reinterpret_cast<DxcCreateInstanceProc>(GetProcAddress(m_dxcModule, "DxcCreateInstance"));
+
+    ComPtr<IDxcCompiler3> compiler;
+    ComPtr<IDxcVersionInfo> versionInfo;
+    UINT32 major = 0;
+    UINT32 minor = 0;
+    if (!m_dxilModule || !m_dxcCreateInstance ||
+      FAILED(m_dxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler))) ||
+      FAILED(compiler.As(&versionInfo)) || FAILED(versionInfo->GetVersion(&major, &minor)))
+    {
+      m_dxcCreateInstance = nullptr;
+      OutputDebugStringA("[SHADERS] dxcompiler.dll or dxil.dll could not be loaded, DXC shaders are compiled with FXC\n");
+      return;
+    }
+
+    // the device has to run shader model 6
+    auto device = Graphics::DX12Interface::Get().GetDevice();
+    D3D12_FEATURE_DATA_SHADER_MODEL shaderModel = { D3D_SHADER_MODEL_6_0 };
+    if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shaderModel, sizeof(shaderModel))) ||
+      shaderModel.HighestShaderModel < D3D_SHADER_MODEL_6_0)
+    {
+      m_dxcCreateInstance = nullptr;
+      OutputDebugStringA("[SHADERS] the device has no shader model 6, DXC shaders are compiled with FXC\n");
+      return;
+    }
+
+    m_dxcVersion = "DXC " + std::to_string(major) + "." + std::to_string(minor);
+  }
+
+  void ShaderManager::CompileStage(ShaderStage& stage) const
+  {
+    // thrown errors are kept with the others
+    try
+    {
+      ShaderCompileDesc desc = { stage.path, stage.entryPoint, stage.profile, stage.defines, COMPILE_FLAGS, "FXC " + std::to_string(D3D_COMPILER_VERSION) };
+      if (stage.backend == Dxc)
+      {
+        desc.flags = 0;
+        desc.compiler = m_dxcVersion;
+        for (const auto& argument : DXC_ARGUMENTS)
+          desc.compiler += " " + argument;
+      }
+      std::vector<std::filesystem::path> includes;
+      const uint64_t key = m_cache.ComputeKey(desc, &includes);
+      stage.files = { std::filesystem::path(stage.path).lexically_normal() };
+      stage.files.insert(stage.files.end(), includes.begin(), includes.end());
+
+      std::vector<uint8_t> bytecode;
+      if (m_cache.Load(key, bytecode))
+      {
+        Utilities::ThrowIfFailed(D3DCreateBlob(bytecode.size(), &stage.bytecode));
+        std::memcpy(stage.bytecode->GetBufferPointer(), bytecode.data(), bytecode.size());
+        stage.cached = true;
+        return;
+      }
+
+      if (stage.backend == Dxc)
+        CompileDxc(stage);
+      else
+        CompileFxc(stage);
+
+      // a failed store only costs a compile on the next run
+      if (stage.bytecode)
+        m_cache.Store(key, stage.bytecode->GetBufferPointer(), stage.bytecode->GetBufferSize());
+    } catch (const std::exception& exception)
+    {
+      stage.errors = exception.what();
+      stage.bytecode.Reset();
+    }
+  }
+
+  void ShaderManager::CompileFxc(ShaderStage& stage) const
+  {
+    auto fullPath = std::filesystem::current_path().string() + "/" + stage.path;
+
+    // Convert char* to std::wstring
+    int wchars_num = MultiByteToWideChar(CP_UTF8, 0, fullPath.c_str(), -1, nullptr, 0);
+    std::wstring wFullPath(wchars_num, 0);
+    MultiByteToWideChar(CP_UTF8, 0, fullPath.c_str(), -1, &wFullPath[0], wchars_num);
+
+    // null terminated, like D3DCompile expects it
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const auto& define : stage.defines)
+      macros.push_back({ define.first.c_str(), define.second.c_str() });
+    macros.push_back({ nullptr, nullptr });
+
+    // includes are resolved relative to the shader file
+    auto include = D3D_COMPILE_STANDARD_FILE_INCLUDE;
+
+    ComPtr<ID3DBlob> errorBlob;
+    const HRESULT hr = D3DCompileFromFile(wFullPath.c_str(), macros.data(), include, stage.entryPoint.c_str(), stage.profile.c_str(),
+      COMPILE_FLAGS, 0, &stage.bytecode, &errorBlob);
+    if (FAILED(hr))
+    {
+      stage.errors = errorBlob ? static_cast<const char*>(errorBlob->GetBufferPointer()) : Utilities::HrToString(hr);
+      stage.bytecode.Reset();
+      return;
+    }
+
+#ifndef _DEBUG
+    const void* data = stage.bytecode->GetBufferPointer();
+    const SIZE_T size = stage.bytecode->GetBufferSize();
+
+    ComPtr<ID3DBlob> pdb;
+    ComPtr<ID3DBlob> debugName;
+    if (SUCCEEDED(D3DGetBlobPart(data, size, D3D_BLOB_PDB, 0, &pdb)) && SUCCEEDED(D3DGetBlobPart(data, size, D3D_BLOB_DEBUG_NAME, 0, &debugName)))
+    {
+      // flags and name length, then the name
+      WritePdb(static_cast<const char*>(debugName->GetBufferPointer()) + 2 * sizeof(uint16_t), pdb->GetBufferPointer(), pdb->GetBufferSize());
+    }
+
+    // the root signature stays
+    ComPtr<ID3DBlob> stripped;
+    Utilities::ThrowIfFailed(D3DStripShader(data, size, D3DCOMPILER_STRIP_DEBUG_INFO | D3DCOMPILER_STRIP_REFLECTION_DATA, &stripped));
+    stage.bytecode = stripped;
+#endif
+  }
+
+  void ShaderManager::CompileDxc(ShaderStage& stage) const
+  {
+    // compiler objects aren't shared between threads
+    ComPtr<IDxcUtils> utils;
+    ComPtr<IDxcCompiler3> compiler;
+    ComPtr<IDxcIncludeHandler> includeHandler;
+    Utilities::ThrowIfFailed(m_dxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils)));
+    Utilities::ThrowIfFailed(m_dxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler)));
+    Utilities::ThrowIfFailed(utils->CreateDefaultIncludeHandler(&includeHandler));
+
+    const std::filesystem::path fullPath = std::filesystem::current_path() / stage.path;
+    ComPtr<IDxcBlobEncoding> source;
+    Utilities::ThrowIfFailed(utils->LoadFile(fullPath.c_str(), nullptr, &source));
+    const DxcBuffer buffer = { source->GetBufferPointer(), source->GetBufferSize(), DXC_CP_ACP };
+
+    // as on the command line, includes are resolved relative to the shader file
+    std::vector<std::string> arguments = { "-E", stage.entryPoint, "-T", stage.profile, "-I", fullPath.parent_path().string() };
+    for (const auto& define : stage.defines)
+    {
+      arguments.push_back("-D");
+      arguments.push_back(define.first + "=" + define.second);
+    }
+    arguments.insert(arguments.end(), DXC_ARGUMENTS.begin(), DXC_ARGUMENTS.end());
+
+    std::vector<std::wstring> wideArguments = { fullPath.wstring() };
+    for (const auto& argument : arguments)
+      wideArguments.push_back(std::filesystem::path(argument).wstring());
+    std::vector<LPCWSTR> argumentPointers;
+    for (const auto& argument : wideArguments)
+      argumentPointers.push_back(argument.c_str());
+
+    ComPtr<IDxcResult> result;
+    HRESULT status = E_FAIL;
+    Utilities::ThrowIfFailed(compiler->Compile(&buffer, argumentPointers.data(), static_cast<UINT32>(argumentPointers.size()), includeHandler.Get(), IID_PPV_ARGS(&result)));
+    Utilities::ThrowIfFailed(result->GetStatus(&status));
+    if (FAILED(status))
+    {
+      ComPtr<IDxcBlobUtf8> errors;
+      result->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors), nullptr);
+      stage.errors = errors && errors->GetStringLength() > 0 ? errors->GetStringPointer() : Utilities::HrToString(status);
+      return;
+    }
+
+    ComPtr<IDxcBlob> object;
+    Utilities::ThrowIfFailed(result->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&object), nullptr));
+    Utilities::ThrowIfFailed(D3DCreateBlob(object->GetBufferSize(), &stage.bytecode));
+    std::memcpy(stage.bytecode->GetBufferPointer(), object->GetBufferPointer(), object->GetBufferSize());
+
+    ComPtr<IDxcBlob> pdb;
+    ComPtr<IDxcBlobUtf16> pdbName;
+    if (result->HasOutput(DXC_OUT_PDB) && SUCCEEDED(result->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(&pdb), &pdbName)) && pdbName)
+      WritePdb(pdbName->GetStringPointer(), pdb->GetBufferPointer(), pdb->GetBufferSize());
+  }
+
+  void ShaderManager::WritePdb(const std::filesystem::path& name, const void* data, size_t size) const
+  {
+    // named after a hash of the shader, an existing one is the same
+    const std::filesystem::path directory = m_cache.GetDirectory() / "pdb";
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error || std::filesystem::exists(directory / name, error))
+      return;
+
+    std::ofstream(directory / name, std::ios::binary).write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
   }
 }
@@ -4,8 +4,18 @@
 
 #include "Graphics/DX12Interface.h"
 
+#include "Shaders/ShaderCache.h"
+#include "Shaders/ShaderWatcher.h"
+
+#include <dxcapi.h>
+
+#include <chrono>
+#include <memory>
 #include <unordered_map>
 #include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
@@ -18,54 +28,71 @@ namespace Shaders
     ComPtr<ID3DBlob> pixelShader;
     ComPtr<ID3DBlob> computeShader;
     ComPtr<ID3D12RootSignature> rootSignature;
-    ComPtr<ID3DBlob> errorBlob;
 
-    ShaderBlob(const std::string& path, bool isCompute)
+    // the compiled stages, compute alone or vertex and pixel
+    ShaderBlob(ComPtr<ID3DBlob> vertex, ComPtr<ID3DBlob> pixel, ComPtr<ID3DBlob> compute)
+      : vertexShader(vertex)
+      , pixelShader(pixel)
+      , computeShader(compute)
+      , rootSignature()
     {
-      // Enable better shader debugging with the graphics debugging tools.
-      UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-      auto fullPath = std::filesystem::current_path().string() + "/" + path;
-
-      // Convert char* to std::wstring
-      int wchars_num = MultiByteToWideChar(CP_UTF8, 0, fullPath.c_str(), -1, nullptr, 0);
-      std::wstring wFullPath(wchars_num, 0);
-      MultiByteToWideChar(CP_UTF8, 0, fullPath.c_str(), -1, &wFullPath[0], wchars_num);
-
-      if (isCompute)
-      {
-        Utilities::ThrowIfFailed(D3DCompileFromFile(wFullPath.c_str(), nullptr, nullptr, "main", "cs_5_1", compileFlags, 0, &computeShader, &errorBlob));
-      } else
-      {
-        Utilities::ThrowIfFailed(D3DCompileFromFile(wFullPath.c_str(), nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorBlob));
-        Utilities::ThrowIfFailed(D3DCompileFromFile(wFullPath.c_str(), nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &errorBlob));
-      }
-
-      auto shaderBlob = isCompute ? computeShader : vertexShader;
-
-      // Extract the root signature from shader
-      ID3DBlob* rootSigBlob = nullptr;
-      D3DGetBlobPart(
-        shaderBlob->GetBufferPointer(),
-        shaderBlob->GetBufferSize(),
-        D3D_BLOB_ROOT_SIGNATURE,
-        0,
-        &rootSigBlob
-      );
+      auto shaderBlob = computeShader ? computeShader : vertexShader;
+
+      // the root signature is read from the shader, FXC and DXC containers alike
       Utilities::ThrowIfFailed(Graphics::DX12Interface::Get().GetDevice()->CreateRootSignature(
-        0, rootSigBlob->GetBufferPointer(), rootSigBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
+        0, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
     }
 
     ~ShaderBlob()
     {
       vertexShader.Reset();
       pixelShader.Reset();
+      computeShader.Reset();
       rootSignature.Reset();
-      errorBlob.Reset();
     }
   };
 
+  enum ShaderBackend
+  {
+    // d3dcompiler, shader model 5
+    Fxc,
+    // dxcompiler, shader model 6, needs dxcompiler.dll and dxil.dll next to the executable
+    Dxc
+  };
+
+  // one stage of a shader, compiled by a job
+  struct ShaderStage
+  {
+    std::string path;
+    std::string entryPoint;
+    std::string profile;
+    std::vector<std::pair<std::string, std::string>> defines;
+    ShaderBackend backend;
+    ComPtr<ID3DBlob> bytecode;
+    bool cached;
+    // compiler output when it failed
+    std::string errors;
+    // the source and the files it includes
+    std::vector<std::filesystem::path> files;
+  };
+
   class ShaderManager
   {
+#ifdef _DEBUG
+    // Enable better shader debugging with the graphics debugging tools.
+    const UINT COMPILE_FLAGS = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    const std::vector<std::string> DXC_ARGUMENTS = { "-Zi", "-Od", "-Qembed_debug" };
+#else
+    // optimized, the debug info is written to a pdb then stripped with the reflection
+    const UINT COMPILE_FLAGS = D3DCOMPILE_OPTIMIZATION_LEVEL3 | D3DCOMPILE_DEBUG | D3DCOMPILE_DEBUG_NAME_FOR_BINARY;
+    const std::vector<std::string> DXC_ARGUMENTS = { "-O3", "-Zi", "-Qstrip_debug", "-Qstrip_reflect" };
+#endif
+    // bits of a permutation key
+    const size_t MAX_PERMUTATION_AXES = 32;
+    // watched by the hot reload
+    const std::string SHADER_DIRECTORY = "Resources/shaders";
+    const std::chrono::milliseconds POLL_INTERVAL = std::chrono::milliseconds(250);
+
   public:
     static ShaderManager& Instance()
     {
@@ -74,15 +101,74 @@ namespace Shaders
     }
     ~ShaderManager();
 
-    const std::shared_ptr<ShaderBlob> GetShader(const std::string& shaderName) { return m_shaderMap[shaderName]; }
+    // bitmask of the axes named in defines, throws on an axis the shader doesn't declare
+    uint32_t GetPermutationKey(const std::string& shaderName, const std::vector<std::string>& defines) const;
+    // compiles the variants that are not compiled yet, every stage in parallel,
+    // throws once with the errors of all of them
+    void CompileVariants(const std::vector<std::pair<std::string, uint32_t>>& variants);
+    // throws when the variant was not compiled
+    const std::shared_ptr<ShaderBlob> GetShader(const std::string& shaderName, uint32_t permutation = 0) const;
+    // main thread, between frames. Polls the shader files when the hot reload is on (debug builds), recompiles the
+    // variants reading changed files in the background and swaps them in once they all compiled. Returns the variants
+    // swapped in, their PSOs have to be rebuilt. The replaced blobs are released once the GPU is done with them.
+    std::vector<std::pair<std::string, uint32_t>> UpdateHotReload();
+    // mesh vertex format from the config, shaders are compiled with COMPRESSED_VERTEX when set
+    bool IsVertexCompressed() const { return m_vertexCompressed; }
 
   private:
-    // function that reads and compiles all available shaders
+    // a shader of the config and the variants compiled so far
+    struct Shader
+    {
+      std::string path;
+      bool compute;
+      ShaderBackend backend;
+      // like "6_0", for DXC
+      std::string shaderModel;
+      // the define of axis i is set in the variants whose key has bit i
+      std::vector<std::string> axes;
+      std::unordered_map<uint32_t, std::shared_ptr<ShaderBlob>> variants;
+    };
+
+    // variants recompiling in the background
+    struct Reload;
+
+    // function that reads the available shaders, variants are compiled once requested
     void RegisterShaders();
+    // appends the stages of the variant, throws on a key with bits past the axes
+    void AddStages(const std::pair<std::string, uint32_t>& variant, std::vector<ShaderStage>& stages) const;
+    // the errors of all stages, empty when they all compiled
+    std::string CollectErrors(const std::vector<ShaderStage>& stages, uint32_t& cachedCount) const;
+    // blobs of the variants from their compiled stages, in the same order. Returns the variants stored, a variant
+    // whose blob can't be created keeps the previous one, and throws when there is none
+    std::vector<std::pair<std::string, uint32_t>> StoreVariants(const std::vector<std::pair<std::string, uint32_t>>& variants, const std::vector<ShaderStage>& stages);
+    // loads dxcompiler.dll, DXC shaders fall back to FXC without it or without shader model 6 on the device
+    void LoadDxc();
+    // fills the bytecode of the stage, from the cache when it has it, or its errors
+    // runs on any thread
+    void CompileStage(ShaderStage& stage) const;
+    void CompileFxc(ShaderStage& stage) const;
+    void CompileDxc(ShaderStage& stage) const;
+    // next to the cache entries, debuggers find it from the name left in the bytecode
+    void WritePdb(const std::filesystem::path& name, const void* data, size_t size) const;
 
   private:
     // shader map
-    std::unordered_map<std::string, std::shared_ptr<ShaderBlob>> m_shaderMap;
+    std::unordered_map<std::string, Shader> m_shaderMap;
+    bool m_vertexCompressed;
+    // defines of every variant, from the config
+    std::vector<std::pair<std::string, std::string>> m_defines;
+    // compiled stages, kept between runs
+    ShaderCache m_cache;
+    HMODULE m_dxcModule;
+    HMODULE m_dxilModule;
+    DxcCreateInstanceProc m_dxcCreateInstance;
+    // compiler and version in the cache keys
+    std::string m_dxcVersion;
+    // hot reload, no watcher when it is off
+    std::unique_ptr<ShaderWatcher> m_watcher;
+    ShaderDependencyGraph m_dependencies;
+    std::unique_ptr<Reload> m_reload;
+    std::chrono::steady_clock::time_point m_lastPoll;
 
   private:
     ShaderManager();
@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "ShaderWatcher.h"
+
+#include <system_error>
+
+namespace Shaders
+{
+  ShaderDependencyGraph::ShaderDependencyGraph()
+    : m_files()
+    , m_dependents()
+  {
+  }
+
+  ShaderDependencyGraph::~ShaderDependencyGraph()
+  {
+  }
+
+  void ShaderDependencyGraph::SetDependencies(const std::string& shader, const std::vector<std::filesystem::path>& files)
+  {
+    Remove(shader);
+
+    auto& shaderFiles = m_files[shader];
+    for (const auto& file : files)
+    {
+      const std::filesystem::path normalized = file.lexically_normal();
+      if (m_dependents[normalized].insert(shader).second)
+        shaderFiles.push_back(normalized);
+    }
+  }
+
+  void ShaderDependencyGraph::Remove(const std::string& shader)
+  {
+    auto files = m_files.find(shader);
+    if (files == m_files.end())
+      return;
+
+    for (const auto& file : files->second)
+    {
+      auto dependents = m_dependents.find(file);
+      dependents->second.erase(shader);
+      if (dependents->second.empty())
+        m_dependents.erase(dependents);
+    }
+    m_files.erase(files);
+  }
+
+  std::vector<std::string> ShaderDependencyGraph::GetAffectedShaders(const std::vector<std::filesystem::path>& files) const
+  {
+    std::set<std::string> affected;
+    for (const auto& file : files)
+    {
+      auto dependents = m_dependents.find(file.lexically_normal());
+      if (dependents != m_dependents.end())
+        affected.insert(dependents->second.begin(), dependents->second.end());
+    }
+    return std::vector<std::string>(affected.begin(), affected.end());
+  }
+
+  ShaderWatcher::ShaderWatcher(const std::filesystem::path& directory)
+    : m_directory(directory)
+    , m_times()
+  {
+    m_times = Scan();
+  }
+
+  ShaderWatcher::~ShaderWatcher()
+  {
+  }
+
+  std::vector<std::filesystem::path> ShaderWatcher::Poll()
+  {
+    auto times = Scan();
+
+    // both maps are sorted, one pass finds the written, added and removed files
+    std::vector<std::filesystem::path> changed;
+    auto before = m_times.begin();
+    auto now = times.begin();
+    while (before != m_times.end() || now != times.end())
+    {
+      if (now == times.end() || (before != m_times.end() && before->first < now->first))
+      {
+        changed.push_back((before++)->first);
+      } else if (before == m_times.end() || now->first < before->first)
+      {
+        changed.push_back((now++)->first);
+      } else
+      {
+        if (before->second != now->second)
+          changed.push_back(now->first);
+        ++before;
+        ++now;
+      }
+    }
+
+    m_times.swap(times);
+    return changed;
+  }
+
+  std::map<std::filesystem::path, std::filesystem::file_time_type> ShaderWatcher::Scan() const
+  {
+    // files can go away while they are listed, an editor saving through a temporary one
+    std::map<std::filesystem::path, std::filesystem::file_time_type> times;
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error))
+    {
+      std::error_code fileError;
+      if (!it->is_regular_file(fileError))
+        continue;
+      const auto time = it->last_write_time(fileError);
+      if (!fileError)
+        times[it->path().lexically_normal()] = time;
+    }
+    return times;
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Shaders
+{
+  // Which shaders read which files: their source and everything it includes, as found
+  // when they were compiled. Paths are compared once lexically normalized.
+  class ShaderDependencyGraph
+  {
+  public:
+    ShaderDependencyGraph();
+    ~ShaderDependencyGraph();
+
+    // replaces the files of the shader
+    void SetDependencies(const std::string& shader, const std::vector<std::filesystem::path>& files);
+    void Remove(const std::string& shader);
+    // shaders reading any of the files, sorted by name
+    std::vector<std::string> GetAffectedShaders(const std::vector<std::filesystem::path>& files) const;
+
+  private:
+    std::unordered_map<std::string, std::vector<std::filesystem::path>> m_files;
+    // the reverse, the shaders reading a file
+    std::map<std::filesystem::path, std::set<std::string>> m_dependents;
+
+  private:
+    ShaderDependencyGraph(const ShaderDependencyGraph&) = delete;
+    ShaderDependencyGraph& operator=(const ShaderDependencyGraph&) = delete;
+  };
+
+  // Polls the write times of the files under a directory, without a thread or OS notifications.
+  class ShaderWatcher
+  {
+  public:
+    // changes are relative to the files as they are now
+    explicit ShaderWatcher(const std::filesystem::path& directory);
+    ~ShaderWatcher();
+
+    // files written, added or removed since the last poll, normalized
+    std::vector<std::filesystem::path> Poll();
+
+  private:
+    std::map<std::filesystem::path, std::filesystem::file_time_type> Scan() const;
+
+  private:
+    std::filesystem::path m_directory;
+    std::map<std::filesystem::path, std::filesystem::file_time_type> m_times;
+
+  private:
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+  };
+}
@@ -9,23 +9,34 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include <stdexcept>
+
 namespace Textures
 {
   DX12Texture::DX12Texture(std::vector<std::string> paths, unsigned mips)
     : m_imgPtrs()
     , m_metaData()
+    , m_decoding()
     , m_mipsLevels(mips)
     , m_texture()
     , m_uploaded(false)
     , m_mipsGenerated(false)
   {
+    // only the headers, the resource can be created before the pixels are there
     for (const auto& path : paths)
     {
       MetaData metadata;
-      m_imgPtrs.emplace_back(stbi_load(path.c_str(), &metadata.width, &metadata.height, &metadata.channels, 4));
+      if (!stbi_info(path.c_str(), &metadata.width, &metadata.height, &metadata.channels))
+      {
+        char message[512];
+        snprintf(message, sizeof(message), "[TEXTURE] could not read %s: %s\n", path.c_str(), stbi_failure_reason());
+        OutputDebugStringA(message);
+        throw std::invalid_argument("[TEXTURE] TEXTURE COULD NOT BE READ !");
+      }
       metadata.channels = 4; // force to 4
       m_metaData.push_back(metadata);
     }
+    m_imgPtrs.assign(paths.size(), nullptr);
 
     D3D12_RESOURCE_DESC textureDesc = {};
     textureDesc.MipLevels = m_mipsLevels;
@@ -40,10 +51,34 @@ namespace Textures
 
     // don't generate mips for skybox
     m_texture = Graphics::ResourceManager::Instance().CreateTextureResource(textureDesc, m_imgPtrs.size() > 1, m_imgPtrs.size() == 1);
+
+    // started last, nothing throws once they reference the texture
+    // cubemap faces decode in parallel too
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+      Core::JobSystem::Instance().Run([this, path = paths[i], i]() {
+        MetaData decoded;
+        m_imgPtrs[i] = stbi_load(path.c_str(), &decoded.width, &decoded.height, &decoded.channels, 4);
+        if (!m_imgPtrs[i] || decoded.width != m_metaData[i].width || decoded.height != m_metaData[i].height)
+          throw std::invalid_argument("[TEXTURE] TEXTURE COULD NOT BE DECODED !");
+      }, &m_decoding);
+    }
   }
 
   DX12Texture::~DX12Texture()
   {
+    // the jobs write the images
+    try
+    {
+      Core::JobSystem::Instance().Wait(m_decoding);
+    } catch (const std::exception&)
+    {
+      // reported by CopyToGPU, or never needed
+    }
+    // never uploaded
+    for (auto ptr : m_imgPtrs)
+      stbi_image_free(ptr);
+
     m_texture.reset();
   }
 
@@ -53,8 +88,11 @@ namespace Textures
       return;
 
     m_uploaded = true;
-    // Copy data to the intermediate upload heap and then schedule 
-    // a copy from the upload heap to the diffuse texture.
+    // resolves the decode, the thread runs other jobs while waiting
+    Core::JobSystem::Instance().Wait(m_decoding);
+
+    // Copy data to the shared staging memory and then schedule 
+    // a copy from it to the diffuse texture.
     std::vector<D3D12_SUBRESOURCE_DATA> textureData(m_imgPtrs.size());
 
     for (unsigned i = 0; i < m_imgPtrs.size(); ++i)
@@ -67,12 +105,18 @@ namespace Textures
     const UINT subResourceCount = static_cast<unsigned>(1 * m_metaData.size());
     auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
       m_texture->resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    UpdateSubresources(commandList, m_texture->resource.Get(), m_texture->upload.Get(), 0, 0, subResourceCount, textureData.data());
+    // placed footprints have to start at a 512 bytes boundary
+    auto staging = Graphics::ResourceManager::Instance().ReserveStaging(
+      GetRequiredIntermediateSize(m_texture->resource.Get(), 0, subResourceCount), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    UpdateSubresources(commandList, m_texture->resource.Get(), staging.resource, staging.offset, 0, subResourceCount, textureData.data());
     commandList->ResourceBarrier(1, &barrier);
 
     // free
-    for (auto ptr : m_imgPtrs)
+    for (auto& ptr : m_imgPtrs)
+    {
       stbi_image_free(ptr);
+      ptr = nullptr;
+    }
   }
 
   void DX12Texture::GenerateMips(ID3D12GraphicsCommandList* commandList)
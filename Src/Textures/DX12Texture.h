@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Core/JobSystem.h"
+
 #include "Graphics/ResourceManager.h"
 
 using namespace DirectX;
@@ -10,13 +12,16 @@ namespace Textures
   class DX12Texture
   {
   public:
+    // reads the image headers and creates the resource, the images are decoded in jobs
     DX12Texture(std::vector<std::string> paths, unsigned mips = 4);
+    // waits for the decode jobs
     ~DX12Texture();
 
     Graphics::TextureDescriptor* GetResource() { return m_texture.get(); }
     
     unsigned GetMipsLevels() { return m_mipsLevels; }
     
+    // waits for the images first, rethrows a failed decode
     void CopyToGPU(ID3D12GraphicsCommandList* commandList);
     void GenerateMips(ID3D12GraphicsCommandList* commandList);
 
@@ -31,8 +36,10 @@ namespace Textures
     // descriptor to the heap
     std::shared_ptr<Graphics::TextureDescriptor> m_texture;
     
+    // written by the decode jobs, one image each
     std::vector<unsigned char*> m_imgPtrs;
     std::vector<MetaData> m_metaData;
+    Core::JobCounter m_decoding;
     unsigned m_mipsLevels;
 
     // indicate that this texture was already uploaded to the GPU
@@ -15,24 +15,28 @@ namespace Textures
 
   std::shared_ptr<DX12Texture> TextureManager::CreateOrGetTexture(const std::vector<std::string>& paths)
   {
-    std::hash<std::string> hashFct;
-    size_t hash = 0;
-    // generate the hash
-    for (auto path : paths)
-      hash += hashFct(path);
+    // the paths themselves, a hash of them could collide
+    std::string key;
+    for (const auto& path : paths)
+      key += path + '|';
+
+    // creating only reads the headers, the lock is held so a texture is never loaded twice
+    // while its decode is in flight, later requests get the texture and wait at upload
+    std::lock_guard<std::mutex> lock(m_mutex);
 
     // check if it exists
-    if (m_textures.find(hash) != m_textures.end())
-      if (std::shared_ptr<DX12Texture> shared = m_textures[hash].lock())
+    auto found = m_textures.find(key);
+    if (found != m_textures.end())
+      if (std::shared_ptr<DX12Texture> shared = found->second.lock())
         return shared;
 
     // does not exist
     // create it, and load it
     auto texture = std::make_shared<DX12Texture>(paths, paths.size() == 1 ? 4 : 1); // no mips for cubemap
-   
+
     // store in map, since it will be casted to weak ptr the ref count will not be increased
     // because when the texture is not used by anyone it is supposed to be freed
-    m_textures[hash] = texture;
+    m_textures[key] = texture;
 
     return texture;
   }
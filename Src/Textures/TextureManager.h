@@ -4,6 +4,7 @@
 
 #include "Textures/DX12Texture.h"
 
+#include <mutex>
 #include <unordered_map>
 
 using namespace DirectX;
@@ -22,12 +23,15 @@ namespace Textures
     }
     ~TextureManager();
 
+    // can be called from loader jobs, returns before the images are decoded
     std::shared_ptr<DX12Texture> CreateOrGetTexture(const std::vector<std::string>& paths);
 
   private:
     // when texture is deleted it will not be removed from this map
     // but the resource will be freed
-    std::unordered_map<size_t, std::weak_ptr<DX12Texture>> m_textures;
+    // keyed by the joined paths
+    std::unordered_map<std::string, std::weak_ptr<DX12Texture>> m_textures;
+    std::mutex m_mutex;
 
   private:
     TextureManager();
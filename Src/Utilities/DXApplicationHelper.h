@@ -198,6 +198,14 @@ namespace Utilities
   #define NAME_D3D12_OBJECT(x) SetName((x).Get(), L#x)
   #define NAME_D3D12_OBJECT_INDEXED(x, n) SetNameIndexed((x)[n].Get(), L#x, n)
 
+  // Per frame stats (staging, culling, recording ...etc) are only written to the debug output
+  // in builds defining FRAME_STATS, writing it every frame is slow with a debugger attached.
+  #if defined(FRAME_STATS)
+  constexpr bool FRAME_STATS_ENABLED = true;
+  #else
+  constexpr bool FRAME_STATS_ENABLED = false;
+  #endif
+
   inline UINT CalculateConstantBufferByteSize(UINT byteSize)
   {
     // Constant buffer size is required to be aligned.
@@ -0,0 +1,7 @@
+#include "TestFramework.h"
+
+// DX12EngineBenchmarks [suite], build with optimizations for meaningful numbers
+int main(int argc, char** argv)
+{
+  return Tests::Run(Tests::GetBenchmarks(), argc > 1 ? argv[1] : "");
+}
@@ -0,0 +1,48 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Core/JobSystem.h"
+
+using namespace Core;
+
+// cost of scheduling itself: the jobs do next to nothing
+BENCHMARK(JobSystem, SchedulingOverhead)
+{
+  const int JOBS = 200000;
+  JobSystem jobs(JobSystem::DefaultWorkerCount());
+  std::atomic<int> count(0);
+
+  // all submitted by the main thread
+  const double fromMain = Tests::MeasureMilliseconds(3, [&]() {
+    JobCounter counter;
+    for (int i = 0; i < JOBS; ++i)
+      jobs.Run([&count]() { count.fetch_add(1, std::memory_order_relaxed); }, &counter);
+    jobs.Wait(counter);
+  });
+
+  // spawned by jobs on the workers, each waiting on its own
+  const double fromWorkers = Tests::MeasureMilliseconds(3, [&]() {
+    JobCounter counter;
+    for (int i = 0; i < 64; ++i)
+    {
+      jobs.Run([&jobs, &count]()
+      {
+        JobCounter inner;
+        for (int k = 0; k < JOBS / 64; ++k)
+          jobs.Run([&count]() { count.fetch_add(1, std::memory_order_relaxed); }, &inner);
+        jobs.Wait(inner);
+      }, &counter);
+    }
+    jobs.Wait(counter);
+  });
+
+  // the shape of the per frame loops: a small ParallelFor of 4 batches
+  const int LOOPS = 10000;
+  const double parallelFor = Tests::MeasureMilliseconds(3, [&]() {
+    for (int i = 0; i < LOOPS; ++i)
+      jobs.ParallelFor(64, 16, [&count](size_t, size_t) { count.fetch_add(1, std::memory_order_relaxed); });
+  });
+
+  printf("  %u workers: %.0f ns per job from the main thread, %.0f ns from workers, %.2f us per 4 batch ParallelFor\n",
+    jobs.GetWorkerCount(), fromMain * 1e6 / JOBS, fromWorkers * 1e6 / (JOBS / 64 * 64), parallelFor * 1e3 / LOOPS);
+}
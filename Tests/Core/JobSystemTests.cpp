@@ -0,0 +1,304 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Core/JobSystem.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace Core;
+
+namespace
+{
+  // a few workers, more than the machine may have, so jobs really move between threads
+  const unsigned WORKERS = 3;
+}
+
+TEST(JobSystem, HundredThousandJobs)
+{
+  JobSystem jobs(WORKERS);
+  std::atomic<int> count(0);
+  JobCounter counter;
+  for (int i = 0; i < 100000; ++i)
+    jobs.Run([&count]() { count.fetch_add(1, std::memory_order_relaxed); }, &counter);
+  jobs.Wait(counter);
+
+  CHECK(counter.IsDone());
+  CHECK(count.load() == 100000);
+}
+
+TEST(JobSystem, NestedWaits)
+{
+  JobSystem jobs(WORKERS);
+  std::atomic<int> count(0);
+  JobCounter counter;
+  // every job waits on its own children, the waiting threads run other jobs meanwhile
+  for (int i = 0; i < 100; ++i)
+  {
+    jobs.Run([&jobs, &count]()
+    {
+      JobCounter inner;
+      for (int k = 0; k < 200; ++k)
+        jobs.Run([&count]() { count.fetch_add(1, std::memory_order_relaxed); }, &inner);
+      jobs.Wait(inner);
+    }, &counter);
+  }
+  jobs.Wait(counter);
+
+  CHECK(count.load() == 20000);
+}
+
+TEST(JobSystem, DequeOverflow)
+{
+  JobSystem jobs(WORKERS);
+  std::atomic<int> count(0);
+  JobCounter counter;
+  // more jobs than a deque holds pushed by one worker, the rest goes to the shared queue
+  jobs.Run([&jobs, &count]()
+  {
+    JobCounter inner;
+    for (int k = 0; k < 10000; ++k)
+      jobs.Run([&count]() { count.fetch_add(1, std::memory_order_relaxed); }, &inner);
+    jobs.Wait(inner);
+  }, &counter);
+  jobs.Wait(counter);
+
+  CHECK(count.load() == 10000);
+}
+
+TEST(JobSystem, Dependencies)
+{
+  JobSystem jobs(WORKERS);
+  std::mutex mutex;
+  std::vector<int> order;
+  auto append = [&mutex, &order](int value)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(value);
+  };
+
+  JobCounter first;
+  JobCounter second;
+  JobCounter third;
+  jobs.Run([&append]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    append(1);
+  }, &first);
+  jobs.RunAfter(first, [&append]() { append(2); }, &second);
+  jobs.RunAfter(second, [&append]() { append(3); }, &third);
+  jobs.Wait(third);
+  CHECK((order == std::vector<int>{ 1, 2, 3 }));
+
+  // already done, queued right away
+  JobCounter done;
+  jobs.RunAfter(done, [&append]() { append(4); }, &third);
+  jobs.Wait(third);
+  CHECK(order.size() == 4);
+}
+
+TEST(JobSystem, ParallelForCoversEveryIndexOnce)
+{
+  JobSystem jobs(WORKERS);
+  std::vector<std::atomic<int>> hits(100003);
+  jobs.ParallelFor(hits.size(), 97, [&hits](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+      hits[i].fetch_add(1, std::memory_order_relaxed);
+  });
+
+  bool once = true;
+  for (const auto& hit : hits)
+    once &= hit.load() == 1;
+  CHECK(once);
+}
+
+TEST(JobSystem, Exceptions)
+{
+  JobSystem jobs(WORKERS);
+
+  JobCounter counter;
+  std::atomic<int> ran(0);
+  for (int i = 0; i < 50; ++i)
+  {
+    jobs.Run([i, &ran]()
+    {
+      ran.fetch_add(1);
+      if (i == 17)
+        throw std::runtime_error("job");
+    }, &counter);
+  }
+  bool thrown = false;
+  try
+  {
+    jobs.Wait(counter);
+  }
+  catch (const std::runtime_error&)
+  {
+    thrown = true;
+  }
+  // the other jobs still ran
+  CHECK(thrown);
+  CHECK(ran.load() == 50);
+
+  thrown = false;
+  try
+  {
+    jobs.ParallelFor(1000, 10, [](size_t begin, size_t)
+    {
+      if (begin == 500)
+        throw std::out_of_range("batch");
+    });
+  }
+  catch (const std::out_of_range&)
+  {
+    thrown = true;
+  }
+  CHECK(thrown);
+
+  // still usable afterwards
+  JobCounter after;
+  jobs.Run([&ran]() { ran.fetch_add(1); }, &after);
+  jobs.Wait(after);
+  CHECK(ran.load() == 51);
+}
+
+TEST(JobSystem, UnhandledExceptions)
+{
+  // fire and forget jobs that throw, on the workers, keep the pool alive
+  JobSystem jobs(WORKERS);
+  std::atomic<int> thrown(0);
+  for (int i = 0; i < 20; ++i)
+  {
+    jobs.Run([&thrown]()
+    {
+      thrown.fetch_add(1);
+      throw std::runtime_error("decode");
+    });
+  }
+
+  // the pool still runs everything afterwards
+  JobCounter counter;
+  std::atomic<int> ran(0);
+  for (int i = 0; i < 1000; ++i)
+    jobs.Run([&ran]() { ran.fetch_add(1); }, &counter);
+  jobs.Wait(counter);
+  CHECK(ran.load() == 1000);
+
+  // all of them ran, the counted ones don't count as unhandled
+  while (thrown.load() < 20)
+    std::this_thread::yield();
+  JobCounter other;
+  jobs.Run([]() { throw std::out_of_range("counted"); }, &other);
+  CHECK_THROWS(jobs.Wait(other), std::out_of_range);
+
+  size_t count = 0;
+  std::exception_ptr exception;
+  // the last throwing job may still be between its throw and the report
+  for (int spin = 0; count < 20 && spin < 100000; ++spin)
+  {
+    size_t taken = 0;
+    std::exception_ptr next = jobs.TakeUnhandledException(&taken);
+    exception = exception ? exception : next;
+    count += taken;
+    std::this_thread::yield();
+  }
+  CHECK(count == 20);
+  REQUIRE(exception);
+  CHECK_THROWS(std::rethrow_exception(exception), std::runtime_error);
+  CHECK(!jobs.TakeUnhandledException());
+}
+
+TEST(JobSystem, MainThreadAffinity)
+{
+  JobSystem jobs(WORKERS);
+  const std::thread::id mainThread = std::this_thread::get_id();
+  std::atomic<int> wrongThread(0);
+  std::atomic<int> count(0);
+
+  // queued from workers
+  JobCounter counter;
+  JobCounter queued;
+  for (int i = 0; i < 100; ++i)
+  {
+    jobs.Run([&]()
+    {
+      jobs.Run([&]()
+      {
+        if (std::this_thread::get_id() != mainThread)
+          wrongThread.fetch_add(1);
+        count.fetch_add(1);
+      }, &queued, MainThread);
+    }, &counter);
+  }
+
+  // waits on the main thread, nested in a ParallelFor too, leave them alone
+  jobs.Wait(counter);
+  jobs.ParallelFor(64, 1, [&](size_t, size_t)
+  {
+    JobCounter inner;
+    jobs.Run([]() {}, &inner);
+    jobs.Wait(inner);
+  });
+  CHECK(count.load() == 0);
+  CHECK(!queued.IsDone());
+
+  // only RunMainThreadJobs, between frames, runs them
+  jobs.RunMainThreadJobs();
+  CHECK(queued.IsDone());
+  CHECK(wrongThread.load() == 0);
+  CHECK(count.load() == 100);
+
+  // continuations with main thread affinity, the way loaded models join the scene
+  JobCounter loading;
+  JobCounter joined;
+  std::vector<int> scene;
+  for (int i = 0; i < 20; ++i)
+    jobs.Run([]() { std::this_thread::sleep_for(std::chrono::microseconds(100)); }, &loading);
+  jobs.RunAfter(loading, [&scene]() { scene.push_back(1); }, &joined, MainThread);
+  jobs.Wait(loading);
+  CHECK(scene.empty());
+  while (!joined.IsDone())
+    jobs.RunMainThreadJobs();
+  CHECK(scene.size() == 1);
+}
+
+TEST(JobSystem, OtherThreadsSubmit)
+{
+  JobSystem jobs(WORKERS);
+  std::atomic<int> count(0);
+  // many short lived counters from a thread the system doesn't know, and from the main thread
+  auto submit = [&jobs, &count]()
+  {
+    for (int round = 0; round < 200; ++round)
+    {
+      JobCounter counter;
+      for (int i = 0; i < 50; ++i)
+        jobs.Run([&count]() { count.fetch_add(1, std::memory_order_relaxed); }, &counter);
+      jobs.Wait(counter);
+    }
+  };
+  std::thread other(submit);
+  submit();
+  other.join();
+
+  CHECK(count.load() == 20000);
+}
+
+TEST(JobSystem, WakesAfterSleeping)
+{
+  JobSystem jobs(WORKERS);
+  for (int round = 0; round < 3; ++round)
+  {
+    // long enough for the workers to go to sleep
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::atomic<int> count(0);
+    JobCounter counter;
+    for (int i = 0; i < 16; ++i)
+      jobs.Run([&count]() { count.fetch_add(1); }, &counter);
+    jobs.Wait(counter);
+    CHECK(count.load() == 16);
+  }
+}
@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/CommandRecorder.h"
+
+#include <cstring>
+#include <random>
+
+using Graphics::CommandRecorder;
+
+namespace
+{
+  // what the command list would have bound, and how many calls reached it
+  class MockTarget : public Graphics::CommandTarget
+  {
+  public:
+    uint32_t calls[CommandRecorder::NumCommands] = {};
+    ID3D12PipelineState* pso = nullptr;
+    ID3D12RootSignature* rootSignature = nullptr;
+    ID3D12DescriptorHeap* heap = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    D3D12_VERTEX_BUFFER_VIEW vertexBuffer = {};
+    D3D12_INDEX_BUFFER_VIEW indexBuffer = {};
+    D3D12_GPU_VIRTUAL_ADDRESS constantBuffers[4] = {};
+    uint64_t tables[4] = {};
+    uint32_t constants[4][8] = {};
+
+    virtual void SetPipelineState(ID3D12PipelineState* value) override
+    {
+      ++calls[CommandRecorder::PipelineState];
+      pso = value;
+    }
+
+    virtual void SetGraphicsRootSignature(ID3D12RootSignature* value) override
+    {
+      ++calls[CommandRecorder::RootSignature];
+      rootSignature = value;
+      // a new root signature leaves the root arguments undefined
+      std::memset(constantBuffers, 0xcd, sizeof(constantBuffers));
+      std::memset(tables, 0xcd, sizeof(tables));
+      std::memset(constants, 0xcd, sizeof(constants));
+    }
+
+    virtual void SetDescriptorHeaps(UINT, ID3D12DescriptorHeap* const* heaps) override
+    {
+      ++calls[CommandRecorder::DescriptorHeaps];
+      heap = heaps[0];
+    }
+
+    virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY value) override
+    {
+      ++calls[CommandRecorder::PrimitiveTopology];
+      topology = value;
+    }
+
+    virtual void IASetVertexBuffers(UINT, UINT, const D3D12_VERTEX_BUFFER_VIEW* views) override
+    {
+      ++calls[CommandRecorder::VertexBuffers];
+      vertexBuffer = views[0];
+    }
+
+    virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view) override
+    {
+      ++calls[CommandRecorder::IndexBuffer];
+      indexBuffer = *view;
+    }
+
+    virtual void SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address) override
+    {
+      ++calls[CommandRecorder::RootConstantBufferView];
+      constantBuffers[parameter] = address;
+    }
+
+    virtual void SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE table) override
+    {
+      ++calls[CommandRecorder::RootDescriptorTable];
+      tables[parameter] = table.ptr;
+    }
+
+    virtual void SetGraphicsRoot32BitConstants(UINT parameter, UINT count, const void* data, UINT offset) override
+    {
+      ++calls[CommandRecorder::Root32BitConstants];
+      std::memcpy(constants[parameter] + offset, data, count * sizeof(uint32_t));
+    }
+  };
+}
+
+TEST(CommandRecorder, DropsRedundantCalls)
+{
+  MockTarget target;
+  CommandRecorder recorder(&target);
+  ID3D12PipelineState psos[2];
+  ID3D12RootSignature rootSignature;
+
+  recorder.SetPipelineState(&psos[0]);
+  recorder.SetPipelineState(&psos[0]);
+  recorder.SetPipelineState(&psos[1]);
+  CHECK(target.calls[CommandRecorder::PipelineState] == 2);
+  CHECK(target.pso == &psos[1]);
+
+  recorder.SetGraphicsRootSignature(&rootSignature);
+  recorder.SetGraphicsRootConstantBufferView(1, 256);
+  recorder.SetGraphicsRootConstantBufferView(1, 256);
+  CHECK(target.calls[CommandRecorder::RootConstantBufferView] == 1);
+
+  // the same root signature again keeps the root arguments
+  recorder.SetGraphicsRootSignature(&rootSignature);
+  recorder.SetGraphicsRootConstantBufferView(1, 256);
+  CHECK(target.calls[CommandRecorder::RootSignature] == 1);
+  CHECK(target.calls[CommandRecorder::RootConstantBufferView] == 1);
+
+  const auto& counters = recorder.GetCounters();
+  CHECK(counters.issued[CommandRecorder::PipelineState] == 2);
+  CHECK(counters.elided[CommandRecorder::PipelineState] == 1);
+  CHECK(counters.elided[CommandRecorder::RootSignature] == 1);
+  CHECK(counters.elided[CommandRecorder::RootConstantBufferView] == 2);
+
+  recorder.ResetCounters();
+  CHECK(recorder.GetCounters().TotalIssued() == 0);
+  CHECK(recorder.GetCounters().TotalElided() == 0);
+}
+
+TEST(CommandRecorder, InvalidateIssuesEverythingAgain)
+{
+  MockTarget target;
+  CommandRecorder recorder(&target);
+  ID3D12PipelineState pso;
+  ID3D12RootSignature rootSignature;
+  ID3D12DescriptorHeap heap;
+  ID3D12DescriptorHeap* heaps[] = { &heap };
+  const D3D12_INDEX_BUFFER_VIEW indexBuffer = { 4096, 1024, 57 };
+  const uint32_t constants[2] = { 1, 2 };
+
+  auto record = [&]()
+  {
+    recorder.SetPipelineState(&pso);
+    recorder.SetGraphicsRootSignature(&rootSignature);
+    recorder.SetDescriptorHeaps(1, heaps);
+    recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    recorder.IASetIndexBuffer(&indexBuffer);
+    recorder.SetGraphicsRoot32BitConstants(3, 2, constants, 0);
+  };
+
+  record();
+  record();
+  CHECK(recorder.GetCounters().TotalIssued() == 6);
+  CHECK(recorder.GetCounters().TotalElided() == 6);
+
+  // something recorded behind its back
+  recorder.Invalidate();
+  record();
+  CHECK(recorder.GetCounters().TotalIssued() == 12);
+  uint32_t calls = 0;
+  for (uint32_t count : target.calls)
+    calls += count;
+  CHECK(calls == 12);
+}
+
+TEST(CommandRecorder, BoundStateMatchesRandomStream)
+{
+  MockTarget target;
+  CommandRecorder recorder(&target);
+  ID3D12PipelineState psos[3];
+  ID3D12RootSignature rootSignatures[2];
+  ID3D12DescriptorHeap heap;
+  ID3D12DescriptorHeap* heaps[] = { &heap };
+  std::mt19937 random(1);
+
+  // after every call the mock, what the GPU would see, holds what was asked for
+  bool match = true;
+  recorder.SetGraphicsRootSignature(&rootSignatures[0]);
+  for (int i = 0; i < 50000; ++i)
+  {
+    if (random() % 1000 == 0)
+      recorder.Invalidate();
+
+    ID3D12PipelineState* pso = &psos[random() % 3];
+    recorder.SetPipelineState(pso);
+    match &= target.pso == pso;
+
+    if (random() % 8 == 0)
+    {
+      ID3D12RootSignature* rootSignature = &rootSignatures[random() % 2];
+      recorder.SetGraphicsRootSignature(rootSignature);
+      match &= target.rootSignature == rootSignature;
+    }
+
+    recorder.SetDescriptorHeaps(1, heaps);
+    match &= target.heap == &heap;
+    recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    match &= target.topology == D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+    const D3D12_VERTEX_BUFFER_VIEW vertexBuffer = { (random() % 3) * 4096ull, 4096, 16 };
+    recorder.IASetVertexBuffers(0, 1, &vertexBuffer);
+    match &= std::memcmp(&target.vertexBuffer, &vertexBuffer, sizeof(vertexBuffer)) == 0;
+    const D3D12_INDEX_BUFFER_VIEW indexBuffer = { (random() % 2) * 4096ull, 4096, 57 };
+    recorder.IASetIndexBuffer(&indexBuffer);
+    match &= std::memcmp(&target.indexBuffer, &indexBuffer, sizeof(indexBuffer)) == 0;
+
+    const D3D12_GPU_VIRTUAL_ADDRESS address = (random() % 4) * 256;
+    recorder.SetGraphicsRootConstantBufferView(0, 77);
+    recorder.SetGraphicsRootConstantBufferView(1, address);
+    match &= target.constantBuffers[0] == 77 && target.constantBuffers[1] == address;
+
+    const D3D12_GPU_DESCRIPTOR_HANDLE table = { random() % 5 };
+    recorder.SetGraphicsRootDescriptorTable(2, table);
+    match &= target.tables[2] == table.ptr;
+
+    uint32_t constants[8];
+    for (auto& constant : constants)
+      constant = random() % 2;
+    recorder.SetGraphicsRoot32BitConstants(3, 8, constants, 0);
+    match &= std::memcmp(target.constants[3], constants, sizeof(constants)) == 0;
+  }
+  CHECK(match);
+
+  // every issued call reached the target, and most were dropped
+  uint32_t calls = 0;
+  for (uint32_t count : target.calls)
+    calls += count;
+  CHECK(recorder.GetCounters().TotalIssued() == calls);
+  CHECK(recorder.GetCounters().TotalElided() > calls);
+}
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/DescriptorAllocator.h"
+
+#include <thread>
+
+using Graphics::DescriptorAllocator;
+
+// helpers
+namespace
+{
+  const unsigned SLOTS = 30000;
+  const unsigned PAIRS = 100000;
+
+  // what the allocator replaced: a vector of free slots taken from the front under a mutex
+  class VectorAllocator
+  {
+  public:
+    explicit VectorAllocator(unsigned count)
+    {
+      for (unsigned i = 0; i < count; ++i)
+        m_free.push_back(i);
+    }
+
+    unsigned Allocate()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const unsigned index = m_free.front();
+      m_free.erase(m_free.begin());
+      return index;
+    }
+
+    void Free(unsigned index)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_free.push_back(index);
+    }
+
+  private:
+    std::vector<unsigned> m_free;
+    std::mutex m_mutex;
+  };
+}
+
+BENCHMARK(DescriptorAllocator, AllocateFreePairs)
+{
+  DescriptorAllocator allocator(0, SLOTS);
+  const double lockFree = Tests::MeasureMilliseconds(5, [&]() {
+    for (unsigned i = 0; i < PAIRS; ++i)
+      allocator.Free(allocator.Allocate());
+  });
+
+  VectorAllocator vector(SLOTS);
+  const double locked = Tests::MeasureMilliseconds(1, [&]() {
+    for (unsigned i = 0; i < PAIRS; ++i)
+      vector.Free(vector.Allocate());
+  });
+
+  printf("  %u alloc/free pairs over %u slots: %.2f ms lock-free, %.2f ms vector\n", PAIRS, SLOTS, lockFree, locked);
+}
+
+BENCHMARK(DescriptorAllocator, ContendedPairs)
+{
+  const unsigned threadCount = std::max(2u, std::thread::hardware_concurrency());
+  DescriptorAllocator allocator(0, SLOTS);
+  const double milliseconds = Tests::MeasureMilliseconds(3, [&]() {
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+      threads.emplace_back([&]() {
+        for (unsigned i = 0; i < PAIRS / threadCount; ++i)
+          allocator.Free(allocator.Allocate());
+      });
+    }
+    for (auto& thread : threads)
+      thread.join();
+  });
+
+  printf("  %u alloc/free pairs on %u threads: %.2f ms\n", PAIRS, threadCount, milliseconds);
+}
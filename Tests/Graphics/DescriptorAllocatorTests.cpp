@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/DescriptorAllocator.h"
+
+#include <stdexcept>
+#include <thread>
+
+using Graphics::DescriptorAllocator;
+
+TEST(DescriptorAllocator, HandsOutTheRangeInOrder)
+{
+  DescriptorAllocator allocator(100, 1000);
+  for (unsigned i = 0; i < 1000; ++i)
+    CHECK(allocator.Allocate() == 100 + i);
+  CHECK(allocator.Allocate() == DescriptorAllocator::InvalidIndex);
+  CHECK(allocator.GetUsed() == 1000);
+  CHECK(allocator.GetHighWater() == 1000);
+}
+
+TEST(DescriptorAllocator, ReusesFreedSlotsFirst)
+{
+  DescriptorAllocator allocator(0, 16);
+  for (unsigned i = 0; i < 16; ++i)
+    allocator.Allocate();
+
+  allocator.Free(5);
+  allocator.Free(9);
+  CHECK(allocator.GetUsed() == 14);
+  CHECK(allocator.Allocate() == 9);
+  CHECK(allocator.Allocate() == 5);
+  CHECK(allocator.Allocate() == DescriptorAllocator::InvalidIndex);
+  CHECK(allocator.GetHighWater() == 16);
+}
+
+TEST(DescriptorAllocator, HandsOutBlocks)
+{
+  // a partial block at the end of the range is never handed out
+  DescriptorAllocator allocator(15000, 10, 4);
+  CHECK(allocator.GetCapacity() == 8);
+  CHECK(allocator.Allocate() == 15000);
+  CHECK(allocator.Allocate() == 15004);
+  CHECK(allocator.Allocate() == DescriptorAllocator::InvalidIndex);
+  CHECK(allocator.GetUsed() == 8);
+
+  // any slot of a block frees the block
+  allocator.Free(15006);
+  CHECK(allocator.Allocate() == 15004);
+}
+
+TEST(DescriptorAllocator, RejectsForeignIndices)
+{
+  DescriptorAllocator allocator(10, 4);
+  CHECK(!allocator.Owns(9));
+  CHECK(allocator.Owns(13));
+  CHECK(!allocator.Owns(14));
+  CHECK_THROWS(allocator.Free(14), std::out_of_range);
+  CHECK_THROWS(DescriptorAllocator(0, 4, 0), std::invalid_argument);
+}
+
+TEST(DescriptorAllocator, EmptyRange)
+{
+  DescriptorAllocator allocator(0, 0);
+  CHECK(allocator.Allocate() == DescriptorAllocator::InvalidIndex);
+  CHECK(allocator.GetCapacity() == 0);
+}
+
+TEST(DescriptorAllocator, ConcurrentAllocateAndFree)
+{
+  // every slot has at most one owner at a time, run under TSAN too
+  const unsigned SLOTS = 4096;
+  const unsigned THREADS = 8;
+  DescriptorAllocator allocator(0, SLOTS);
+  std::unique_ptr<std::atomic<int>[]> owners = std::make_unique<std::atomic<int>[]>(SLOTS);
+  std::atomic<unsigned> doubleOwned(0);
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&]() {
+      std::vector<unsigned> owned;
+      for (int i = 0; i < 50000; ++i)
+      {
+        if (owned.size() < 300 && (i & 3) != 3)
+        {
+          const unsigned index = allocator.Allocate();
+          if (index == DescriptorAllocator::InvalidIndex)
+            continue;
+          if (owners[index].fetch_add(1) != 0)
+            doubleOwned++;
+          owned.push_back(index);
+        } else if (!owned.empty())
+        {
+          const unsigned index = owned.back();
+          owned.pop_back();
+          owners[index].fetch_sub(1);
+          allocator.Free(index);
+        }
+      }
+      for (unsigned index : owned)
+      {
+        owners[index].fetch_sub(1);
+        allocator.Free(index);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  CHECK(doubleOwned == 0);
+  CHECK(allocator.GetUsed() == 0);
+  CHECK(allocator.GetHighWater() <= THREADS * 300);
+
+  // everything came back
+  unsigned count = 0;
+  while (allocator.Allocate() != DescriptorAllocator::InvalidIndex)
+    ++count;
+  CHECK(count == SLOTS);
+}
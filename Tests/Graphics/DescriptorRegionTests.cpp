@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/DescriptorRegion.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+using Graphics::DescriptorAllocator;
+using Graphics::DescriptorRegion;
+
+TEST(DescriptorRegion, GrowsWithPagesOfThePool)
+{
+  // 4 pages of 16 slots
+  DescriptorAllocator pool(100, 64, 16);
+  DescriptorRegion region("Textures", 0, 10, 1, &pool);
+
+  std::vector<unsigned> indices;
+  for (unsigned i = 0; i < 10 + 64; ++i)
+  {
+    const unsigned index = region.Allocate();
+    REQUIRE(index != DescriptorAllocator::InvalidIndex);
+    indices.push_back(index);
+  }
+  CHECK(region.Allocate() == DescriptorAllocator::InvalidIndex);
+
+  const DescriptorRegion::Stats stats = region.GetStats();
+  CHECK(stats.pages == 4);
+  CHECK(stats.capacity == 74);
+  CHECK(stats.used == 74);
+  CHECK(pool.GetUsed() == 64);
+
+  for (unsigned index : indices)
+    region.Free(index);
+  CHECK(region.GetStats().used == 0);
+  CHECK(region.GetStats().highWater == 74);
+}
+
+TEST(DescriptorRegion, GivesEmptyPagesBack)
+{
+  DescriptorAllocator pool(100, 64, 16);
+  DescriptorRegion first("First", 0, 10, 1, &pool);
+  DescriptorRegion second("Second", 10, 10, 1, &pool);
+
+  // the first region takes the whole pool for a moment
+  std::vector<unsigned> indices;
+  for (unsigned i = 0; i < 10 + 64; ++i)
+    indices.push_back(first.Allocate());
+  CHECK(second.Allocate() == 10);
+  for (unsigned i = 1; i < 10; ++i)
+    second.Allocate();
+  CHECK(second.Allocate() == DescriptorAllocator::InvalidIndex);
+
+  for (unsigned index : indices)
+    first.Free(index);
+  CHECK(first.GetStats().pages == 0);
+  CHECK(first.GetStats().capacity == 10);
+  CHECK(pool.GetUsed() == 0);
+
+  // the other region can use the space now
+  for (unsigned i = 0; i < 64; ++i)
+    CHECK(second.Allocate() != DescriptorAllocator::InvalidIndex);
+  CHECK(second.GetStats().pages == 4);
+}
+
+TEST(DescriptorRegion, KeepsAPageWhileTheRegionIsNearlyFull)
+{
+  DescriptorAllocator pool(100, 64, 16);
+  DescriptorRegion region("Buffers", 0, 10, 1, &pool);
+
+  for (unsigned i = 0; i < 10; ++i)
+    region.Allocate();
+  const unsigned index = region.Allocate();
+  CHECK(index >= 100);
+
+  // the reserved range is still full, the page would be taken again right away
+  region.Free(index);
+  CHECK(region.GetStats().pages == 1);
+  CHECK(pool.GetUsed() == 16);
+  CHECK(region.Allocate() == index);
+}
+
+TEST(DescriptorRegion, FixedRegionDoesNotGrow)
+{
+  DescriptorRegion region("Fixed", 0, 8, 4, nullptr);
+  CHECK(region.Allocate() == 0);
+  CHECK(region.Allocate() == 4);
+  CHECK(region.Allocate() == DescriptorAllocator::InvalidIndex);
+  CHECK_THROWS(region.Free(100), std::out_of_range);
+}
+
+TEST(DescriptorRegion, ConcurrentChurn)
+{
+  // threads take and give back pages all the time, an index is never held twice
+  DescriptorAllocator pool(1000, 64 * 32, 32);
+  DescriptorRegion region("Churn", 0, 16, 1, &pool);
+
+  std::vector<std::atomic<bool>> held(1000 + 64 * 32);
+  std::atomic<unsigned> duplicates(0);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&]()
+    {
+      std::vector<unsigned> indices;
+      for (unsigned round = 0; round < 200; ++round)
+      {
+        for (unsigned i = 0; i < 40; ++i)
+        {
+          const unsigned index = region.Allocate();
+          if (index == DescriptorAllocator::InvalidIndex)
+            continue;
+          if (held[index].exchange(true))
+            duplicates.fetch_add(1);
+          indices.push_back(index);
+        }
+        for (unsigned index : indices)
+        {
+          held[index].store(false);
+          region.Free(index);
+        }
+        indices.clear();
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  CHECK(duplicates.load() == 0);
+  CHECK(region.GetStats().used == 0);
+  // a page emptied while the rest was full is kept until another page empties
+  CHECK(pool.GetUsed() == region.GetStats().pages * 32);
+}
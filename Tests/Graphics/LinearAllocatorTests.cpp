@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/LinearAllocator.h"
+
+#include <stdexcept>
+#include <thread>
+
+using Graphics::LinearAllocator;
+
+namespace
+{
+  // D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+  const size_t Alignment = 256;
+}
+
+TEST(LinearAllocator, AlignsConstants)
+{
+  LinearAllocator allocator(64 * 1024, 3);
+  CHECK(allocator.GetCapacity() == 3 * 64 * 1024);
+
+  size_t previousEnd = 0;
+  for (size_t size : { 1, 64, 255, 256, 257, 1000, 4096, 3 })
+  {
+    const size_t offset = allocator.Allocate(size, Alignment);
+    REQUIRE(offset != LinearAllocator::InvalidOffset);
+    CHECK(offset % Alignment == 0);
+    CHECK(offset >= previousEnd);
+    // no more padding than the alignment needs
+    CHECK(offset - previousEnd < Alignment);
+    previousEnd = offset + size;
+  }
+  CHECK(allocator.GetUsed() == previousEnd);
+
+  // offsets are from the start of the buffer, the region is aligned too
+  allocator.Reset(1);
+  CHECK(allocator.GetActiveRegion() == 1);
+  CHECK(allocator.GetUsed() == 0);
+  CHECK(allocator.Allocate(16, Alignment) == 64 * 1024);
+  CHECK(allocator.Allocate(16, Alignment) == 64 * 1024 + Alignment);
+}
+
+TEST(LinearAllocator, ReusesRegionsAfterReset)
+{
+  const size_t regionSize = 4096;
+  LinearAllocator allocator(regionSize, 3);
+
+  // frames go round the regions, each one starts from the beginning of its region again
+  for (unsigned frame = 0; frame < 9; ++frame)
+  {
+    const unsigned region = frame % 3;
+    allocator.Reset(region);
+    for (unsigned i = 0; i < 1 + frame; ++i)
+      CHECK(allocator.Allocate(200, Alignment) == region * regionSize + i * Alignment);
+  }
+
+  // the peak is per region, not added up over frames
+  CHECK(allocator.GetPeak() == 8 * Alignment + 200);
+  CHECK_THROWS(allocator.Reset(3), std::out_of_range);
+  CHECK_THROWS(LinearAllocator(regionSize, 0), std::invalid_argument);
+}
+
+TEST(LinearAllocator, FullRegionFailsCleanly)
+{
+  const size_t regionSize = 4096;
+  LinearAllocator allocator(regionSize, 2);
+
+  // exactly full
+  for (unsigned i = 0; i < regionSize / Alignment; ++i)
+    CHECK(allocator.Allocate(Alignment, Alignment) == i * Alignment);
+  CHECK(allocator.Allocate(1, Alignment) == LinearAllocator::InvalidOffset);
+  CHECK(allocator.GetUsed() == regionSize);
+
+  // a failed allocation doesn't spill into the next region, nor take anything
+  allocator.Reset(0);
+  CHECK(allocator.Allocate(regionSize - 100, Alignment) == 0);
+  CHECK(allocator.Allocate(200, Alignment) == LinearAllocator::InvalidOffset);
+  CHECK(allocator.Allocate(regionSize + 1, Alignment) == LinearAllocator::InvalidOffset);
+  CHECK(allocator.GetUsed() == regionSize - 100);
+  // what still fits, after the padding
+  CHECK(allocator.Allocate(50, 4) == regionSize - 100);
+
+  // sizes that would wrap the offset around
+  allocator.Reset(1);
+  CHECK(allocator.Allocate(~static_cast<size_t>(0) - 10, Alignment) == LinearAllocator::InvalidOffset);
+  CHECK(allocator.Allocate(16, Alignment) == regionSize);
+}
+
+TEST(LinearAllocator, ConcurrentAllocate)
+{
+  // recording threads allocate together, every range is theirs alone, run under TSAN too
+  const unsigned THREADS = 8;
+  const size_t regionSize = 1024 * 1024;
+  LinearAllocator allocator(regionSize, 2);
+  allocator.Reset(1);
+
+  std::vector<std::vector<std::pair<size_t, size_t>>> ranges(THREADS);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      // sizes vary so threads race on different amounts of padding
+      for (size_t i = 0;; ++i)
+      {
+        const size_t size = 16 + (i * 37 + t * 101) % 700;
+        const size_t offset = allocator.Allocate(size, Alignment);
+        if (offset == LinearAllocator::InvalidOffset)
+          break;
+        ranges[t].emplace_back(offset, size);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  std::vector<std::pair<size_t, size_t>> all;
+  for (const auto& owned : ranges)
+    all.insert(all.end(), owned.begin(), owned.end());
+  std::sort(all.begin(), all.end());
+
+  bool valid = !all.empty();
+  for (size_t i = 0; i < all.size(); ++i)
+  {
+    valid &= all[i].first % Alignment == 0;
+    valid &= all[i].first >= regionSize && all[i].first + all[i].second <= 2 * regionSize;
+    if (i > 0)
+      valid &= all[i - 1].first + all[i - 1].second <= all[i].first;
+  }
+  CHECK(valid);
+  // the region is used up to the last allocation
+  CHECK(allocator.GetUsed() == all.back().first + all.back().second - regionSize);
+  CHECK(allocator.GetPeak() == allocator.GetUsed());
+}
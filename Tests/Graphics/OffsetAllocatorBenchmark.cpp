@@ -0,0 +1,48 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/OffsetAllocator.h"
+
+#include <random>
+
+using Graphics::OffsetAllocator;
+
+// mesh streaming: ranges the size of vertex and index buffers come and go in a page
+BENCHMARK(OffsetAllocator, Churn)
+{
+  const uint32_t PAGE = 32u << 20;
+  const int OPERATIONS = 1000000;
+
+  OffsetAllocator allocator(PAGE);
+  std::vector<OffsetAllocator::Allocation> live;
+  live.reserve(OPERATIONS);
+  std::mt19937 random(7);
+  size_t failed = 0;
+
+  const double milliseconds = Tests::MeasureMilliseconds(1, [&]() {
+    for (int i = 0; i < OPERATIONS; ++i)
+    {
+      if (!live.empty() && (random() % 100) < 48)
+      {
+        // anywhere in the live set, so holes open all over the page
+        const size_t index = random() % live.size();
+        allocator.Free(live[index]);
+        live[index] = live.back();
+        live.pop_back();
+        continue;
+      }
+
+      // mostly small meshes, a few big ones
+      const uint32_t size = random() % 16 == 0 ? 16384 + random() % 262144 : 64 + random() % 8192;
+      auto allocation = allocator.Allocate(size);
+      if (allocation.offset == OffsetAllocator::InvalidOffset)
+        ++failed;
+      else
+        live.push_back(allocation);
+    }
+  });
+
+  const auto stats = allocator.GetStats();
+  printf("  %d operations: %.2f ms (%.1f ns each), %zu live, %zu failed, %u free regions, fragmentation %.3f\n",
+    OPERATIONS, milliseconds, milliseconds * 1e6 / OPERATIONS, live.size(), failed, stats.freeRegions, stats.fragmentation);
+}
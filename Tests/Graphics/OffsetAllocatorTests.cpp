@@ -0,0 +1,154 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/OffsetAllocator.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+
+using Graphics::OffsetAllocator;
+
+TEST(OffsetAllocator, WholeSpace)
+{
+  OffsetAllocator allocator(1000);
+  auto all = allocator.Allocate(1000);
+  CHECK(all.offset == 0);
+  CHECK(allocator.Allocate(1).offset == OffsetAllocator::InvalidOffset);
+
+  allocator.Free(all);
+  auto stats = allocator.GetStats();
+  CHECK(stats.totalFree == 1000);
+  CHECK(stats.largestFree == 1000);
+  CHECK(stats.freeRegions == 1);
+  CHECK(stats.allocations == 0);
+  CHECK(stats.fragmentation == 0.0f);
+
+  // the biggest space the bins cover
+  OffsetAllocator big(1u << 30);
+  auto bigAll = big.Allocate(1u << 30);
+  CHECK(bigAll.offset == 0);
+  big.Free(bigAll);
+}
+
+TEST(OffsetAllocator, InvalidRequests)
+{
+  CHECK_THROWS(OffsetAllocator(0), std::invalid_argument);
+
+  OffsetAllocator allocator(64);
+  CHECK(allocator.Allocate(0).offset == OffsetAllocator::InvalidOffset);
+  CHECK(allocator.Allocate(65).offset == OffsetAllocator::InvalidOffset);
+
+  auto allocation = allocator.Allocate(8);
+  allocator.Free(allocation);
+  CHECK_THROWS(allocator.Free(allocation), std::out_of_range);
+  CHECK_THROWS(allocator.Free(OffsetAllocator::Allocation()), std::out_of_range);
+}
+
+TEST(OffsetAllocator, MergesNeighbours)
+{
+  OffsetAllocator allocator(300);
+  auto a = allocator.Allocate(100);
+  auto b = allocator.Allocate(100);
+  auto c = allocator.Allocate(100);
+  CHECK(a.offset == 0);
+  CHECK(b.offset == 100);
+  CHECK(c.offset == 200);
+
+  // two holes, neither fits 200
+  allocator.Free(a);
+  allocator.Free(c);
+  auto stats = allocator.GetStats();
+  CHECK(stats.freeRegions == 2);
+  CHECK(stats.largestFree == 100);
+  CHECK(stats.fragmentation == 0.5f);
+  CHECK(allocator.Allocate(200).offset == OffsetAllocator::InvalidOffset);
+
+  // freeing the middle merges all three
+  allocator.Free(b);
+  stats = allocator.GetStats();
+  CHECK(stats.freeRegions == 1);
+  CHECK(stats.largestFree == 300);
+  CHECK(allocator.Allocate(300).offset == 0);
+}
+
+TEST(OffsetAllocator, SizesBetweenBins)
+{
+  // a free range only a little bigger than the request sits in the bin rounded down
+  OffsetAllocator allocator(1000);
+  auto head = allocator.Allocate(10);
+  auto hole = allocator.Allocate(77);
+  auto tail = allocator.Allocate(913);
+  CHECK(tail.offset == 87);
+  allocator.Free(hole);
+
+  auto fit = allocator.Allocate(75);
+  CHECK(fit.offset == 10);
+  allocator.Free(head);
+  allocator.Free(fit);
+  allocator.Free(tail);
+  CHECK(allocator.GetStats().freeRegions == 1);
+}
+
+TEST(OffsetAllocator, Reset)
+{
+  OffsetAllocator allocator(128);
+  allocator.Allocate(64);
+  allocator.Allocate(32);
+  allocator.Reset();
+  auto stats = allocator.GetStats();
+  CHECK(stats.allocations == 0);
+  CHECK(stats.totalFree == 128);
+  CHECK(allocator.Allocate(128).offset == 0);
+}
+
+TEST(OffsetAllocator, RandomChurnNeverOverlaps)
+{
+  const uint32_t SIZE = 1u << 20;
+  OffsetAllocator allocator(SIZE);
+  std::mt19937 random(3);
+  // offset -> size, allocation
+  std::map<uint32_t, std::pair<uint32_t, OffsetAllocator::Allocation>> live;
+
+  for (int i = 0; i < 200000; ++i)
+  {
+    if (!live.empty() && random() % 2)
+    {
+      auto freed = live.begin();
+      std::advance(freed, random() % std::min<size_t>(live.size(), 16));
+      allocator.Free(freed->second.second);
+      live.erase(freed);
+      continue;
+    }
+
+    const uint32_t size = 1 + random() % 5000;
+    auto allocation = allocator.Allocate(size);
+    if (allocation.offset == OffsetAllocator::InvalidOffset)
+      continue;
+
+    REQUIRE(allocation.offset + size <= SIZE);
+    auto next = live.lower_bound(allocation.offset);
+    if (next != live.end())
+      REQUIRE(allocation.offset + size <= next->first);
+    if (next != live.begin())
+    {
+      auto previous = std::prev(next);
+      REQUIRE(previous->first + previous->second.first <= allocation.offset);
+    }
+    live[allocation.offset] = { size, allocation };
+  }
+
+  uint32_t used = 0;
+  for (const auto& allocation : live)
+    used += allocation.second.first;
+  auto stats = allocator.GetStats();
+  CHECK(stats.totalFree == SIZE - used);
+  CHECK(stats.allocations == live.size());
+
+  for (const auto& allocation : live)
+    allocator.Free(allocation.second.second);
+  stats = allocator.GetStats();
+  CHECK(stats.freeRegions == 1);
+  CHECK(stats.totalFree == SIZE);
+}
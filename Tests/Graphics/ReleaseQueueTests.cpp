@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/ReleaseQueue.h"
+
+#include <thread>
+
+using Graphics::ReleaseQueue;
+
+TEST(ReleaseQueue, WaitsForTheFence)
+{
+  ReleaseQueue queue;
+  std::vector<int> released;
+
+  // what the context does, frame n signals n when it is done
+  queue.SetCurrentFenceValue(1);
+  queue.Enqueue([&]() { released.push_back(1); });
+  queue.Enqueue([&]() { released.push_back(1); });
+  queue.SetCurrentFenceValue(2);
+  queue.Enqueue([&]() { released.push_back(2); });
+  CHECK(queue.GetCurrentFenceValue() == 2);
+  CHECK(queue.GetPendingCount() == 3);
+
+  queue.Process(0);
+  CHECK(released.empty());
+  queue.Process(1);
+  CHECK(released == std::vector<int>({ 1, 1 }));
+  CHECK(queue.GetPendingCount() == 1);
+  // the same value again releases nothing twice
+  queue.Process(1);
+  CHECK(released.size() == 2);
+  queue.Process(2);
+  CHECK(released == std::vector<int>({ 1, 1, 2 }));
+  CHECK(queue.GetPendingCount() == 0);
+}
+
+TEST(ReleaseQueue, RetiresSkippedFramesInOrder)
+{
+  ReleaseQueue queue;
+  std::vector<uint64_t> released;
+  for (uint64_t frame = 1; frame <= 5; ++frame)
+  {
+    queue.SetCurrentFenceValue(frame);
+    queue.Enqueue([&released, frame]() { released.push_back(frame); });
+    queue.Enqueue([&released, frame]() { released.push_back(frame); });
+  }
+
+  // the GPU caught up on several frames at once
+  queue.Process(4);
+  CHECK(released == std::vector<uint64_t>({ 1, 1, 2, 2, 3, 3, 4, 4 }));
+  CHECK(queue.GetPendingCount() == 2);
+
+  // past the last one
+  queue.Process(100);
+  CHECK(released.size() == 10);
+  CHECK(released.back() == 5);
+}
+
+TEST(ReleaseQueue, FlushRunsEverything)
+{
+  // resizing waits for the GPU, then flushes
+  ReleaseQueue queue;
+  int released = 0;
+  for (uint64_t frame = 10; frame < 13; ++frame)
+  {
+    queue.SetCurrentFenceValue(frame);
+    queue.Enqueue([&]() { ++released; });
+  }
+  queue.Flush();
+  CHECK(released == 3);
+  CHECK(queue.GetPendingCount() == 0);
+
+  // still usable afterwards, and nothing runs twice
+  queue.SetCurrentFenceValue(13);
+  queue.Enqueue([&]() { ++released; });
+  queue.Process(12);
+  CHECK(released == 3);
+  queue.Process(13);
+  CHECK(released == 4);
+
+  // and the destructor flushes what is left
+  {
+    ReleaseQueue scoped;
+    scoped.SetCurrentFenceValue(1);
+    scoped.Enqueue([&]() { ++released; });
+  }
+  CHECK(released == 5);
+}
+
+TEST(ReleaseQueue, ReleasesRunOutsideTheLock)
+{
+  // a release that enqueues would deadlock under the lock, it lands in the current frame
+  ReleaseQueue queue;
+  int released = 0;
+  queue.SetCurrentFenceValue(1);
+  queue.Enqueue([&]() {
+    ++released;
+    queue.Enqueue([&]() { ++released; });
+  });
+  queue.SetCurrentFenceValue(2);
+  queue.Process(1);
+  CHECK(released == 1);
+  CHECK(queue.GetPendingCount() == 1);
+  queue.Process(2);
+  CHECK(released == 2);
+
+  queue.Flush();
+  queue.Enqueue([&]() {
+    ++released;
+    queue.Enqueue([&]() { ++released; });
+  });
+  queue.Flush();
+  CHECK(released == 3);
+  queue.Flush();
+  CHECK(released == 4);
+}
+
+TEST(ReleaseQueue, ConcurrentEnqueueAndProcess)
+{
+  // loading threads defer releases while the main thread moves the fence on, run under TSAN too
+  const unsigned THREADS = 4;
+  const unsigned RELEASES = 20000;
+  const uint64_t FRAMES = 2000;
+  ReleaseQueue queue;
+  std::atomic<unsigned> released(0);
+  std::atomic<bool> early(false);
+  std::atomic<uint64_t> completed(0);
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&]() {
+      for (unsigned i = 0; i < RELEASES; ++i)
+      {
+        // the fence a release waits for is at least the current one when it was enqueued
+        const uint64_t enqueued = queue.GetCurrentFenceValue();
+        queue.Enqueue([&, enqueued]() {
+          if (completed.load() < enqueued)
+            early = true;
+          released++;
+        });
+      }
+    });
+  }
+
+  for (uint64_t frame = 1; frame <= FRAMES; ++frame)
+  {
+    queue.SetCurrentFenceValue(frame);
+    // two frames in flight
+    if (frame > 2)
+    {
+      completed = frame - 2;
+      queue.Process(frame - 2);
+    }
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  completed = FRAMES;
+  queue.Process(FRAMES);
+  CHECK(!early);
+  CHECK(released == THREADS * RELEASES);
+  CHECK(queue.GetPendingCount() == 0);
+}
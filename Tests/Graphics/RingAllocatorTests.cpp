@@ -0,0 +1,178 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Graphics/RingAllocator.h"
+
+#include <random>
+
+using Graphics::RingAllocator;
+
+TEST(RingAllocator, WrapsPastTheTail)
+{
+  RingAllocator ring(1024);
+  ring.SetCurrentFenceValue(1);
+  CHECK(ring.Allocate(400, 4) == 0);
+  ring.SetCurrentFenceValue(2);
+  CHECK(ring.Allocate(400, 4) == 400);
+  CHECK(ring.Retire(1) == 400);
+
+  // 300 doesn't fit in the last 224 bytes, they are skipped and count as used
+  ring.SetCurrentFenceValue(3);
+  CHECK(ring.Allocate(300, 4) == 0);
+  CHECK(ring.GetUsed() == 400 + 224 + 300);
+  // up to the oldest frame still in flight, exactly
+  CHECK(ring.Allocate(100, 4) == 300);
+  CHECK(ring.GetUsed() == 1024);
+  CHECK(ring.Allocate(1, 1) == RingAllocator::InvalidOffset);
+
+  CHECK(ring.Retire(2) == 400);
+  ring.SetCurrentFenceValue(4);
+  CHECK(ring.Allocate(100, 4) == 400);
+  // the skipped tail goes back with the frame that skipped it
+  CHECK(ring.Retire(3) == 224 + 300 + 100);
+  CHECK(ring.GetUsed() == 100);
+  CHECK(ring.Retire(4) == 100);
+
+  // empty, the next allocation starts over from 0
+  ring.SetCurrentFenceValue(5);
+  CHECK(ring.Allocate(1000, 4) == 0);
+}
+
+TEST(RingAllocator, AlignsAndCountsThePadding)
+{
+  RingAllocator ring(4096);
+  ring.SetCurrentFenceValue(1);
+  CHECK(ring.Allocate(10, 4) == 0);
+  CHECK(ring.Allocate(10, 512) == 512);
+  CHECK(ring.Allocate(3, 4) == 524);
+  CHECK(ring.GetUsed() == 527);
+
+  // the padding can't push it past the end, it wraps instead
+  ring.SetCurrentFenceValue(2);
+  CHECK(ring.Allocate(3000, 4) == 528);
+  CHECK(ring.Retire(1) == 527);
+  ring.SetCurrentFenceValue(3);
+  CHECK(ring.Allocate(100, 1024) == 0);
+  CHECK(ring.GetUsed() == 3001 + 4096 - 3528 + 100);
+}
+
+TEST(RingAllocator, FullRingFailsCleanly)
+{
+  RingAllocator ring(1000);
+  unsigned count = 0;
+  for (uint64_t frame = 1; frame <= 3; ++frame)
+  {
+    ring.SetCurrentFenceValue(frame);
+    while (ring.Allocate(64, 16) != RingAllocator::InvalidOffset)
+      ++count;
+  }
+  CHECK(count == 1000 / 64);
+  const size_t used = ring.GetUsed();
+
+  // nothing retired, nothing fits, and the failures took nothing
+  CHECK(ring.Retire(0) == 0);
+  CHECK(ring.Allocate(64, 16) == RingAllocator::InvalidOffset);
+  CHECK(ring.Allocate(41, 1) == RingAllocator::InvalidOffset);
+  CHECK(ring.Allocate(2000, 1) == RingAllocator::InvalidOffset);
+  CHECK(ring.Allocate(0, 1) == RingAllocator::InvalidOffset);
+  CHECK(ring.GetUsed() == used);
+  CHECK(ring.ConsumePeak() == used);
+
+  // frame 1 took everything, frames 2 and 3 nothing
+  CHECK(ring.Retire(3) == used);
+  CHECK(ring.GetUsed() == 0);
+  CHECK(ring.ConsumePeak() == used);
+  CHECK(ring.ConsumePeak() == 0);
+
+  // after a flush too
+  ring.SetCurrentFenceValue(4);
+  ring.Allocate(500, 4);
+  ring.Reset();
+  CHECK(ring.GetUsed() == 0);
+  CHECK(ring.Allocate(1000, 4) == 0);
+}
+
+TEST(RingAllocator, RetiresOldestFirst)
+{
+  RingAllocator ring(1024);
+  for (uint64_t frame = 1; frame <= 4; ++frame)
+  {
+    ring.SetCurrentFenceValue(frame * 10);
+    ring.Allocate(100, 4);
+  }
+
+  // a completed value between two frames stops at the older one that isn't done
+  CHECK(ring.Retire(25) == 200);
+  CHECK(ring.GetUsed() == 200);
+  // an older completed value, read late, gives back nothing
+  CHECK(ring.Retire(15) == 0);
+  CHECK(ring.Retire(25) == 0);
+  CHECK(ring.GetUsed() == 200);
+  CHECK(ring.Retire(40) == 200);
+  CHECK(ring.Retire(20) == 0);
+  CHECK(ring.GetUsed() == 0);
+}
+
+TEST(RingAllocator, RefusesAboveTheMaximum)
+{
+  // what the resource manager gives a temporary chunk instead
+  const size_t capacity = 64 * 1024;
+  RingAllocator ring(capacity, capacity / 4);
+  CHECK(ring.GetMaxAllocationSize() == capacity / 4);
+  ring.SetCurrentFenceValue(1);
+  CHECK(ring.Allocate(capacity / 4 + 1, 4) == RingAllocator::InvalidOffset);
+  CHECK(ring.GetUsed() == 0);
+  CHECK(ring.Allocate(capacity / 4, 4) == 0);
+
+  // never above the capacity
+  CHECK(RingAllocator(1024, 4096).GetMaxAllocationSize() == 1024);
+  CHECK(RingAllocator(1024).GetMaxAllocationSize() == 1024);
+}
+
+TEST(RingAllocator, RandomFramesNeverOverlap)
+{
+  // frames of random uploads, the GPU two frames behind, against a byte map of who owns what
+  const size_t capacity = 64 * 1024;
+  RingAllocator ring(capacity);
+  std::vector<uint64_t> owners(capacity, 0);
+  std::mt19937 random(7);
+  bool valid = true;
+  size_t allocations = 0;
+  size_t failures = 0;
+
+  for (uint64_t frame = 1; frame <= 3000; ++frame)
+  {
+    ring.SetCurrentFenceValue(frame);
+    if (frame > 2)
+    {
+      ring.Retire(frame - 2);
+      for (auto& owner : owners)
+        owner = owner <= frame - 2 ? 0 : owner;
+    }
+
+    const unsigned count = random() % 12;
+    for (unsigned i = 0; i < count; ++i)
+    {
+      const size_t size = 1 + random() % (random() % 8 == 0 ? 20000 : 2000);
+      const size_t alignment = size_t(1) << (random() % 10);
+      const size_t offset = ring.Allocate(size, alignment);
+      if (offset == RingAllocator::InvalidOffset)
+      {
+        ++failures;
+        continue;
+      }
+      ++allocations;
+      valid &= offset % alignment == 0 && offset + size <= capacity;
+      for (size_t byte = offset; byte < offset + size && byte < capacity; ++byte)
+      {
+        valid &= owners[byte] == 0;
+        owners[byte] = frame;
+      }
+    }
+    valid &= ring.GetUsed() <= capacity;
+  }
+  CHECK(valid);
+  CHECK(allocations > 10000);
+  // it did fill up now and then
+  CHECK(failures > 0);
+}
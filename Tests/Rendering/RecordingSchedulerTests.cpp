@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Rendering/RecordingScheduler.h"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+using Rendering::RecordingScheduler;
+
+TEST(RecordingScheduler, NeedsAChunk)
+{
+  bool thrown = false;
+  try
+  {
+    RecordingScheduler scheduler(0, 1.0);
+  }
+  catch (const std::invalid_argument&)
+  {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+TEST(RecordingScheduler, CheapPassesStayOnOneList)
+{
+  // 100 draws at 0.1 us are well under what a list costs
+  RecordingScheduler scheduler(8, 0.1);
+  const auto& chunks = scheduler.Partition(std::vector<uint32_t>(100, 1));
+  REQUIRE(chunks.size() == 1);
+  CHECK(chunks[0].begin == 0);
+  CHECK(chunks[0].end == 100);
+
+  CHECK(scheduler.Partition({}).empty());
+}
+
+TEST(RecordingScheduler, ChunksCoverTheDrawsEvenly)
+{
+  std::mt19937 random(1);
+  bool covered = true;
+  bool balanced = true;
+  for (int i = 0; i < 20000; ++i)
+  {
+    const unsigned maxChunks = 1 + random() % 8;
+    RecordingScheduler scheduler(maxChunks, (random() % 100) / 10.0);
+
+    // some draws weigh nothing
+    std::vector<uint32_t> weights(random() % 300);
+    uint64_t total = 0;
+    uint32_t heaviest = 0;
+    for (auto& weight : weights)
+    {
+      weight = random() % 5 == 0 ? 0 : random() % 10 + 1;
+      total += weight;
+      heaviest = weight > heaviest ? weight : heaviest;
+    }
+
+    const auto& chunks = scheduler.Partition(weights);
+    if (weights.empty())
+    {
+      covered &= chunks.empty();
+      continue;
+    }
+    covered &= !chunks.empty() && chunks.size() <= maxChunks && chunks.size() <= weights.size();
+
+    // contiguous, in order, never empty
+    size_t begin = 0;
+    uint64_t largest = 0;
+    for (const auto& chunk : chunks)
+    {
+      covered &= chunk.begin == begin && chunk.end > chunk.begin;
+      uint64_t weight = 0;
+      for (size_t draw = chunk.begin; draw < chunk.end; ++draw)
+        weight += weights[draw];
+      largest = weight > largest ? weight : largest;
+      begin = chunk.end;
+    }
+    covered &= begin == weights.size();
+
+    // no chunk above its share by more than a draw, unless keeping a draw for each chunk forces it
+    const double share = static_cast<double>(total) / chunks.size();
+    if (weights.size() >= 4 * chunks.size())
+      balanced &= largest <= share + heaviest + 1e-9;
+  }
+  CHECK(covered);
+  CHECK(balanced);
+}
+
+TEST(RecordingScheduler, LearnsTheCostOfADraw)
+{
+  // starts too expensive, every chunk then reports 0.05 us per weight
+  RecordingScheduler scheduler(8, 1.0);
+  const std::vector<uint32_t> weights(1000, 2);
+  CHECK(scheduler.Partition(weights).size() == 8);
+
+  for (int frame = 0; frame < 60; ++frame)
+  {
+    const auto& chunks = scheduler.Partition(weights);
+    std::vector<double> microseconds(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i)
+      microseconds[i] = (chunks[i].end - chunks[i].begin) * 2 * 0.05;
+    scheduler.Report(microseconds);
+  }
+  CHECK(std::abs(scheduler.GetMicrosecondsPerWeight() - 0.05) < 1e-4);
+  // 100 us of work pays for two lists
+  CHECK(scheduler.GetChunks().size() == 2);
+
+  // a report that doesn't match the partition is ignored
+  scheduler.Report({ 1e6 });
+  CHECK(std::abs(scheduler.GetMicrosecondsPerWeight() - 0.05) < 1e-4);
+}
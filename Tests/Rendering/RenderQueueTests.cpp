@@ -0,0 +1,127 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Rendering/RenderQueue.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+using namespace Rendering;
+
+TEST(RenderQueue, KeyFields)
+{
+  const uint64_t key = DrawKey::Make(3, 5, 7, 11, 13);
+  CHECK(key >> 60 == 3);
+  CHECK(((key >> 48) & 0xfff) == 5);
+  CHECK(((key >> 40) & 0xff) == 7);
+  CHECK(((key >> 20) & 0xfffff) == 11);
+  CHECK((key & 0xfffff) == 13);
+
+  // wider fields are cut, they don't spill into the next one
+  CHECK(DrawKey::Make(0, 1u << DrawKey::PsoBits, 0, 0, 0) == 0);
+  CHECK(DrawKey::Make(0, 0, 0, 0, 1u << DrawKey::DepthBits) == 0);
+
+  // the pass decides before anything else, then the pso
+  CHECK(DrawKey::Make(1, 0, 0, 0, 0) > DrawKey::Make(0, 4095, 255, 0xfffff, 0xfffff));
+  CHECK(DrawKey::Make(0, 2, 0, 0, 0) > DrawKey::Make(0, 1, 255, 0xfffff, 0xfffff));
+}
+
+TEST(RenderQueue, QuantizeDepth)
+{
+  const uint32_t maximum = (1u << DrawKey::DepthBits) - 1;
+  CHECK(DrawKey::QuantizeDepth(0.0f, 100.0f) == 0);
+  CHECK(DrawKey::QuantizeDepth(-5.0f, 100.0f) == 0);
+  CHECK(DrawKey::QuantizeDepth(100.0f, 100.0f) == maximum);
+  CHECK(DrawKey::QuantizeDepth(1e9f, 100.0f) == maximum);
+  CHECK(DrawKey::QuantizeDepth(std::numeric_limits<float>::quiet_NaN(), 100.0f) == 0);
+  CHECK(DrawKey::QuantizeDepth(1.0f, 0.0f) == 0);
+  CHECK(DrawKey::QuantizeDepth(25.0f, 100.0f) < DrawKey::QuantizeDepth(50.0f, 100.0f));
+}
+
+TEST(RenderQueue, RadixSortMatchesStableSort)
+{
+  std::mt19937_64 random(9);
+  // empty, single, odd sizes, keys that share most of their digits
+  for (size_t count : { 0, 1, 2, 3, 255, 256, 1000, 65537 })
+  {
+    for (unsigned variant = 0; variant < 3; ++variant)
+    {
+      std::vector<uint64_t> keys(count);
+      for (auto& key : keys)
+      {
+        if (variant == 0)
+          key = random();
+        else if (variant == 1)
+          key = DrawKey::Make(static_cast<uint32_t>(random() % 3), static_cast<uint32_t>(random() % 8), 0, static_cast<uint32_t>(random() % 64), static_cast<uint32_t>(random()));
+        else
+          key = 42;
+      }
+
+      std::vector<uint32_t> values(count);
+      for (size_t i = 0; i < count; ++i)
+        values[i] = static_cast<uint32_t>(i);
+
+      std::vector<std::pair<uint64_t, uint32_t>> expected(count);
+      for (size_t i = 0; i < count; ++i)
+        expected[i] = { keys[i], values[i] };
+      std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+      std::vector<uint64_t> keyScratch(count);
+      std::vector<uint32_t> valueScratch(count);
+      RadixSort::Sort(keys.data(), values.data(), count, keyScratch.data(), valueScratch.data());
+
+      bool match = true;
+      for (size_t i = 0; i < count; ++i)
+        match &= keys[i] == expected[i].first && values[i] == expected[i].second;
+      CHECK(match);
+    }
+  }
+}
+
+TEST(RenderQueue, SortsPacketsWithTheirKeys)
+{
+  RenderQueue queue;
+  ID3D12PipelineState psos[2];
+  const uint64_t keys[] = { 30, 10, 20, 10 };
+  for (size_t i = 0; i < 4; ++i)
+    queue.Push(keys[i], { nullptr, &psos[i % 2], nullptr, i });
+
+  // push order until sorted
+  CHECK(queue.Size() == 4);
+  CHECK(queue.GetPacket(0).modelConstants == 0);
+
+  queue.Sort();
+  CHECK(queue.GetKey(0) == 10 && queue.GetKey(1) == 10 && queue.GetKey(2) == 20 && queue.GetKey(3) == 30);
+  // equal keys keep their push order
+  CHECK(queue.GetPacket(0).modelConstants == 1);
+  CHECK(queue.GetPacket(1).modelConstants == 3);
+  CHECK(queue.GetPacket(2).modelConstants == 2);
+  CHECK(queue.GetPacket(3).pso == &psos[0]);
+
+  queue.Clear();
+  CHECK(queue.Size() == 0);
+}
+
+TEST(RenderQueue, IdsStartOverAfterReset)
+{
+  RenderQueue queue;
+  ID3D12PipelineState psos[3];
+  ID3D12RootSignature rootSignatures[2];
+
+  CHECK(queue.GetPsoId(&psos[0]) == 0);
+  CHECK(queue.GetPsoId(&psos[1]) == 1);
+  CHECK(queue.GetPsoId(&psos[0]) == 0);
+  CHECK(queue.GetRootSignatureId(&rootSignatures[1]) == 0);
+  CHECK(queue.GetRootSignatureId(&rootSignatures[0]) == 1);
+
+  // ids survive a frame
+  queue.Clear();
+  CHECK(queue.GetPsoId(&psos[1]) == 1);
+
+  // a rebuilt pso may come back at an old address, it must not inherit a stale id
+  queue.ResetIds();
+  CHECK(queue.GetPsoId(&psos[2]) == 0);
+  CHECK(queue.GetPsoId(&psos[0]) == 1);
+  CHECK(queue.GetRootSignatureId(&rootSignatures[0]) == 0);
+}
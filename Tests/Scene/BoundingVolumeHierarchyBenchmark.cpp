@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/BoundingVolumeHierarchy.h"
+
+#include <cmath>
+#include <random>
+
+using namespace Scene;
+
+namespace
+{
+  std::vector<Bounds> RandomBounds(size_t count)
+  {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> size(0.5f, 10.0f);
+
+    std::vector<Bounds> output(count);
+    for (Bounds& item : output)
+    {
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        item.center[axis] = position(random);
+        item.extents[axis] = size(random);
+      }
+      item.radius = std::sqrt(item.extents[0] * item.extents[0] + item.extents[1] * item.extents[1] + item.extents[2] * item.extents[2]);
+    }
+    return output;
+  }
+
+  Frustum Perspective()
+  {
+    const float height = 1.0f / std::tan(0.5f);
+    const float range = 800.0f / (800.0f - 0.5f);
+    const float matrix[16] = {
+      height / 1.6f, 0.0f, 0.0f, 0.0f,
+      0.0f, height, 0.0f, 0.0f,
+      0.0f, 0.0f, range, 1.0f,
+      0.0f, 0.0f, -range * 0.5f, 0.0f };
+    return FrustumCulling::ExtractPlanes(matrix);
+  }
+}
+
+BENCHMARK(BoundingVolumeHierarchy, Build)
+{
+  for (size_t count : { size_t(10000), size_t(100000) })
+  {
+    const std::vector<Bounds> bounds = RandomBounds(count);
+    BoundingVolumeHierarchy bvh;
+    const double milliseconds = Tests::MeasureMilliseconds(5, [&]() { bvh.Build(bounds); });
+    printf("  %zu items: %.2f ms, %zu nodes, SAH cost %.1f\n", count, milliseconds, bvh.GetNodeCount(), bvh.GetCost());
+  }
+}
+
+BENCHMARK(BoundingVolumeHierarchy, Refit)
+{
+  const size_t COUNT = 100000;
+  std::vector<Bounds> bounds = RandomBounds(COUNT);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(bounds);
+
+  // small moves every frame, like animated objects
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> drift(-1.0f, 1.0f);
+  for (Bounds& item : bounds)
+    for (unsigned axis = 0; axis < 3; ++axis)
+      item.center[axis] += drift(random);
+
+  const double refit = Tests::MeasureMilliseconds(10, [&]() { bvh.Refit(bounds); });
+  const double update = Tests::MeasureMilliseconds(10, [&]() {
+    for (uint32_t i = 0; i < COUNT; i += 100)
+      bvh.Update(i, bounds[i]);
+  });
+  printf("  %zu items: refit %.2f ms, update of 1%% one by one %.3f ms, cost %.1f (build %.1f)\n",
+    COUNT, refit, update, bvh.GetCost(), bvh.GetBuildCost());
+}
+
+BENCHMARK(BoundingVolumeHierarchy, QueryVsBruteForce)
+{
+  const size_t COUNT = 100000;
+  const std::vector<Bounds> bounds = RandomBounds(COUNT);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(bounds);
+  BoundsList all;
+  for (const Bounds& item : bounds)
+    all.Push(item);
+  const Frustum frustum = Perspective();
+
+  std::vector<uint32_t> query;
+  std::vector<uint8_t> visible(COUNT);
+  size_t bruteVisible = 0;
+  const double tree = Tests::MeasureMilliseconds(20, [&]() {
+    query.clear();
+    bvh.QueryFrustum(frustum, query);
+  });
+  const double brute = Tests::MeasureMilliseconds(20, [&]() { bruteVisible = FrustumCulling::Cull(all, frustum, visible.data()); });
+  printf("  %zu items, %zu visible: bvh %.3f ms, culling every bounds %.3f ms\n", COUNT, query.size(), tree, brute);
+  if (query.size() != bruteVisible)
+    printf("  bvh and brute force disagree!\n");
+}
@@ -0,0 +1,197 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+using namespace Scene;
+
+namespace
+{
+  struct RandomScene
+  {
+    std::vector<Bounds> bounds;
+    std::mt19937 random;
+    std::uniform_real_distribution<float> position;
+    std::uniform_real_distribution<float> size;
+
+    explicit RandomScene(size_t count)
+      : bounds(count)
+      , random(7)
+      , position(-1000.0f, 1000.0f)
+      , size(0.5f, 10.0f)
+    {
+      for (Bounds& item : bounds)
+        item = RandomBounds();
+      // items at the same place, the split has to cope with equal centers
+      for (size_t i = 1; i < 50 && i < count; ++i)
+        bounds[i] = bounds[0];
+    }
+
+    Bounds RandomBounds()
+    {
+      Bounds output;
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        output.center[axis] = position(random);
+        output.extents[axis] = size(random);
+      }
+      output.radius = std::sqrt(output.extents[0] * output.extents[0] + output.extents[1] * output.extents[1] + output.extents[2] * output.extents[2]);
+      return output;
+    }
+  };
+
+  Frustum Perspective()
+  {
+    const float height = 1.0f / std::tan(0.5f);
+    const float range = 800.0f / (800.0f - 0.5f);
+    const float matrix[16] = {
+      height / 1.6f, 0.0f, 0.0f, 0.0f,
+      0.0f, height, 0.0f, 0.0f,
+      0.0f, 0.0f, range, 1.0f,
+      0.0f, 0.0f, -range * 0.5f, 0.0f };
+    return FrustumCulling::ExtractPlanes(matrix);
+  }
+
+  // distance along the ray to the box, FLT_MAX when missed
+  float RayBox(const Bounds& bounds, const float* origin, const float* direction, float maxDistance)
+  {
+    float enter = 0.0f;
+    float exit = maxDistance;
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      const float inverse = 1.0f / direction[axis];
+      float near = (bounds.center[axis] - bounds.extents[axis] - origin[axis]) * inverse;
+      float far = (bounds.center[axis] + bounds.extents[axis] - origin[axis]) * inverse;
+      if (near > far)
+        std::swap(near, far);
+      enter = std::max(enter, near);
+      exit = std::min(exit, far);
+    }
+    return enter <= exit ? enter : FLT_MAX;
+  }
+
+  // the tree gives the same items as culling every bounds, and the same closest hits as testing every box
+  void CheckAgainstBruteForce(const BoundingVolumeHierarchy& bvh, const std::vector<Bounds>& bounds, std::mt19937& random)
+  {
+    const Frustum frustum = Perspective();
+    BoundsList all;
+    for (const Bounds& item : bounds)
+      all.Push(item);
+    std::vector<uint8_t> visible(bounds.size());
+    FrustumCulling::Cull(all, frustum, visible.data());
+
+    std::vector<uint32_t> query;
+    bvh.QueryFrustum(frustum, query);
+    std::sort(query.begin(), query.end());
+    CHECK(std::adjacent_find(query.begin(), query.end()) == query.end());
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < bounds.size(); ++i)
+      if (visible[i])
+        expected.push_back(i);
+    CHECK(query == expected);
+
+    std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+    size_t rayMismatches = 0;
+    for (unsigned ray = 0; ray < 200; ++ray)
+    {
+      const float origin[3] = { coordinate(random), coordinate(random), coordinate(random) };
+      float direction[3] = { coordinate(random), ray % 10 == 0 ? 0.0f : coordinate(random), coordinate(random) };
+      const float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+      for (float& value : direction)
+        value /= length;
+
+      const RayHit hit = bvh.Raycast(origin, direction, 5000.0f);
+      float best = 5000.0f;
+      uint32_t bestItem = BoundingVolumeHierarchy::InvalidItem;
+      for (uint32_t i = 0; i < bounds.size(); ++i)
+      {
+        const float distance = RayBox(bounds[i], origin, direction, best);
+        if (distance != FLT_MAX && (distance < best || bestItem == BoundingVolumeHierarchy::InvalidItem))
+        {
+          best = distance;
+          bestItem = i;
+        }
+      }
+
+      // ties between boxes may pick either, the distance has to match
+      if ((hit.item == BoundingVolumeHierarchy::InvalidItem) != (bestItem == BoundingVolumeHierarchy::InvalidItem))
+        ++rayMismatches;
+      else if (bestItem != BoundingVolumeHierarchy::InvalidItem && std::fabs(hit.distance - best) > 1e-3f)
+        ++rayMismatches;
+    }
+    CHECK(rayMismatches == 0);
+  }
+}
+
+TEST(BoundingVolumeHierarchy, MatchesBruteForce)
+{
+  RandomScene scene(20000);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(scene.bounds);
+  CHECK(bvh.GetItemCount() == scene.bounds.size());
+  CHECK(bvh.GetCost() == bvh.GetBuildCost());
+  CheckAgainstBruteForce(bvh, scene.bounds, scene.random);
+}
+
+TEST(BoundingVolumeHierarchy, MatchesBruteForceAfterUpdates)
+{
+  RandomScene scene(20000);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(scene.bounds);
+
+  // a tenth of the items move one by one
+  std::uniform_real_distribution<float> step(0.0f, 50.0f);
+  for (size_t i = 0; i < scene.bounds.size(); i += 10)
+  {
+    for (unsigned axis = 0; axis < 3; ++axis)
+      scene.bounds[i].center[axis] += step(scene.random);
+    bvh.Update(static_cast<uint32_t>(i), scene.bounds[i]);
+  }
+  CHECK(bvh.GetCost() >= bvh.GetBuildCost());
+  CheckAgainstBruteForce(bvh, scene.bounds, scene.random);
+
+  // then all of them
+  std::uniform_real_distribution<float> drift(-300.0f, 300.0f);
+  for (Bounds& item : scene.bounds)
+    for (unsigned axis = 0; axis < 3; ++axis)
+      item.center[axis] += drift(scene.random);
+  bvh.Refit(scene.bounds);
+  CHECK(bvh.GetCost() > bvh.GetBuildCost());
+  CheckAgainstBruteForce(bvh, scene.bounds, scene.random);
+}
+
+TEST(BoundingVolumeHierarchy, EmptyAndSingleItem)
+{
+  const Frustum frustum = Perspective();
+  const float origin[3] = { 0.0f, 0.0f, 0.0f };
+  const float direction[3] = { 0.0f, 0.0f, 1.0f };
+
+  BoundingVolumeHierarchy bvh;
+  bvh.Build({});
+  std::vector<uint32_t> query;
+  bvh.QueryFrustum(frustum, query);
+  CHECK(query.empty());
+  CHECK(bvh.Raycast(origin, direction, 10.0f).item == BoundingVolumeHierarchy::InvalidItem);
+
+  const Bounds item = { { 0.0f, 0.0f, 5.0f }, { 1.0f, 1.0f, 1.0f }, 1.8f };
+  bvh.Build({ item });
+  bvh.QueryFrustum(frustum, query);
+  CHECK(query == std::vector<uint32_t>({ 0 }));
+  const RayHit hit = bvh.Raycast(origin, direction, 10.0f);
+  CHECK(hit.item == 0);
+  CHECK(std::fabs(hit.distance - 4.0f) < 1e-5f);
+
+  // moved behind the camera
+  const Bounds moved = { { 0.0f, 0.0f, -5.0f }, { 1.0f, 1.0f, 1.0f }, 1.8f };
+  bvh.Update(0, moved);
+  query.clear();
+  bvh.QueryFrustum(frustum, query);
+  CHECK(query.empty());
+  CHECK(bvh.Raycast(origin, direction, 10.0f).item == BoundingVolumeHierarchy::InvalidItem);
+}
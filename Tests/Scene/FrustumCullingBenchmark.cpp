@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/FrustumCulling.h"
+
+#include <cmath>
+#include <random>
+
+using namespace Scene;
+
+// a big scene worth of mesh bounds against a camera in the middle of it
+BENCHMARK(FrustumCulling, Kernel100k)
+{
+  const size_t COUNT = 100000;
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> size(0.0f, 20.0f);
+  BoundsList bounds;
+  for (size_t i = 0; i < COUNT; ++i)
+  {
+    Bounds item;
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      item.center[axis] = position(random);
+      item.extents[axis] = size(random);
+    }
+    item.radius = std::sqrt(item.extents[0] * item.extents[0] + item.extents[1] * item.extents[1] + item.extents[2] * item.extents[2]);
+    bounds.Push(item);
+  }
+
+  const float height = 1.0f / std::tan(0.5f);
+  const float matrix[16] = {
+    height / 1.7778f, 0.0f, 0.0f, 0.0f,
+    0.0f, height, 0.0f, 0.0f,
+    0.0f, 0.0f, 1000.0f / 999.5f, 1.0f,
+    0.0f, 0.0f, -0.5f * 1000.0f / 999.5f, 0.0f };
+  const Frustum frustum = FrustumCulling::ExtractPlanes(matrix);
+
+  std::vector<uint8_t> visible(COUNT);
+  size_t kernelVisible = 0;
+  size_t scalarVisible = 0;
+  const double kernel = Tests::MeasureMilliseconds(50, [&]() { kernelVisible = FrustumCulling::Cull(bounds, frustum, visible.data()); });
+  const double scalar = Tests::MeasureMilliseconds(50, [&]() { scalarVisible = FrustumCulling::CullScalar(bounds, frustum, visible.data()); });
+
+  printf("  %zu bounds, %zu visible: kernel %.3f ms (%.2f ns each), scalar %.3f ms (%.2f ns each), %.1fx\n",
+    COUNT, kernelVisible, kernel, kernel * 1e6 / COUNT, scalar, scalar * 1e6 / COUNT, scalar / kernel);
+  if (kernelVisible != scalarVisible)
+    printf("  kernel and scalar disagree!\n");
+}
@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/FrustumCulling.h"
+
+#include <cmath>
+#include <random>
+
+using namespace Scene;
+
+namespace
+{
+  // XMMatrixPerspectiveFovLH layout, looking down +z from the origin
+  Frustum Perspective(float fov, float aspect, float nearZ, float farZ)
+  {
+    const float height = 1.0f / std::tan(fov * 0.5f);
+    const float width = height / aspect;
+    const float range = farZ / (farZ - nearZ);
+    const float matrix[16] = {
+      width, 0.0f, 0.0f, 0.0f,
+      0.0f, height, 0.0f, 0.0f,
+      0.0f, 0.0f, range, 1.0f,
+      0.0f, 0.0f, -range * nearZ, 0.0f };
+    return FrustumCulling::ExtractPlanes(matrix);
+  }
+
+  Bounds Box(float x, float y, float z, float extent, float radius)
+  {
+    return { { x, y, z }, { extent, extent, extent }, radius };
+  }
+
+  BoundsList RandomBounds(size_t count, unsigned seed)
+  {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.0f, 20.0f);
+
+    BoundsList output;
+    for (size_t i = 0; i < count; ++i)
+    {
+      Bounds bounds;
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        bounds.center[axis] = position(random);
+        bounds.extents[axis] = size(random);
+      }
+      // spheres a bit tighter than the box corners, like around a mesh
+      const float diagonal = std::sqrt(bounds.extents[0] * bounds.extents[0] + bounds.extents[1] * bounds.extents[1] + bounds.extents[2] * bounds.extents[2]);
+      bounds.radius = diagonal * (0.7f + 0.3f * size(random) / 20.0f);
+      output.Push(bounds);
+    }
+    return output;
+  }
+}
+
+TEST(FrustumCulling, ExtractPlanes)
+{
+  const Frustum frustum = Perspective(1.0f, 16.0f / 9.0f, 0.5f, 1000.0f);
+  for (const auto& plane : frustum.planes)
+    CHECK(std::fabs(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2] - 1.0f) < 1e-5f);
+
+  // near and far planes at their distance
+  CHECK(std::fabs(frustum.planes[4][3] + 0.5f) < 1e-4f);
+  CHECK(std::fabs(frustum.planes[5][3] - 1000.0f) < 0.5f);
+}
+
+TEST(FrustumCulling, KnownBounds)
+{
+  const Frustum frustum = Perspective(1.0f, 16.0f / 9.0f, 0.5f, 1000.0f);
+
+  BoundsList bounds;
+  // in front, behind, far to the side, past the far plane
+  bounds.Push(Box(0.0f, 0.0f, 10.0f, 0.0f, 0.0f));
+  bounds.Push(Box(0.0f, 0.0f, -10.0f, 0.0f, 0.0f));
+  bounds.Push(Box(1000.0f, 0.0f, 10.0f, 0.0f, 0.0f));
+  bounds.Push(Box(0.0f, 0.0f, 1100.0f, 1.0f, 1.7f));
+  // behind but big enough to reach in, box and sphere both have to be out to cull
+  bounds.Push(Box(0.0f, 0.0f, -10.0f, 11.0f, 20.0f));
+  bounds.Push(Box(0.0f, 0.0f, -10.0f, 1.0f, 20.0f));
+
+  uint8_t visible[6];
+  CHECK(FrustumCulling::Cull(bounds, frustum, visible) == 2);
+  CHECK(visible[0] == 1);
+  CHECK(visible[1] == 0);
+  CHECK(visible[2] == 0);
+  CHECK(visible[3] == 0);
+  CHECK(visible[4] == 1);
+  CHECK(visible[5] == 0);
+}
+
+TEST(FrustumCulling, KernelMatchesScalar)
+{
+  // not a multiple of 4, the tail goes through the scalar path
+  const Frustum frustum = Perspective(1.2f, 1.5f, 0.1f, 400.0f);
+  const BoundsList bounds = RandomBounds(100003, 1);
+
+  std::vector<uint8_t> kernel(bounds.Size());
+  std::vector<uint8_t> scalar(bounds.Size());
+  const size_t kernelCount = FrustumCulling::Cull(bounds, frustum, kernel.data());
+  const size_t scalarCount = FrustumCulling::CullScalar(bounds, frustum, scalar.data());
+
+  CHECK(kernelCount == scalarCount);
+  CHECK(kernel == scalar);
+  CHECK(kernelCount > 0);
+  CHECK(kernelCount < bounds.Size());
+}
+
+TEST(FrustumCulling, MergeAndTransform)
+{
+  const Bounds merged = FrustumCulling::MergeBounds(Box(0.0f, 0.0f, 0.0f, 1.0f, 1.5f), Box(4.0f, 0.0f, 0.0f, 1.0f, 1.5f));
+  CHECK(merged.center[0] == 2.0f);
+  CHECK(merged.extents[0] == 3.0f);
+  CHECK(merged.extents[1] == 1.0f);
+  // the box corners are closer than the spheres
+  CHECK(std::fabs(merged.radius - std::sqrt(11.0f)) < 1e-5f);
+
+  // 90 degrees around z, scale 2 on x, translated
+  const float matrix[16] = {
+    0.0f, 1.0f, 0.0f, 0.0f,
+    -2.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    5.0f, 6.0f, 7.0f, 1.0f };
+  const Bounds transformed = FrustumCulling::TransformBounds(Box(4.0f, 0.0f, 0.0f, 1.0f, 1.5f), matrix, 2.0f);
+  CHECK(transformed.center[0] == 5.0f);
+  CHECK(transformed.center[1] == 10.0f);
+  CHECK(transformed.center[2] == 7.0f);
+  CHECK(transformed.extents[0] == 2.0f);
+  CHECK(transformed.extents[1] == 1.0f);
+  CHECK(transformed.radius == 3.0f);
+}
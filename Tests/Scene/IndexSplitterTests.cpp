@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/IndexSplitter.h"
+#include "Scene/TestMeshes.h"
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+namespace
+{
+  // the vertices the way DX12Model lays them out for a single level
+  std::vector<MeshVertex> SplitVertices(const SplitIndices& split, const std::vector<MeshVertex>& source)
+  {
+    if (split.vertexRemap.empty())
+      return source;
+
+    std::vector<MeshVertex> output;
+    for (uint32_t vertex : split.vertexRemap)
+      output.push_back(source[vertex]);
+    return output;
+  }
+
+  // every triangle drawn from the ranges is the source triangle, same vertices in the same order
+  void CheckIdenticalTriangles(const std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices)
+  {
+    const SplitIndices split = IndexSplitter::Split(indices.data(), indices.size(), vertices.size());
+    const std::vector<MeshVertex> splitVertices = SplitVertices(split, vertices);
+
+    REQUIRE(split.indices.size() == indices.size());
+    size_t drawn = 0;
+    size_t mismatches = 0;
+    for (const IndexRange& range : split.ranges)
+    {
+      // ranges follow each other and are made of whole triangles
+      CHECK(range.indexOffset == drawn);
+      CHECK(range.indexCount % 3 == 0);
+      drawn += range.indexCount;
+
+      for (uint32_t i = range.indexOffset; i < range.indexOffset + range.indexCount; ++i)
+      {
+        const size_t vertex = size_t(range.vertexOffset) + split.indices[i];
+        REQUIRE(vertex < splitVertices.size());
+        mismatches += memcmp(&splitVertices[vertex], &vertices[indices[i]], sizeof(MeshVertex)) != 0;
+      }
+    }
+    CHECK(drawn == indices.size());
+    CHECK(mismatches == 0);
+  }
+
+  std::vector<uint32_t> RandomTriangles(size_t vertexCount, size_t triangleCount)
+  {
+    std::mt19937 random(3);
+    std::vector<uint32_t> output;
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+      // mostly local triangles, a few spanning the whole mesh
+      const uint32_t first = random() % vertexCount;
+      output.push_back(first);
+      output.push_back((first + random() % 50) % vertexCount);
+      output.push_back(triangle % 17 == 0 ? random() % vertexCount : (first + random() % 50) % vertexCount);
+    }
+    return output;
+  }
+
+  std::vector<MeshVertex> NumberedVertices(size_t count)
+  {
+    std::vector<MeshVertex> output(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      output[i] = {};
+      output[i].position[0] = float(i);
+    }
+    return output;
+  }
+}
+
+TEST(IndexSplitter, SmallMeshKeepsItsVertices)
+{
+  const Tests::TestMesh mesh = Tests::MakeTube(64, 16);
+  const SplitIndices split = IndexSplitter::Split(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+  CHECK(split.vertexRemap.empty());
+  REQUIRE(split.ranges.size() == 1);
+  CHECK(split.ranges[0].vertexOffset == 0);
+  for (size_t i = 0; i < mesh.indices.size(); ++i)
+    CHECK(split.indices[i] == mesh.indices[i]);
+}
+
+TEST(IndexSplitter, IdenticalTriangles)
+{
+  // at the 16-bit limit and just above it
+  for (size_t vertexCount : { size_t(65536), size_t(65537) })
+    CheckIdenticalTriangles(RandomTriangles(vertexCount, vertexCount * 2), NumberedVertices(vertexCount));
+
+  // a big tube, and random triangles all over a large mesh
+  const Tests::TestMesh mesh = Tests::MakeTube(1024, 96);
+  CheckIdenticalTriangles(mesh.indices, mesh.vertices);
+  CheckIdenticalTriangles(RandomTriangles(300000, 600000), NumberedVertices(300000));
+}
+
+TEST(IndexSplitter, RangesFitSixteenBits)
+{
+  const std::vector<uint32_t> indices = RandomTriangles(200000, 400000);
+  const SplitIndices split = IndexSplitter::Split(indices.data(), indices.size(), 200000);
+
+  CHECK(split.ranges.size() > 1);
+  for (size_t r = 0; r < split.ranges.size(); ++r)
+  {
+    // a range only references its own copy of the vertices
+    const uint32_t end = r + 1 < split.ranges.size() ? split.ranges[r + 1].vertexOffset : uint32_t(split.vertexRemap.size());
+    CHECK(end - split.ranges[r].vertexOffset <= IndexSplitter::MaxRangeVertices);
+    for (uint32_t i = split.ranges[r].indexOffset; i < split.ranges[r].indexOffset + split.ranges[r].indexCount; ++i)
+      CHECK(split.ranges[r].vertexOffset + split.indices[i] < end);
+  }
+}
+
+TEST(IndexSplitter, RejectsBadInput)
+{
+  const std::vector<uint32_t> notTriangles = { 0, 1, 2, 3 };
+  CHECK_THROWS(IndexSplitter::Split(notTriangles.data(), notTriangles.size(), 4), std::invalid_argument);
+
+  const std::vector<uint32_t> outOfRange = { 0, 1, 4 };
+  CHECK_THROWS(IndexSplitter::Split(outOfRange.data(), outOfRange.size(), 4), std::out_of_range);
+  const std::vector<uint32_t> bigOutOfRange = { 0, 1, 70000 };
+  CHECK_THROWS(IndexSplitter::Split(bigOutOfRange.data(), bigOutOfRange.size(), 70000), std::out_of_range);
+}
@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/MeshOptimizer.h"
+#include "Scene/TestMeshes.h"
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+// the three passes DX12Model runs at import, on every mesh of sponza
+BENCHMARK(MeshOptimizer, ImportSponza)
+{
+  const std::vector<Tests::TestMesh> meshes = Tests::LoadSponza();
+
+  size_t triangleCount = 0;
+  double before = 0.0;
+  double after = 0.0;
+  double beforeAtvr = 0.0;
+  double afterAtvr = 0.0;
+  std::vector<std::vector<uint32_t>> indices(meshes.size());
+
+  const double milliseconds = Tests::MeasureMilliseconds(3, [&]() {
+    triangleCount = 0;
+    before = after = beforeAtvr = afterAtvr = 0.0;
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+      const Tests::TestMesh& mesh = meshes[i];
+      indices[i] = mesh.indices;
+      uint32_t* meshIndices = indices[i].data();
+      const size_t indexCount = indices[i].size();
+      const size_t vertexCount = mesh.vertices.size();
+
+      const VertexCacheStats start = MeshOptimizer::AnalyzeVertexCache(meshIndices, indexCount, vertexCount);
+      const std::vector<uint32_t> clusters = MeshOptimizer::OptimizeVertexCache(meshIndices, indexCount, vertexCount);
+      MeshOptimizer::OptimizeOverdraw(meshIndices, indexCount, mesh.vertices[0].position, sizeof(MeshVertex), vertexCount, clusters);
+      const std::vector<uint32_t> sources = MeshOptimizer::OptimizeVertexFetch(meshIndices, indexCount, vertexCount);
+      const VertexCacheStats end = MeshOptimizer::AnalyzeVertexCache(meshIndices, indexCount, sources.size());
+
+      // weighted by triangles
+      const size_t triangles = indexCount / 3;
+      triangleCount += triangles;
+      before += start.acmr * triangles;
+      after += end.acmr * triangles;
+      beforeAtvr += start.atvr * triangles;
+      afterAtvr += end.atvr * triangles;
+    }
+  });
+
+  printf("  %s: %zu meshes, %zu triangles, %.2f ms (%.1f ms per million triangles)\n",
+    meshes[0].name.c_str(), meshes.size(), triangleCount, milliseconds, milliseconds * 1e6 / triangleCount);
+  printf("  acmr %.3f -> %.3f, atvr %.3f -> %.3f\n",
+    before / triangleCount, after / triangleCount, beforeAtvr / triangleCount, afterAtvr / triangleCount);
+}
@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/MeshOptimizer.h"
+#include "Scene/TestMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+namespace
+{
+  typedef std::array<uint32_t, 3> Triangle;
+
+  // triangles in a canonical order, rotated to keep the winding
+  std::vector<Triangle> SortedTriangles(const std::vector<uint32_t>& indices, const std::vector<uint32_t>* sources = nullptr)
+  {
+    std::vector<Triangle> output;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+      Triangle triangle = { indices[i], indices[i + 1], indices[i + 2] };
+      if (sources)
+      {
+        for (uint32_t& vertex : triangle)
+          vertex = (*sources)[vertex];
+      }
+      while (triangle[0] > triangle[1] || triangle[0] > triangle[2])
+        std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+      output.push_back(triangle);
+    }
+    std::sort(output.begin(), output.end());
+    return output;
+  }
+
+  // the tube in random triangle order, what a badly exported mesh looks like
+  Tests::TestMesh ShuffledTube()
+  {
+    Tests::TestMesh mesh = Tests::MakeTube(256, 32);
+    std::vector<Triangle> triangles;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+      triangles.push_back({ mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] });
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(5));
+
+    mesh.indices.clear();
+    for (const Triangle& triangle : triangles)
+      mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    return mesh;
+  }
+}
+
+TEST(MeshOptimizer, AnalyzeVertexCache)
+{
+  // a lone triangle misses every vertex
+  const std::vector<uint32_t> triangle = { 0, 1, 2 };
+  VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(triangle.data(), triangle.size(), 3);
+  CHECK(stats.acmr == 3.0f);
+  CHECK(stats.atvr == 1.0f);
+
+  // a quad reuses the shared edge
+  const std::vector<uint32_t> quad = { 0, 1, 2, 2, 1, 3 };
+  stats = MeshOptimizer::AnalyzeVertexCache(quad.data(), quad.size(), 4);
+  CHECK(stats.acmr == 2.0f);
+  CHECK(stats.atvr == 1.0f);
+}
+
+TEST(MeshOptimizer, KeepsTheTriangles)
+{
+  Tests::TestMesh mesh = ShuffledTube();
+  const std::vector<Triangle> source = SortedTriangles(mesh.indices);
+  const size_t vertexCount = mesh.vertices.size();
+
+  const std::vector<uint32_t> clusters = MeshOptimizer::OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+  CHECK(SortedTriangles(mesh.indices) == source);
+  REQUIRE(!clusters.empty());
+  CHECK(clusters[0] == 0);
+  CHECK(std::is_sorted(clusters.begin(), clusters.end()));
+
+  MeshOptimizer::OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(MeshVertex), vertexCount, clusters);
+  CHECK(SortedTriangles(mesh.indices) == source);
+
+  const std::vector<uint32_t> sources = MeshOptimizer::OptimizeVertexFetch(mesh.indices.data(), mesh.indices.size(), vertexCount);
+  CHECK(SortedTriangles(mesh.indices, &sources) == source);
+}
+
+TEST(MeshOptimizer, ImprovesTheVertexCache)
+{
+  Tests::TestMesh mesh = ShuffledTube();
+  const size_t vertexCount = mesh.vertices.size();
+  const VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+
+  const std::vector<uint32_t> clusters = MeshOptimizer::OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+  const VertexCacheStats optimized = MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+  CHECK(before.acmr > 2.5f);
+  CHECK(optimized.acmr < 0.8f);
+  CHECK(optimized.atvr < before.atvr);
+
+  // the overdraw pass only gives back a little of it, the threshold plus the seams between moved clusters
+  MeshOptimizer::OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(MeshVertex), vertexCount, clusters);
+  const VertexCacheStats overdraw = MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+  CHECK(overdraw.acmr <= optimized.acmr * 1.15f);
+  CHECK(overdraw.acmr < 1.0f);
+}
+
+TEST(MeshOptimizer, VertexFetchOrder)
+{
+  // vertex 1 and 4 are unused
+  std::vector<uint32_t> indices = { 5, 3, 0, 0, 3, 2, 2, 3, 5 };
+  const std::vector<uint32_t> sources = MeshOptimizer::OptimizeVertexFetch(indices.data(), indices.size(), 6);
+
+  CHECK(sources == std::vector<uint32_t>({ 5, 3, 0, 2 }));
+  CHECK(indices == std::vector<uint32_t>({ 0, 1, 2, 2, 1, 3, 3, 1, 0 }));
+
+  std::vector<int> vertices = { 10, 11, 12, 13, 14, 15 };
+  MeshOptimizer::RemapVertices(sources, vertices);
+  CHECK(vertices == std::vector<int>({ 15, 13, 10, 12 }));
+}
+
+TEST(MeshOptimizer, DegenerateInput)
+{
+  std::vector<uint32_t> empty;
+  CHECK(MeshOptimizer::OptimizeVertexCache(empty.data(), 0, 5).empty());
+  CHECK(MeshOptimizer::OptimizeVertexFetch(empty.data(), 0, 5).empty());
+
+  // degenerate triangles survive every pass
+  const float positions[5 * 3] = {};
+  std::vector<uint32_t> indices = { 3, 3, 3, 4, 2, 3 };
+  const std::vector<Triangle> source = SortedTriangles(indices);
+  const std::vector<uint32_t> clusters = MeshOptimizer::OptimizeVertexCache(indices.data(), indices.size(), 5);
+  MeshOptimizer::OptimizeOverdraw(indices.data(), indices.size(), positions, sizeof(float) * 3, 5, clusters);
+  CHECK(SortedTriangles(indices) == source);
+}
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/FrustumCulling.h"
+#include "Scene/MeshSimplifier.h"
+#include "Scene/TestMeshes.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+namespace
+{
+  // DX12Mesh settings
+  const size_t LOD_COUNT = 4;
+  const float LOD_REDUCTION = 0.5f;
+  const float LOD_MIN_REDUCTION = 0.8f;
+  const float LOD_PIXEL_ERROR = 1.0f;
+  const float LOD_HYSTERESIS = 0.75f;
+
+  struct LodChain
+  {
+    std::vector<size_t> triangles;
+    std::vector<float> errors;
+    Bounds bounds;
+  };
+
+  // the levels DX12Mesh builds at import, each one simplified from the previous one
+  LodChain BuildLods(const Tests::TestMesh& mesh)
+  {
+    LodChain output;
+    std::vector<uint32_t> previous = mesh.indices;
+    output.triangles.push_back(previous.size() / 3);
+    output.errors.push_back(0.0f);
+    while (output.triangles.size() < LOD_COUNT)
+    {
+      auto simplified = MeshSimplifier::Simplify(
+        previous.data(), previous.size(), mesh.vertices[0].position, sizeof(MeshVertex), mesh.vertices.size(),
+        static_cast<size_t>(previous.size() / 3 * LOD_REDUCTION) * 3, FLT_MAX);
+      if (simplified.indices.empty() || simplified.indices.size() > previous.size() * LOD_MIN_REDUCTION)
+        break;
+      output.triangles.push_back(simplified.indices.size() / 3);
+      output.errors.push_back(output.errors.back() + simplified.error);
+      previous.swap(simplified.indices);
+    }
+    output.bounds = FrustumCulling::ComputeBounds(mesh.vertices[0].position, sizeof(MeshVertex), mesh.vertices.size());
+    return output;
+  }
+
+  struct Flythrough
+  {
+    double triangles = 0.0;
+    double fullTriangles = 0.0;
+    size_t peakTriangles = 0;
+    size_t switches = 0;
+  };
+}
+
+// a field of mesh instances, the camera flies low across it then climbs away, levels picked every frame
+BENCHMARK(MeshSimplifier, LodFlythrough)
+{
+  const std::vector<Tests::TestMesh> meshes = Tests::LoadSponza();
+
+  std::vector<LodChain> chains(meshes.size());
+  const double buildMilliseconds = Tests::MeasureMilliseconds(1, [&]() {
+    for (size_t i = 0; i < meshes.size(); ++i)
+      chains[i] = BuildLods(meshes[i]);
+  });
+
+  // recentred on a grid, far enough apart that they don't overlap
+  const unsigned GRID = 16;
+  float spacing = 0.0f;
+  for (const LodChain& chain : chains)
+    spacing = chain.bounds.radius * 3.0f > spacing ? chain.bounds.radius * 3.0f : spacing;
+  std::vector<Bounds> instances;
+  std::vector<const LodChain*> instanceChains;
+  for (unsigned z = 0; z < GRID; ++z)
+  {
+    for (unsigned x = 0; x < GRID; ++x)
+    {
+      const LodChain& chain = chains[(z * GRID + x) % chains.size()];
+      Bounds bounds = chain.bounds;
+      bounds.center[0] = (x - GRID * 0.5f) * spacing;
+      bounds.center[1] = 0.0f;
+      bounds.center[2] = (z - GRID * 0.5f) * spacing;
+      instances.push_back(bounds);
+      instanceChains.push_back(&chain);
+    }
+  }
+
+  // 1080p, the fov of the tests
+  const float pixelScale = 1080.0f / (2.0f * std::tan(0.4f));
+  const unsigned FRAMES = 1200;
+  auto eyeAt = [&](unsigned frame, float eye[3]) {
+    const float t = float(frame) / FRAMES;
+    const float half = GRID * 0.5f * spacing;
+    const float across = t < 0.66f ? t / 0.66f : 1.0f;
+    const float climb = t < 0.66f ? 0.0f : (t - 0.66f) / 0.34f;
+    eye[0] = -half + 2.0f * half * across;
+    eye[1] = spacing * 0.5f + climb * 4.0f * half;
+    eye[2] = -half + 1.6f * half * across;
+  };
+
+  auto fly = [&](float hysteresis) {
+    Flythrough output;
+    std::vector<size_t> current(instances.size(), 0);
+    for (unsigned frame = 0; frame < FRAMES; ++frame)
+    {
+      float eye[3];
+      eyeAt(frame, eye);
+      size_t triangles = 0;
+      for (size_t i = 0; i < instances.size(); ++i)
+      {
+        const Bounds& bounds = instances[i];
+        const LodChain& chain = *instanceChains[i];
+        const float dx = bounds.center[0] - eye[0];
+        const float dy = bounds.center[1] - eye[1];
+        const float dz = bounds.center[2] - eye[2];
+        const float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - bounds.radius;
+
+        const size_t level = distance <= 0.0f ? 0 : MeshSimplifier::SelectLevel(
+          chain.errors.data(), chain.errors.size(), current[i], pixelScale / distance, LOD_PIXEL_ERROR, hysteresis);
+        output.switches += level != current[i];
+        current[i] = level;
+        triangles += chain.triangles[level];
+        output.fullTriangles += chain.triangles[0];
+      }
+      output.triangles += triangles;
+      output.peakTriangles = triangles > output.peakTriangles ? triangles : output.peakTriangles;
+    }
+    output.triangles /= FRAMES;
+    output.fullTriangles /= FRAMES;
+    return output;
+  };
+
+  Flythrough hysteresis;
+  Flythrough plain;
+  const double selectMilliseconds = Tests::MeasureMilliseconds(5, [&]() { hysteresis = fly(LOD_HYSTERESIS); });
+  plain = fly(1.0f);
+
+  size_t levels = 0;
+  for (const LodChain& chain : chains)
+    levels += chain.triangles.size();
+  printf("  %s: %zu meshes, %.2f levels each, built in %.1f ms\n",
+    meshes[0].name.c_str(), meshes.size(), double(levels) / meshes.size(), buildMilliseconds);
+  printf("  %zu instances, %u frames: %.0f triangles submitted per frame (peak %zu) against %.0f at LOD0, %.1f%%\n",
+    instances.size(), FRAMES, hysteresis.triangles, hysteresis.peakTriangles, hysteresis.fullTriangles, 100.0 * hysteresis.triangles / hysteresis.fullTriangles);
+  printf("  level switches %zu with hysteresis, %zu without, selection %.3f us per instance\n",
+    hysteresis.switches, plain.switches, selectMilliseconds * 1e3 / (double(FRAMES) * instances.size()));
+}
@@ -0,0 +1,208 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/MeshSimplifier.h"
+#include "Scene/TestMeshes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+namespace
+{
+  double Dot(const double* a, const double* b)
+  {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  }
+
+  // projection on the plane when it falls inside, the closest edge otherwise
+  double PointTriangleDistance(const float* point, const float* a, const float* b, const float* c)
+  {
+    const float* corners[3] = { a, b, c };
+    double best = 1e30;
+    for (unsigned edge = 0; edge < 3; ++edge)
+    {
+      const float* start = corners[edge];
+      const float* end = corners[(edge + 1) % 3];
+      const double direction[3] = { double(end[0]) - start[0], double(end[1]) - start[1], double(end[2]) - start[2] };
+      const double offset[3] = { double(point[0]) - start[0], double(point[1]) - start[1], double(point[2]) - start[2] };
+      const double length = Dot(direction, direction);
+      const double t = length > 0.0 ? std::clamp(Dot(offset, direction) / length, 0.0, 1.0) : 0.0;
+      const double rest[3] = { offset[0] - direction[0] * t, offset[1] - direction[1] * t, offset[2] - direction[2] * t };
+      best = std::min(best, std::sqrt(Dot(rest, rest)));
+    }
+
+    const double e1[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+    const double e2[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+    double normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    const double length = std::sqrt(Dot(normal, normal));
+    if (length == 0.0)
+      return best;
+    for (double& value : normal)
+      value /= length;
+
+    const double offset[3] = { double(point[0]) - a[0], double(point[1]) - a[1], double(point[2]) - a[2] };
+    const double height = Dot(offset, normal);
+    const double projected[3] = { point[0] - normal[0] * height, point[1] - normal[1] * height, point[2] - normal[2] * height };
+    for (unsigned edge = 0; edge < 3; ++edge)
+    {
+      const float* start = corners[edge];
+      const float* end = corners[(edge + 1) % 3];
+      const double direction[3] = { double(end[0]) - start[0], double(end[1]) - start[1], double(end[2]) - start[2] };
+      const double toPoint[3] = { projected[0] - start[0], projected[1] - start[1], projected[2] - start[2] };
+      const double side[3] = {
+        direction[1] * toPoint[2] - direction[2] * toPoint[1],
+        direction[2] * toPoint[0] - direction[0] * toPoint[2],
+        direction[0] * toPoint[1] - direction[1] * toPoint[0] };
+      if (Dot(side, normal) < 0.0)
+        return best;
+    }
+    return std::min(best, std::fabs(height));
+  }
+
+  // largest distance of the input vertices to the simplified surface, brute force
+  double MeasureError(const std::vector<uint32_t>& input, const std::vector<uint32_t>& simplified, const std::vector<MeshVertex>& vertices)
+  {
+    std::vector<bool> used(vertices.size(), false);
+    for (uint32_t vertex : input)
+      used[vertex] = true;
+
+    double worst = 0.0;
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+      if (!used[v])
+        continue;
+      double closest = 1e30;
+      for (size_t i = 0; i < simplified.size(); i += 3)
+        closest = std::min(closest, PointTriangleDistance(vertices[v].position,
+          vertices[simplified[i]].position, vertices[simplified[i + 1]].position, vertices[simplified[i + 2]].position));
+      worst = std::max(worst, closest);
+    }
+    return worst;
+  }
+
+  SimplifiedMesh Simplify(const std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, size_t targetIndexCount, float targetError)
+  {
+    return MeshSimplifier::Simplify(
+      indices.data(), indices.size(), vertices[0].position, sizeof(MeshVertex), vertices.size(), targetIndexCount, targetError);
+  }
+}
+
+TEST(MeshSimplifier, ErrorIsABound)
+{
+  // levels simplified from the previous one like at import, the error of each one against its input
+  const Tests::TestMesh mesh = Tests::MakeTube(96, 16);
+  std::vector<uint32_t> level = mesh.indices;
+  for (unsigned lod = 0; lod < 3; ++lod)
+  {
+    const SimplifiedMesh simplified = Simplify(level, mesh.vertices, level.size() / 6 * 3, 1e30f);
+    REQUIRE(!simplified.indices.empty());
+    CHECK(simplified.indices.size() <= level.size() / 2 + 3);
+
+    const double measured = MeasureError(level, simplified.indices, mesh.vertices);
+    CHECK(measured > 0.0);
+    // the quadric estimate was about 1.3 times under it
+    CHECK(simplified.error >= measured * 0.9999);
+    CHECK(simplified.error <= measured * 1.0001 + 1e-6);
+
+    level = simplified.indices;
+  }
+}
+
+TEST(MeshSimplifier, StopsAtTheTargetError)
+{
+  const Tests::TestMesh mesh = Tests::MakeTube(96, 16);
+  const SimplifiedMesh coarse = Simplify(mesh.indices, mesh.vertices, 0, 0.05f);
+  const SimplifiedMesh fine = Simplify(mesh.indices, mesh.vertices, 0, 0.01f);
+
+  CHECK(fine.indices.size() < mesh.indices.size());
+  CHECK(fine.indices.size() > coarse.indices.size());
+  CHECK(fine.error < coarse.error);
+  CHECK(fine.error >= MeasureError(mesh.indices, fine.indices, mesh.vertices) * 0.9999);
+}
+
+TEST(MeshSimplifier, KeepsBordersAndSeams)
+{
+  // a flat grid collapses freely inside, the border vertices stay where they are
+  const unsigned Size = 16;
+  std::vector<MeshVertex> vertices;
+  for (unsigned y = 0; y <= Size; ++y)
+    for (unsigned x = 0; x <= Size; ++x)
+      vertices.push_back({ { float(x), float(y), 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } });
+  std::vector<uint32_t> indices;
+  for (unsigned y = 0; y < Size; ++y)
+  {
+    for (unsigned x = 0; x < Size; ++x)
+    {
+      const uint32_t a = y * (Size + 1) + x;
+      indices.insert(indices.end(), { a, a + 1, a + Size + 1, a + 1, a + Size + 2, a + Size + 1 });
+    }
+  }
+
+  const SimplifiedMesh simplified = Simplify(indices, vertices, 0, 1e30f);
+  CHECK(simplified.indices.size() < indices.size() / 4);
+  CHECK(simplified.error < 1e-4f);
+
+  std::vector<bool> used(vertices.size(), false);
+  for (uint32_t vertex : simplified.indices)
+    used[vertex] = true;
+  for (unsigned i = 0; i <= Size; ++i)
+  {
+    CHECK(used[i]);
+    CHECK(used[Size * (Size + 1) + i]);
+    CHECK(used[i * (Size + 1)]);
+    CHECK(used[i * (Size + 1) + Size]);
+  }
+}
+
+TEST(MeshSimplifier, RejectsBadInput)
+{
+  const std::vector<MeshVertex> vertices(4);
+  const std::vector<uint32_t> notTriangles = { 0, 1, 2, 3 };
+  CHECK_THROWS(Simplify(notTriangles, vertices, 0, 1.0f), std::invalid_argument);
+  const std::vector<uint32_t> outOfRange = { 0, 1, 4 };
+  CHECK_THROWS(Simplify(outOfRange, vertices, 0, 1.0f), std::out_of_range);
+}
+
+TEST(MeshSimplifier, SelectLevelHysteresis)
+{
+  // one pixel of error allowed, coarser under three quarters of it
+  const float errors[] = { 0.0f, 1.0f, 2.0f, 4.0f };
+  auto select = [&](size_t current, float errorScale) { return MeshSimplifier::SelectLevel(errors, 4, current, errorScale, 1.0f, 0.75f); };
+
+  // close, the full mesh, far enough, the coarsest
+  CHECK(select(0, 10.0f) == 0);
+  CHECK(select(3, 10.0f) == 0);
+  CHECK(select(0, 0.1f) == 3);
+
+  // level 1 shows 0.9 pixels, enough to stay but not to go coarser
+  CHECK(select(1, 0.9f) == 1);
+  CHECK(select(0, 0.9f) == 0);
+  CHECK(select(0, 0.7f) == 1);
+  // level 2 shows 1.4 pixels, finer right away
+  CHECK(select(2, 0.7f) == 1);
+
+  // going away and coming back, the switch points differ
+  size_t level = 0;
+  std::vector<size_t> out;
+  std::vector<size_t> back;
+  for (int step = 0; step <= 100; ++step)
+    out.push_back(level = select(level, 2.0f - step * 0.019f));
+  for (int step = 100; step >= 0; --step)
+    back.push_back(level = select(level, 2.0f - step * 0.019f));
+  std::reverse(back.begin(), back.end());
+  CHECK(out.front() == 0 && back.front() == 0);
+  CHECK(out != back);
+  // at the same distance, never coarser on the way out than on the way back
+  bool finerOut = true;
+  for (size_t i = 0; i < out.size(); ++i)
+    finerOut &= out[i] <= back[i];
+  CHECK(finerOut);
+
+  // a current level past the end, and a single level
+  CHECK(select(7, 10.0f) == 0);
+  CHECK(MeshSimplifier::SelectLevel(errors, 1, 0, 0.0f, 1.0f, 0.75f) == 0);
+}
@@ -0,0 +1,38 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/MeshOptimizer.h"
+#include "Scene/MeshletBuilder.h"
+#include "Scene/TestMeshes.h"
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+// meshlets of every sponza mesh, after the vertex cache pass like at import
+BENCHMARK(MeshletBuilder, BuildSponza)
+{
+  std::vector<Tests::TestMesh> meshes = Tests::LoadSponza();
+  size_t triangleCount = 0;
+  for (Tests::TestMesh& mesh : meshes)
+  {
+    MeshOptimizer::OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    triangleCount += mesh.indices.size() / 3;
+  }
+
+  size_t meshletCount = 0;
+  size_t cullable = 0;
+  const double milliseconds = Tests::MeasureMilliseconds(5, [&]() {
+    meshletCount = cullable = 0;
+    for (const Tests::TestMesh& mesh : meshes)
+    {
+      const MeshletData data = MeshletBuilder::Build(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(MeshVertex), mesh.vertices.size());
+      meshletCount += data.meshlets.size();
+      for (const Meshlet& meshlet : data.meshlets)
+        cullable += meshlet.coneCutoff < 1.0f;
+    }
+  });
+
+  printf("  %s: %zu meshes, %zu triangles, %.2f ms (%.1f ms per million triangles)\n",
+    meshes[0].name.c_str(), meshes.size(), triangleCount, milliseconds, milliseconds * 1e6 / triangleCount);
+  printf("  %zu meshlets, %.1f triangles each, %zu with a normal cone\n", meshletCount, double(triangleCount) / meshletCount, cullable);
+}
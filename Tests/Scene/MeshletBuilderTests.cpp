@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/MeshOptimizer.h"
+#include "Scene/MeshletBuilder.h"
+#include "Scene/TestMeshes.h"
+
+#include <cmath>
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+TEST(MeshletBuilder, CoversTheMeshWithinLimits)
+{
+  Tests::TestMesh mesh = Tests::MakeTube(256, 32);
+  MeshOptimizer::OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+  const MeshletData data = MeshletBuilder::Build(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(MeshVertex), mesh.vertices.size());
+
+  size_t triangle = 0;
+  size_t mismatches = 0;
+  size_t outside = 0;
+  for (const Meshlet& meshlet : data.meshlets)
+  {
+    CHECK(meshlet.vertexCount <= MeshletBuilder::MaxVertices);
+    CHECK(meshlet.triangleCount <= MeshletBuilder::MaxTriangles);
+    CHECK(meshlet.triangleOffset == triangle * 3);
+
+    // the triangles in index order, through the meshlet vertices
+    for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+    {
+      const uint8_t local = data.triangles[meshlet.triangleOffset + i];
+      REQUIRE(local < meshlet.vertexCount);
+      mismatches += data.vertices[meshlet.vertexOffset + local] != mesh.indices[triangle * 3 + i];
+    }
+    triangle += meshlet.triangleCount;
+
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+      const float* position = mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position;
+      const float distance = std::sqrt(
+        (position[0] - meshlet.center[0]) * (position[0] - meshlet.center[0]) +
+        (position[1] - meshlet.center[1]) * (position[1] - meshlet.center[1]) +
+        (position[2] - meshlet.center[2]) * (position[2] - meshlet.center[2]));
+      outside += distance > meshlet.radius * 1.0001f + 1e-6f;
+    }
+  }
+
+  CHECK(triangle * 3 == mesh.indices.size());
+  CHECK(mismatches == 0);
+  CHECK(outside == 0);
+}
+
+TEST(MeshletBuilder, NormalConesHoldForTheTriangles)
+{
+  Tests::TestMesh mesh = Tests::MakeTube(128, 32);
+  MeshOptimizer::OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+  const MeshletData data = MeshletBuilder::Build(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(MeshVertex), mesh.vertices.size());
+
+  // every face normal is within the cone, the cutoff is the sine of its half angle
+  size_t cullable = 0;
+  size_t violations = 0;
+  for (const Meshlet& meshlet : data.meshlets)
+  {
+    if (meshlet.coneCutoff >= 1.0f)
+      continue;
+    ++cullable;
+
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+    {
+      const float* p[3];
+      for (unsigned k = 0; k < 3; ++k)
+        p[k] = mesh.vertices[data.vertices[meshlet.vertexOffset + data.triangles[meshlet.triangleOffset + t * 3 + k]]].position;
+
+      const float e0[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+      const float e1[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+      const float normal[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+      const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+      if (length == 0.0f)
+        continue;
+
+      // cosine of the angle to the axis at least the cosine of the half angle
+      const float dot = (normal[0] * meshlet.coneAxis[0] + normal[1] * meshlet.coneAxis[1] + normal[2] * meshlet.coneAxis[2]) / length;
+      violations += dot < std::sqrt(std::fmax(0.0f, 1.0f - meshlet.coneCutoff * meshlet.coneCutoff)) - 1e-3f;
+    }
+  }
+
+  CHECK(cullable > data.meshlets.size() / 2);
+  CHECK(violations == 0);
+}
+
+TEST(MeshletBuilder, Deterministic)
+{
+  const Tests::TestMesh mesh = Tests::MakeTube(64, 24);
+  const MeshletData first = MeshletBuilder::Build(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(MeshVertex), mesh.vertices.size());
+  const MeshletData second = MeshletBuilder::Build(mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].position, sizeof(MeshVertex), mesh.vertices.size());
+
+  CHECK(first.vertices == second.vertices);
+  CHECK(first.triangles == second.triangles);
+  CHECK(first.meshlets.size() == second.meshlets.size());
+}
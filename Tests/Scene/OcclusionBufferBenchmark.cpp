@@ -0,0 +1,118 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/OcclusionBuffer.h"
+
+#include <cmath>
+#include <random>
+
+using namespace Scene;
+
+namespace
+{
+  // SceneGraph settings
+  const uint32_t OCCLUSION_WIDTH = 320;
+  const uint32_t OCCLUSION_HEIGHT = 192;
+  const unsigned OCCLUSION_THREADS = 4;
+  const double OCCLUSION_BUDGET_MS = 1.0;
+  const size_t OCCLUDER_TRIANGLE_BUDGET = 8192;
+
+  const float Identity[16] = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f };
+
+  // box between low and high, 12 triangles
+  OccluderMesh Box(const float low[3], const float high[3])
+  {
+    OccluderMesh mesh;
+    for (unsigned corner = 0; corner < 8; ++corner)
+      mesh.positions.insert(mesh.positions.end(), { corner & 1 ? high[0] : low[0], corner & 2 ? high[1] : low[1], corner & 4 ? high[2] : low[2] });
+    mesh.indices = {
+      0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+      0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+      0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+    return mesh;
+  }
+}
+
+// a street of buildings in front of the camera, the occluder triangle budget filled, a frame of visible meshes tested
+BENCHMARK(OcclusionBuffer, Frame)
+{
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  std::vector<OccluderMesh> occluders;
+  size_t triangles = 0;
+  while (triangles + 12 <= OCCLUDER_TRIANGLE_BUDGET)
+  {
+    const float x = (unit(random) - 0.5f) * 300.0f;
+    const float z = 10.0f + unit(random) * 300.0f;
+    const float size = 2.0f + unit(random) * 8.0f;
+    const float low[3] = { x, -2.0f, z };
+    const float high[3] = { x + size, -2.0f + size * (1.0f + unit(random) * 3.0f), z + size };
+    occluders.push_back(Box(low, high));
+    triangles += 12;
+  }
+
+  std::vector<Bounds> tested(5000);
+  for (Bounds& bounds : tested)
+  {
+    const float extent = 0.2f + unit(random) * 2.0f;
+    bounds = { { (unit(random) - 0.5f) * 300.0f, unit(random) * 10.0f, 5.0f + unit(random) * 400.0f }, { extent, extent, extent }, extent * 1.7320508f };
+  }
+
+  // XMMatrixPerspectiveFovLH, looking down +z from the origin
+  const float eye[3] = { 0.0f, 1.5f, 0.0f };
+  const float height = 1.0f / std::tan(0.4f);
+  const float range = 1000.0f / (1000.0f - 0.5f);
+  const float viewProjection[16] = {
+    height * OCCLUSION_HEIGHT / OCCLUSION_WIDTH, 0.0f, 0.0f, 0.0f,
+    0.0f, height, 0.0f, 0.0f,
+    0.0f, 0.0f, range, 1.0f,
+    0.0f, -1.5f * height, -range * 0.5f, 0.0f };
+
+  OcclusionBuffer buffer(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+  double stages[4] = {};
+  size_t hidden = 0;
+  auto frame = [&](bool kernel) {
+    auto start = std::chrono::steady_clock::now();
+    auto lap = [&start](double& stage) {
+      const auto now = std::chrono::steady_clock::now();
+      stage += std::chrono::duration<double, std::milli>(now - start).count();
+      start = now;
+    };
+
+    buffer.Clear(viewProjection, eye);
+    lap(stages[0]);
+    for (const OccluderMesh& occluder : occluders)
+      buffer.AddOccluder(occluder, Identity);
+    lap(stages[1]);
+    if (kernel)
+      buffer.Rasterize(OCCLUSION_THREADS);
+    else
+      buffer.RasterizeScalar();
+    lap(stages[2]);
+    hidden = 0;
+    for (const Bounds& bounds : tested)
+      hidden += !buffer.IsVisible(bounds);
+    lap(stages[3]);
+  };
+
+  const int REPETITIONS = 50;
+  const double kernel = Tests::MeasureMilliseconds(REPETITIONS, [&]() { frame(true); });
+  const size_t kernelHidden = hidden;
+  const double kernelStages[4] = { stages[0] / REPETITIONS, stages[1] / REPETITIONS, stages[2] / REPETITIONS, stages[3] / REPETITIONS };
+  std::fill(stages, stages + 4, 0.0);
+  const double scalar = Tests::MeasureMilliseconds(REPETITIONS, [&]() { frame(false); });
+
+  printf("  %ux%u, %zu occluder triangles (%zu set up), %zu bounds tested, %zu hidden\n",
+    OCCLUSION_WIDTH, OCCLUSION_HEIGHT, triangles, buffer.GetTriangleCount(), tested.size(), kernelHidden);
+  printf("  frame: kernel on %u threads %.3f ms, scalar %.3f ms, %.1fx, budget %.1f ms\n",
+    OCCLUSION_THREADS, kernel, scalar, scalar / kernel, OCCLUSION_BUDGET_MS);
+  printf("  kernel average: clear %.3f ms, add %.3f ms, rasterize %.3f ms, test %.3f ms; scalar rasterize %.3f ms\n",
+    kernelStages[0], kernelStages[1], kernelStages[2], kernelStages[3], stages[2] / REPETITIONS);
+  if (hidden != kernelHidden)
+    printf("  kernel and scalar disagree!\n");
+}
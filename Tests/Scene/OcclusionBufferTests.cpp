@@ -0,0 +1,212 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/OcclusionBuffer.h"
+
+#include <cmath>
+#include <random>
+
+using namespace Scene;
+
+namespace
+{
+  const float Eye[3] = { 0.0f, 0.0f, 0.0f };
+
+  const float Identity[16] = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f };
+
+  // XMMatrixPerspectiveFovLH layout, looking down +z from the origin
+  void Perspective(float fov, float aspect, float nearZ, float farZ, float matrix[16])
+  {
+    const float height = 1.0f / std::tan(fov * 0.5f);
+    const float width = height / aspect;
+    const float range = farZ / (farZ - nearZ);
+    const float output[16] = {
+      width, 0.0f, 0.0f, 0.0f,
+      0.0f, height, 0.0f, 0.0f,
+      0.0f, 0.0f, range, 1.0f,
+      0.0f, 0.0f, -range * nearZ, 0.0f };
+    std::copy(output, output + 16, matrix);
+  }
+
+  // square facing the camera, at depth z
+  OccluderMesh Wall(float halfSize, float z)
+  {
+    OccluderMesh mesh;
+    mesh.positions = { -halfSize, -halfSize, z, halfSize, -halfSize, z, halfSize, halfSize, z, -halfSize, halfSize, z };
+    mesh.indices = { 0, 1, 2, 0, 2, 3 };
+    return mesh;
+  }
+
+  Bounds Box(float x, float y, float z, float extent)
+  {
+    return { { x, y, z }, { extent, extent, extent }, extent * 1.7320508f };
+  }
+}
+
+TEST(OcclusionBuffer, KernelMatchesScalar)
+{
+  float viewProjection[16];
+  Perspective(0.8f, 16.0f / 9.0f, 0.5f, 1000.0f, viewProjection);
+
+  // random triangles, some of them crossing the near plane
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  OccluderMesh mesh;
+  for (uint32_t i = 0; i < 6000; ++i)
+  {
+    const float center[3] = { unit(random) * 30.0f, unit(random) * 20.0f, 5.0f + (unit(random) + 1.0f) * 60.0f - (i % 7 == 0 ? 60.0f : 0.0f) };
+    for (unsigned corner = 0; corner < 3; ++corner)
+    {
+      for (unsigned axis = 0; axis < 3; ++axis)
+        mesh.positions.push_back(center[axis] + unit(random) * 8.0f);
+      mesh.indices.push_back(i * 3 + corner);
+    }
+  }
+
+  OcclusionBuffer kernel(320, 192);
+  OcclusionBuffer scalar(320, 192);
+  kernel.Clear(viewProjection, Eye);
+  scalar.Clear(viewProjection, Eye);
+  kernel.AddOccluder(mesh, Identity);
+  scalar.AddOccluder(mesh, Identity);
+  kernel.Rasterize(4);
+  scalar.RasterizeScalar();
+
+  CHECK(kernel.GetTriangleCount() > 0);
+  CHECK(kernel.GetDepth() == scalar.GetDepth());
+  CHECK(kernel.GetTiles() == scalar.GetTiles());
+}
+
+TEST(OcclusionBuffer, OnlyCoveredPixelsAreWritten)
+{
+  // clip space is the world here, x and y map straight to pixels
+  const uint32_t width = 64;
+  const uint32_t height = 32;
+  auto toClipX = [&](float pixel) { return pixel / width * 2.0f - 1.0f; };
+  auto toClipY = [&](float pixel) { return 1.0f - pixel / height * 2.0f; };
+
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> pixelX(-4.0f, width + 4.0f);
+  std::uniform_real_distribution<float> pixelY(-4.0f, height + 4.0f);
+  OcclusionBuffer buffer(width, height);
+  size_t written = 0;
+  size_t mismatches = 0;
+  for (unsigned i = 0; i < 200; ++i)
+  {
+    double corners[3][2];
+    OccluderMesh mesh;
+    for (unsigned corner = 0; corner < 3; ++corner)
+    {
+      corners[corner][0] = pixelX(random);
+      corners[corner][1] = pixelY(random);
+      mesh.positions.insert(mesh.positions.end(), { toClipX(static_cast<float>(corners[corner][0])), toClipY(static_cast<float>(corners[corner][1])), 0.5f });
+    }
+    mesh.indices = { 0, 1, 2 };
+
+    buffer.Clear(Identity, Eye);
+    buffer.AddOccluder(mesh, Identity);
+    buffer.Rasterize(2);
+
+    // a pixel is written when its four corners are inside, near misses on an edge may go either way
+    const double area = (corners[1][0] - corners[0][0]) * (corners[2][1] - corners[0][1]) - (corners[2][0] - corners[0][0]) * (corners[1][1] - corners[0][1]);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        double nearest = 1e30;
+        for (unsigned pixelCorner = 0; pixelCorner < 4; ++pixelCorner)
+        {
+          const double px = x + (pixelCorner & 1);
+          const double py = y + (pixelCorner >> 1);
+          for (unsigned edge = 0; edge < 3; ++edge)
+          {
+            const double* a = corners[edge];
+            const double* b = corners[(edge + 1) % 3];
+            const double length = std::sqrt((b[0] - a[0]) * (b[0] - a[0]) + (b[1] - a[1]) * (b[1] - a[1]));
+            const double distance = ((b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0])) / length;
+            nearest = std::min(nearest, area > 0.0 ? distance : -distance);
+          }
+        }
+        const bool covered = buffer.GetDepth()[y * width + x] < 1.0f;
+        written += covered;
+        if (std::fabs(nearest) > 1e-3 && covered != (nearest > 0.0))
+          ++mismatches;
+      }
+    }
+  }
+  CHECK(written > 0);
+  CHECK(mismatches == 0);
+
+  // a sliver thinner than a pixel covers nothing
+  OccluderMesh sliver;
+  sliver.positions = { toClipX(30.2f), toClipY(2.0f), 0.5f, toClipX(30.9f), toClipY(2.0f), 0.5f, toClipX(30.5f), toClipY(30.0f), 0.5f };
+  sliver.indices = { 0, 1, 2 };
+  buffer.Clear(Identity, Eye);
+  buffer.AddOccluder(sliver, Identity);
+  buffer.Rasterize(2);
+  bool empty = true;
+  for (float depth : buffer.GetDepth())
+    empty &= depth == 1.0f;
+  CHECK(empty);
+}
+
+TEST(OcclusionBuffer, HidesOnlyWhatIsBehind)
+{
+  float viewProjection[16];
+  Perspective(0.8f, 16.0f / 9.0f, 0.5f, 1000.0f, viewProjection);
+
+  OcclusionBuffer buffer(320, 192);
+  buffer.Clear(viewProjection, Eye);
+  buffer.AddOccluder(Wall(10.0f, 20.0f), Identity);
+  buffer.Rasterize(3);
+
+  // away from the diagonal, the two triangles of the wall leave a crack along it
+  CHECK(!buffer.IsVisible(Box(6.0f, -6.0f, 40.0f, 1.0f)));
+  CHECK(buffer.IsVisible(Box(0.0f, 0.0f, 40.0f, 1.0f)));
+  // in front, to the side, through the wall, over its edge, around the eye
+  CHECK(buffer.IsVisible(Box(0.0f, 0.0f, 10.0f, 1.0f)));
+  CHECK(buffer.IsVisible(Box(30.0f, 0.0f, 40.0f, 1.0f)));
+  CHECK(buffer.IsVisible(Box(0.0f, 0.0f, 20.0f, 1.0f)));
+  CHECK(buffer.IsVisible(Box(19.5f, 0.0f, 40.0f, 1.0f)));
+  CHECK(buffer.IsVisible(Box(0.0f, 0.0f, 0.3f, 1.0f)));
+}
+
+TEST(OcclusionBuffer, ErrorPushesTheOccluderBack)
+{
+  float viewProjection[16];
+  Perspective(0.8f, 16.0f / 9.0f, 0.5f, 1000.0f, viewProjection);
+
+  // just behind the wall, but closer than the error
+  const Bounds box = Box(4.0f, -4.0f, 20.6f, 0.2f);
+
+  OcclusionBuffer buffer(320, 192);
+  buffer.Clear(viewProjection, Eye);
+  buffer.AddOccluder(Wall(10.0f, 20.0f), Identity);
+  buffer.Rasterize(1);
+  CHECK(!buffer.IsVisible(box));
+
+  OccluderMesh coarse = Wall(10.0f, 20.0f);
+  coarse.error = 1.0f;
+  buffer.Clear(viewProjection, Eye);
+  buffer.AddOccluder(coarse, Identity);
+  buffer.Rasterize(1);
+  CHECK(buffer.IsVisible(box));
+  CHECK(!buffer.IsVisible(Box(4.0f, -4.0f, 23.0f, 0.2f)));
+
+  // the error is in mesh units, scaled with the world transform
+  const float scaled[16] = {
+    2.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 2.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 2.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f };
+  OccluderMesh half = Wall(5.0f, 10.0f);
+  half.error = 0.5f;
+  buffer.Clear(viewProjection, Eye);
+  buffer.AddOccluder(half, scaled);
+  buffer.Rasterize(1);
+  CHECK(buffer.IsVisible(box));
+}
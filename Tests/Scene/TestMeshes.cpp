@@ -0,0 +1,140 @@
+#include "stdafx.h"
+#include "Scene/TestMeshes.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace Tests
+{
+  TestMesh MakeTube(unsigned rings, unsigned segments)
+  {
+    const float Pi = 3.14159265f;
+    const float radius = 0.3f;
+
+    TestMesh output;
+    output.name = "Tube";
+    output.vertices.reserve(size_t(rings) * segments);
+
+    for (unsigned ring = 0; ring < rings; ++ring)
+    {
+      // center line on a (2, 3) torus knot
+      const float t = 2.0f * Pi * ring / rings;
+      const float r = 2.0f + std::cos(3.0f * t);
+      const float center[3] = { r * std::cos(2.0f * t), r * std::sin(2.0f * t), std::sin(3.0f * t) };
+      const float next = t + 0.001f;
+      const float nr = 2.0f + std::cos(3.0f * next);
+      float tangent[3] = { nr * std::cos(2.0f * next) - center[0], nr * std::sin(2.0f * next) - center[1], std::sin(3.0f * next) - center[2] };
+      const float tangentLength = std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+      for (float& value : tangent)
+        value /= tangentLength;
+
+      // frame around the tangent, z is never parallel to it on this knot
+      float side[3] = { tangent[1], -tangent[0], 0.0f };
+      const float sideLength = std::sqrt(side[0] * side[0] + side[1] * side[1]);
+      side[0] /= sideLength;
+      side[1] /= sideLength;
+      const float up[3] = {
+        tangent[1] * side[2] - tangent[2] * side[1],
+        tangent[2] * side[0] - tangent[0] * side[2],
+        tangent[0] * side[1] - tangent[1] * side[0] };
+
+      for (unsigned segment = 0; segment < segments; ++segment)
+      {
+        const float angle = 2.0f * Pi * segment / segments;
+        MeshVertex vertex;
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+          vertex.normal[axis] = std::cos(angle) * side[axis] + std::sin(angle) * up[axis];
+          vertex.position[axis] = center[axis] + radius * vertex.normal[axis];
+        }
+        vertex.uv[0] = float(ring) / rings * 8.0f;
+        vertex.uv[1] = float(segment) / segments;
+        output.vertices.push_back(vertex);
+      }
+    }
+
+    output.indices.reserve(size_t(rings) * segments * 6);
+    for (unsigned ring = 0; ring < rings; ++ring)
+    {
+      for (unsigned segment = 0; segment < segments; ++segment)
+      {
+        const uint32_t a = ring * segments + segment;
+        const uint32_t b = ring * segments + (segment + 1) % segments;
+        const uint32_t c = ((ring + 1) % rings) * segments + segment;
+        const uint32_t d = ((ring + 1) % rings) * segments + (segment + 1) % segments;
+        output.indices.insert(output.indices.end(), { a, c, b, b, c, d });
+      }
+    }
+
+    return output;
+  }
+
+  std::vector<TestMesh> LoadSponza()
+  {
+    const std::string path = std::string(ENGINE_ROOT_DIR) + "/Resources/models/sponza.obj";
+
+    tinyobj::attrib_t attributes;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string error;
+
+    std::vector<TestMesh> output;
+    if (tinyobj::LoadObj(&attributes, &shapes, &materials, &error, path.c_str(), nullptr, true))
+    {
+      for (const tinyobj::shape_t& shape : shapes)
+      {
+        TestMesh mesh;
+        mesh.name = "sponza.obj " + shape.name;
+
+        // obj indexes positions, normals and uvs separately, one vertex per distinct triple
+        std::map<std::tuple<int, int, int>, uint32_t> remap;
+        for (const tinyobj::index_t& index : shape.mesh.indices)
+        {
+          const auto key = std::make_tuple(index.vertex_index, index.normal_index, index.texcoord_index);
+          auto found = remap.find(key);
+          if (found == remap.end())
+          {
+            MeshVertex vertex = {};
+            for (unsigned axis = 0; axis < 3; ++axis)
+            {
+              vertex.position[axis] = attributes.vertices[3 * index.vertex_index + axis];
+              vertex.normal[axis] = index.normal_index >= 0 ? attributes.normals[3 * index.normal_index + axis] : (axis == 2 ? 1.0f : 0.0f);
+            }
+            if (index.texcoord_index >= 0)
+            {
+              vertex.uv[0] = attributes.texcoords[2 * index.texcoord_index];
+              vertex.uv[1] = attributes.texcoords[2 * index.texcoord_index + 1];
+            }
+
+            found = remap.emplace(key, uint32_t(mesh.vertices.size())).first;
+            mesh.vertices.push_back(vertex);
+          }
+          mesh.indices.push_back(found->second);
+        }
+
+        if (!mesh.indices.empty())
+          output.push_back(std::move(mesh));
+      }
+    }
+
+    if (!output.empty())
+      return output;
+
+    // about the size of sponza, 262k triangles in meshes of very different sizes
+    const unsigned sizes[][2] = { { 1024, 96 }, { 256, 64 }, { 128, 32 }, { 64, 16 }, { 32, 8 } };
+    for (const auto& size : sizes)
+    {
+      for (unsigned copy = 0; copy < (size[0] < 128 ? 8u : 1u); ++copy)
+      {
+        output.push_back(MakeTube(size[0], size[1]));
+        output.back().name = "procedural " + std::to_string(size[0]) + "x" + std::to_string(size[1]);
+      }
+    }
+
+    return output;
+  }
+}
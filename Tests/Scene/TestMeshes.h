@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Meshes for the geometry tests and benchmarks, same vertex layout as DX12Mesh::Vertex.
+namespace Tests
+{
+  struct MeshVertex
+  {
+    float position[3];
+    float normal[3];
+    float uv[2];
+  };
+
+  struct TestMesh
+  {
+    std::string name;
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+  };
+
+  // a torus knot like tube, smooth normals, rings * segments vertices
+  TestMesh MakeTube(unsigned rings, unsigned segments);
+
+  // Resources/models/sponza.obj one mesh per shape, it isn't in the repository so without it
+  // procedural meshes of about the same size are used, the name of the first mesh tells which
+  std::vector<TestMesh> LoadSponza();
+}
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/TestMeshes.h"
+#include "Scene/VertexCompression.h"
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+// every mesh of sponza like at import
+BENCHMARK(VertexCompression, EncodeSponza)
+{
+  const std::vector<Tests::TestMesh> meshes = Tests::LoadSponza();
+
+  size_t vertexCount = 0;
+  std::vector<std::vector<CompressedVertex>> encoded(meshes.size());
+  std::vector<VertexDequantization> dequantizations(meshes.size());
+  for (size_t i = 0; i < meshes.size(); ++i)
+  {
+    encoded[i].resize(meshes[i].vertices.size());
+    vertexCount += meshes[i].vertices.size();
+  }
+
+  const double encodeMilliseconds = Tests::MeasureMilliseconds(5, [&]() {
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+      const MeshVertex* vertices = meshes[i].vertices.data();
+      const size_t count = meshes[i].vertices.size();
+      dequantizations[i] = VertexCompression::ComputeDequantization(vertices[0].position, sizeof(MeshVertex), count);
+      VertexCompression::Encode(vertices[0].position, vertices[0].normal, vertices[0].uv, sizeof(MeshVertex), count, dequantizations[i], encoded[i].data());
+    }
+  });
+
+  std::vector<MeshVertex> decoded;
+  const double decodeMilliseconds = Tests::MeasureMilliseconds(5, [&]() {
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+      decoded.resize(encoded[i].size());
+      VertexCompression::Decode(encoded[i].data(), encoded[i].size(), dequantizations[i], decoded[0].position, decoded[0].normal, decoded[0].uv, sizeof(MeshVertex));
+    }
+  });
+
+  printf("  %s: %zu meshes, %zu vertices, %zu -> %zu bytes\n",
+    meshes[0].name.c_str(), meshes.size(), vertexCount, vertexCount * sizeof(MeshVertex), vertexCount * sizeof(CompressedVertex));
+  printf("  encode %.2f ms (%.1f M vertices/s), decode %.2f ms (%.1f M vertices/s)\n",
+    encodeMilliseconds, vertexCount / encodeMilliseconds / 1000.0, decodeMilliseconds, vertexCount / decodeMilliseconds / 1000.0);
+}
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Scene/TestMeshes.h"
+#include "Scene/VertexCompression.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+using namespace Scene;
+using Tests::MeshVertex;
+
+namespace
+{
+  std::vector<MeshVertex> RandomVertices(size_t count)
+  {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> wide(-40.0f, 40.0f);
+
+    std::vector<MeshVertex> output(count);
+    for (MeshVertex& vertex : output)
+    {
+      float length = 0.0f;
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        vertex.position[axis] = wide(random);
+        vertex.normal[axis] = unit(random);
+        length += vertex.normal[axis] * vertex.normal[axis];
+      }
+      for (unsigned axis = 0; axis < 3; ++axis)
+        vertex.normal[axis] /= std::sqrt(length);
+      vertex.uv[0] = unit(random) * 4.0f;
+      vertex.uv[1] = unit(random) * 4.0f;
+    }
+
+    // the axes and the folds of the octahedron
+    const float axes[][3] = { { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 } };
+    for (unsigned i = 0; i < 6; ++i)
+      memcpy(output[i].normal, axes[i], sizeof(axes[i]));
+
+    return output;
+  }
+
+  std::vector<CompressedVertex> EncodeAll(const std::vector<MeshVertex>& vertices, const VertexDequantization& dequantization)
+  {
+    std::vector<CompressedVertex> output(vertices.size());
+    VertexCompression::Encode(
+      vertices[0].position, vertices[0].normal, vertices[0].uv, sizeof(MeshVertex), vertices.size(), dequantization, output.data());
+    return output;
+  }
+}
+
+TEST(VertexCompression, ErrorBounds)
+{
+  const std::vector<MeshVertex> vertices = RandomVertices(10003);
+  const VertexDequantization dequantization = VertexCompression::ComputeDequantization(vertices[0].position, sizeof(MeshVertex), vertices.size());
+  const std::vector<CompressedVertex> encoded = EncodeAll(vertices, dequantization);
+
+  float positionError = 0.0f;
+  float normalAngle = 0.0f;
+  float uvError = 0.0f;
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    MeshVertex decoded;
+    VertexCompression::Decode(encoded[i], dequantization, decoded.position, decoded.normal, decoded.uv);
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+      positionError = std::fmax(positionError, std::fabs(decoded.position[axis] - vertices[i].position[axis]) / dequantization.positionExtent[axis]);
+
+    // from the cross product, acos of a dot close to 1 has no precision left
+    const double cross[3] = {
+      double(decoded.normal[1]) * vertices[i].normal[2] - double(decoded.normal[2]) * vertices[i].normal[1],
+      double(decoded.normal[2]) * vertices[i].normal[0] - double(decoded.normal[0]) * vertices[i].normal[2],
+      double(decoded.normal[0]) * vertices[i].normal[1] - double(decoded.normal[1]) * vertices[i].normal[0] };
+    const double sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+    normalAngle = std::fmax(normalAngle, float(std::asin(std::fmin(sine, 1.0)) * 57.29578));
+
+    // halfs keep 11 significant bits
+    for (unsigned k = 0; k < 2; ++k)
+      uvError = std::fmax(uvError, std::fabs(decoded.uv[k] - vertices[i].uv[k]) / std::fmax(std::fabs(vertices[i].uv[k]), 1.0f));
+  }
+
+  // half a step of 16 bits, a little more for the float math
+  CHECK(positionError <= 0.5f / 65535.0f * 1.01f);
+  // 16 bit octahedral is about 0.005 degrees
+  CHECK(normalAngle < 0.01f);
+  CHECK(uvError <= 1.0f / 2048.0f);
+}
+
+TEST(VertexCompression, VectorEncodeMatchesScalar)
+{
+  // 4 at a time for the most, the tail goes through the scalar path
+  const std::vector<MeshVertex> vertices = RandomVertices(1027);
+  const VertexDequantization dequantization = VertexCompression::ComputeDequantization(vertices[0].position, sizeof(MeshVertex), vertices.size());
+  const std::vector<CompressedVertex> encoded = EncodeAll(vertices, dequantization);
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    CompressedVertex single;
+    VertexCompression::Encode(vertices[i].position, vertices[i].normal, vertices[i].uv, sizeof(MeshVertex), 1, dequantization, &single);
+    mismatches += memcmp(&single, &encoded[i], sizeof(single)) != 0;
+  }
+  CHECK(mismatches == 0);
+}
+
+TEST(VertexCompression, VectorDecodeMatchesScalar)
+{
+  // every bit pattern, out of range snorms and half NaNs included
+  std::mt19937 random(3);
+  std::vector<CompressedVertex> encoded(4099);
+  for (CompressedVertex& vertex : encoded)
+  {
+    for (uint16_t& value : vertex.position)
+      value = uint16_t(random());
+    vertex.normal[0] = int16_t(random());
+    vertex.normal[1] = int16_t(random());
+    vertex.uv[0] = uint16_t(random());
+    vertex.uv[1] = uint16_t(random());
+  }
+  encoded[0].normal[0] = -32768;
+  encoded[1].uv[0] = 0x7c00;
+  encoded[2].uv[1] = 0x8001;
+
+  const VertexDequantization dequantization = { { -3.0f, 1.0f, 2.0f }, 0.0f, { 10.0f, 0.5f, 7.0f }, 0.0f };
+  std::vector<MeshVertex> decoded(encoded.size());
+  VertexCompression::Decode(encoded.data(), encoded.size(), dequantization, decoded[0].position, decoded[0].normal, decoded[0].uv, sizeof(MeshVertex));
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < encoded.size(); ++i)
+  {
+    MeshVertex single;
+    VertexCompression::Decode(encoded[i], dequantization, single.position, single.normal, single.uv);
+    mismatches += memcmp(&single, &decoded[i], sizeof(single)) != 0;
+  }
+  CHECK(mismatches == 0);
+}
+
+TEST(VertexCompression, HalfSpecialValues)
+{
+  CHECK(VertexCompression::FloatToHalf(0.0f) == 0x0000);
+  CHECK(VertexCompression::FloatToHalf(-0.0f) == 0x8000);
+  CHECK(VertexCompression::FloatToHalf(1.0f) == 0x3c00);
+  CHECK(VertexCompression::FloatToHalf(65504.0f) == 0x7bff);
+  CHECK(VertexCompression::FloatToHalf(70000.0f) == 0x7c00);
+  CHECK(VertexCompression::FloatToHalf(std::numeric_limits<float>::quiet_NaN()) == 0x7e00);
+  // smallest denormal, and ties to even
+  CHECK(VertexCompression::FloatToHalf(5.9604645e-8f) == 0x0001);
+  CHECK(VertexCompression::FloatToHalf(1.00048828125f) == 0x3c00);
+  CHECK(VertexCompression::FloatToHalf(1.00146484375f) == 0x3c02);
+
+  // every finite half goes back to itself
+  size_t mismatches = 0;
+  for (uint32_t half = 0; half < 0x10000; ++half)
+  {
+    if ((half & 0x7c00) == 0x7c00)
+      continue;
+    mismatches += VertexCompression::FloatToHalf(VertexCompression::HalfToFloat(uint16_t(half))) != half;
+  }
+  CHECK(mismatches == 0);
+}
+
+TEST(VertexCompression, FlatAxisDecodesToTheMinimum)
+{
+  std::vector<MeshVertex> vertices = RandomVertices(8);
+  for (MeshVertex& vertex : vertices)
+    vertex.position[1] = 2.5f;
+
+  const VertexDequantization dequantization = VertexCompression::ComputeDequantization(vertices[0].position, sizeof(MeshVertex), vertices.size());
+  CHECK(dequantization.positionExtent[1] > 0.0f);
+
+  const std::vector<CompressedVertex> encoded = EncodeAll(vertices, dequantization);
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    MeshVertex decoded;
+    VertexCompression::Decode(encoded[i], dequantization, decoded.position, decoded.normal, decoded.uv);
+    CHECK(decoded.position[1] == 2.5f);
+  }
+}
@@ -0,0 +1,216 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Shaders/ShaderCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace Shaders;
+namespace fs = std::filesystem;
+
+namespace
+{
+  // a fresh directory of the system temp directory for each test
+  fs::path MakeDirectory(const char* name)
+  {
+    const fs::path directory = fs::temp_directory_path() / "DX12EngineTests" / name;
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    return directory;
+  }
+
+  void WriteFile(const fs::path& path, const std::string& content)
+  {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << content;
+  }
+
+  fs::path EntryPath(const ShaderCache& cache, uint64_t key)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(key));
+    return cache.GetDirectory() / name;
+  }
+
+  std::vector<uint8_t> MakeBytecode(size_t size, uint8_t seed)
+  {
+    std::vector<uint8_t> bytecode(size);
+    for (size_t i = 0; i < size; ++i)
+      bytecode[i] = static_cast<uint8_t>(i * 7 + seed);
+    return bytecode;
+  }
+}
+
+TEST(ShaderCache, KeyCoversTheDescription)
+{
+  const fs::path directory = MakeDirectory("ShaderCacheKey");
+  WriteFile(directory / "src/a.hlsl", "float4 main() : SV_Target { return 0; }\n");
+  ShaderCache cache(directory / "cache");
+
+  const ShaderCompileDesc desc = { (directory / "src/a.hlsl").string(), "VSMain", "vs_5_0", { { "X", "1" } }, 3, "FXC 47" };
+  const uint64_t key = cache.ComputeKey(desc);
+  auto keyWith = [&](auto change)
+  {
+    ShaderCompileDesc copy = desc;
+    change(copy);
+    return cache.ComputeKey(copy);
+  };
+
+  CHECK(keyWith([](ShaderCompileDesc&) {}) == key);
+  CHECK(keyWith([](ShaderCompileDesc& copy) { copy.entryPoint = "PSMain"; }) != key);
+  CHECK(keyWith([](ShaderCompileDesc& copy) { copy.profile = "vs_5_1"; }) != key);
+  CHECK(keyWith([](ShaderCompileDesc& copy) { copy.defines.clear(); }) != key);
+  CHECK(keyWith([](ShaderCompileDesc& copy) { copy.defines = { { "X", "2" } }; }) != key);
+  // names and values don't run into each other
+  CHECK(keyWith([](ShaderCompileDesc& copy) { copy.defines = { { "X1", "" } }; }) != key);
+  CHECK(keyWith([](ShaderCompileDesc& copy) { copy.flags = 1; }) != key);
+  CHECK(keyWith([](ShaderCompileDesc& copy) { copy.compiler = "DXC"; }) != key);
+
+  // a source that isn't there can't be compiled either
+  bool thrown = false;
+  try
+  {
+    keyWith([&](ShaderCompileDesc& copy) { copy.path = (directory / "src/missing.hlsl").string(); });
+  }
+  catch (const std::invalid_argument&)
+  {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+TEST(ShaderCache, KeyFollowsIncludes)
+{
+  const fs::path directory = MakeDirectory("ShaderCacheIncludes");
+  // both include forms, a file included twice, a missing one, and a nested relative one
+  WriteFile(directory / "src/a.hlsl", "#include \"sub/b.hlsli\"\n  #  include <sub/b.hlsli>\n#include \"missing.hlsli\"\nfloat4 main() : SV_Target { return 0; }\n");
+  WriteFile(directory / "src/sub/b.hlsli", "#include \"../c.hlsli\"\n");
+  WriteFile(directory / "src/c.hlsli", "// c\n");
+  ShaderCache cache(directory / "cache");
+
+  const ShaderCompileDesc desc = { (directory / "src/a.hlsl").string(), "main", "ps_5_0", {}, 0, "FXC" };
+  std::vector<fs::path> includes;
+  const uint64_t key = cache.ComputeKey(desc, &includes);
+  REQUIRE(includes.size() == 2);
+  CHECK(includes[0] == (directory / "src/sub/b.hlsli").lexically_normal());
+  CHECK(includes[1] == (directory / "src/c.hlsli").lexically_normal());
+
+  // an edit two levels down, and back
+  WriteFile(directory / "src/c.hlsli", "// d\n");
+  CHECK(cache.ComputeKey(desc) != key);
+  WriteFile(directory / "src/c.hlsli", "// c\n");
+  CHECK(cache.ComputeKey(desc) == key);
+
+  // the missing include showing up
+  WriteFile(directory / "src/missing.hlsli", "");
+  CHECK(cache.ComputeKey(desc) != key);
+}
+
+TEST(ShaderCache, StoreAndLoad)
+{
+  const fs::path directory = MakeDirectory("ShaderCacheStore");
+  ShaderCache cache(directory / "cache");
+  const uint64_t key = 0x0123456789abcdefull;
+  const std::vector<uint8_t> bytecode = MakeBytecode(5000, 0);
+
+  std::vector<uint8_t> loaded(3, 1);
+  CHECK(!cache.Load(key, loaded));
+  CHECK(loaded.empty());
+
+  // the directory is made on the first store
+  CHECK(cache.Store(key, bytecode.data(), bytecode.size()));
+  CHECK(fs::is_directory(cache.GetDirectory()));
+  CHECK(cache.Load(key, loaded));
+  CHECK(loaded == bytecode);
+  CHECK(!cache.Load(key + 1, loaded));
+
+  // overwritten by a newer entry
+  const std::vector<uint8_t> newer = MakeBytecode(300, 5);
+  CHECK(cache.Store(key, newer.data(), newer.size()));
+  CHECK(cache.Load(key, loaded));
+  CHECK(loaded == newer);
+
+  // no temporary file left behind
+  size_t files = 0;
+  for (const auto& entry : fs::directory_iterator(cache.GetDirectory()))
+    files += entry.path().extension() == ".cso";
+  CHECK(files == 1);
+  CHECK(std::distance(fs::directory_iterator(cache.GetDirectory()), fs::directory_iterator()) == 1);
+}
+
+TEST(ShaderCache, DamagedEntriesAreMisses)
+{
+  const fs::path directory = MakeDirectory("ShaderCacheDamaged");
+  ShaderCache cache(directory / "cache");
+  const uint64_t key = 42;
+  const std::vector<uint8_t> bytecode = MakeBytecode(5000, 3);
+  const fs::path entry = EntryPath(cache, key);
+  std::vector<uint8_t> loaded;
+
+  // a flipped byte of the bytecode
+  CHECK(cache.Store(key, bytecode.data(), bytecode.size()));
+  {
+    std::fstream file(entry, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(100);
+    file.put(static_cast<char>(bytecode[100 - 32] ^ 1));
+  }
+  CHECK(!cache.Load(key, loaded));
+  CHECK(loaded.empty());
+
+  // truncated
+  CHECK(cache.Store(key, bytecode.data(), bytecode.size()));
+  fs::resize_file(entry, fs::file_size(entry) - 1);
+  CHECK(!cache.Load(key, loaded));
+
+  // an entry renamed to another key
+  CHECK(cache.Store(key, bytecode.data(), bytecode.size()));
+  fs::copy_file(entry, EntryPath(cache, 7));
+  CHECK(!cache.Load(7, loaded));
+
+  // shorter than a header
+  WriteFile(EntryPath(cache, 8), "SHCB");
+  CHECK(!cache.Load(8, loaded));
+
+  // the good one is still there
+  CHECK(cache.Load(key, loaded));
+  CHECK(loaded == bytecode);
+}
+
+TEST(ShaderCache, ConcurrentStores)
+{
+  const fs::path directory = MakeDirectory("ShaderCacheConcurrent");
+  ShaderCache cache(directory / "cache");
+  const uint64_t key = 99;
+
+  // writers of the same key and readers, a reader only ever sees a whole entry
+  std::vector<std::vector<uint8_t>> versions;
+  for (uint8_t i = 0; i < 4; ++i)
+    versions.push_back(MakeBytecode(20000 + i * 100, i));
+
+  std::atomic<int> badLoads(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < versions.size(); ++i)
+  {
+    threads.emplace_back([&, i]()
+    {
+      for (int round = 0; round < 50; ++round)
+      {
+        // may fail while another thread holds the file on some platforms, the cache is only a speed up
+        cache.Store(key, versions[i].data(), versions[i].size());
+
+        std::vector<uint8_t> loaded;
+        if (cache.Load(key, loaded) && std::find(versions.begin(), versions.end(), loaded) == versions.end())
+          badLoads.fetch_add(1);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  CHECK(badLoads.load() == 0);
+  std::vector<uint8_t> loaded;
+  CHECK(cache.Load(key, loaded));
+}
@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include "TestFramework.h"
+
+#include "Shaders/ShaderCache.h"
+#include "Shaders/ShaderWatcher.h"
+
+#include <chrono>
+#include <fstream>
+
+using namespace Shaders;
+namespace fs = std::filesystem;
+
+namespace
+{
+  fs::path MakeDirectory(const char* name)
+  {
+    const fs::path directory = fs::temp_directory_path() / "DX12EngineTests" / name;
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    return directory;
+  }
+
+  // the write time is moved on explicitly, file systems with a coarse clock would miss the change
+  void WriteFile(const fs::path& path, const std::string& content)
+  {
+    const bool existed = fs::exists(path);
+    const fs::file_time_type previous = existed ? fs::last_write_time(path) : fs::file_time_type();
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << content;
+    if (existed)
+      fs::last_write_time(path, previous + std::chrono::seconds(2));
+  }
+
+  std::vector<std::string> Names(std::initializer_list<const char*> names)
+  {
+    return std::vector<std::string>(names.begin(), names.end());
+  }
+}
+
+TEST(ShaderWatcher, DependencyGraph)
+{
+  const fs::path a = "shaders/a.hlsl";
+  const fs::path b = "shaders/b.hlsl";
+  const fs::path common = "shaders/common.hlsli";
+
+  ShaderDependencyGraph graph;
+  graph.SetDependencies("A", { a, common });
+  graph.SetDependencies("B", { b, common });
+  CHECK(graph.GetAffectedShaders({ common }) == Names({ "A", "B" }));
+  CHECK(graph.GetAffectedShaders({ b }) == Names({ "B" }));
+  CHECK(graph.GetAffectedShaders({ "shaders/other.hlsli" }).empty());
+  // spelled differently, same file
+  CHECK(graph.GetAffectedShaders({ "shaders/./sub/../common.hlsli" }) == Names({ "A", "B" }));
+
+  // replaced, not added to
+  graph.SetDependencies("A", { a });
+  CHECK(graph.GetAffectedShaders({ common }) == Names({ "B" }));
+  CHECK(graph.GetAffectedShaders({ a, b }) == Names({ "A", "B" }));
+
+  // twice is fine
+  graph.Remove("B");
+  graph.Remove("B");
+  CHECK(graph.GetAffectedShaders({ common }).empty());
+  CHECK(graph.GetAffectedShaders({ a }) == Names({ "A" }));
+}
+
+TEST(ShaderWatcher, PollsChanges)
+{
+  const fs::path directory = MakeDirectory("ShaderWatcherPoll");
+  const fs::path shaders = directory / "shaders";
+  WriteFile(shaders / "common.hlsli", "float a;\n");
+  WriteFile(shaders / "sub/x.hlsli", "#include \"../common.hlsli\"\n");
+  WriteFile(shaders / "a.hlsl", "#include \"common.hlsli\"\nvoid main() {}\n");
+  WriteFile(shaders / "b.hlsl", "  #  include <sub/x.hlsli>\n");
+  WriteFile(shaders / "c.hlsl", "void main() {}\n");
+
+  // dependencies as the shader manager finds them, the source and what the cache key followed
+  ShaderCache cache(directory / "cache");
+  ShaderDependencyGraph graph;
+  for (const char* name : { "a", "b", "c" })
+  {
+    const ShaderCompileDesc desc = { (shaders / (std::string(name) + ".hlsl")).string(), "main", "cs_5_1", {}, 0, "FXC" };
+    std::vector<fs::path> files;
+    cache.ComputeKey(desc, &files);
+    files.insert(files.begin(), fs::path(desc.path).lexically_normal());
+    graph.SetDependencies(std::string("S") + name, files);
+  }
+
+  ShaderWatcher watcher(shaders);
+  CHECK(watcher.Poll().empty());
+
+  // an include two shaders reach, one of them through another include
+  WriteFile(shaders / "common.hlsli", "float b;\n");
+  std::vector<fs::path> changed = watcher.Poll();
+  REQUIRE(changed.size() == 1);
+  CHECK(changed[0] == (shaders / "common.hlsli").lexically_normal());
+  CHECK(graph.GetAffectedShaders(changed) == Names({ "Sa", "Sb" }));
+  // reported once
+  CHECK(watcher.Poll().empty());
+
+  WriteFile(shaders / "c.hlsl", "void main() { }\n");
+  CHECK(graph.GetAffectedShaders(watcher.Poll()) == Names({ "Sc" }));
+
+  // added and removed files count too
+  WriteFile(shaders / "new.hlsli", "");
+  fs::remove(shaders / "sub/x.hlsli");
+  changed = watcher.Poll();
+  CHECK(changed.size() == 2);
+  CHECK(graph.GetAffectedShaders(changed) == Names({ "Sb" }));
+}
+
+TEST(ShaderWatcher, MissingDirectory)
+{
+  const fs::path directory = MakeDirectory("ShaderWatcherMissing");
+  ShaderWatcher watcher(directory / "nothing");
+  CHECK(watcher.Poll().empty());
+
+  // showing up later
+  WriteFile(directory / "nothing/a.hlsl", "");
+  CHECK(watcher.Poll().size() == 1);
+}
@@ -0,0 +1,61 @@
+#include "TestFramework.h"
+
+#include <exception>
+
+// helpers
+namespace
+{
+  // failures of the entry running
+  unsigned s_failures = 0;
+}
+
+namespace Tests
+{
+  std::vector<Entry>& GetTests()
+  {
+    static std::vector<Entry> tests;
+    return tests;
+  }
+
+  std::vector<Entry>& GetBenchmarks()
+  {
+    static std::vector<Entry> benchmarks;
+    return benchmarks;
+  }
+
+  void ReportFailure(const char* file, int line, const char* expression)
+  {
+    ++s_failures;
+    printf("  %s(%d): CHECK FAILED %s\n", file, line, expression);
+  }
+
+  int Run(std::vector<Entry>& entries, const std::string& filter)
+  {
+    unsigned run = 0;
+    unsigned failed = 0;
+    for (const auto& entry : entries)
+    {
+      if (!filter.empty() && filter != entry.suite)
+        continue;
+
+      printf("[%s.%s]\n", entry.suite, entry.name);
+      fflush(stdout);
+      s_failures = 0;
+      try
+      {
+        entry.function();
+      } catch (const RequireFailure&)
+      {
+      } catch (const std::exception& exception)
+      {
+        ReportFailure(__FILE__, __LINE__, exception.what());
+      }
+      ++run;
+      failed += s_failures > 0 ? 1 : 0;
+    }
+
+    printf("%u run, %u failed\n", run, failed);
+    // a filter matching nothing is a typo in the test list
+    return run == 0 || failed > 0 ? 1 : 0;
+  }
+}
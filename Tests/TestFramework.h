@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Minimal test and benchmark registry for the headless targets.
+// TEST bodies report failed CHECKs and keep going, REQUIRE stops the test.
+// BENCHMARK bodies time themselves with MeasureMilliseconds and print what they measured.
+namespace Tests
+{
+  typedef void (*Function)();
+
+  struct Entry
+  {
+    const char* suite;
+    const char* name;
+    Function function;
+  };
+
+  // thrown by REQUIRE, caught by the runner
+  struct RequireFailure
+  {
+  };
+
+  std::vector<Entry>& GetTests();
+  std::vector<Entry>& GetBenchmarks();
+
+  void ReportFailure(const char* file, int line, const char* expression);
+  // runs the entries whose suite matches filter, or all of them for an empty one
+  // returns the process exit code
+  int Run(std::vector<Entry>& entries, const std::string& filter);
+
+  struct Registrar
+  {
+    Registrar(std::vector<Entry>& entries, const char* suite, const char* name, Function function)
+    {
+      entries.push_back({ suite, name, function });
+    }
+  };
+
+  // best of repetitions, in milliseconds
+  template <typename Body>
+  double MeasureMilliseconds(int repetitions, Body&& body)
+  {
+    double best = 0.0;
+    for (int i = 0; i < repetitions; ++i)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      body();
+      const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      best = i == 0 || milliseconds < best ? milliseconds : best;
+    }
+    return best;
+  }
+}
+
+#define TESTS_CONCAT_INNER(a, b) a##b
+#define TESTS_CONCAT(a, b) TESTS_CONCAT_INNER(a, b)
+
+#define TEST(suite, name) \
+  static void TESTS_CONCAT(suite##_##name, _Test)(); \
+  static Tests::Registrar TESTS_CONCAT(suite##_##name, _TestRegistrar)(Tests::GetTests(), #suite, #name, &TESTS_CONCAT(suite##_##name, _Test)); \
+  static void TESTS_CONCAT(suite##_##name, _Test)()
+
+#define BENCHMARK(suite, name) \
+  static void TESTS_CONCAT(suite##_##name, _Benchmark)(); \
+  static Tests::Registrar TESTS_CONCAT(suite##_##name, _BenchmarkRegistrar)(Tests::GetBenchmarks(), #suite, #name, &TESTS_CONCAT(suite##_##name, _Benchmark)); \
+  static void TESTS_CONCAT(suite##_##name, _Benchmark)()
+
+#define CHECK(expression) \
+  do \
+  { \
+    if (!(expression)) \
+      Tests::ReportFailure(__FILE__, __LINE__, #expression); \
+  } while (0)
+
+#define REQUIRE(expression) \
+  do \
+  { \
+    if (!(expression)) \
+    { \
+      Tests::ReportFailure(__FILE__, __LINE__, #expression); \
+      throw Tests::RequireFailure(); \
+    } \
+  } while (0)
+
+#define CHECK_THROWS(expression, type) \
+  do \
+  { \
+    bool thrown = false; \
+    try \
+    { \
+      expression; \
+    } catch (const type&) \
+    { \
+      thrown = true; \
+    } \
+    if (!thrown) \
+      Tests::ReportFailure(__FILE__, __LINE__, #expression " throws " #type); \
+  } while (0)
@@ -0,0 +1,7 @@
+#include "TestFramework.h"
+
+// DX12EngineTests [suite]
+int main(int argc, char** argv)
+{
+  return Tests::Run(Tests::GetTests(), argc > 1 ? argv[1] : "");
+}
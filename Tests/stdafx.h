@@ -0,0 +1,79 @@
+#pragma once
+
+// headless builds of the device-free modules, in place of Src/stdafx.h
+// the few D3D12 types their headers name are declared here off Windows
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <d3d12.h>
+
+#else
+
+typedef unsigned int UINT;
+typedef uint64_t D3D12_GPU_VIRTUAL_ADDRESS;
+
+struct ID3D12PipelineState {};
+struct ID3D12RootSignature {};
+struct ID3D12DescriptorHeap {};
+
+enum D3D12_PRIMITIVE_TOPOLOGY
+{
+  D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+  D3D_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+  D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4
+};
+
+struct D3D12_VERTEX_BUFFER_VIEW
+{
+  D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+  UINT SizeInBytes;
+  UINT StrideInBytes;
+};
+
+struct D3D12_INDEX_BUFFER_VIEW
+{
+  D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+  UINT SizeInBytes;
+  UINT Format;
+};
+
+struct D3D12_GPU_DESCRIPTOR_HANDLE
+{
+  uint64_t ptr;
+};
+
+// only the calls CommandListTarget forwards
+struct ID3D12GraphicsCommandList
+{
+  void SetPipelineState(ID3D12PipelineState*) {}
+  void SetGraphicsRootSignature(ID3D12RootSignature*) {}
+  void SetDescriptorHeaps(UINT, ID3D12DescriptorHeap* const*) {}
+  void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY) {}
+  void IASetVertexBuffers(UINT, UINT, const D3D12_VERTEX_BUFFER_VIEW*) {}
+  void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW*) {}
+  void SetGraphicsRootConstantBufferView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) {}
+  void SetGraphicsRootDescriptorTable(UINT, D3D12_GPU_DESCRIPTOR_HANDLE) {}
+  void SetGraphicsRoot32BitConstants(UINT, UINT, const void*, UINT) {}
+};
+
+#endif